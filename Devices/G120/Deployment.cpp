@@ -15,6 +15,7 @@
 
 #include <LPC17.h>
 #include "../../Drivers/S25FL032_Flash/S25FL032_Flash.h"
+#include "../../Drivers/DeploymentIndex/DeploymentIndex.h"
 
 #define TOTAL_DEPLOYMENT_CONTROLLERS 1
 
@@ -35,6 +36,8 @@ struct DeploymentState {
     TinyCLR_Storage_Descriptor storageDescriptor;
     TinyCLR_Startup_DeploymentConfiguration deploymentConfiguration;
 
+    DeploymentIndex<LPC17_DEPLOYMENT_SECTOR_NUM> index;
+
     bool isOpened = false;
     bool tableInitialized = false;
 };
@@ -70,6 +73,8 @@ void LPC17_Deployment_EnsureTableInitialized() {
         deploymentStates[i].regionCount = LPC17_DEPLOYMENT_SECTOR_NUM;
 
         deploymentStates[i].tableInitialized = true;
+
+        deploymentStates[i].index.Reset();
     }
 }
 
@@ -99,7 +104,11 @@ TinyCLR_Result LPC17_Deployment_Acquire(const TinyCLR_Storage_Controller* self)
 
     TinyCLR_Spi_Controller* spiController = (TinyCLR_Spi_Controller*)spiApi->Implementation;
 
-    return S25FL032_Flash_Acquire(spiController, LPC17_DEPLOYMENT_SPI_ENABLE_PIN);
+    auto timeApi = CONCAT(DEVICE_TARGET, _Time_GetRequiredApi)();
+
+    TinyCLR_NativeTime_Controller* timerController = (TinyCLR_NativeTime_Controller*)timeApi->Implementation;
+
+    return S25FL032_Flash_Acquire(spiController, timerController, LPC17_DEPLOYMENT_SPI_ENABLE_PIN);
 }
 
 TinyCLR_Result LPC17_Deployment_Release(const TinyCLR_Storage_Controller* self) {
@@ -161,12 +170,26 @@ TinyCLR_Result LPC17_Deployment_Read(const TinyCLR_Storage_Controller* self, uin
 }
 
 TinyCLR_Result LPC17_Deployment_Write(const TinyCLR_Storage_Controller* self, uint64_t address, size_t& count, const uint8_t* data, uint64_t timeout) {
-    return S25FL032_Flash_Write(address, count, data);;
+    auto state = reinterpret_cast<DeploymentState*>(self->ApiInfo->State);
+
+    if (state->isOpened) {
+        for (auto i = 0; i < state->regionCount; i++)
+            if (state->regionAddresses[i] < address + count && address < state->regionAddresses[i] + state->regionSizes[i])
+                state->index.Invalidate(i);
+    }
+    else {
+        state->index.Reset();
+    }
+
+    return S25FL032_Flash_Write(address, count, data);
 }
 
 TinyCLR_Result LPC17_Deployment_Erase(const TinyCLR_Storage_Controller* self, uint64_t address, size_t& count, uint64_t timeout) {
+    auto state = reinterpret_cast<DeploymentState*>(self->ApiInfo->State);
     auto sector = address;
 
+    state->index.Invalidate(sector);
+
     sector += LPC17_DEPLOYMENT_SECTOR_START;
 
     return S25FL032_Flash_EraseBlock(sector);
@@ -180,6 +203,19 @@ TinyCLR_Result LPC17_Deployment_IsErased(const TinyCLR_Storage_Controller* self,
     return S25FL032_Flash_IsBlockErased(sector, erased);
 }
 
+// Content hash of a deployment sector for the debugger to compare against the image, see DeploymentIndex.h.
+TinyCLR_Result LPC17_Deployment_GetSectorHash(const TinyCLR_Storage_Controller* self, uint64_t sector, uint64_t& hash) {
+    auto state = reinterpret_cast<DeploymentState*>(self->ApiInfo->State);
+
+    if (!state->isOpened)
+        return TinyCLR_Result::InvalidOperation;
+
+    if (sector >= state->regionCount)
+        return TinyCLR_Result::IndexOutOfRange;
+
+    return DeploymentIndex_GetSectorHash(state->index, sector, static_cast<uint32_t>(state->regionAddresses[sector]), state->regionSizes[sector], &S25FL032_Flash_Read, hash);
+}
+
 TinyCLR_Result LPC17_Deployment_GetBytesPerSector(const TinyCLR_Storage_Controller* self, uint32_t address, int32_t& size) {
     return S25FL032_Flash_GetBytesPerSector(address, size);
 }
@@ -85,6 +85,7 @@
 #define STM32F4_SD_DATA3_PINS { { PIN(C, 11), AF(12) } }
 #define STM32F4_SD_CLK_PINS { { PIN(C, 12), AF(12) } }
 #define STM32F4_SD_CMD_PINS { { PIN(D, 2), AF(12) } }
+#define STM32F4_SD_DMA_STREAM DMA_STREAM(2, 3, 4)
 
 #define INCLUDE_SIGNALS
 
@@ -93,6 +94,7 @@
 #define STM32F4_SPI_SCLK_PINS { { PIN(B, 3), AF(5) }, { PIN(B, 13), AF(5) } }
 #define STM32F4_SPI_MISO_PINS { { PIN(B, 4), AF(5) }, { PIN(B, 14), AF(5) } }
 #define STM32F4_SPI_MOSI_PINS { { PIN(B, 5), AF(5) }, { PIN(B, 15), AF(5) } }
+#define STM32F4_SPI_DMA_THRESHOLD 32
 
 #define INCLUDE_STORAGE
 
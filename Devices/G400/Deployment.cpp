@@ -15,6 +15,7 @@
 
 #include <AT91.h>
 #include "../../Drivers/AT45DB321D_Flash/AT45DB321D_Flash.h"
+#include "../../Drivers/DeploymentIndex/DeploymentIndex.h"
 
 #define TOTAL_DEPLOYMENT_CONTROLLERS 1
 
@@ -31,6 +32,8 @@ struct DeploymentState {
     TinyCLR_Storage_Descriptor storageDescriptor;
     TinyCLR_Startup_DeploymentConfiguration deploymentConfiguration;
 
+    DeploymentIndex<AT91_DEPLOYMENT_SECTOR_NUM> index;
+
     bool isOpened = false;
     bool tableInitialized = false;
 };
@@ -70,6 +73,8 @@ void AT91_Deployment_EnsureTableInitialized() {
         deploymentStates[i].regionCount = AT91_DEPLOYMENT_SECTOR_NUM;
 
         deploymentStates[i].tableInitialized = true;
+
+        deploymentStates[i].index.Reset();
     }
 }
 
@@ -165,12 +170,26 @@ TinyCLR_Result AT91_Deployment_Read(const TinyCLR_Storage_Controller* self, uint
 }
 
 TinyCLR_Result AT91_Deployment_Write(const TinyCLR_Storage_Controller* self, uint64_t address, size_t& count, const uint8_t* data, uint64_t timeout) {
-    return AT45DB321D_Flash_Write(address, count, data);;
+    auto state = reinterpret_cast<DeploymentState*>(self->ApiInfo->State);
+
+    if (state->isOpened) {
+        for (auto i = 0; i < state->regionCount; i++)
+            if (state->regionAddresses[i] < address + count && address < state->regionAddresses[i] + state->regionSizes[i])
+                state->index.Invalidate(i);
+    }
+    else {
+        state->index.Reset();
+    }
+
+    return AT45DB321D_Flash_Write(address, count, data);
 }
 
 TinyCLR_Result AT91_Deployment_Erase(const TinyCLR_Storage_Controller* self, uint64_t address, size_t& count, uint64_t timeout) {
+    auto state = reinterpret_cast<DeploymentState*>(self->ApiInfo->State);
     auto sector = address;
 
+    state->index.Invalidate(sector);
+
     sector += AT91_DEPLOYMENT_SECTOR_START;
 
     return AT45DB321D_Flash_EraseBlock(sector);
@@ -184,6 +203,19 @@ TinyCLR_Result AT91_Deployment_IsErased(const TinyCLR_Storage_Controller* self,
     return AT45DB321D_Flash_IsBlockErased(sector, erased);
 }
 
+// Content hash of a deployment sector for the debugger to compare against the image, see DeploymentIndex.h.
+TinyCLR_Result AT91_Deployment_GetSectorHash(const TinyCLR_Storage_Controller* self, uint64_t sector, uint64_t& hash) {
+    auto state = reinterpret_cast<DeploymentState*>(self->ApiInfo->State);
+
+    if (!state->isOpened)
+        return TinyCLR_Result::InvalidOperation;
+
+    if (sector >= state->regionCount)
+        return TinyCLR_Result::IndexOutOfRange;
+
+    return DeploymentIndex_GetSectorHash(state->index, sector, static_cast<uint32_t>(state->regionAddresses[sector]), state->regionSizes[sector], &AT45DB321D_Flash_Read, hash);
+}
+
 TinyCLR_Result AT91_Deployment_GetBytesPerSector(const TinyCLR_Storage_Controller* self, uint32_t address, int32_t& size) {
     return AT45DB321D_Flash_GetBytesPerSector(address, size);
 }
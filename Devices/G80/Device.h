@@ -50,6 +50,8 @@
 #define STM32F4_EXT_CRYSTAL_CLOCK_HZ 12000000
 #define STM32F4_SUPPLY_VOLTAGE_MV 3300
 
+#define STM32F4_TIME_TIMER 5
+
 #define INCLUDE_ADC
 
 #define INCLUDE_CAN
@@ -104,6 +106,7 @@
 #define STM32F4_SD_DATA3_PINS { { PIN(C, 11), AF(12) } }
 #define STM32F4_SD_CLK_PINS { { PIN(C, 12), AF(12) } }
 #define STM32F4_SD_CMD_PINS { { PIN(D, 2), AF(12) } }
+#define STM32F4_SD_DMA_STREAM DMA_STREAM(2, 3, 4)
 
 #define INCLUDE_SIGNALS
 
@@ -112,6 +115,7 @@
 #define STM32F4_SPI_SCLK_PINS { { PIN(B, 3), AF(5) }, { PIN(B, 10), AF(5) } }
 #define STM32F4_SPI_MISO_PINS { { PIN(B, 4), AF(5) }, { PIN(C,  2), AF(5) } }
 #define STM32F4_SPI_MOSI_PINS { { PIN(B, 5), AF(5) }, { PIN(C,  3), AF(5) } }
+#define STM32F4_SPI_DMA_THRESHOLD 32
 
 #define INCLUDE_STORAGE
 
@@ -123,6 +127,8 @@
 #define STM32F4_UART_RX_PINS  { { PIN(A, 10), AF(7)   }, { PIN(D, 6), AF(7) }, { PIN(D,  9), AF(7) }, { PIN(A, 1), AF(8)   } }
 #define STM32F4_UART_CTS_PINS { { PIN_NONE  , AF_NONE }, { PIN(D, 3), AF(7) }, { PIN(D, 11), AF(7) }, { PIN_NONE , AF_NONE } }
 #define STM32F4_UART_RTS_PINS { { PIN_NONE  , AF_NONE }, { PIN(D, 4), AF(7) }, { PIN(D, 12), AF(7) }, { PIN_NONE , AF_NONE } }
+#define STM32F4_UART_RX_DMA
+#define STM32F4_UART_TX_DMA
 
 #define INCLUDE_USBCLIENT
 #define STM32F4_TOTAL_USB_CONTROLLERS 1
@@ -39,12 +39,34 @@
 #define AT45DB321D_FLASH_COMMAND_READ_FROM_MAIN_MEMORY_DIRECT    0xD2
 #define AT45DB321D_FLASH_COMMAND_PAGE_ERASE                      0x81
 #define AT45DB321D_FLASH_COMMAND_BLOCK_ERASE                     0x50
+#define AT45DB321D_FLASH_COMMAND_CONTINUOUS_ARRAY_READ           0x0B
+#define AT45DB321D_FLASH_COMMAND_WRITE_BUFFER_1_TO_MEMORY_NO_ERASE 0x88
+#define AT45DB321D_FLASH_COMMAND_WRITE_BUFFER_2_TO_MEMORY_NO_ERASE 0x89
+#define AT45DB321D_FLASH_COMMAND_MEMORY_TO_BUFFER_1              0x53
+#define AT45DB321D_FLASH_COMMAND_MEMORY_TO_BUFFER_2              0x55
 
 #define AT45DB321D_FLASH_COMMAND_SIZE                      4
 #define AT45DB321D_FLASH_ACCESS_TIMEOUT                    1000
 
 #define AT45DB321D_FLASH_PAGE_SIZE                         528
 #define AT45DB321D_FLASH_BLOCK_SIZE                        (528 * 8)
+#define AT45DB321D_FLASH_PAGE_PER_BLOCK                    (AT45DB321D_FLASH_BLOCK_SIZE / AT45DB321D_FLASH_PAGE_SIZE)
+
+// opcode, three address bytes and one don't care byte
+#define AT45DB321D_FLASH_READ_ARRAY_HEADER_SIZE            5
+
+// Small reads go through a cache of recently read lines. A line is a run of pages read ahead in one go, so it has to
+// divide a block evenly.
+#ifndef AT45DB321D_FLASH_CACHE_LINES
+#define AT45DB321D_FLASH_CACHE_LINES                       4
+#endif
+
+#ifndef AT45DB321D_FLASH_CACHE_LINE_PAGES
+#define AT45DB321D_FLASH_CACHE_LINE_PAGES                  2
+#endif
+
+#define AT45DB321D_FLASH_CACHE_LINE_SIZE                   (AT45DB321D_FLASH_PAGE_SIZE * AT45DB321D_FLASH_CACHE_LINE_PAGES)
+#define AT45DB321D_FLASH_CACHE_LINE_EMPTY                  0xFFFFFFFF
 
 #define AT45DB321D_FLASH_MANUFACTURER_CODE                 0x1F
 #define AT45DB321D_FLASH_DEVICE_CODE                       0x27
@@ -65,6 +87,17 @@ uint8_t g_AT45DB321D_Flash_BufferRW[(AT45DB321D_FLASH_PAGE_SIZE * 1) + AT45DB321
 uint8_t g_AT45DB321D_Flash_DataReadBuffer[AT45DB321D_FLASH_BLOCK_SIZE + 8];
 uint8_t g_AT45DB321D_Flash_DataWriteBuffer[AT45DB321D_FLASH_BLOCK_SIZE + 8];
 
+struct AT45DB321D_Flash_CacheLine {
+    uint32_t line;
+    uint32_t lastUse;
+    uint8_t data[AT45DB321D_FLASH_CACHE_LINE_SIZE];
+};
+
+AT45DB321D_Flash_CacheLine g_AT45DB321D_Flash_Cache[AT45DB321D_FLASH_CACHE_LINES];
+uint32_t g_AT45DB321D_Flash_CacheUseCount;
+
+uint32_t g_AT45DB321D_Flash_NextBuffer;
+
 uint8_t AT45DB321D_Flash_GetStatus() {
     size_t writeLength;
     size_t readLength;
@@ -80,83 +113,117 @@ uint8_t AT45DB321D_Flash_GetStatus() {
     return g_AT45DB321D_Flash_DataReadBuffer[1];
 }
 
-TinyCLR_Result AT45DB321D_Flash_Read(uint32_t address, size_t length, uint8_t* buffer) {
-    DISABLE_INTERRUPTS_SCOPED(irq);
+static void AT45DB321D_Flash_SetReadArrayCommand(uint32_t address) {
+    uint32_t pageAddress = (address % AT45DB321D_FLASH_PAGE_SIZE) | ((address / AT45DB321D_FLASH_PAGE_SIZE) << 10);
 
-    int32_t block = length / AT45DB321D_FLASH_PAGE_SIZE;
-    int32_t rest = length % AT45DB321D_FLASH_PAGE_SIZE;
-    int32_t index = 0;
-    size_t writeLength;
+    g_AT45DB321D_Flash_DataWriteBuffer[0] = AT45DB321D_FLASH_COMMAND_CONTINUOUS_ARRAY_READ;
+    g_AT45DB321D_Flash_DataWriteBuffer[1] = pageAddress >> 16;
+    g_AT45DB321D_Flash_DataWriteBuffer[2] = pageAddress >> 8;
+    g_AT45DB321D_Flash_DataWriteBuffer[3] = pageAddress;
+    g_AT45DB321D_Flash_DataWriteBuffer[4] = 0x00;
+}
+
+// Continuous array read: the chip keeps clocking out data across page boundaries for as long as chip select stays
+// low, so no status polling is needed between pages. The bytes clocked in while the header goes out land at the
+// start of the read buffer; the first page goes through the driver buffer and everything after it is read straight
+// into the caller buffer, over the tail of the first page, which is put back afterwards.
+static void AT45DB321D_Flash_ReadArray(uint32_t address, size_t length, uint8_t* buffer) {
+    size_t writeLength = AT45DB321D_FLASH_READ_ARRAY_HEADER_SIZE;
     size_t readLength;
+    size_t first = length < AT45DB321D_FLASH_PAGE_SIZE ? length : AT45DB321D_FLASH_PAGE_SIZE;
+    uint8_t header[AT45DB321D_FLASH_READ_ARRAY_HEADER_SIZE];
 
-    g_AT45DB321D_Flash_SpiProvider->Acquire(g_AT45DB321D_Flash_SpiProvider);
+    AT45DB321D_Flash_SetReadArrayCommand(address);
 
-    g_AT45DB321D_Flash_SpiProvider->SetActiveSettings(g_AT45DB321D_Flash_SpiProvider, &g_AT45DB321D_Flash_SpiSettings);
+    readLength = first + AT45DB321D_FLASH_READ_ARRAY_HEADER_SIZE;
 
-    while (block > 0) {
-        uint32_t pageNumber = (address % AT45DB321D_FLASH_PAGE_SIZE) | ((address / AT45DB321D_FLASH_PAGE_SIZE) << 10);
+    g_AT45DB321D_Flash_SpiProvider->WriteRead(g_AT45DB321D_Flash_SpiProvider, g_AT45DB321D_Flash_DataWriteBuffer, writeLength, g_AT45DB321D_Flash_DataReadBuffer, readLength, false);
 
-        g_AT45DB321D_Flash_DataWriteBuffer[0] = AT45DB321D_FLASH_COMMAND_READ_FROM_MAIN_MEMORY_LEGACY;
-        g_AT45DB321D_Flash_DataWriteBuffer[1] = pageNumber >> 16;
-        g_AT45DB321D_Flash_DataWriteBuffer[2] = pageNumber >> 8;
-        g_AT45DB321D_Flash_DataWriteBuffer[3] = pageNumber;
-        g_AT45DB321D_Flash_DataWriteBuffer[4] = 0x00;
-        g_AT45DB321D_Flash_DataWriteBuffer[5] = 0x00;
-        g_AT45DB321D_Flash_DataWriteBuffer[6] = 0x00;
-        g_AT45DB321D_Flash_DataWriteBuffer[7] = 0x00;
+    memcpy(buffer, &g_AT45DB321D_Flash_DataReadBuffer[AT45DB321D_FLASH_READ_ARRAY_HEADER_SIZE], first);
 
-        writeLength = AT45DB321D_FLASH_PAGE_SIZE + 8;
-        readLength = AT45DB321D_FLASH_PAGE_SIZE + 8;
+    if (first == length)
+        return;
 
-        g_AT45DB321D_Flash_SpiProvider->WriteRead(g_AT45DB321D_Flash_SpiProvider, g_AT45DB321D_Flash_DataWriteBuffer, writeLength, g_AT45DB321D_Flash_DataReadBuffer, readLength, false);
+    auto to = buffer + first - AT45DB321D_FLASH_READ_ARRAY_HEADER_SIZE;
 
-        int32_t timeout;
+    memcpy(header, to, AT45DB321D_FLASH_READ_ARRAY_HEADER_SIZE);
 
-        for (timeout = 0; timeout < AT45DB321D_FLASH_ACCESS_TIMEOUT; timeout++) {
-            if (AT45DB321D_Flash_GetStatus() & 0x80)
-                break;
+    AT45DB321D_Flash_SetReadArrayCommand(address + first);
 
-            g_AT45DB321D_Flash_TimeProvider->Wait(g_AT45DB321D_Flash_TimeProvider, g_AT45DB321D_Flash_TimeProvider->ConvertSystemTimeToNativeTime(g_AT45DB321D_Flash_TimeProvider, 1000));
-        }
+    writeLength = AT45DB321D_FLASH_READ_ARRAY_HEADER_SIZE;
+    readLength = length - first + AT45DB321D_FLASH_READ_ARRAY_HEADER_SIZE;
 
-        memcpy(&buffer[index], &g_AT45DB321D_Flash_DataReadBuffer[8], AT45DB321D_FLASH_PAGE_SIZE);
+    g_AT45DB321D_Flash_SpiProvider->WriteRead(g_AT45DB321D_Flash_SpiProvider, g_AT45DB321D_Flash_DataWriteBuffer, writeLength, to, readLength, false);
 
-        address += AT45DB321D_FLASH_PAGE_SIZE;
-        index += AT45DB321D_FLASH_PAGE_SIZE;
-        block--;
+    memcpy(to, header, AT45DB321D_FLASH_READ_ARRAY_HEADER_SIZE);
+}
+
+static void AT45DB321D_Flash_InvalidateCache(uint32_t pageNumber, uint32_t pageCount) {
+    for (auto i = 0; i < AT45DB321D_FLASH_CACHE_LINES; i++) {
+        auto& entry = g_AT45DB321D_Flash_Cache[i];
+        auto firstPage = entry.line * AT45DB321D_FLASH_CACHE_LINE_PAGES;
+
+        if (entry.line != AT45DB321D_FLASH_CACHE_LINE_EMPTY && firstPage < pageNumber + pageCount && pageNumber < firstPage + AT45DB321D_FLASH_CACHE_LINE_PAGES)
+            entry.line = AT45DB321D_FLASH_CACHE_LINE_EMPTY;
     }
+}
+
+// Returns the cached line, reading it in over the least recently used one when it is not cached and load is set.
+static AT45DB321D_Flash_CacheLine* AT45DB321D_Flash_GetCacheLine(uint32_t line, bool load) {
+    AT45DB321D_Flash_CacheLine* victim = &g_AT45DB321D_Flash_Cache[0];
 
-    if (rest > 0) {
-        uint32_t pageNumber = (address % AT45DB321D_FLASH_PAGE_SIZE) | ((address / AT45DB321D_FLASH_PAGE_SIZE) << 10);
+    for (auto i = 0; i < AT45DB321D_FLASH_CACHE_LINES; i++) {
+        auto& entry = g_AT45DB321D_Flash_Cache[i];
 
-        g_AT45DB321D_Flash_DataWriteBuffer[0] = AT45DB321D_FLASH_COMMAND_READ_FROM_MAIN_MEMORY_LEGACY;
-        g_AT45DB321D_Flash_DataWriteBuffer[1] = pageNumber >> 16;
-        g_AT45DB321D_Flash_DataWriteBuffer[2] = pageNumber >> 8;
-        g_AT45DB321D_Flash_DataWriteBuffer[3] = pageNumber;
-        g_AT45DB321D_Flash_DataWriteBuffer[4] = 0x00;
-        g_AT45DB321D_Flash_DataWriteBuffer[5] = 0x00;
-        g_AT45DB321D_Flash_DataWriteBuffer[6] = 0x00;
-        g_AT45DB321D_Flash_DataWriteBuffer[7] = 0x00;
+        if (entry.line == line) {
+            entry.lastUse = ++g_AT45DB321D_Flash_CacheUseCount;
 
-        writeLength = rest + 8;
-        readLength = rest + 8;
+            return &entry;
+        }
 
-        g_AT45DB321D_Flash_SpiProvider->WriteRead(g_AT45DB321D_Flash_SpiProvider, g_AT45DB321D_Flash_DataWriteBuffer, writeLength, g_AT45DB321D_Flash_DataReadBuffer, readLength, false);
+        if (victim->line != AT45DB321D_FLASH_CACHE_LINE_EMPTY && (entry.line == AT45DB321D_FLASH_CACHE_LINE_EMPTY || entry.lastUse < victim->lastUse))
+            victim = &entry;
+    }
 
-        int32_t timeout;
+    if (!load)
+        return nullptr;
 
-        for (timeout = 0; timeout < AT45DB321D_FLASH_ACCESS_TIMEOUT; timeout++) {
-            if (AT45DB321D_Flash_GetStatus() & 0x80)
-                break;
+    AT45DB321D_Flash_ReadArray(line * AT45DB321D_FLASH_CACHE_LINE_SIZE, AT45DB321D_FLASH_CACHE_LINE_SIZE, victim->data);
 
-            g_AT45DB321D_Flash_TimeProvider->Wait(g_AT45DB321D_Flash_TimeProvider, g_AT45DB321D_Flash_TimeProvider->ConvertSystemTimeToNativeTime(g_AT45DB321D_Flash_TimeProvider, 1000));
+    victim->line = line;
+    victim->lastUse = ++g_AT45DB321D_Flash_CacheUseCount;
+
+    return victim;
+}
+
+TinyCLR_Result AT45DB321D_Flash_Read(uint32_t address, size_t length, uint8_t* buffer) {
+    DISABLE_INTERRUPTS_SCOPED(irq);
+
+    g_AT45DB321D_Flash_SpiProvider->Acquire(g_AT45DB321D_Flash_SpiProvider);
+
+    g_AT45DB321D_Flash_SpiProvider->SetActiveSettings(g_AT45DB321D_Flash_SpiProvider, &g_AT45DB321D_Flash_SpiSettings);
+
+    while (length > 0) {
+        uint32_t offset = address % AT45DB321D_FLASH_CACHE_LINE_SIZE;
+        size_t count = AT45DB321D_FLASH_CACHE_LINE_SIZE - offset;
+
+        if (count > length)
+            count = length;
+
+        // what is left of a long read is streamed in one go, only short reads are worth caching
+        auto entry = AT45DB321D_Flash_GetCacheLine(address / AT45DB321D_FLASH_CACHE_LINE_SIZE, length < AT45DB321D_FLASH_CACHE_LINE_SIZE);
+
+        if (entry == nullptr) {
+            AT45DB321D_Flash_ReadArray(address, length, buffer);
+
+            break;
         }
 
-        memcpy(&buffer[index], &g_AT45DB321D_Flash_DataReadBuffer[8], rest);
+        memcpy(buffer, &entry->data[offset], count);
 
-        address += rest;
-        index += rest;
-        block--;
+        address += count;
+        buffer += count;
+        length -= count;
     }
 
     g_AT45DB321D_Flash_SpiProvider->Release(g_AT45DB321D_Flash_SpiProvider);
@@ -164,42 +231,80 @@ TinyCLR_Result AT45DB321D_Flash_Read(uint32_t address, size_t length, uint8_t* b
     return TinyCLR_Result::Success;
 }
 
-bool AT45DB321D_Flash_WriteSector(uint32_t pageNumber, uint8_t* dataBuffer) {
-    size_t writeLength;
-    size_t readLength;
+static bool AT45DB321D_Flash_WaitReady() {
+    int32_t timeout;
 
-    g_AT45DB321D_Flash_DataWriteBuffer[0] = AT45DB321D_FLASH_COMMAND_WRITE_BUFFER_1;
-    g_AT45DB321D_Flash_DataWriteBuffer[1] = 0x00;
-    g_AT45DB321D_Flash_DataWriteBuffer[2] = 0x00;
-    g_AT45DB321D_Flash_DataWriteBuffer[3] = 0x00;
+    for (timeout = 0; timeout < AT45DB321D_FLASH_ACCESS_TIMEOUT; timeout++) {
+        if (AT45DB321D_Flash_GetStatus() & 0x80)
+            return true;
 
-    memcpy(&g_AT45DB321D_Flash_DataWriteBuffer[4], dataBuffer, AT45DB321D_FLASH_PAGE_SIZE);
+        g_AT45DB321D_Flash_TimeProvider->Wait(g_AT45DB321D_Flash_TimeProvider, g_AT45DB321D_Flash_TimeProvider->ConvertSystemTimeToNativeTime(g_AT45DB321D_Flash_TimeProvider, 1000));
+    }
 
-    writeLength = AT45DB321D_FLASH_COMMAND_SIZE + AT45DB321D_FLASH_PAGE_SIZE;
-    readLength = AT45DB321D_FLASH_COMMAND_SIZE + AT45DB321D_FLASH_PAGE_SIZE;
+    return false;
+}
 
-    g_AT45DB321D_Flash_SpiProvider->WriteRead(g_AT45DB321D_Flash_SpiProvider, g_AT45DB321D_Flash_DataWriteBuffer, writeLength, g_AT45DB321D_Flash_DataReadBuffer, readLength, false);
+static void AT45DB321D_Flash_PageCommand(uint8_t command, uint32_t pageNumber) {
+    size_t writeLength = AT45DB321D_FLASH_COMMAND_SIZE;
+    size_t readLength = AT45DB321D_FLASH_COMMAND_SIZE;
 
-    g_AT45DB321D_Flash_DataWriteBuffer[0] = 0x88;
+    g_AT45DB321D_Flash_DataWriteBuffer[0] = command;
     g_AT45DB321D_Flash_DataWriteBuffer[1] = (pageNumber << 2) >> 8;
     g_AT45DB321D_Flash_DataWriteBuffer[2] = pageNumber << 2;
     g_AT45DB321D_Flash_DataWriteBuffer[3] = 0x00;
 
-    writeLength = AT45DB321D_FLASH_COMMAND_SIZE;
-    readLength = AT45DB321D_FLASH_COMMAND_SIZE;
+    g_AT45DB321D_Flash_SpiProvider->WriteRead(g_AT45DB321D_Flash_SpiProvider, g_AT45DB321D_Flash_DataWriteBuffer, writeLength, g_AT45DB321D_Flash_DataReadBuffer, readLength, false);
+}
+
+// Writing a SRAM buffer is allowed while the chip programs from the other one.
+static void AT45DB321D_Flash_LoadBuffer(uint32_t buffer, uint32_t offset, const uint8_t* data, size_t length) {
+    size_t writeLength = AT45DB321D_FLASH_COMMAND_SIZE + length;
+    size_t readLength = AT45DB321D_FLASH_COMMAND_SIZE + length;
+
+    g_AT45DB321D_Flash_DataWriteBuffer[0] = buffer == 0 ? AT45DB321D_FLASH_COMMAND_WRITE_BUFFER_1 : AT45DB321D_FLASH_COMMAND_WRITE_BUFFER_2;
+    g_AT45DB321D_Flash_DataWriteBuffer[1] = 0x00;
+    g_AT45DB321D_Flash_DataWriteBuffer[2] = offset >> 8;
+    g_AT45DB321D_Flash_DataWriteBuffer[3] = offset;
+
+    memcpy(&g_AT45DB321D_Flash_DataWriteBuffer[AT45DB321D_FLASH_COMMAND_SIZE], data, length);
 
     g_AT45DB321D_Flash_SpiProvider->WriteRead(g_AT45DB321D_Flash_SpiProvider, g_AT45DB321D_Flash_DataWriteBuffer, writeLength, g_AT45DB321D_Flash_DataReadBuffer, readLength, false);
+}
 
-    int32_t timeout;
+// Programs length bytes at offset into a page and returns without waiting for the programming to finish. The two
+// SRAM buffers are used in turn, so the next page is loaded while the previous one is still being programmed.
+// A partial page is first filled with what the page holds and programmed with the built in erase, so the bytes
+// around the written ones are kept whatever they are. Whole pages go to blocks that were erased beforehand and are
+// programmed without the erase, which takes a fraction of the time.
+bool AT45DB321D_Flash_WriteSector(uint32_t pageNumber, uint32_t offset, const uint8_t* data, size_t length) {
+    auto buffer = g_AT45DB321D_Flash_NextBuffer;
+    auto partial = length < AT45DB321D_FLASH_PAGE_SIZE;
 
-    for (timeout = 0; timeout < AT45DB321D_FLASH_ACCESS_TIMEOUT; timeout++) {
-        if (AT45DB321D_Flash_GetStatus() & 0x80)
-            return true;
+    g_AT45DB321D_Flash_NextBuffer ^= 1;
 
-        g_AT45DB321D_Flash_TimeProvider->Wait(g_AT45DB321D_Flash_TimeProvider, g_AT45DB321D_Flash_TimeProvider->ConvertSystemTimeToNativeTime(g_AT45DB321D_Flash_TimeProvider, 1000));
+    AT45DB321D_Flash_InvalidateCache(pageNumber, 1);
+
+    if (partial) {
+        if (!AT45DB321D_Flash_WaitReady())
+            return false;
+
+        AT45DB321D_Flash_PageCommand(buffer == 0 ? AT45DB321D_FLASH_COMMAND_MEMORY_TO_BUFFER_1 : AT45DB321D_FLASH_COMMAND_MEMORY_TO_BUFFER_2, pageNumber);
+
+        if (!AT45DB321D_Flash_WaitReady())
+            return false;
     }
 
-    return false;
+    AT45DB321D_Flash_LoadBuffer(buffer, offset, data, length);
+
+    if (!AT45DB321D_Flash_WaitReady())
+        return false;
+
+    if (partial)
+        AT45DB321D_Flash_PageCommand(buffer == 0 ? AT45DB321D_FLASH_COMMAND_WRITE_BUFFER_1_TO_MEMORY : AT45DB321D_FLASH_COMMAND_WRITE_BUFFER_2_TO_MEMORY, pageNumber);
+    else
+        AT45DB321D_Flash_PageCommand(buffer == 0 ? AT45DB321D_FLASH_COMMAND_WRITE_BUFFER_1_TO_MEMORY_NO_ERASE : AT45DB321D_FLASH_COMMAND_WRITE_BUFFER_2_TO_MEMORY_NO_ERASE, pageNumber);
+
+    return true;
 }
 
 TinyCLR_Result AT45DB321D_Flash_Write(uint32_t address, size_t length, const uint8_t* buffer) {
@@ -207,63 +312,33 @@ TinyCLR_Result AT45DB321D_Flash_Write(uint32_t address, size_t length, const uin
 
     uint32_t pageNumber = address / AT45DB321D_FLASH_PAGE_SIZE;
     uint32_t pageOffset = address % AT45DB321D_FLASH_PAGE_SIZE;
-    uint32_t currentIndex = 0;
-    uint32_t remainingBytes = length;
-    uint32_t beginningBytes = AT45DB321D_FLASH_PAGE_SIZE - pageOffset;
-    uint32_t remainingBytesPageSegmentSize = AT45DB321D_FLASH_PAGE_SIZE - pageOffset;
+    bool success = true;
 
     g_AT45DB321D_Flash_SpiProvider->Acquire(g_AT45DB321D_Flash_SpiProvider);
 
     g_AT45DB321D_Flash_SpiProvider->SetActiveSettings(g_AT45DB321D_Flash_SpiProvider, &g_AT45DB321D_Flash_SpiSettings);
 
-    if (pageOffset) {
-        memset(g_AT45DB321D_Flash_BufferRW, 0xFF, AT45DB321D_FLASH_PAGE_SIZE);
+    while (length > 0 && success) {
+        size_t count = AT45DB321D_FLASH_PAGE_SIZE - pageOffset;
 
-        if (length <= remainingBytesPageSegmentSize) {
-            memcpy(&g_AT45DB321D_Flash_BufferRW[pageOffset], &buffer[currentIndex], length);
+        if (count > length)
+            count = length;
 
-            remainingBytes -= length;
-        }
-        else {
-            memcpy(&g_AT45DB321D_Flash_BufferRW[pageOffset], &buffer[currentIndex], beginningBytes);
-
-            currentIndex += beginningBytes;
-            remainingBytes -= beginningBytes;
-        }
-
-        AT45DB321D_Flash_WriteSector(pageNumber, g_AT45DB321D_Flash_BufferRW);
+        success = AT45DB321D_Flash_WriteSector(pageNumber, pageOffset, buffer, count);
 
+        buffer += count;
+        length -= count;
+        pageOffset = 0;
         pageNumber++;
     }
 
-    if (!remainingBytes)
-        TinyCLR_Result::Success;
-
-    uint32_t sector = remainingBytes / AT45DB321D_FLASH_PAGE_SIZE;
-
-    while (sector) {
-        memset(g_AT45DB321D_Flash_BufferRW, 0xFF, AT45DB321D_FLASH_PAGE_SIZE);
-        memcpy(g_AT45DB321D_Flash_BufferRW, &buffer[currentIndex], AT45DB321D_FLASH_PAGE_SIZE);
-
-        AT45DB321D_Flash_WriteSector(pageNumber, g_AT45DB321D_Flash_BufferRW);
-
-        currentIndex += AT45DB321D_FLASH_PAGE_SIZE;
-        remainingBytes -= AT45DB321D_FLASH_PAGE_SIZE;
-        sector--;
-        pageNumber++;
-    }
-
-    if (!remainingBytes)
-        TinyCLR_Result::Success;
-
-    memset(g_AT45DB321D_Flash_BufferRW, 0xFF, AT45DB321D_FLASH_PAGE_SIZE);
-    memcpy(g_AT45DB321D_Flash_BufferRW, &buffer[currentIndex], remainingBytes);
-
-    AT45DB321D_Flash_WriteSector(pageNumber, g_AT45DB321D_Flash_BufferRW);
+    // the last page is still programming
+    if (success)
+        success = AT45DB321D_Flash_WaitReady();
 
     g_AT45DB321D_Flash_SpiProvider->Release(g_AT45DB321D_Flash_SpiProvider);
 
-    TinyCLR_Result::Success;
+    return success ? TinyCLR_Result::Success : TinyCLR_Result::InvalidOperation;
 }
 
 TinyCLR_Result AT45DB321D_Flash_IsBlockErased(uint32_t sector, bool &erased) {
@@ -271,18 +346,22 @@ TinyCLR_Result AT45DB321D_Flash_IsBlockErased(uint32_t sector, bool &erased) {
     uint32_t startAddress = g_AT45DB321D_Flash_SectorAddress[sector];
 
     int32_t block = AT45DB321D_FLASH_BLOCK_SIZE / AT45DB321D_FLASH_PAGE_SIZE;
-    int32_t rest = AT45DB321D_FLASH_BLOCK_SIZE % AT45DB321D_FLASH_PAGE_SIZE;
 
     erased = true;
 
-    while (block > 0) {
-        AT45DB321D_Flash_Read(startAddress, AT45DB321D_FLASH_PAGE_SIZE, g_AT45DB321D_Flash_BufferRW);
+    g_AT45DB321D_Flash_SpiProvider->Acquire(g_AT45DB321D_Flash_SpiProvider);
+
+    g_AT45DB321D_Flash_SpiProvider->SetActiveSettings(g_AT45DB321D_Flash_SpiProvider, &g_AT45DB321D_Flash_SpiSettings);
+
+    // a block scan would only push the useful lines out of the cache
+    while (block > 0 && erased) {
+        AT45DB321D_Flash_ReadArray(startAddress, AT45DB321D_FLASH_PAGE_SIZE, g_AT45DB321D_Flash_BufferRW);
 
         for (auto i = 0; i < AT45DB321D_FLASH_PAGE_SIZE; i++) {
             if (g_AT45DB321D_Flash_BufferRW[i] != 0xFF) {
                 erased = false;
 
-                return TinyCLR_Result::Success;
+                break;
             }
         }
 
@@ -291,17 +370,7 @@ TinyCLR_Result AT45DB321D_Flash_IsBlockErased(uint32_t sector, bool &erased) {
         startAddress += AT45DB321D_FLASH_PAGE_SIZE;
     }
 
-    if (rest > 0) {
-        AT45DB321D_Flash_Read(startAddress, rest, g_AT45DB321D_Flash_BufferRW);
-
-        for (auto i = 0; i < rest; i++) {
-            if (g_AT45DB321D_Flash_BufferRW[i] != 0xFF) {
-                erased = false;
-
-                return TinyCLR_Result::Success;
-            }
-        }
-    }
+    g_AT45DB321D_Flash_SpiProvider->Release(g_AT45DB321D_Flash_SpiProvider);
 
     return TinyCLR_Result::Success;
 }
@@ -314,6 +383,8 @@ TinyCLR_Result AT45DB321D_Flash_EraseBlock(uint32_t sector) {
 
     uint32_t blockNumber = g_AT45DB321D_Flash_SectorAddress[sector] / (AT45DB321D_FLASH_BLOCK_SIZE);
 
+    AT45DB321D_Flash_InvalidateCache(blockNumber * AT45DB321D_FLASH_PAGE_PER_BLOCK, AT45DB321D_FLASH_PAGE_PER_BLOCK);
+
     g_AT45DB321D_Flash_SpiProvider->Acquire(g_AT45DB321D_Flash_SpiProvider);
 
     g_AT45DB321D_Flash_SpiProvider->SetActiveSettings(g_AT45DB321D_Flash_SpiProvider, &g_AT45DB321D_Flash_SpiSettings);
@@ -355,6 +426,9 @@ TinyCLR_Result AT45DB321D_Flash_Acquire(const TinyCLR_Spi_Controller* spiProvide
 
     g_AT45DB321D_Flash_SpiChipSelectLine = chipSelectLine;
 
+    for (auto i = 0; i < AT45DB321D_FLASH_CACHE_LINES; i++)
+        g_AT45DB321D_Flash_Cache[i].line = AT45DB321D_FLASH_CACHE_LINE_EMPTY;
+
     g_AT45DB321D_Flash_SpiProvider->Acquire(g_AT45DB321D_Flash_SpiProvider);
 
     g_AT45DB321D_Flash_SpiSettings.Mode = TinyCLR_Spi_Mode::Mode0;
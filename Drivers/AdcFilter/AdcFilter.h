@@ -0,0 +1,82 @@
+// Copyright GHI Electronics, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+
+// Filters for ADC drivers that take a handful of conversions per read. Both are O(n); the median reorders
+// the samples in place.
+
+// Moves the k-th smallest sample to samples[k] with only smaller or equal ones before it, average O(n).
+inline void AdcFilter_Select(uint32_t* samples, int32_t count, int32_t k) {
+    auto left = 0;
+    auto right = count - 1;
+
+    while (left < right) {
+        auto pivot = samples[(left + right) / 2];
+        auto i = left;
+        auto j = right;
+
+        while (i <= j) {
+            while (samples[i] < pivot) i++;
+            while (samples[j] > pivot) j--;
+
+            if (i <= j) {
+                auto t = samples[i];
+
+                samples[i++] = samples[j];
+                samples[j--] = t;
+            }
+        }
+
+        // [left, j] <= pivot, [i, right] >= pivot and anything in between equals it
+        if (k <= j)
+            right = j;
+        else if (k >= i)
+            left = i;
+        else
+            break;
+    }
+}
+
+// The median averaged with its two neighbours in sorted order, spikes in either direction are dropped. Needs at
+// least 3 samples; with 5 this is the middle three of a sorted read.
+inline uint32_t AdcFilter_Median(uint32_t* samples, int32_t count) {
+    auto middle = count / 2;
+
+    AdcFilter_Select(samples, count, middle);
+
+    // the neighbours are the largest below the median and the smallest above it
+    auto below = samples[0];
+    auto above = samples[middle + 1];
+
+    for (auto i = 1; i < middle; i++)
+        if (samples[i] > below) below = samples[i];
+
+    for (auto i = middle + 2; i < count; i++)
+        if (samples[i] < above) above = samples[i];
+
+    return (below + samples[middle] + above) / 3;
+}
+
+// The rounded mean of all samples, which suits white noise better than the median.
+inline uint32_t AdcFilter_Mean(const uint32_t* samples, int32_t count) {
+    uint32_t sum = 0;
+
+    for (auto i = 0; i < count; i++)
+        sum += samples[i];
+
+    return (sum + count / 2) / count;
+}
@@ -0,0 +1,62 @@
+// Copyright GHI Electronics, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Register programming of the timer triggered regular sequence scan on the STM32F4 and STM32F7 ADC, whose
+// converters are laid out alike. The trigger timer is set up with TriggerTimer_Program. The register blocks are template parameters so the host tests can pass plain
+// ones; the bit names are the CMSIS ones from the device header included before this file.
+
+#define ADC_SCAN_MAX_SEQUENCE_LENGTH 16
+
+// peripheral to memory in halfwords, circular, half and full transfer and error interrupts
+#define ADC_SCAN_DMA_CONFIGURATION (DMA_SxCR_PL_1 | DMA_SxCR_MSIZE_0 | DMA_SxCR_PSIZE_0 | DMA_SxCR_MINC | DMA_SxCR_CIRC | DMA_SxCR_HTIE | DMA_SxCR_TCIE | DMA_SxCR_TEIE)
+
+// Each half of the buffer holds whole scans, NDTR is 16 bits.
+inline bool AdcScan_IsValidLength(size_t channelCount, size_t length) {
+    return channelCount > 0 && channelCount <= ADC_SCAN_MAX_SEQUENCE_LENGTH && length > 0 && length % (channelCount * 2) == 0 && length <= 0xFFFF;
+}
+
+// Loads channels as the regular sequence and turns scan mode on, the converter is left on without a trigger.
+template<typename Adc> void AdcScan_ProgramSequence(Adc& adc, const uint32_t* channels, size_t channelCount) {
+    // ranks 1 - 6 go to SQR3, 7 - 12 to SQR2 and 13 - 16 to SQR1 next to the sequence length
+    uint32_t sequence[3] = { 0, 0, 0 };
+
+    for (auto i = 0u; i < channelCount; i++)
+        sequence[i / 6] |= channels[i] << ((i % 6) * 5);
+
+    adc.CR2 = ADC_CR2_ADON;
+    adc.SR = 0;
+    adc.SQR3 = sequence[0];
+    adc.SQR2 = sequence[1];
+    adc.SQR1 = sequence[2] | ((channelCount - 1) * ADC_SQR1_L_0);
+    adc.CR1 = ADC_CR1_SCAN;
+}
+
+// Lets the rising edge of external trigger extsel start the sequence, each conversion asks the DMA to fetch it.
+template<typename Adc> void AdcScan_EnableTrigger(Adc& adc, uint32_t extsel) {
+    // DDS keeps the DMA requests going past the end of the buffer
+    adc.CR2 = ADC_CR2_ADON | ADC_CR2_DMA | ADC_CR2_DDS | ADC_CR2_EXTEN_0 | (extsel * ADC_CR2_EXTSEL_0);
+}
+
+// Back to the single software started conversion of one channel.
+template<typename Adc> void AdcScan_Reset(Adc& adc) {
+    adc.CR2 = ADC_CR2_ADON;
+    adc.CR1 = 0;
+    adc.SQR1 = 0;
+    adc.SR = 0;
+}
@@ -0,0 +1,57 @@
+// Copyright GHI Electronics, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Pieces of the DAC streaming output that do not depend on the part. A stream buffer is played in two halves.
+
+// Counter reload for a converter paced straight from clockHz, rounded to the nearest tick. frequency is updated to
+// the rate the counter really runs at.
+inline uint32_t DacStream_GetTicks(uint32_t clockHz, double& frequency) {
+    auto ticks = (uint32_t)(clockHz / frequency + 0.5);
+
+    frequency = (double)clockHz / ticks;
+
+    return ticks;
+}
+
+// Fills the two linked list items of a GPDMA channel that moves the halves of buffer, length samples in all, to
+// destination. control holds everything but the transfer size, which is the half. The second item links back to
+// the first in a circular stream and ends the chain otherwise. Item is the controller's list item layout.
+template<typename Item> void DacStream_LinkHalves(Item* items, const uint16_t* buffer, size_t length, volatile void* destination, uint32_t control, bool circular) {
+    typedef decltype(items[0].next) Address;
+
+    auto count = length / 2;
+
+    for (auto i = 0; i < 2; i++) {
+        items[i].source = (Address)(uintptr_t)(buffer + i * count);
+        items[i].destination = (Address)(uintptr_t)destination;
+        items[i].control = control | count;
+    }
+
+    items[0].next = (Address)(uintptr_t)&items[1];
+    items[1].next = circular ? (Address)(uintptr_t)&items[0] : 0;
+}
+
+// Loads the first item of the chain into the channel registers and enables it with configuration.
+template<typename Channel, typename Item> void DacStream_StartChannel(Channel& channel, const Item& first, uint32_t configuration) {
+    channel.CSrcAddr = first.source;
+    channel.CDestAddr = first.destination;
+    channel.CLLI = first.next;
+    channel.CControl = first.control;
+    channel.CConfig = configuration;
+}
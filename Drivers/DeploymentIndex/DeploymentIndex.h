@@ -0,0 +1,115 @@
+// Copyright GHI Electronics, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <TinyCLR.h>
+#include <stdint.h>
+#include <string.h>
+
+// Content hashes of the deployment sectors. The debugger asks for the hash of a sector before deploying into it and
+// leaves the sector alone when it matches what it was going to write, so only the changed sectors are erased and
+// programmed.
+//
+// The hash is 64 bit FNV-1a taken over the whole sector as little endian 32 bit words, a tail that is not a
+// multiple of four bytes is taken a byte at a time. The host computes the same over the image padded with 0xFF
+// to the sector size.
+
+#define DEPLOYMENT_INDEX_HASH_BASIS 14695981039346656037ULL
+#define DEPLOYMENT_INDEX_HASH_PRIME 1099511628211ULL
+
+// Continues hash over length more bytes. Only the last piece of a sector may have a length that is not a multiple
+// of four.
+inline uint64_t DeploymentIndex_Hash(uint64_t hash, const uint8_t* data, size_t length) {
+    for (; length >= 4; length -= 4, data += 4) {
+        hash ^= (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+        hash *= DEPLOYMENT_INDEX_HASH_PRIME;
+    }
+
+    for (; length > 0; length--) {
+        hash ^= *data++;
+        hash *= DEPLOYMENT_INDEX_HASH_PRIME;
+    }
+
+    return hash;
+}
+
+// Hashes of the sectors computed so far. They are only kept in RAM: the flash is what counts, a hash is worked
+// out from it the first time it is asked for and dropped whenever the sector is written or erased.
+template <size_t N> struct DeploymentIndex {
+    uint64_t hashes[N];
+    uint32_t known[(N + 31) / 32];
+
+    void Reset() {
+        memset(this->known, 0, sizeof(this->known));
+    }
+
+    bool Get(size_t sector, uint64_t& hash) const {
+        if (sector >= N || (this->known[sector / 32] & (1UL << (sector % 32))) == 0)
+            return false;
+
+        hash = this->hashes[sector];
+
+        return true;
+    }
+
+    void Set(size_t sector, uint64_t hash) {
+        if (sector >= N)
+            return;
+
+        this->hashes[sector] = hash;
+        this->known[sector / 32] |= 1UL << (sector % 32);
+    }
+
+    void Invalidate(size_t sector) {
+        if (sector < N)
+            this->known[sector / 32] &= ~(1UL << (sector % 32));
+    }
+};
+
+// Flash that is not memory mapped is hashed through its driver's read, a chunk at a time from a stack buffer.
+typedef TinyCLR_Result(*DeploymentIndex_ReadFunction)(uint32_t address, size_t length, uint8_t* buffer);
+
+#ifndef DEPLOYMENT_INDEX_READ_CHUNK_SIZE
+#define DEPLOYMENT_INDEX_READ_CHUNK_SIZE 512
+#endif
+
+// Hash of the sector of size bytes at address, from index when it is known there, else read and kept in index.
+// A failed read is returned and nothing is kept.
+template <size_t N> TinyCLR_Result DeploymentIndex_GetSectorHash(DeploymentIndex<N>& index, size_t sector, uint32_t address, size_t size, DeploymentIndex_ReadFunction read, uint64_t& hash) {
+    if (index.Get(sector, hash))
+        return TinyCLR_Result::Success;
+
+    uint8_t buffer[DEPLOYMENT_INDEX_READ_CHUNK_SIZE];
+    auto value = DEPLOYMENT_INDEX_HASH_BASIS;
+
+    while (size > 0) {
+        auto length = size < sizeof(buffer) ? size : sizeof(buffer);
+        auto result = read(address, length, buffer);
+
+        if (result != TinyCLR_Result::Success)
+            return result;
+
+        value = DeploymentIndex_Hash(value, buffer, length);
+
+        address += length;
+        size -= length;
+    }
+
+    hash = value;
+
+    index.Set(sector, hash);
+
+    return TinyCLR_Result::Success;
+}
@@ -0,0 +1,153 @@
+// Copyright GHI Electronics, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+// 16bpp copy and rotation kernels shared by the display drivers. Strides are in pixels. Pixels are stored
+// in pairs as one 32-bit access whenever the destination allows it; the ARM9 parts fault on unaligned
+// words, so the pair accesses are only made on 4 byte boundaries.
+
+#define DISPLAY_BLIT_STRIP_ROWS 16
+
+typedef uint32_t __attribute__((__may_alias__)) DisplayBlit_PixelPair;
+
+// Copies a rows x columns block, rows that are contiguous on both sides are merged into a single copy.
+inline void DisplayBlit_Copy(uint16_t* to, int32_t toStride, const uint16_t* from, int32_t fromStride, int32_t columns, int32_t rows) {
+    if (toStride == columns && fromStride == columns) {
+        memcpy(to, from, columns * rows * sizeof(uint16_t));
+
+        return;
+    }
+
+    for (auto row = 0; row < rows; row++) {
+        memcpy(to, from, columns * sizeof(uint16_t));
+
+        to += toStride;
+        from += fromStride;
+    }
+}
+
+// 90 degree rotations. Destination pixel (column, row) takes from[column * columnStep + row * rowStep]; rowStep
+// is +-1 and columnStep a source line. The destination is walked in strips of DISPLAY_BLIT_STRIP_ROWS rows and
+// two columns at a time, so every source read continues a run of adjacent pixels and every destination write
+// is a pixel pair, while only a strip's worth of destination lines is in flight.
+inline void DisplayBlit_Rotate90(uint16_t* to, int32_t toStride, const uint16_t* from, int32_t columnStep, int32_t rowStep, int32_t columns, int32_t rows) {
+    for (auto strip = 0; strip < rows; strip += DISPLAY_BLIT_STRIP_ROWS) {
+        auto stripRows = rows - strip < DISPLAY_BLIT_STRIP_ROWS ? rows - strip : DISPLAY_BLIT_STRIP_ROWS;
+        auto d = to + strip * toStride;
+        auto s = from + strip * rowStep;
+        auto column = 0;
+
+        // destination rows only share the alignment of the first when the line pitch is even
+        auto pairs = (toStride & 0x01) == 0;
+
+        if (pairs && ((uintptr_t)d & 0x02)) {
+            for (auto row = 0; row < stripRows; row++)
+                d[row * toStride] = s[row * rowStep];
+
+            column++;
+        }
+
+        for (; pairs && column + 1 < columns; column += 2) {
+            auto s0 = s + column * columnStep;
+            auto s1 = s0 + columnStep;
+            auto d0 = d + column;
+
+            for (auto row = 0; row < stripRows; row++) {
+                *(DisplayBlit_PixelPair*)d0 = *s0 | ((uint32_t)*s1 << 16);
+
+                d0 += toStride;
+                s0 += rowStep;
+                s1 += rowStep;
+            }
+        }
+
+        for (; column < columns; column++) {
+            for (auto row = 0; row < stripRows; row++)
+                d[row * toStride + column] = s[column * columnStep + row * rowStep];
+        }
+    }
+}
+
+// 180 degree rotation. from points at the last pixel of the first source row to use, rows and pixels are
+// read backwards.
+inline void DisplayBlit_Rotate180(uint16_t* to, int32_t toStride, const uint16_t* from, int32_t fromStride, int32_t columns, int32_t rows) {
+    for (auto row = 0; row < rows; row++) {
+        auto d = to;
+        auto s = from;
+        auto count = columns;
+
+        if (count > 0 && ((uintptr_t)d & 0x02)) {
+            *d++ = *s--;
+            count--;
+        }
+
+        if (((uintptr_t)(s - 1) & 0x03) == 0) {
+            // both sides aligned: one word read and a halfword swap per pair
+            while (count >= 2) {
+                auto pair = *(const DisplayBlit_PixelPair*)(s - 1);
+
+                *(DisplayBlit_PixelPair*)d = (pair >> 16) | (pair << 16);
+
+                d += 2;
+                s -= 2;
+                count -= 2;
+            }
+        }
+        else {
+            while (count >= 2) {
+                *(DisplayBlit_PixelPair*)d = s[0] | ((uint32_t)s[-1] << 16);
+
+                d += 2;
+                s -= 2;
+                count -= 2;
+            }
+        }
+
+        if (count > 0)
+            *d = *s;
+
+        to += toStride;
+        from -= fromStride;
+    }
+}
+
+// Bounding box of what was drawn into a frame buffer, in frame buffer coordinates. Used by the double buffered
+// drivers to carry the last presented changes over into the other buffer instead of copying whole frames.
+struct DisplayBlit_Region {
+    int32_t left;
+    int32_t top;
+    int32_t right;
+    int32_t bottom;
+
+    void Reset() {
+        this->left = this->top = INT32_MAX;
+        this->right = this->bottom = INT32_MIN;
+    }
+
+    bool IsEmpty() const { return this->left >= this->right || this->top >= this->bottom; }
+
+    void Include(int32_t x, int32_t y, int32_t width, int32_t height) {
+        if (width <= 0 || height <= 0)
+            return;
+
+        if (x < this->left) this->left = x;
+        if (y < this->top) this->top = y;
+        if (x + width > this->right) this->right = x + width;
+        if (y + height > this->bottom) this->bottom = y + height;
+    }
+};
@@ -0,0 +1,28 @@
+// Copyright GHI Electronics, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+
+// Fixed point duty cycles for the PWM drivers. A duty cycle is a Q16 fraction of the period, PWM_DUTY_FULL_SCALE is
+// always on.
+
+#define PWM_DUTY_FULL_SCALE (1 << 16)
+
+// Compare value for dutyCycle of a period of periodTicks timer ticks, rounded down. dutyCycle must not be above
+// PWM_DUTY_FULL_SCALE, so the result is never more than periodTicks.
+inline uint32_t PwmDuty_GetCompare(uint32_t dutyCycle, uint32_t periodTicks) {
+    return (uint32_t)(((uint64_t)dutyCycle * periodTicks) >> 16);
+}
@@ -0,0 +1,51 @@
+// Copyright GHI Electronics, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../PwmDuty/PwmDuty.h"
+
+// Pattern encoders for the PWM sequencers. dutyCycles holds length Q16 values frame after frame, a frame has one
+// value for each channel the sequence drives, and the pattern keeps that order. Values above PWM_DUTY_FULL_SCALE
+// are taken as full scale.
+
+// STM32 timers: one compare value per sample, Sample is the width of the compare registers. The polarity is applied
+// by the timer and is not part of the pattern.
+template<typename Sample> void PwmSequence_EncodeCompare(const uint32_t* dutyCycles, size_t length, uint32_t periodTicks, Sample* pattern) {
+    for (auto i = 0u; i < length; i++) {
+        auto dutyCycle = dutyCycles[i] > PWM_DUTY_FULL_SCALE ? PWM_DUTY_FULL_SCALE : dutyCycles[i];
+
+        pattern[i] = (Sample)PwmDuty_GetCompare(dutyCycle, periodTicks);
+    }
+}
+
+// LPC17 PWM: one 32 bit match value per sample. Bit n of activeLow is set when the n-th channel of a frame is
+// inverted, its duty cycle is encoded as the rest of the period. Full scale is a match past the period end, which
+// never clears the output, and zero clears it with the period start.
+inline void PwmSequence_EncodeMatch(const uint32_t* dutyCycles, size_t length, uint32_t channelCount, uint32_t activeLow, uint32_t periodTicks, uint32_t* pattern) {
+    for (auto i = 0u; i < length; i++) {
+        auto dutyCycle = dutyCycles[i] > PWM_DUTY_FULL_SCALE ? PWM_DUTY_FULL_SCALE : dutyCycles[i];
+
+        if (activeLow & (1 << (i % channelCount)))
+            dutyCycle = PWM_DUTY_FULL_SCALE - dutyCycle;
+
+        if (dutyCycle == PWM_DUTY_FULL_SCALE)
+            pattern[i] = periodTicks + 1;
+        else
+            pattern[i] = PwmDuty_GetCompare(dutyCycle, periodTicks);
+    }
+}
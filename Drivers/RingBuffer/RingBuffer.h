@@ -0,0 +1,213 @@
+// Copyright GHI Electronics, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stddef.h>
+#include <string.h>
+
+// Keeps the compiler from moving slot accesses across an index update. Producer and consumer run on the
+// same core (thread and interrupt), so no hardware barrier is needed for them to agree on ordering. Code that
+// runs the two sides on different cores, like the host tests, defines it as a full fence first.
+#ifndef RING_BUFFER_BARRIER
+#define RING_BUFFER_BARRIER() __asm__ __volatile__("" ::: "memory")
+#endif
+
+// Single producer, single consumer ring. The producer only writes head and the consumer only writes tail,
+// so one side can be an interrupt handler and the other thread code without either masking interrupts.
+// Capacity is a power of two; head and tail run free and are masked on access, which lets every slot be
+// used and makes Count a single subtraction.
+template<typename T> class RingBuffer {
+    T* storage;
+    size_t mask;
+
+    volatile size_t head;
+    volatile size_t tail;
+
+public:
+    // Smallest power of two that holds at least size items.
+    static size_t GetCapacityFor(size_t size) {
+        size_t capacity = 1;
+
+        while (capacity < size)
+            capacity <<= 1;
+
+        return capacity;
+    }
+
+    // capacity must come from GetCapacityFor. Neither side may be running.
+    void Initialize(T* buffer, size_t capacity) {
+        this->storage = buffer;
+        this->mask = buffer != nullptr ? capacity - 1 : 0;
+        this->head = 0;
+        this->tail = 0;
+    }
+
+    void Uninitialize() {
+        this->Initialize(nullptr, 0);
+    }
+
+    T* GetStorage() const { return this->storage; }
+    size_t GetCapacity() const { return this->storage != nullptr ? this->mask + 1 : 0; }
+
+    size_t GetCount() const {
+        auto count = this->head - this->tail;
+
+        // a producer that cannot be held back (DMA) may overrun; never report more than fits
+        return count <= this->mask + 1 ? count : this->mask + 1;
+    }
+
+    size_t GetFree() const { return this->GetCapacity() - this->GetCount(); }
+    bool IsEmpty() const { return this->head == this->tail; }
+    bool IsFull() const { return this->storage == nullptr || this->GetCount() == this->GetCapacity(); }
+
+    // Producer side
+
+    bool Push(const T& item) {
+        if (this->IsFull())
+            return false;
+
+        this->storage[this->head & this->mask] = item;
+
+        RING_BUFFER_BARRIER();
+
+        this->head = this->head + 1;
+
+        return true;
+    }
+
+    size_t PushN(const T* items, size_t count) {
+        auto space = this->GetFree();
+
+        if (count > space)
+            count = space;
+
+        if (count == 0)
+            return 0;
+
+        auto index = this->head & this->mask;
+        auto first = (this->mask + 1) - index;
+
+        if (first > count)
+            first = count;
+
+        memcpy(&this->storage[index], items, first * sizeof(T));
+        memcpy(&this->storage[0], items + first, (count - first) * sizeof(T));
+
+        RING_BUFFER_BARRIER();
+
+        this->head = this->head + count;
+
+        return count;
+    }
+
+    // Free slots that can be filled in place before wrapping; publish them with Commit.
+    T* GetWriteSpan(size_t& count) {
+        auto index = this->head & this->mask;
+        auto contiguous = (this->mask + 1) - index;
+        auto space = this->GetFree();
+
+        count = contiguous < space ? contiguous : space;
+
+        return count > 0 ? &this->storage[index] : nullptr;
+    }
+
+    void Commit(size_t count) {
+        RING_BUFFER_BARRIER();
+
+        this->head = this->head + count;
+    }
+
+    size_t GetHeadIndex() const { return this->head & this->mask; }
+
+    // Consumer side
+
+    bool Pop(T& item) {
+        if (this->IsEmpty())
+            return false;
+
+        item = this->storage[this->tail & this->mask];
+
+        RING_BUFFER_BARRIER();
+
+        this->tail = this->tail + 1;
+
+        return true;
+    }
+
+    size_t PopN(T* items, size_t count) {
+        auto available = this->GetCount();
+
+        if (count > available)
+            count = available;
+
+        if (count == 0)
+            return 0;
+
+        auto index = this->tail & this->mask;
+        auto first = (this->mask + 1) - index;
+
+        if (first > count)
+            first = count;
+
+        memcpy(items, &this->storage[index], first * sizeof(T));
+        memcpy(items + first, &this->storage[0], (count - first) * sizeof(T));
+
+        RING_BUFFER_BARRIER();
+
+        this->tail = this->tail + count;
+
+        return count;
+    }
+
+    // Oldest item, nullptr when empty.
+    T* Peek() {
+        return this->IsEmpty() ? nullptr : &this->storage[this->tail & this->mask];
+    }
+
+    // Queued items that can be read in place before wrapping; release them with Consume.
+    T* GetReadSpan(size_t& count) {
+        auto index = this->tail & this->mask;
+        auto contiguous = (this->mask + 1) - index;
+        auto available = this->GetCount();
+
+        count = contiguous < available ? contiguous : available;
+
+        return count > 0 ? &this->storage[index] : nullptr;
+    }
+
+    void Consume(size_t count) {
+        RING_BUFFER_BARRIER();
+
+        this->tail = this->tail + count;
+    }
+
+    // After a producer that cannot be held back (DMA) has lapped the consumer, moves up to the oldest item
+    // that was not overwritten. Returns true if anything was lost.
+    bool SkipOverwritten() {
+        auto head = this->head;
+
+        if (head - this->tail <= this->mask + 1)
+            return false;
+
+        this->tail = head - (this->mask + 1);
+
+        return true;
+    }
+
+    // Drops everything queued so far.
+    void Discard() {
+        this->tail = this->head;
+    }
+};
@@ -20,12 +20,26 @@
 
 #define SPI_CLOCK_RATE_HZ 20000000
 
+// Busy polling backs off from the first to the last interval (system time, 100ns units), doubling every time.
+#define S25FL032_FLASH_POLL_FIRST_INTERVAL 200
+#define S25FL032_FLASH_POLL_LAST_INTERVAL 10000
+
+#define S25FL032_FLASH_PROGRAM_TIMEOUT 500000
+#define S25FL032_FLASH_ERASE_TIMEOUT 50000000
+
+#define S25FL032_FLASH_WRITE_ENABLE_RETRIES 10
+
+// IsBlockErased reads a sector in chunks of this size
+#define S25FL032_FLASH_ERASE_CHECK_SIZE (4 * 1024)
+
 const TinyCLR_Spi_Controller* s25fl032FlashSpiProvider;
+const TinyCLR_NativeTime_Controller* s25fl032FlashTimeProvider;
 static uint32_t s25fl032FlashSpiChipSelectLine;
 static TinyCLR_Spi_Settings s25fl032FlashSpiSettings;
 
-static uint8_t s25fl032FlashDataReadBuffer[S25FL032_FLASH_SECTOR_SIZE + 4];
-static uint8_t s25fl032FlashDataWriteBuffer[S25FL032_FLASH_SECTOR_SIZE + 4];
+// Reads land S25FL032_FLASH_FAST_READ_HEADER_SIZE bytes in, the first three bytes keep the data word aligned.
+static uint8_t __attribute__((aligned(4))) s25fl032FlashDataReadBuffer[S25FL032_FLASH_ERASE_CHECK_SIZE + 8];
+static uint8_t s25fl032FlashDataWriteBuffer[ALIGNMENT_WINDOW + 4];
 
 static uint64_t s25fl032FlashSectorAddress[S25FL032_FLASH_SECTOR_NUM];
 static size_t s25fl032FlashSectorSize[S25FL032_FLASH_SECTOR_NUM];
@@ -68,114 +82,117 @@ bool S25FL032_Flash_WriteInProgress() {
         return false;
 }
 
-TinyCLR_Result S25FL032_Flash_Read(uint32_t address, size_t length, uint8_t* buffer) {
-    DISABLE_INTERRUPTS_SCOPED(irq);
+// Waits for the program or erase in progress to finish, for up to timeout (system time).
+static bool S25FL032_Flash_WaitReady(uint64_t timeout) {
+    uint64_t interval = S25FL032_FLASH_POLL_FIRST_INTERVAL;
+    uint64_t elapsed = 0;
 
-    s25fl032FlashSpiProvider->Acquire(s25fl032FlashSpiProvider);
+    while (S25FL032_Flash_WriteInProgress()) {
+        if (elapsed >= timeout)
+            return false;
 
-    s25fl032FlashSpiProvider->SetActiveSettings(s25fl032FlashSpiProvider, &s25fl032FlashSpiSettings);
+        s25fl032FlashTimeProvider->Wait(s25fl032FlashTimeProvider, s25fl032FlashTimeProvider->ConvertSystemTimeToNativeTime(s25fl032FlashTimeProvider, interval));
 
-    while (S25FL032_Flash_WriteInProgress() == true);
+        elapsed += interval;
 
-    int32_t block = length / S25FL032_FLASH_SECTOR_SIZE;
-    int32_t rest = length % S25FL032_FLASH_SECTOR_SIZE;
-    int32_t index = 0;
-    size_t writeLength = S25FL032_FLASH_SECTOR_SIZE + 4;
-    size_t readLength = S25FL032_FLASH_SECTOR_SIZE + 4;
+        if (interval < S25FL032_FLASH_POLL_LAST_INTERVAL)
+            interval *= 2;
+    }
 
-    while (block > 0) {
-        s25fl032FlashDataWriteBuffer[0] = S25FL032_FLASH_COMMAND_READ_DATA;
-        s25fl032FlashDataWriteBuffer[1] = (uint8_t)((address) >> 16);
-        s25fl032FlashDataWriteBuffer[2] = (uint8_t)((address) >> 8);
-        s25fl032FlashDataWriteBuffer[3] = (uint8_t)((address) >> 0);
+    return true;
+}
+
+static bool S25FL032_Flash_EnableWrite() {
+    for (auto retries = 0; retries < S25FL032_FLASH_WRITE_ENABLE_RETRIES; retries++) {
+        if (S25FL032_Flash_WriteEnable())
+            return true;
+    }
 
-        writeLength = S25FL032_FLASH_SECTOR_SIZE + 4;
-        readLength = S25FL032_FLASH_SECTOR_SIZE + 4;
+    return false;
+}
+
+// Sends a FAST_READ for length bytes. The bytes clocked in while the header goes out come first, the data starts
+// S25FL032_FLASH_FAST_READ_HEADER_SIZE bytes into to.
+static void S25FL032_Flash_FastRead(uint32_t address, uint8_t* to, size_t length) {
+    size_t writeLength = S25FL032_FLASH_FAST_READ_HEADER_SIZE;
+    size_t readLength = length + S25FL032_FLASH_FAST_READ_HEADER_SIZE;
 
-        // start to read
-        s25fl032FlashSpiProvider->WriteRead(s25fl032FlashSpiProvider, s25fl032FlashDataWriteBuffer, writeLength, s25fl032FlashDataReadBuffer, readLength, false);
+    s25fl032FlashDataWriteBuffer[0] = S25FL032_FLASH_COMMAND_FAST_READ;
+    s25fl032FlashDataWriteBuffer[1] = (uint8_t)((address) >> 16);
+    s25fl032FlashDataWriteBuffer[2] = (uint8_t)((address) >> 8);
+    s25fl032FlashDataWriteBuffer[3] = (uint8_t)((address) >> 0);
+    s25fl032FlashDataWriteBuffer[4] = 0x00;
 
-        // copy to buffer
-        memcpy(&buffer[index], &s25fl032FlashDataReadBuffer[4], S25FL032_FLASH_SECTOR_SIZE);
+    s25fl032FlashSpiProvider->WriteRead(s25fl032FlashSpiProvider, s25fl032FlashDataWriteBuffer, writeLength, to, readLength, false);
+}
+
+TinyCLR_Result S25FL032_Flash_Read(uint32_t address, size_t length, uint8_t* buffer) {
+    DISABLE_INTERRUPTS_SCOPED(irq);
 
-        address += S25FL032_FLASH_SECTOR_SIZE;
-        index += S25FL032_FLASH_SECTOR_SIZE;
-        block--;
+    auto result = TinyCLR_Result::Success;
 
+    s25fl032FlashSpiProvider->Acquire(s25fl032FlashSpiProvider);
+
+    s25fl032FlashSpiProvider->SetActiveSettings(s25fl032FlashSpiProvider, &s25fl032FlashSpiSettings);
+
+    if (!S25FL032_Flash_WaitReady(S25FL032_FLASH_ERASE_TIMEOUT)) {
+        result = TinyCLR_Result::InvalidOperation;
     }
+    else if (length > 0) {
+        // the first page goes through the driver buffer, the rest is read in one go straight into the caller
+        // buffer, over the tail of the first page that is put back afterwards
+        size_t first = length < ALIGNMENT_WINDOW ? length : ALIGNMENT_WINDOW;
 
-    if (rest > 0) {
-        s25fl032FlashDataWriteBuffer[0] = S25FL032_FLASH_COMMAND_READ_DATA;
-        s25fl032FlashDataWriteBuffer[1] = (uint8_t)((address) >> 16);
-        s25fl032FlashDataWriteBuffer[2] = (uint8_t)((address) >> 8);
-        s25fl032FlashDataWriteBuffer[3] = (uint8_t)((address) >> 0);
+        S25FL032_Flash_FastRead(address, s25fl032FlashDataReadBuffer, first);
+
+        memcpy(buffer, &s25fl032FlashDataReadBuffer[S25FL032_FLASH_FAST_READ_HEADER_SIZE], first);
 
-        writeLength = rest + 4;
-        readLength = rest + 4;
+        if (first < length) {
+            uint8_t header[S25FL032_FLASH_FAST_READ_HEADER_SIZE];
+            auto to = buffer + first - S25FL032_FLASH_FAST_READ_HEADER_SIZE;
 
-        // start to read
-        s25fl032FlashSpiProvider->WriteRead(s25fl032FlashSpiProvider, s25fl032FlashDataWriteBuffer, writeLength, s25fl032FlashDataReadBuffer, readLength, false);
+            memcpy(header, to, S25FL032_FLASH_FAST_READ_HEADER_SIZE);
 
-        // copy to buffer
-        memcpy(&buffer[index], &s25fl032FlashDataReadBuffer[4], rest);
+            S25FL032_Flash_FastRead(address + first, to, length - first);
 
-        address += rest;
-        index += rest;
-        rest = 0;
+            memcpy(to, header, S25FL032_FLASH_FAST_READ_HEADER_SIZE);
+        }
     }
 
     s25fl032FlashSpiProvider->Release(s25fl032FlashSpiProvider);
 
-    return index == length ? TinyCLR_Result::Success : TinyCLR_Result::InvalidOperation;
+    return result;
 }
 
+// Programs the data one page at a time, never across a 256 byte page boundary.
 TinyCLR_Result S25FL032_Flash_PageProgram(uint32_t byteAddress, uint32_t NumberOfBytesToWrite, const uint8_t * pointerToWriteBuffer) {
+    while (NumberOfBytesToWrite > 0) {
+        uint32_t block_size = ALIGNMENT_WINDOW - (byteAddress % ALIGNMENT_WINDOW);
 
-    uint32_t addr = byteAddress;
-    uint32_t addr_misalignment = addr % ALIGNMENT_WINDOW;
-    uint32_t extended_size = NumberOfBytesToWrite + addr_misalignment;
-    uint32_t block_cnt = extended_size / ALIGNMENT_WINDOW + (extended_size % ALIGNMENT_WINDOW > 0 ? 1 : 0);
-    uint32_t block_size;
-    uint32_t source_index = 0;
+        if (block_size > NumberOfBytesToWrite)
+            block_size = NumberOfBytesToWrite;
 
-    if (extended_size > ALIGNMENT_WINDOW)
-        block_size = ALIGNMENT_WINDOW - addr_misalignment;
-    else
-        block_size = extended_size - addr_misalignment;
-
-    while (block_cnt > 0) {
-        while (S25FL032_Flash_WriteEnable() == false);
+        if (!S25FL032_Flash_WaitReady(S25FL032_FLASH_PROGRAM_TIMEOUT) || !S25FL032_Flash_EnableWrite())
+            return TinyCLR_Result::InvalidOperation;
 
         s25fl032FlashDataWriteBuffer[0] = S25FL032_FLASH_COMMAND_PAGE_PROGRAMMING; //0x2
-        s25fl032FlashDataWriteBuffer[1] = (uint8_t)(addr >> 16);
-        s25fl032FlashDataWriteBuffer[2] = (uint8_t)(addr >> 8);
-        s25fl032FlashDataWriteBuffer[3] = (uint8_t)(addr >> 0);
+        s25fl032FlashDataWriteBuffer[1] = (uint8_t)(byteAddress >> 16);
+        s25fl032FlashDataWriteBuffer[2] = (uint8_t)(byteAddress >> 8);
+        s25fl032FlashDataWriteBuffer[3] = (uint8_t)(byteAddress >> 0);
 
         size_t actualWrite = block_size + 4;
         size_t actualRead = 0;
 
-        memcpy(&s25fl032FlashDataWriteBuffer[4], pointerToWriteBuffer + source_index, block_size);
+        memcpy(&s25fl032FlashDataWriteBuffer[4], pointerToWriteBuffer, block_size);
 
-        // Write cmd to Write
         s25fl032FlashSpiProvider->WriteRead(s25fl032FlashSpiProvider, s25fl032FlashDataWriteBuffer, actualWrite, nullptr, actualRead, false);
 
-        while (S25FL032_Flash_WriteInProgress() == true);
-
-        //-------------Next Round----------------//
-        block_cnt--;
-        source_index += block_size;
-        addr += block_size;
-
-        if ((NumberOfBytesToWrite - source_index) > ALIGNMENT_WINDOW)
-            block_size = ALIGNMENT_WINDOW;
-        else
-            block_size = NumberOfBytesToWrite - source_index;
+        byteAddress += block_size;
+        pointerToWriteBuffer += block_size;
+        NumberOfBytesToWrite -= block_size;
     }
 
-    if ((NumberOfBytesToWrite - source_index) == 0)
-        return TinyCLR_Result::Success;
-    else
-        return TinyCLR_Result::InvalidOperation;
+    return S25FL032_Flash_WaitReady(S25FL032_FLASH_PROGRAM_TIMEOUT) ? TinyCLR_Result::Success : TinyCLR_Result::InvalidOperation;
 }
 
 TinyCLR_Result S25FL032_Flash_Write(uint32_t address, size_t length, const uint8_t* buffer) {
@@ -208,12 +225,27 @@ TinyCLR_Result S25FL032_Flash_IsBlockErased(uint32_t sector, bool &erased) {
     DISABLE_INTERRUPTS_SCOPED(irq);
 
     uint32_t address = s25fl032FlashSectorAddress[sector];
+    uint32_t *ptr = (uint32_t*)&s25fl032FlashDataReadBuffer[8];
 
-    S25FL032_Flash_Read(address, S25FL032_FLASH_SECTOR_SIZE, s25fl032FlashDataReadBuffer);
+    erased = true;
 
-    uint32_t *ptr = (uint32_t*)& s25fl032FlashDataReadBuffer;
+    s25fl032FlashSpiProvider->Acquire(s25fl032FlashSpiProvider);
 
-    erased = CompareArrayValueToValue(ptr, 0xFFFFFFFF, S25FL032_FLASH_SECTOR_SIZE / 4);
+    s25fl032FlashSpiProvider->SetActiveSettings(s25fl032FlashSpiProvider, &s25fl032FlashSpiSettings);
+
+    if (!S25FL032_Flash_WaitReady(S25FL032_FLASH_ERASE_TIMEOUT)) {
+        s25fl032FlashSpiProvider->Release(s25fl032FlashSpiProvider);
+
+        return TinyCLR_Result::InvalidOperation;
+    }
+
+    for (auto offset = 0; offset < S25FL032_FLASH_SECTOR_SIZE && erased; offset += S25FL032_FLASH_ERASE_CHECK_SIZE) {
+        S25FL032_Flash_FastRead(address + offset, &s25fl032FlashDataReadBuffer[3], S25FL032_FLASH_ERASE_CHECK_SIZE);
+
+        erased = CompareArrayValueToValue(ptr, 0xFFFFFFFF, S25FL032_FLASH_ERASE_CHECK_SIZE / 4);
+    }
+
+    s25fl032FlashSpiProvider->Release(s25fl032FlashSpiProvider);
 
     return TinyCLR_Result::Success;
 }
@@ -221,32 +253,39 @@ TinyCLR_Result S25FL032_Flash_IsBlockErased(uint32_t sector, bool &erased) {
 TinyCLR_Result S25FL032_Flash_EraseBlock(uint32_t sector) {
     DISABLE_INTERRUPTS_SCOPED(irq);
 
+    auto result = TinyCLR_Result::Success;
+
     s25fl032FlashSpiProvider->Acquire(s25fl032FlashSpiProvider);
 
     s25fl032FlashSpiProvider->SetActiveSettings(s25fl032FlashSpiProvider, &s25fl032FlashSpiSettings);
 
-    while (S25FL032_Flash_WriteEnable() == false);
-
-    uint32_t address = s25fl032FlashSectorAddress[sector];
+    if (!S25FL032_Flash_WaitReady(S25FL032_FLASH_ERASE_TIMEOUT) || !S25FL032_Flash_EnableWrite()) {
+        result = TinyCLR_Result::InvalidOperation;
+    }
+    else {
+        uint32_t address = s25fl032FlashSectorAddress[sector];
 
-    s25fl032FlashDataWriteBuffer[0] = S25FL032_FLASH_COMMAND_ERASE_SECTOR_64K;
-    s25fl032FlashDataWriteBuffer[1] = (uint8_t)((address) >> 16);
-    s25fl032FlashDataWriteBuffer[2] = (uint8_t)((address) >> 8);
-    s25fl032FlashDataWriteBuffer[3] = (uint8_t)((address) >> 0);
+        // a deployment sector is a whole 64KB block, erased with a single command
+        s25fl032FlashDataWriteBuffer[0] = S25FL032_FLASH_COMMAND_ERASE_SECTOR_64K;
+        s25fl032FlashDataWriteBuffer[1] = (uint8_t)((address) >> 16);
+        s25fl032FlashDataWriteBuffer[2] = (uint8_t)((address) >> 8);
+        s25fl032FlashDataWriteBuffer[3] = (uint8_t)((address) >> 0);
 
-    size_t writeLength = 4;
-    size_t readLength = 0;
+        size_t writeLength = 4;
+        size_t readLength = 0;
 
-    s25fl032FlashSpiProvider->WriteRead(s25fl032FlashSpiProvider, s25fl032FlashDataWriteBuffer, writeLength, nullptr, readLength, false);
+        s25fl032FlashSpiProvider->WriteRead(s25fl032FlashSpiProvider, s25fl032FlashDataWriteBuffer, writeLength, nullptr, readLength, false);
 
-    while (S25FL032_Flash_WriteInProgress() == true);
+        if (!S25FL032_Flash_WaitReady(S25FL032_FLASH_ERASE_TIMEOUT))
+            result = TinyCLR_Result::InvalidOperation;
+    }
 
     s25fl032FlashSpiProvider->Release(s25fl032FlashSpiProvider);
 
-    TinyCLR_Result::Success;
+    return result;
 }
 
-TinyCLR_Result S25FL032_Flash_Acquire(const TinyCLR_Spi_Controller* spiProvider, uint32_t chipSelectLine) {
+TinyCLR_Result S25FL032_Flash_Acquire(const TinyCLR_Spi_Controller* spiProvider, const TinyCLR_NativeTime_Controller* timeProvider, uint32_t chipSelectLine) {
     auto controller = *reinterpret_cast<int32_t*>(spiProvider->ApiInfo->State);
 
     s25fl032FlashDataWriteBuffer[0] = S25FL032_FLASH_COMMAND_READID;
@@ -258,6 +297,7 @@ TinyCLR_Result S25FL032_Flash_Acquire(const TinyCLR_Spi_Controller* spiProvider,
     size_t readLength = 4;
 
     s25fl032FlashSpiProvider = spiProvider;
+    s25fl032FlashTimeProvider = timeProvider;
     s25fl032FlashSpiChipSelectLine = chipSelectLine;
 
     s25fl032FlashSpiProvider->Acquire(s25fl032FlashSpiProvider);
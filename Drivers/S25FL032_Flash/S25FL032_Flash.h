@@ -10,6 +10,7 @@
 #define S25FL032_FLASH_COMMAND_READID                              0x9F
 #define S25FL032_FLASH_COMMAND_READ_STATUS_REGISTER                0x05
 #define S25FL032_FLASH_COMMAND_READ_DATA                           0x03
+#define S25FL032_FLASH_COMMAND_FAST_READ                           0x0B
 #define S25FL032_FLASH_COMMAND_WRITE_ENABLE                        0x06
 #define S25FL032_FLASH_COMMAND_PAGE_PROGRAMMING                    0x02
 #define S25FL032_FLASH_COMMAND_ERASE_SECTOR_64K                    0xD8
@@ -18,6 +19,9 @@
 #define ALIGNMENT_WINDOW 256
 #define DATA_BUFFER_SIZE_TRANSFER                   256
 
+// opcode, three address bytes and one dummy byte
+#define S25FL032_FLASH_FAST_READ_HEADER_SIZE        5
+
 //Manufacture ID code
 #define S25F_FLASH_MANUFACTURER_CODE                0x01
 #define S25F_FLASH_DEVICE_CODE_0                    0x02
@@ -27,7 +31,7 @@
 #define MX25L_FLASH_DEVICE_CODE_0                   0x20
 #define MX25L_FLASH_DEVICE_CODE_1                   0x16
 
-TinyCLR_Result S25FL032_Flash_Acquire(const TinyCLR_Spi_Controller* spiProvider, uint32_t chipSelectLine);
+TinyCLR_Result S25FL032_Flash_Acquire(const TinyCLR_Spi_Controller* spiProvider, const TinyCLR_NativeTime_Controller* timeProvider, uint32_t chipSelectLine);
 TinyCLR_Result S25FL032_Flash_Release();
 TinyCLR_Result S25FL032_Flash_Read(uint32_t address, size_t length, uint8_t* buffer);
 TinyCLR_Result S25FL032_Flash_Write(uint32_t address, size_t length, const uint8_t* buffer);
@@ -0,0 +1,128 @@
+// Copyright GHI Electronics, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The 8 bit full duplex transfer of the STM32F4 SPI, polled or by DMA. Zeros are clocked out past the end of the
+// write buffer and input past the end of the read buffer is dropped; the DMA path splits where either side runs
+// out, so both put the same bytes on the bus and in the read buffer. The register block and the DMA streams are
+// template parameters so the host tests can pass simulated ones; the bit names are the CMSIS ones from the device
+// header included before this file.
+
+// NDTR is 16 bits
+#define SPI_TRANSFER_DMA_MAX_LENGTH 0xFFFF
+
+// bytes on both sides, the memory side only steps through a real buffer
+#define SPI_TRANSFER_DMA_RX_CONFIGURATION(increment) (DMA_SxCR_PL_1 | ((increment) ? DMA_SxCR_MINC : 0))
+#define SPI_TRANSFER_DMA_TX_CONFIGURATION(increment) (DMA_SxCR_PL_0 | DMA_SxCR_DIR_0 | ((increment) ? DMA_SxCR_MINC : 0))
+
+template<typename Spi> void SpiTransfer_Polled(Spi& spi, const uint8_t* writeBuffer, int32_t writeLength, uint8_t* readBuffer, int32_t readLength) {
+    int32_t num = writeLength > readLength ? writeLength : readLength;
+    int32_t i = 0;
+    int32_t ii = 0;
+    uint8_t out = writeLength > 0 ? writeBuffer[0] : 0;
+    uint8_t in;
+
+    while (!(spi.SR & SPI_SR_TXE)); // wait for Tx empty
+
+    spi.DR = out; // write first word
+
+    while (++i < num) {
+        if (i < writeLength) {
+            out = writeBuffer[i]; // get new output data
+        }
+        else {
+            out = 0;
+        }
+
+        while (!(spi.SR & SPI_SR_RXNE));
+
+        in = spi.DR; // read input
+
+        while (!(spi.SR & SPI_SR_TXE)); // wait for Tx empty
+
+        spi.DR = out; // start output
+
+        if (ii < readLength) {
+            readBuffer[ii] = in; // save input data
+        }
+
+        ii++;
+    }
+
+    while (!(spi.SR & SPI_SR_RXNE));
+
+    in = spi.DR; // read last input
+
+    if (ii < readLength) {
+        readBuffer[ii] = in; // save last input
+    }
+}
+
+// One DMA transfer of length bytes, a null buffer clocks out zeros or drops the input. dma runs the two streams:
+// StartRx and StartTx(peripheral, memory, count, configuration), WaitRx(count) for the transfer complete and
+// error flags of the receive stream in the stream 0 positions, 0 when it timed out, and Stop for both.
+template<typename Spi, typename Dma> bool SpiTransfer_DmaTransfer(Spi& spi, Dma& dma, const uint8_t* writeBuffer, uint8_t* readBuffer, size_t length) {
+    static const uint8_t idle = 0;
+    static uint8_t discard;
+
+    while (spi.SR & SPI_SR_RXNE) // drop any stale input
+        static_cast<uint32_t>(spi.DR);
+
+    // rx is armed first so that no input is lost once tx starts clocking
+    dma.StartRx(&spi.DR, readBuffer != nullptr ? readBuffer : &discard, length, SPI_TRANSFER_DMA_RX_CONFIGURATION(readBuffer != nullptr));
+    dma.StartTx(&spi.DR, writeBuffer != nullptr ? writeBuffer : &idle, length, SPI_TRANSFER_DMA_TX_CONFIGURATION(writeBuffer != nullptr));
+
+    spi.CR2 |= SPI_CR2_RXDMAEN;
+    spi.CR2 |= SPI_CR2_TXDMAEN;
+
+    auto flags = dma.WaitRx(length);
+
+    spi.CR2 &= ~(SPI_CR2_RXDMAEN | SPI_CR2_TXDMAEN);
+
+    dma.Stop();
+
+    return (flags & (DMA_LISR_TCIF0 | DMA_LISR_TEIF0)) == DMA_LISR_TCIF0;
+}
+
+// The whole transfer as SpiTransfer_Polled does it, in DMA transfers of at most SPI_TRANSFER_DMA_MAX_LENGTH.
+template<typename Spi, typename Dma> bool SpiTransfer_Dma(Spi& spi, Dma& dma, const uint8_t* writeBuffer, size_t writeLength, uint8_t* readBuffer, size_t readLength) {
+    size_t total = writeLength > readLength ? writeLength : readLength;
+    size_t offset = 0;
+
+    while (offset < total) {
+        auto end = total;
+
+        if (offset < writeLength && writeLength < end) end = writeLength;
+        if (offset < readLength && readLength < end) end = readLength;
+
+        auto length = end - offset;
+
+        if (length > SPI_TRANSFER_DMA_MAX_LENGTH)
+            length = SPI_TRANSFER_DMA_MAX_LENGTH;
+
+        auto write = offset < writeLength ? writeBuffer + offset : nullptr;
+        auto read = offset < readLength ? readBuffer + offset : nullptr;
+
+        if (!SpiTransfer_DmaTransfer(spi, dma, write, read, length))
+            return false;
+
+        offset += length;
+    }
+
+    return true;
+}
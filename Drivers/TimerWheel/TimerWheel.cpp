@@ -0,0 +1,282 @@
+// Copyright GHI Electronics, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "TimerWheel.h"
+#include <Device.h>
+
+#define TIMER_WHEEL_SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+#define TIMER_WHEEL_SPAN_BITS (TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOT_BITS)
+
+// timers that do not fit in the wheel yet, looked at again each time the top level turns over
+#define TIMER_WHEEL_FAR_LIST (TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS)
+
+#define TIMER_WHEEL_NEVER 0xFFFFFFFFFFFFFFFFULL
+
+// All times below are wheel ticks. timerWheelCurrent is the first tick not processed yet. A timer is on the lowest
+// level where it is in the same turn as timerWheelCurrent, so the occupied slots of a level are never behind the
+// current one.
+static TimerWheel_Timer* timerWheelLists[TIMER_WHEEL_FAR_LIST + 1];
+static uint64_t timerWheelOccupied[TIMER_WHEEL_LEVELS];
+static uint64_t timerWheelCurrent;
+static uint64_t timerWheelResolution;
+static size_t timerWheelCount;
+
+static const TinyCLR_NativeTime_Controller* timerWheelTimeController;
+static TimerWheel_ScheduleHandler timerWheelScheduleHandler;
+
+static void TimerWheel_Link(TimerWheel_Timer* timer) {
+    auto expires = timer->expires < timerWheelCurrent ? timerWheelCurrent : timer->expires;
+    size_t list = TIMER_WHEEL_FAR_LIST;
+
+    for (auto level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        auto shift = level * TIMER_WHEEL_SLOT_BITS;
+
+        if ((expires >> (shift + TIMER_WHEEL_SLOT_BITS)) == (timerWheelCurrent >> (shift + TIMER_WHEEL_SLOT_BITS))) {
+            auto slot = (expires >> shift) & TIMER_WHEEL_SLOT_MASK;
+
+            list = level * TIMER_WHEEL_SLOTS + slot;
+
+            timerWheelOccupied[level] |= 1ULL << slot;
+
+            break;
+        }
+    }
+
+    timer->previous = nullptr;
+    timer->next = timerWheelLists[list];
+
+    if (timer->next != nullptr)
+        timer->next->previous = timer;
+
+    timerWheelLists[list] = timer;
+
+    timer->list = list + 1;
+}
+
+static void TimerWheel_Unlink(TimerWheel_Timer* timer) {
+    size_t list = timer->list - 1;
+
+    if (timer->previous != nullptr)
+        timer->previous->next = timer->next;
+    else
+        timerWheelLists[list] = timer->next;
+
+    if (timer->next != nullptr)
+        timer->next->previous = timer->previous;
+
+    if (timerWheelLists[list] == nullptr && list < TIMER_WHEEL_FAR_LIST)
+        timerWheelOccupied[list / TIMER_WHEEL_SLOTS] &= ~(1ULL << (list % TIMER_WHEEL_SLOTS));
+
+    timer->list = 0;
+}
+
+// Moves the timers of a list to where they belong now, one or more levels down.
+static void TimerWheel_Cascade(size_t list) {
+    auto timer = timerWheelLists[list];
+
+    timerWheelLists[list] = nullptr;
+
+    if (list < TIMER_WHEEL_FAR_LIST)
+        timerWheelOccupied[list / TIMER_WHEEL_SLOTS] &= ~(1ULL << (list % TIMER_WHEEL_SLOTS));
+
+    while (timer != nullptr) {
+        auto next = timer->next;
+
+        TimerWheel_Link(timer);
+
+        timer = next;
+    }
+}
+
+// First tick from the current one on where a timer fires or has to be cascaded.
+static uint64_t TimerWheel_GetNextTick() {
+    auto next = TIMER_WHEEL_NEVER;
+
+    for (auto level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        auto shift = level * TIMER_WHEEL_SLOT_BITS;
+        auto index = (timerWheelCurrent >> shift) & TIMER_WHEEL_SLOT_MASK;
+        auto pending = timerWheelOccupied[level] >> index;
+
+        if (pending != 0) {
+            auto slot = index + __builtin_ctzll(pending);
+            auto turn = (timerWheelCurrent >> (shift + TIMER_WHEEL_SLOT_BITS)) << (shift + TIMER_WHEEL_SLOT_BITS);
+            auto tick = turn + (slot << shift);
+
+            if (tick < timerWheelCurrent)
+                tick = timerWheelCurrent;
+
+            if (tick < next)
+                next = tick;
+        }
+    }
+
+    if (timerWheelLists[TIMER_WHEEL_FAR_LIST] != nullptr) {
+        auto mask = (1ULL << TIMER_WHEEL_SPAN_BITS) - 1;
+        auto tick = (timerWheelCurrent & mask) == 0 ? timerWheelCurrent : (timerWheelCurrent | mask) + 1;
+
+        if (tick < next)
+            next = tick;
+    }
+
+    return next;
+}
+
+// Advances the wheel up to now and takes the next timer that is due, a periodic one is started again first.
+static TimerWheel_Timer* TimerWheel_TakeDue(uint64_t now) {
+    for (;;) {
+        auto tick = TimerWheel_GetNextTick();
+
+        if (tick > now) {
+            if (timerWheelCurrent <= now)
+                timerWheelCurrent = now + 1;
+
+            return nullptr;
+        }
+
+        timerWheelCurrent = tick;
+
+        if ((tick & ((1ULL << TIMER_WHEEL_SPAN_BITS) - 1)) == 0 && timerWheelLists[TIMER_WHEEL_FAR_LIST] != nullptr)
+            TimerWheel_Cascade(TIMER_WHEEL_FAR_LIST);
+
+        // from the top, what comes down from a level may have to go on down through the ones below
+        for (auto level = TIMER_WHEEL_LEVELS - 1; level > 0; level--) {
+            auto slot = (tick >> (level * TIMER_WHEEL_SLOT_BITS)) & TIMER_WHEEL_SLOT_MASK;
+
+            if (timerWheelOccupied[level] & (1ULL << slot))
+                TimerWheel_Cascade(level * TIMER_WHEEL_SLOTS + slot);
+        }
+
+        auto timer = timerWheelLists[tick & TIMER_WHEEL_SLOT_MASK];
+
+        if (timer != nullptr) {
+            TimerWheel_Unlink(timer);
+
+            if (timer->period != 0) {
+                timer->expires += timer->period;
+
+                TimerWheel_Link(timer);
+            }
+            else {
+                timerWheelCount--;
+            }
+
+            return timer;
+        }
+
+        timerWheelCurrent = tick + 1;
+    }
+}
+
+void TimerWheel_Initialize(const TinyCLR_NativeTime_Controller* timeController, uint64_t resolution, TimerWheel_ScheduleHandler scheduleHandler) {
+    DISABLE_INTERRUPTS_SCOPED(irq);
+
+    timerWheelTimeController = timeController;
+    timerWheelScheduleHandler = scheduleHandler;
+    timerWheelResolution = resolution > 0 ? resolution : 1;
+
+    for (auto i = 0; i <= TIMER_WHEEL_FAR_LIST; i++)
+        timerWheelLists[i] = nullptr;
+
+    for (auto i = 0; i < TIMER_WHEEL_LEVELS; i++)
+        timerWheelOccupied[i] = 0;
+
+    timerWheelCount = 0;
+    timerWheelCurrent = timeController->GetNativeTime(timeController) / timerWheelResolution;
+}
+
+TinyCLR_Result TimerWheel_Start(TimerWheel_Timer* timer, uint64_t dueTime, uint64_t period, TimerWheel_Callback callback, void* argument) {
+    if (timer == nullptr || callback == nullptr)
+        return TinyCLR_Result::ArgumentNull;
+
+    if (timerWheelTimeController == nullptr)
+        return TinyCLR_Result::NotAvailable;
+
+    {
+        DISABLE_INTERRUPTS_SCOPED(irq);
+
+        auto now = timerWheelTimeController->GetNativeTime(timerWheelTimeController);
+
+        if (timer->list != 0)
+            TimerWheel_Unlink(timer);
+        else
+            timerWheelCount++;
+
+        // an empty wheel has nothing to catch up on, it starts again from now
+        if (timerWheelCount == 1)
+            timerWheelCurrent = now / timerWheelResolution;
+
+        // rounded up, a timer never fires early
+        timer->expires = (now + dueTime + timerWheelResolution - 1) / timerWheelResolution;
+        timer->period = period == 0 ? 0 : (period + timerWheelResolution / 2) / timerWheelResolution;
+
+        if (period != 0 && timer->period == 0)
+            timer->period = 1;
+
+        timer->callback = callback;
+        timer->argument = argument;
+
+        TimerWheel_Link(timer);
+    }
+
+    if (timerWheelScheduleHandler != nullptr)
+        timerWheelScheduleHandler();
+
+    return TinyCLR_Result::Success;
+}
+
+void TimerWheel_Cancel(TimerWheel_Timer* timer) {
+    DISABLE_INTERRUPTS_SCOPED(irq);
+
+    // the next event is left as it is, it finds nothing to do
+    if (timer != nullptr && timer->list != 0) {
+        TimerWheel_Unlink(timer);
+
+        timerWheelCount--;
+    }
+}
+
+bool TimerWheel_IsStarted(const TimerWheel_Timer* timer) {
+    return timer != nullptr && timer->list != 0;
+}
+
+uint64_t TimerWheel_GetNextEvent() {
+    DISABLE_INTERRUPTS_SCOPED(irq);
+
+    if (timerWheelCount == 0)
+        return TIMER_WHEEL_NEVER;
+
+    auto tick = TimerWheel_GetNextTick();
+
+    return tick < TIMER_WHEEL_NEVER / timerWheelResolution ? tick * timerWheelResolution : TIMER_WHEEL_NEVER;
+}
+
+void TimerWheel_Expire(uint64_t nativeTime) {
+    for (;;) {
+        TimerWheel_Timer* timer;
+
+        {
+            DISABLE_INTERRUPTS_SCOPED(irq);
+
+            if (timerWheelCount == 0)
+                return;
+
+            timer = TimerWheel_TakeDue(nativeTime / timerWheelResolution);
+        }
+
+        if (timer == nullptr)
+            return;
+
+        timer->callback(timer, timer->argument);
+    }
+}
@@ -0,0 +1,59 @@
+// Copyright GHI Electronics, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <TinyCLR.h>
+
+// One shot and periodic callbacks on native time for drivers that would otherwise wait in a loop. Timers are kept
+// in a hierarchical wheel: TIMER_WHEEL_LEVELS levels of TIMER_WHEEL_SLOTS lists, each level TIMER_WHEEL_SLOTS
+// times coarser than the one below. Start and Cancel are constant time, a timer moves down a level at most
+// TIMER_WHEEL_LEVELS times before it fires. The time controller owns the wheel: it asks for the next expiry when
+// it schedules its event and runs TimerWheel_Expire from its interrupt, which is where the callbacks run.
+
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_SLOT_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_SLOT_BITS)
+
+struct TimerWheel_Timer;
+
+typedef void(*TimerWheel_Callback)(TimerWheel_Timer* timer, void* argument);
+typedef void(*TimerWheel_ScheduleHandler)();
+
+// Owned by the caller, zero initialized before its first use and left alone while it is started.
+struct TimerWheel_Timer {
+    TimerWheel_Timer* next;
+    TimerWheel_Timer* previous;
+
+    uint64_t expires;
+    uint64_t period;
+
+    TimerWheel_Callback callback;
+    void* argument;
+
+    uint16_t list;
+};
+
+// resolution is the wheel tick in native ticks, scheduleHandler is called when the next expiry may have moved.
+void TimerWheel_Initialize(const TinyCLR_NativeTime_Controller* timeController, uint64_t resolution, TimerWheel_ScheduleHandler scheduleHandler);
+
+// dueTime and period are native ticks, dueTime from now. A period of zero makes a one shot timer. Starting a timer
+// that is started already restarts it.
+TinyCLR_Result TimerWheel_Start(TimerWheel_Timer* timer, uint64_t dueTime, uint64_t period, TimerWheel_Callback callback, void* argument);
+void TimerWheel_Cancel(TimerWheel_Timer* timer);
+bool TimerWheel_IsStarted(const TimerWheel_Timer* timer);
+
+// For the time controller: the native time of the next expiry or cascade, and running what is due at nativeTime.
+uint64_t TimerWheel_GetNextEvent();
+void TimerWheel_Expire(uint64_t nativeTime);
@@ -0,0 +1,40 @@
+// Copyright GHI Electronics, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+
+// STM32F4/F7 timer that paces a converter through its TRGO, used by the ADC scan and the DAC streams. The timer
+// is a template parameter so the host tests can pass a plain register block; the bit names are the CMSIS ones
+// from the device header included before this file.
+
+// Sets timer, clocked at clockHz, to update frequency times a second with TRGO on every update and leaves it
+// stopped. Returns the rate it will really run at.
+template<typename Timer> double TriggerTimer_Program(Timer& timer, uint32_t clockHz, double frequency) {
+    // the prescaler takes what does not fit the 16 bit reload
+    auto ticks = (uint64_t)(clockHz / frequency + 0.5);
+    auto prescaler = (uint32_t)((ticks - 1) / 0x10000);
+    auto reload = (uint32_t)(ticks / (prescaler + 1));
+
+    timer.CR1 = 0;
+    timer.CR2 = TIM_CR2_MMS_1; // TRGO on update
+    timer.DIER = 0;
+    timer.PSC = prescaler;
+    timer.ARR = reload - 1;
+    timer.EGR = TIM_EGR_UG; // load the prescaler
+    timer.SR = 0;
+
+    return (double)clockHz / ((prescaler + 1) * (uint64_t)reload);
+}
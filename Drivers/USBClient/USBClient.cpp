@@ -676,18 +676,36 @@ uint8_t TinyCLR_UsbClient_ControlCallback(UsClientState* usClientState) {
     return USB_STATE_STALL;
 }
 
-USB_PACKET64* TinyCLR_UsbClient_RxEnqueue(UsClientState* usClientState, int32_t endpoint, bool& disableRx) {
-    USB_PACKET64* packet;
-
-    if (usClientState->fifoPacketCount[endpoint] == usClientState->maxFifoPacketCount[endpoint]) {
-        disableRx = true;
+// Packet pool. Every open endpoint has minFifoPacketCount packets of the pool reserved for it and takes more from
+// the unreserved rest while there are any, up to maxFifoPacketCount. Endpoint queues only hold pool indices.
+uint32_t TinyCLR_UsbClient_GetPacketRoom(UsClientState* usClientState, int32_t endpoint) {
+    if (usClientState->queues[endpoint] == nullptr)
+        return 0;
+
+    uint32_t count = usClientState->fifoPacketCount[endpoint];
+    uint32_t minimum = usClientState->minFifoPacketCount[endpoint];
+    uint32_t reserved = minimum > count ? minimum - count : 0;
+    int32_t shared = usClientState->packetPoolCount - usClientState->packetPoolReserved - usClientState->packetPoolShared;
+
+    // a reservation made while others borrowed beyond theirs is only backed once those packets come back
+    if (shared < 0)
+        shared = 0;
+
+    return __min(usClientState->maxFifoPacketCount[endpoint] - count, reserved + (uint32_t)shared);
+}
 
+static USB_PACKET64* TinyCLR_UsbClient_TakePacket(UsClientState* usClientState, int32_t endpoint) {
+    if (TinyCLR_UsbClient_GetPacketRoom(usClientState, endpoint) == 0 || usClientState->packetPoolFree == USB_PACKET_POOL_END)
         return nullptr;
-    }
 
-    disableRx = false;
+    auto index = usClientState->packetPoolFree;
 
-    packet = &usClientState->queues[endpoint][usClientState->fifoPacketIn[endpoint]];
+    usClientState->packetPoolFree = usClientState->packetPoolLinks[index];
+
+    if (usClientState->fifoPacketCount[endpoint] >= usClientState->minFifoPacketCount[endpoint])
+        usClientState->packetPoolShared++;
+
+    usClientState->queues[endpoint][usClientState->fifoPacketIn[endpoint]] = index;
 
     usClientState->fifoPacketIn[endpoint]++;
     usClientState->fifoPacketCount[endpoint]++;
@@ -695,35 +713,205 @@ USB_PACKET64* TinyCLR_UsbClient_RxEnqueue(UsClientState* usClientState, int32_t
     if (usClientState->fifoPacketIn[endpoint] == usClientState->maxFifoPacketCount[endpoint])
         usClientState->fifoPacketIn[endpoint] = 0;
 
-    TinyCLR_UsbClient_SetEvent(usClientState, 1 << endpoint);
+    return &usClientState->packetPool[index];
+}
+
+static USB_PACKET64* TinyCLR_UsbClient_GetQueuedPacket(UsClientState* usClientState, int32_t endpoint, uint32_t position) {
+    return &usClientState->packetPool[usClientState->queues[endpoint][(usClientState->fifoPacketOut[endpoint] + position) % usClientState->maxFifoPacketCount[endpoint]]];
+}
+
+// Gives the packets at the head of the queue back to the pool. Their content stays until a packet is taken again.
+static void TinyCLR_UsbClient_ReleasePackets(UsClientState* usClientState, int32_t endpoint, uint32_t packets) {
+    while (packets-- > 0) {
+        auto index = usClientState->queues[endpoint][usClientState->fifoPacketOut[endpoint]];
+
+        usClientState->packetPoolLinks[index] = usClientState->packetPoolFree;
+        usClientState->packetPoolFree = index;
+
+        if (usClientState->fifoPacketCount[endpoint] > usClientState->minFifoPacketCount[endpoint])
+            usClientState->packetPoolShared--;
+
+        usClientState->fifoPacketCount[endpoint]--;
+        usClientState->fifoPacketOut[endpoint]++;
+
+        if (usClientState->fifoPacketOut[endpoint] == usClientState->maxFifoPacketCount[endpoint])
+            usClientState->fifoPacketOut[endpoint] = 0;
+    }
+}
+
+USB_PACKET64* TinyCLR_UsbClient_RxEnqueue(UsClientState* usClientState, int32_t endpoint, bool& disableRx) {
+    USB_PACKET64* packet = TinyCLR_UsbClient_TakePacket(usClientState, endpoint);
+
+    disableRx = packet == nullptr;
+
+    if (packet != nullptr)
+        TinyCLR_UsbClient_SetEvent(usClientState, 1 << endpoint);
 
     return packet;
 }
 
-USB_PACKET64* TinyCLR_UsbClient_TxDequeue(UsClientState* usClientState, int32_t endpoint) {
+static USB_PACKET64* TinyCLR_UsbClient_TxDequeue(UsClientState* usClientState, int32_t endpoint) {
     USB_PACKET64* packet;
 
     if (usClientState->fifoPacketCount[endpoint] == 0) {
         return nullptr;
     }
 
-    packet = &usClientState->queues[endpoint][usClientState->fifoPacketOut[endpoint]];
-
-    usClientState->fifoPacketCount[endpoint]--;
-    usClientState->fifoPacketOut[endpoint]++;
+    packet = TinyCLR_UsbClient_GetQueuedPacket(usClientState, endpoint, 0);
 
-    if (usClientState->fifoPacketOut[endpoint] == usClientState->maxFifoPacketCount[endpoint])
-        usClientState->fifoPacketOut[endpoint] = 0;
+    TinyCLR_UsbClient_ReleasePackets(usClientState, endpoint, 1);
 
     return packet;
 }
 
+static void TinyCLR_UsbClient_CompleteTransfer(UsClientState* usClientState, int32_t endpoint, TinyCLR_Result result) {
+    auto transfer = usClientState->transferHead[endpoint];
+
+    usClientState->transferHead[endpoint] = transfer->next;
+
+    if (transfer->next == nullptr)
+        usClientState->transferTail[endpoint] = nullptr;
+
+    transfer->next = nullptr;
+    transfer->Result = result;
+
+    if (transfer->Callback != nullptr)
+        transfer->Callback(transfer);
+}
+
+// Next packet for the hardware, with interrupts disabled. Copied WritePipe packets go first, then the submitted
+// transfers. data stays valid until the next call for this endpoint, a transfer completes on the call after its
+// last packet, which is when the hardware asks for more because that packet is out.
+bool TinyCLR_UsbClient_TxGetPacket(UsClientState* usClientState, int32_t endpoint, const uint8_t*& data, uint32_t& size) {
+    auto packet = TinyCLR_UsbClient_TxDequeue(usClientState, endpoint);
+
+    if (packet != nullptr) {
+        data = packet->Buffer;
+        size = packet->Size;
+
+        return true;
+    }
+
+    if (usClientState->transferHead == nullptr)
+        return false;
+
+    auto transfer = usClientState->transferHead[endpoint];
+
+    if (transfer != nullptr && transfer->lastPacketSent) {
+        TinyCLR_UsbClient_CompleteTransfer(usClientState, endpoint, TinyCLR_Result::Success);
+
+        transfer = usClientState->transferHead[endpoint];
+    }
+
+    if (transfer == nullptr)
+        return false;
+
+    uint32_t packetSize = usClientState->maxEndpointsPacketSize[endpoint];
+    auto staging = usClientState->transferStaging[endpoint];
+
+    while (transfer->segment < transfer->SegmentCount && transfer->offset == transfer->Segments[transfer->segment].Length) {
+        transfer->segment++;
+        transfer->offset = 0;
+    }
+
+    if (transfer->segment < transfer->SegmentCount && transfer->Segments[transfer->segment].Length - transfer->offset >= packetSize) {
+        // full packet inside one segment, the hardware reads it from there
+        data = transfer->Segments[transfer->segment].Data + transfer->offset;
+        size = packetSize;
+
+        transfer->offset += packetSize;
+    }
+    else {
+        // spans segments, or the short packet at the end. Zero length when the data ended on a packet boundary.
+        size = 0;
+
+        while (size < packetSize && transfer->segment < transfer->SegmentCount) {
+            auto& segment = transfer->Segments[transfer->segment];
+            auto count = __min(packetSize - size, segment.Length - transfer->offset);
+
+            memcpy(staging + size, segment.Data + transfer->offset, count);
+
+            size += count;
+            transfer->offset += count;
+
+            if (transfer->offset == segment.Length) {
+                transfer->segment++;
+                transfer->offset = 0;
+            }
+        }
+
+        data = staging;
+    }
+
+    transfer->Transferred += size;
+    transfer->lastPacketSent = size < packetSize;
+
+    return true;
+}
+
 void TinyCLR_UsbClient_ClearEndpoints(UsClientState* usClientState, int32_t endpoint) {
+    if (usClientState->queues[endpoint] != nullptr)
+        TinyCLR_UsbClient_ReleasePackets(usClientState, endpoint, usClientState->fifoPacketCount[endpoint]);
+
     usClientState->fifoPacketIn[endpoint] = usClientState->fifoPacketOut[endpoint] = usClientState->fifoPacketCount[endpoint] = 0;
+
+    // the offset belongs to the head packet that was just dropped
+    if (usClientState->currentPacketOffset != nullptr)
+        usClientState->currentPacketOffset[endpoint] = 0;
+
+    if (usClientState->transferHead != nullptr) {
+        while (usClientState->transferHead[endpoint] != nullptr)
+            TinyCLR_UsbClient_CompleteTransfer(usClientState, endpoint, TinyCLR_Result::NotAvailable);
+    }
+}
+
+static void TinyCLR_UsbClient_QueueTransfer(UsClientState* usClientState, int32_t endpoint, USB_TRANSFER* transfer) {
+    transfer->next = nullptr;
+    transfer->segment = 0;
+    transfer->offset = 0;
+    transfer->lastPacketSent = false;
+    transfer->Transferred = 0;
+    transfer->Result = TinyCLR_Result::Busy;
+
+    if (usClientState->transferTail[endpoint] != nullptr)
+        usClientState->transferTail[endpoint]->next = transfer;
+    else
+        usClientState->transferHead[endpoint] = transfer;
+
+    usClientState->transferTail[endpoint] = transfer;
+}
+
+// Takes a transfer out of the queue without calling it back, the hardware copies each packet when it gets it so
+// nothing refers to the caller's buffers afterwards.
+static void TinyCLR_UsbClient_RemoveTransfer(UsClientState* usClientState, int32_t endpoint, USB_TRANSFER* transfer) {
+    USB_TRANSFER* previous = nullptr;
+
+    for (auto t = usClientState->transferHead[endpoint]; t != nullptr; previous = t, t = t->next) {
+        if (t != transfer)
+            continue;
+
+        if (previous != nullptr)
+            previous->next = t->next;
+        else
+            usClientState->transferHead[endpoint] = t->next;
+
+        if (usClientState->transferTail[endpoint] == t)
+            usClientState->transferTail[endpoint] = previous;
+
+        t->next = nullptr;
+
+        break;
+    }
+}
+
+static uint32_t TinyCLR_UsbClient_GetTxProgress(UsClientState* usClientState, int32_t endpoint) {
+    auto transfer = usClientState->transferHead[endpoint];
+
+    return usClientState->fifoPacketCount[endpoint] + (transfer != nullptr ? transfer->Transferred : 0);
 }
 
 bool TinyCLR_UsbClient_CanReceivePackage(UsClientState* usClientState, int32_t endpoint) {
-    return usClientState->fifoPacketCount[endpoint] < usClientState->maxFifoPacketCount[endpoint];
+    return TinyCLR_UsbClient_GetPacketRoom(usClientState, endpoint) > 0;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////
@@ -809,7 +997,7 @@ TinyCLR_Result TinyCLR_UsbClient_Acquire(const TinyCLR_UsbClient_Controller* sel
         if (apiManager != nullptr) {
             auto memoryManager = reinterpret_cast<const TinyCLR_Memory_Manager*>(apiManager->FindDefault(apiManager, TinyCLR_Api_Type::MemoryManager));
 
-            usClientState->queues = reinterpret_cast<USB_PACKET64**>(memoryManager->Allocate(memoryManager, usClientState->totalEndpointsCount * sizeof(uint32_t)));
+            usClientState->queues = reinterpret_cast<uint16_t**>(memoryManager->Allocate(memoryManager, usClientState->totalEndpointsCount * sizeof(uint16_t*)));
             usClientState->currentPacketOffset = reinterpret_cast<uint8_t*>(memoryManager->Allocate(memoryManager, usClientState->totalEndpointsCount * sizeof(uint8_t)));
             usClientState->isTxQueue = reinterpret_cast<bool*>(memoryManager->Allocate(memoryManager, usClientState->totalEndpointsCount * sizeof(bool)));
 
@@ -817,13 +1005,21 @@ TinyCLR_Result TinyCLR_UsbClient_Acquire(const TinyCLR_UsbClient_Controller* sel
             usClientState->fifoPacketOut = reinterpret_cast<uint8_t*>(memoryManager->Allocate(memoryManager, usClientState->totalEndpointsCount * sizeof(uint8_t)));
             usClientState->fifoPacketCount = reinterpret_cast<uint8_t*>(memoryManager->Allocate(memoryManager, usClientState->totalEndpointsCount * sizeof(uint8_t)));
             usClientState->maxFifoPacketCount = reinterpret_cast<uint8_t*>(memoryManager->Allocate(memoryManager, usClientState->totalEndpointsCount * sizeof(uint8_t)));
+            usClientState->minFifoPacketCount = reinterpret_cast<uint8_t*>(memoryManager->Allocate(memoryManager, usClientState->totalEndpointsCount * sizeof(uint8_t)));
+
+            usClientState->packetPool = reinterpret_cast<USB_PACKET64*>(memoryManager->Allocate(memoryManager, usClientState->packetPoolCount * sizeof(USB_PACKET64)));
+            usClientState->packetPoolLinks = reinterpret_cast<uint16_t*>(memoryManager->Allocate(memoryManager, usClientState->packetPoolCount * sizeof(uint16_t)));
 
             usClientState->pipes = reinterpret_cast<USB_PIPE_MAP*>(memoryManager->Allocate(memoryManager, usClientState->totalPipesCount * sizeof(USB_PIPE_MAP)));
 
             usClientState->controlEndpointBuffer = reinterpret_cast<uint8_t*>(memoryManager->Allocate(memoryManager, USB_ENDPOINT_CONTROL_BUFFER_SIZE));
 
             usClientState->endpointStatus = reinterpret_cast<uint16_t*>(memoryManager->Allocate(memoryManager, usClientState->totalEndpointsCount * sizeof(uint16_t)));
-            usClientState->maxEndpointsPacketSize = reinterpret_cast<uint8_t*>(memoryManager->Allocate(memoryManager, usClientState->totalEndpointsCount * sizeof(uint8_t)));
+            usClientState->maxEndpointsPacketSize = reinterpret_cast<uint16_t*>(memoryManager->Allocate(memoryManager, usClientState->totalEndpointsCount * sizeof(uint16_t)));
+
+            usClientState->transferHead = reinterpret_cast<USB_TRANSFER**>(memoryManager->Allocate(memoryManager, usClientState->totalEndpointsCount * sizeof(USB_TRANSFER*)));
+            usClientState->transferTail = reinterpret_cast<USB_TRANSFER**>(memoryManager->Allocate(memoryManager, usClientState->totalEndpointsCount * sizeof(USB_TRANSFER*)));
+            usClientState->transferStaging = reinterpret_cast<uint8_t**>(memoryManager->Allocate(memoryManager, usClientState->totalEndpointsCount * sizeof(uint8_t*)));
 
             if (usClientState->queues == nullptr
                 || usClientState->currentPacketOffset == nullptr
@@ -832,14 +1028,20 @@ TinyCLR_Result TinyCLR_UsbClient_Acquire(const TinyCLR_UsbClient_Controller* sel
                 || usClientState->fifoPacketOut == nullptr
                 || usClientState->fifoPacketCount == nullptr
                 || usClientState->maxFifoPacketCount == nullptr
+                || usClientState->minFifoPacketCount == nullptr
+                || usClientState->packetPool == nullptr
+                || usClientState->packetPoolLinks == nullptr
                 || usClientState->pipes == nullptr
                 || usClientState->controlEndpointBuffer == nullptr
                 || usClientState->maxEndpointsPacketSize == nullptr
-                || usClientState->endpointStatus == nullptr)
+                || usClientState->endpointStatus == nullptr
+                || usClientState->transferHead == nullptr
+                || usClientState->transferTail == nullptr
+                || usClientState->transferStaging == nullptr)
                 goto acquire_error;
 
             // Reset buffer, make sure no random value in RAM after soft reset
-            memset(reinterpret_cast<uint8_t*>(usClientState->queues), 0x00, usClientState->totalEndpointsCount * sizeof(uint32_t));
+            memset(reinterpret_cast<uint8_t*>(usClientState->queues), 0x00, usClientState->totalEndpointsCount * sizeof(uint16_t*));
             memset(reinterpret_cast<uint8_t*>(usClientState->currentPacketOffset), 0x00, usClientState->totalEndpointsCount * sizeof(uint8_t));
 
             memset(reinterpret_cast<uint8_t*>(usClientState->fifoPacketIn), 0x00, usClientState->totalEndpointsCount * sizeof(uint8_t));
@@ -847,6 +1049,10 @@ TinyCLR_Result TinyCLR_UsbClient_Acquire(const TinyCLR_UsbClient_Controller* sel
             memset(reinterpret_cast<uint8_t*>(usClientState->fifoPacketCount), 0x00, usClientState->totalEndpointsCount * sizeof(uint8_t));
             memset(reinterpret_cast<uint8_t*>(usClientState->maxFifoPacketCount), 0x00, usClientState->totalEndpointsCount * sizeof(uint8_t));
 
+            memset(reinterpret_cast<uint8_t*>(usClientState->transferHead), 0x00, usClientState->totalEndpointsCount * sizeof(USB_TRANSFER*));
+            memset(reinterpret_cast<uint8_t*>(usClientState->transferTail), 0x00, usClientState->totalEndpointsCount * sizeof(USB_TRANSFER*));
+            memset(reinterpret_cast<uint8_t*>(usClientState->transferStaging), 0x00, usClientState->totalEndpointsCount * sizeof(uint8_t*));
+
             for (auto i = 0; i < usClientState->totalPipesCount; i++) {
                 usClientState->pipes[i].RxEP = USB_ENDPOINT_NULL;
                 usClientState->pipes[i].TxEP = USB_ENDPOINT_NULL;
@@ -855,8 +1061,16 @@ TinyCLR_Result TinyCLR_UsbClient_Acquire(const TinyCLR_UsbClient_Controller* sel
             for (auto i = 0; i < usClientState->totalEndpointsCount; i++) {
                 usClientState->maxEndpointsPacketSize[i] = TinyCLR_UsbClient_GetEndpointSize(i);
                 usClientState->maxFifoPacketCount[i] = usClientState->maxFifoPacketCountDefault;
+                usClientState->minFifoPacketCount[i] = usClientState->minFifoPacketCountDefault;
             }
 
+            for (auto i = 0; i < usClientState->packetPoolCount; i++)
+                usClientState->packetPoolLinks[i] = (i + 1 < usClientState->packetPoolCount) ? i + 1 : USB_PACKET_POOL_END;
+
+            usClientState->packetPoolFree = usClientState->packetPoolCount > 0 ? 0 : USB_PACKET_POOL_END;
+            usClientState->packetPoolReserved = 0;
+            usClientState->packetPoolShared = 0;
+
             usClientState->initialized = true;
 
             goto acquire_success;
@@ -903,12 +1117,24 @@ TinyCLR_Result TinyCLR_UsbClient_Release(const TinyCLR_UsbClient_Controller* sel
                 memoryManager->Free(memoryManager, usClientState->fifoPacketOut);
                 memoryManager->Free(memoryManager, usClientState->fifoPacketCount);
                 memoryManager->Free(memoryManager, usClientState->maxFifoPacketCount);
+                memoryManager->Free(memoryManager, usClientState->minFifoPacketCount);
+
+                memoryManager->Free(memoryManager, usClientState->packetPool);
+                memoryManager->Free(memoryManager, usClientState->packetPoolLinks);
 
                 memoryManager->Free(memoryManager, usClientState->pipes);
 
                 memoryManager->Free(memoryManager, usClientState->controlEndpointBuffer);
                 memoryManager->Free(memoryManager, usClientState->endpointStatus);
                 memoryManager->Free(memoryManager, usClientState->maxEndpointsPacketSize);
+
+                memoryManager->Free(memoryManager, usClientState->transferHead);
+                memoryManager->Free(memoryManager, usClientState->transferTail);
+                memoryManager->Free(memoryManager, usClientState->transferStaging);
+
+                usClientState->transferHead = nullptr;
+                usClientState->transferTail = nullptr;
+                usClientState->transferStaging = nullptr;
             }
         }
     }
@@ -916,6 +1142,19 @@ TinyCLR_Result TinyCLR_UsbClient_Release(const TinyCLR_UsbClient_Controller* sel
     return TinyCLR_Result::Success;
 }
 
+// Gives back what OpenPipe took for endpoint: its queue, its staging packet and its share of the packet pool.
+static void TinyCLR_UsbClient_ReleaseEndpoint(UsClientState* usClientState, const TinyCLR_Memory_Manager* memoryManager, int32_t endpoint) {
+    memoryManager->Free(memoryManager, usClientState->queues[endpoint]);
+
+    usClientState->packetPoolReserved -= usClientState->minFifoPacketCount[endpoint];
+
+    if (usClientState->transferStaging[endpoint] != nullptr)
+        memoryManager->Free(memoryManager, usClientState->transferStaging[endpoint]);
+
+    usClientState->queues[endpoint] = nullptr;
+    usClientState->transferStaging[endpoint] = nullptr;
+}
+
 TinyCLR_Result TinyCLR_UsbClient_OpenPipe(const TinyCLR_UsbClient_Controller* self, uint8_t writeEndpoint, uint8_t readEndpoint, uint32_t& pipe) {
     UsClientState * usClientState = reinterpret_cast<UsClientState*>(self->ApiInfo->State);
 
@@ -929,14 +1168,40 @@ TinyCLR_Result TinyCLR_UsbClient_OpenPipe(const TinyCLR_UsbClient_Controller* se
         usClientState->isTxQueue[readEndpoint] = false;
 
     if (apiManager != nullptr) {
+        auto memoryManager = reinterpret_cast<const TinyCLR_Memory_Manager*>(apiManager->FindDefault(apiManager, TinyCLR_Api_Type::MemoryManager));
+        int32_t opened[2] = { USB_ENDPOINT_NULL, USB_ENDPOINT_NULL };
+        uint32_t reserve = 0;
+
+        if (writeEndpoint < usClientState->totalEndpointsCount && usClientState->queues[writeEndpoint] == nullptr)
+            reserve += usClientState->minFifoPacketCount[writeEndpoint];
+
+        if (readEndpoint < usClientState->totalEndpointsCount && usClientState->queues[readEndpoint] == nullptr)
+            reserve += usClientState->minFifoPacketCount[readEndpoint];
+
+        // the reservations have to fit in the pool next to those of the pipes already open
+        if (usClientState->packetPoolReserved + reserve > usClientState->packetPoolCount)
+            goto pipe_error;
+
         for (auto i = 0; i < 2; i++) {
-            auto memoryManager = reinterpret_cast<const TinyCLR_Memory_Manager*>(apiManager->FindDefault(apiManager, TinyCLR_Api_Type::MemoryManager));
             auto endpoint = (i == 0) ? writeEndpoint : readEndpoint;
 
-            if (memoryManager != nullptr && endpoint < usClientState->totalEndpointsCount) {
-                usClientState->queues[endpoint] = (USB_PACKET64*)memoryManager->Allocate(memoryManager, usClientState->maxFifoPacketCount[endpoint] * sizeof(USB_PACKET64));
+            if (memoryManager != nullptr && endpoint < usClientState->totalEndpointsCount && usClientState->queues[endpoint] == nullptr) {
+                usClientState->queues[endpoint] = reinterpret_cast<uint16_t*>(memoryManager->Allocate(memoryManager, usClientState->maxFifoPacketCount[endpoint] * sizeof(uint16_t)));
+
+                if (usClientState->queues[endpoint] == nullptr)
+                    goto pipe_release;
+
+                usClientState->packetPoolReserved += usClientState->minFifoPacketCount[endpoint];
+
+                opened[i] = endpoint;
+
+                // WritePipe and the submitted transfers rely on it for every packet that is not sent in place
+                if (endpoint == writeEndpoint && usClientState->transferStaging[endpoint] == nullptr) {
+                    usClientState->transferStaging[endpoint] = reinterpret_cast<uint8_t*>(memoryManager->Allocate(memoryManager, usClientState->maxEndpointsPacketSize[endpoint]));
 
-                memset(reinterpret_cast<uint8_t*>(usClientState->queues[endpoint]), 0x00, usClientState->maxFifoPacketCount[endpoint] * sizeof(USB_PACKET64));
+                    if (usClientState->transferStaging[endpoint] == nullptr)
+                        goto pipe_release;
+                }
 
                 TinyCLR_UsbClient_ClearEndpoints(usClientState, endpoint);
             }
@@ -949,7 +1214,7 @@ TinyCLR_Result TinyCLR_UsbClient_OpenPipe(const TinyCLR_UsbClient_Controller* se
         }
 
         if (pipe == usClientState->totalPipesCount)
-            goto pipe_error;
+            goto pipe_release;
 
         // All tests pass, assign the endpoints to the pipe
         usClientState->pipes[pipe].RxEP = readEndpoint;
@@ -960,6 +1225,13 @@ TinyCLR_Result TinyCLR_UsbClient_OpenPipe(const TinyCLR_UsbClient_Controller* se
         }
 
         return TinyCLR_Result::Success;
+
+    pipe_release:
+        // undo only what this call set up, endpoints shared with an open pipe keep their queues
+        for (auto i = 0; i < 2; i++) {
+            if (opened[i] != USB_ENDPOINT_NULL)
+                TinyCLR_UsbClient_ReleaseEndpoint(usClientState, memoryManager, opened[i]);
+        }
     }
 
 pipe_error:
@@ -984,10 +1256,7 @@ TinyCLR_Result TinyCLR_UsbClient_ClosePipe(const TinyCLR_UsbClient_Controller* s
             if (apiManager != nullptr) {
                 auto memoryManager = reinterpret_cast<const TinyCLR_Memory_Manager*>(apiManager->FindDefault(apiManager, TinyCLR_Api_Type::MemoryManager));
 
-                if (usClientState->queues[endpoint] != nullptr)
-                    memoryManager->Free(memoryManager, usClientState->queues[endpoint]);
-
-                usClientState->queues[endpoint] = nullptr;
+                TinyCLR_UsbClient_ReleaseEndpoint(usClientState, memoryManager, endpoint);
             }
         }
     }
@@ -998,6 +1267,7 @@ TinyCLR_Result TinyCLR_UsbClient_ClosePipe(const TinyCLR_UsbClient_Controller* s
     return TinyCLR_Result::Success;
 }
 
+#define USB_WRITE_PIPE_DIRECT_SIZE 512
 TinyCLR_Result TinyCLR_UsbClient_WritePipe(const TinyCLR_UsbClient_Controller* self, uint32_t pipe, const uint8_t* data, size_t& length) {
     UsClientState * usClientState = reinterpret_cast<UsClientState*>(self->ApiInfo->State);
 
@@ -1021,31 +1291,77 @@ TinyCLR_Result TinyCLR_UsbClient_WritePipe(const TinyCLR_UsbClient_Controller* s
     bool                Done = false;
     uint32_t            WaitLoopCnt = 0;
     int32_t             totWrite = 0;
+    uint32_t            packetSize = usClientState->maxEndpointsPacketSize[endpoint];
+
+    // Large writes skip the packet queue and are sent straight from the caller's buffer, which is valid until
+    // this returns. Same give up rule as below: no progress for 5ms. Endpoints with packets bigger than the
+    // queued ones (512 bytes on the high speed parts) always go this way, even with interrupts disabled, a
+    // queued packet would be a short packet to the host and end the transfer. StartOutput polls the endpoint
+    // then, as it does for FlushPipe.
+    if ((packetSize > sizeof(USB_PACKET64::Buffer) || (length >= USB_WRITE_PIPE_DIRECT_SIZE && !irq.IsDisabled())) && usClientState->transferStaging[endpoint] != nullptr) {
+        USB_TRANSFER_SEGMENT segment = { data, static_cast<uint32_t>(length) };
+        USB_TRANSFER transfer;
+        uint32_t progress = 0;
+
+        memset(&transfer, 0, sizeof(USB_TRANSFER));
+
+        transfer.Segments = &segment;
+        transfer.SegmentCount = 1;
+
+        TinyCLR_UsbClient_QueueTransfer(usClientState, endpoint, &transfer);
+
+        while (transfer.Result == TinyCLR_Result::Busy) {
+            TinyCLR_UsbClient_StartOutput(usClientState, endpoint);
+
+            irq.Release();
+
+            TinyCLR_UsbClient_Delay(50);
+
+            irq.Acquire();
+
+            if (transfer.Result != TinyCLR_Result::Busy)
+                break;
+
+            if (transfer.Transferred != progress) {
+                progress = transfer.Transferred;
+                WaitLoopCnt = 0;
+            }
+            else if (++WaitLoopCnt > 100 || usClientState->deviceState != USB_DEVICE_STATE_CONFIGURED) {
+                TinyCLR_UsbClient_RemoveTransfer(usClientState, endpoint, &transfer);
+
+                if (transfer.Transferred == 0)
+                    TinyCLR_UsbClient_ClearEndpoints(usClientState, endpoint);
+
+                break;
+            }
+        }
+
+        length = transfer.Transferred;
+
+        return TinyCLR_Result::Success;
+    }
 
     // This loop packetizes the data and sends it out.  All packets sent have
     // the maximum length for the given endpoint except for the last packet which
     // will always have less than the maximum length - even if the packet length
     // must be zero for this to occur.   This is done to comply with standard
     // USB bulk-mode transfers.
+    packetSize = __min(packetSize, sizeof(USB_PACKET64::Buffer));
+
     while (!Done) {
 
         USB_PACKET64* Packet64 = nullptr;
 
-        if (usClientState->fifoPacketCount[endpoint] < usClientState->maxFifoPacketCount[endpoint]) {
-            Packet64 = &usClientState->queues[endpoint][usClientState->fifoPacketIn[endpoint]];
-
-            usClientState->fifoPacketIn[endpoint]++;
-            usClientState->fifoPacketCount[endpoint]++;
-
-            if (usClientState->fifoPacketIn[endpoint] == usClientState->maxFifoPacketCount[endpoint])
-                usClientState->fifoPacketIn[endpoint] = 0;
+        // copies wait for submitted transfers to drain, so the data leaves in the order it was written
+        if (usClientState->transferHead[endpoint] == nullptr) {
+            Packet64 = TinyCLR_UsbClient_TakePacket(usClientState, endpoint);
         }
 
         if (Packet64) {
             uint32_t max_move;
 
-            if (count > usClientState->maxEndpointsPacketSize[endpoint])
-                max_move = usClientState->maxEndpointsPacketSize[endpoint];
+            if (count > packetSize)
+                max_move = packetSize;
             else
                 max_move = count;
 
@@ -1054,7 +1370,7 @@ TinyCLR_Result TinyCLR_UsbClient_WritePipe(const TinyCLR_UsbClient_Controller* s
             }
 
             // we are done when we send a non-full length packet
-            if (max_move < usClientState->maxEndpointsPacketSize[endpoint]) {
+            if (max_move < packetSize) {
                 Done = true;
             }
 
@@ -1117,66 +1433,146 @@ done_write:
     return TinyCLR_Result::Success;
 }
 
+// Hands fully read packets back to the receiver. Rx is re-armed once for all of them.
+static void TinyCLR_UsbClient_RxRelease(UsClientState* usClientState, int32_t endpoint, uint32_t packets) {
+    if (packets == 0)
+        return;
+
+    TinyCLR_UsbClient_ReleasePackets(usClientState, endpoint, packets);
+
+    if (usClientState->fifoPacketCount[endpoint] == 0)
+        TinyCLR_UsbClient_ClearEvent(usClientState, 1 << endpoint);
+
+    TinyCLR_UsbClient_RxEnable(usClientState, endpoint);
+}
+
+static int32_t TinyCLR_UsbClient_GetRxEndpoint(UsClientState* usClientState, uint32_t pipe) {
+    if (!usClientState->initialized || usClientState->deviceState != USB_DEVICE_STATE_CONFIGURED)
+        return USB_ENDPOINT_NULL;
+
+    int32_t endpoint = usClientState->pipes[pipe].RxEP;
+    // If no Read side to pipe (or if not yet open)
+    if (endpoint == USB_ENDPOINT_NULL || usClientState->queues[endpoint] == nullptr)
+        return USB_ENDPOINT_NULL;
+
+    return endpoint;
+}
+
 TinyCLR_Result TinyCLR_UsbClient_ReadPipe(const TinyCLR_UsbClient_Controller* self, uint32_t pipe, uint8_t* data, size_t& length) {
-    int32_t endpoint;
     UsClientState * usClientState = reinterpret_cast<UsClientState*>(self->ApiInfo->State);
 
-    if (!usClientState->initialized || usClientState->deviceState != USB_DEVICE_STATE_CONFIGURED) {
-        return TinyCLR_Result::NotAvailable;
-    }
+    int32_t endpoint = TinyCLR_UsbClient_GetRxEndpoint(usClientState, pipe);
 
-    endpoint = usClientState->pipes[pipe].RxEP;
-    // If no Read side to pipe (or if not yet open)
-    if (endpoint == USB_ENDPOINT_NULL || usClientState->queues[endpoint] == nullptr) {
+    if (endpoint == USB_ENDPOINT_NULL)
         return TinyCLR_Result::NotAvailable;
-    }
 
     DISABLE_INTERRUPTS_SCOPED(irq);
 
-    USB_PACKET64* Packet64 = nullptr;
-    uint8_t*        ptr = reinterpret_cast<uint8_t*>(data);
-    uint32_t        count = 0;
-    uint32_t        remain = length;
+    uint32_t ready = usClientState->fifoPacketCount[endpoint];
+    uint32_t offset = usClientState->currentPacketOffset[endpoint];
+    uint32_t packets = 0;
+    size_t count = 0;
 
-    while (count < length) {
-        uint32_t max_move;
+    // Drains every packet that is ready in one pass. A packet only leaves the queue once it is read to the end,
+    // a partly read one stays at the head with its offset.
+    while (count < length && packets < ready) {
+        auto Packet64 = TinyCLR_UsbClient_GetQueuedPacket(usClientState, endpoint, packets);
 
-        if (usClientState->fifoPacketCount[endpoint] > 0) {
-            Packet64 = &usClientState->queues[endpoint][usClientState->fifoPacketOut[endpoint]];
+        if (offset > Packet64->Size)
+            offset = Packet64->Size;
 
-            usClientState->fifoPacketCount[endpoint]--;
-            usClientState->fifoPacketOut[endpoint]++;
+        auto max_move = __min(Packet64->Size - offset, length - count);
 
-            if (usClientState->fifoPacketOut[endpoint] == usClientState->maxFifoPacketCount[endpoint]) {
-                usClientState->fifoPacketOut[endpoint] = 0;
-            }
-        }
+        memcpy(data + count, &Packet64->Buffer[offset], max_move);
 
-        if (!Packet64) {
-            TinyCLR_UsbClient_ClearEvent(usClientState, 1 << endpoint);
-            break;
+        count += max_move;
+        offset += max_move;
+
+        if (offset == Packet64->Size) {
+            offset = 0;
+            packets++;
         }
+    }
 
-        max_move = Packet64->Size - usClientState->currentPacketOffset[endpoint];
-        if (remain < max_move) max_move = remain;
+    usClientState->currentPacketOffset[endpoint] = offset;
 
-        memcpy(ptr, &Packet64->Buffer[usClientState->currentPacketOffset[endpoint]], max_move);
+    TinyCLR_UsbClient_RxRelease(usClientState, endpoint, packets);
 
-        usClientState->currentPacketOffset[endpoint] += max_move;
-        ptr += max_move;
-        count += max_move;
-        remain -= max_move;
+    length = count;
+
+    return TinyCLR_Result::Success;
+}
+
+// Unread bytes of the packet at the head of the read queue, in place. length is 0 when nothing was received. The
+// bytes stay valid until ConsumeReadSpan or ReadPipe moves past them.
+TinyCLR_Result TinyCLR_UsbClient_GetReadSpan(const TinyCLR_UsbClient_Controller* self, uint32_t pipe, const uint8_t*& data, size_t& length) {
+    UsClientState * usClientState = reinterpret_cast<UsClientState*>(self->ApiInfo->State);
+
+    int32_t endpoint = TinyCLR_UsbClient_GetRxEndpoint(usClientState, pipe);
 
-        /* if we're done with this packet, move onto the next */
-        if (usClientState->currentPacketOffset[endpoint] == Packet64->Size) {
-            usClientState->currentPacketOffset[endpoint] = 0;
-            Packet64 = nullptr;
+    if (endpoint == USB_ENDPOINT_NULL)
+        return TinyCLR_Result::NotAvailable;
+
+    DISABLE_INTERRUPTS_SCOPED(irq);
+
+    uint32_t packets = 0;
+    uint32_t offset = usClientState->currentPacketOffset[endpoint];
+
+    data = nullptr;
+    length = 0;
 
-            TinyCLR_UsbClient_RxEnable(usClientState, endpoint);
+    // zero length packets carry nothing to look at
+    while (packets < usClientState->fifoPacketCount[endpoint]) {
+        auto Packet64 = TinyCLR_UsbClient_GetQueuedPacket(usClientState, endpoint, packets);
+
+        if (Packet64->Size > offset) {
+            data = &Packet64->Buffer[offset];
+            length = Packet64->Size - offset;
+
+            break;
         }
+
+        offset = 0;
+        packets++;
     }
 
-    length = count;
+    if (packets > 0)
+        usClientState->currentPacketOffset[endpoint] = 0;
+
+    TinyCLR_UsbClient_RxRelease(usClientState, endpoint, packets);
+
+    return TinyCLR_Result::Success;
+}
+
+TinyCLR_Result TinyCLR_UsbClient_ConsumeReadSpan(const TinyCLR_UsbClient_Controller* self, uint32_t pipe, size_t length) {
+    UsClientState * usClientState = reinterpret_cast<UsClientState*>(self->ApiInfo->State);
+
+    int32_t endpoint = TinyCLR_UsbClient_GetRxEndpoint(usClientState, pipe);
+
+    if (endpoint == USB_ENDPOINT_NULL)
+        return TinyCLR_Result::NotAvailable;
+
+    DISABLE_INTERRUPTS_SCOPED(irq);
+
+    if (length == 0)
+        return TinyCLR_Result::Success;
+
+    if (usClientState->fifoPacketCount[endpoint] == 0)
+        return TinyCLR_Result::ArgumentOutOfRange;
+
+    auto Packet64 = TinyCLR_UsbClient_GetQueuedPacket(usClientState, endpoint, 0);
+    auto offset = usClientState->currentPacketOffset[endpoint];
+
+    if (offset > Packet64->Size || length > Packet64->Size - offset)
+        return TinyCLR_Result::ArgumentOutOfRange;
+
+    usClientState->currentPacketOffset[endpoint] += length;
+
+    if (usClientState->currentPacketOffset[endpoint] == Packet64->Size) {
+        usClientState->currentPacketOffset[endpoint] = 0;
+
+        TinyCLR_UsbClient_RxRelease(usClientState, endpoint, 1);
+    }
 
     return TinyCLR_Result::Success;
 }
@@ -1199,17 +1595,17 @@ TinyCLR_Result TinyCLR_UsbClient_FlushPipe(const TinyCLR_UsbClient_Controller* s
         return TinyCLR_Result::NotAvailable;
     }
 
-    queueCnt = usClientState->fifoPacketCount[endpoint];
+    queueCnt = TinyCLR_UsbClient_GetTxProgress(usClientState, endpoint);
 
     // interrupts were disabled or USB interrupt was disabled for whatever reason, so force the flush
-    while (usClientState->fifoPacketCount[endpoint] > 0 && retries > 0) {
+    while ((usClientState->fifoPacketCount[endpoint] > 0 || usClientState->transferHead[endpoint] != nullptr) && retries > 0) {
         TinyCLR_UsbClient_StartOutput(usClientState, endpoint);
 
-        TinyCLR_UsbClient_Delay(queueCnt == usClientState->fifoPacketCount[endpoint] ? 100 : 0); // don't call Events_WaitForEventsXXX because it will turn off interrupts
+        TinyCLR_UsbClient_Delay(queueCnt == TinyCLR_UsbClient_GetTxProgress(usClientState, endpoint) ? 100 : 0); // don't call Events_WaitForEventsXXX because it will turn off interrupts
 
-        retries = (queueCnt == usClientState->fifoPacketCount[endpoint]) ? retries - 1 : USB_FLUSH_RETRY_COUNT;
+        retries = (queueCnt == TinyCLR_UsbClient_GetTxProgress(usClientState, endpoint)) ? retries - 1 : USB_FLUSH_RETRY_COUNT;
 
-        queueCnt = usClientState->fifoPacketCount[endpoint];
+        queueCnt = TinyCLR_UsbClient_GetTxProgress(usClientState, endpoint);
     }
 
     if (retries <= 0)
@@ -1218,6 +1614,29 @@ TinyCLR_Result TinyCLR_UsbClient_FlushPipe(const TinyCLR_UsbClient_Controller* s
     return TinyCLR_Result::Success;
 }
 
+TinyCLR_Result TinyCLR_UsbClient_SubmitTransfer(const TinyCLR_UsbClient_Controller* self, uint32_t pipe, USB_TRANSFER* transfer) {
+    UsClientState * usClientState = reinterpret_cast<UsClientState*>(self->ApiInfo->State);
+
+    if (transfer == nullptr || (transfer->Segments == nullptr && transfer->SegmentCount > 0))
+        return TinyCLR_Result::ArgumentNull;
+
+    if (!usClientState->initialized || usClientState->deviceState != USB_DEVICE_STATE_CONFIGURED)
+        return TinyCLR_Result::NotAvailable;
+
+    int32_t endpoint = usClientState->pipes[pipe].TxEP;
+    // If no Write side to pipe (or if not yet open)
+    if (endpoint == USB_ENDPOINT_NULL || usClientState->queues[endpoint] == nullptr || usClientState->transferStaging[endpoint] == nullptr)
+        return TinyCLR_Result::NotAvailable;
+
+    DISABLE_INTERRUPTS_SCOPED(irq);
+
+    TinyCLR_UsbClient_QueueTransfer(usClientState, endpoint, transfer);
+
+    TinyCLR_UsbClient_StartOutput(usClientState, endpoint);
+
+    return TinyCLR_Result::Success;
+}
+
 TinyCLR_Result TinyCLR_UsbClient_SetDataReceivedHandler(const TinyCLR_UsbClient_Controller* self, TinyCLR_UsbClient_DataReceivedHandler handler) {
     TinyCLR_UsbClient_SetDataReceived = handler;
 
@@ -1312,33 +1731,80 @@ size_t TinyCLR_UsbClient_GetReadBufferSize(const TinyCLR_UsbClient_Controller* s
 #endif  
 }
 
-TinyCLR_Result TinyCLR_UsbClient_SetWriteBufferSize(const TinyCLR_UsbClient_Controller* self, uint32_t pipe, size_t size) {
 #if DEVICE_MEMORY_PROFILE_FACTOR > 5
-    UsClientState * usClientState = reinterpret_cast<UsClientState*>(self->ApiInfo->State);
+// Changes how many pool packets an endpoint keeps to itself (minimum) and how many it may queue at most (maximum).
+// Whatever is queued on the endpoint is dropped when either changes.
+static TinyCLR_Result TinyCLR_UsbClient_SetPacketReservation(UsClientState* usClientState, int32_t endpoint, size_t minimum, size_t maximum) {
+    if (endpoint == USB_ENDPOINT_NULL || endpoint >= usClientState->totalEndpointsCount)
+        return TinyCLR_Result::InvalidOperation;
 
-    int32_t endpoint = usClientState->pipes[pipe].TxEP;
+    if (maximum == 0 || maximum > 0xFF || minimum > maximum)
+        return TinyCLR_Result::ArgumentOutOfRange;
 
-    if (usClientState->maxFifoPacketCount[endpoint] != size) {
-        usClientState->maxFifoPacketCount[endpoint] = size;
+    if (usClientState->minFifoPacketCount[endpoint] == minimum && usClientState->maxFifoPacketCount[endpoint] == maximum)
+        return TinyCLR_Result::Success;
 
-        if (apiManager != nullptr) {
-            auto memoryManager = reinterpret_cast<const TinyCLR_Memory_Manager*>(apiManager->FindDefault(apiManager, TinyCLR_Api_Type::MemoryManager));
+    if (apiManager == nullptr)
+        return TinyCLR_Result::InvalidOperation;
 
-            if (usClientState->queues[endpoint] != nullptr) {
-                // free if allocated
-                memoryManager->Free(memoryManager, usClientState->queues[endpoint]);
-            }
+    auto memoryManager = reinterpret_cast<const TinyCLR_Memory_Manager*>(apiManager->FindDefault(apiManager, TinyCLR_Api_Type::MemoryManager));
+    auto open = usClientState->queues[endpoint] != nullptr;
+    uint16_t* queue = nullptr;
 
-            // relocated
-            usClientState->queues[endpoint] = (USB_PACKET64*)memoryManager->Allocate(memoryManager, usClientState->maxFifoPacketCount[endpoint] * sizeof(USB_PACKET64));
+    if (open && usClientState->maxFifoPacketCount[endpoint] != maximum) {
+        queue = reinterpret_cast<uint16_t*>(memoryManager->Allocate(memoryManager, maximum * sizeof(uint16_t)));
 
-            memset(reinterpret_cast<uint8_t*>(usClientState->queues[endpoint]), 0x00, usClientState->maxFifoPacketCount[endpoint] * sizeof(USB_PACKET64));
+        if (queue == nullptr)
+            return TinyCLR_Result::OutOfMemory;
+    }
 
-            TinyCLR_UsbClient_ClearEndpoints(usClientState, endpoint);
+    DISABLE_INTERRUPTS_SCOPED(irq);
+
+    if (open && usClientState->packetPoolReserved - usClientState->minFifoPacketCount[endpoint] + minimum > usClientState->packetPoolCount) {
+        irq.Release();
+
+        if (queue != nullptr)
+            memoryManager->Free(memoryManager, queue);
+
+        return TinyCLR_Result::OutOfMemory;
+    }
+
+    TinyCLR_UsbClient_ClearEndpoints(usClientState, endpoint);
+
+    if (open) {
+        usClientState->packetPoolReserved = usClientState->packetPoolReserved - usClientState->minFifoPacketCount[endpoint] + minimum;
+
+        if (queue != nullptr) {
+            auto old = usClientState->queues[endpoint];
+
+            usClientState->queues[endpoint] = queue;
+
+            queue = old;
         }
     }
 
+    usClientState->minFifoPacketCount[endpoint] = minimum;
+    usClientState->maxFifoPacketCount[endpoint] = maximum;
+
+    irq.Release();
+
+    if (queue != nullptr)
+        memoryManager->Free(memoryManager, queue);
+
     return TinyCLR_Result::Success;
+}
+#endif
+
+TinyCLR_Result TinyCLR_UsbClient_SetWriteBufferSize(const TinyCLR_UsbClient_Controller* self, uint32_t pipe, size_t size) {
+#if DEVICE_MEMORY_PROFILE_FACTOR > 5
+    UsClientState * usClientState = reinterpret_cast<UsClientState*>(self->ApiInfo->State);
+
+    int32_t endpoint = usClientState->pipes[pipe].TxEP;
+
+    if (endpoint == USB_ENDPOINT_NULL)
+        return TinyCLR_Result::InvalidOperation;
+
+    return TinyCLR_UsbClient_SetPacketReservation(usClientState, endpoint, __min(usClientState->minFifoPacketCount[endpoint], size), size);
 #else
     return TinyCLR_Result::NotSupported;
 #endif  
@@ -1350,30 +1816,30 @@ TinyCLR_Result TinyCLR_UsbClient_SetReadBufferSize(const TinyCLR_UsbClient_Contr
 
     int32_t endpoint = usClientState->pipes[pipe].RxEP;
 
-    if (usClientState->maxFifoPacketCount[endpoint] != size) {
-        usClientState->maxFifoPacketCount[endpoint] = size;
-
-        if (apiManager != nullptr) {
-            auto memoryManager = reinterpret_cast<const TinyCLR_Memory_Manager*>(apiManager->FindDefault(apiManager, TinyCLR_Api_Type::MemoryManager));
+    if (endpoint == USB_ENDPOINT_NULL)
+        return TinyCLR_Result::InvalidOperation;
 
-            if (usClientState->queues[endpoint] != nullptr) {
-                // free if allocated
-                memoryManager->Free(memoryManager, usClientState->queues[endpoint]);
-            }
+    return TinyCLR_UsbClient_SetPacketReservation(usClientState, endpoint, __min(usClientState->minFifoPacketCount[endpoint], size), size);
+#else
+    return TinyCLR_Result::NotSupported;
+#endif  
+}
 
-            // relocated
-            usClientState->queues[endpoint] = (USB_PACKET64*)memoryManager->Allocate(memoryManager, usClientState->maxFifoPacketCount[endpoint] * sizeof(USB_PACKET64));
+// The buffer size set through Set{Write,Read}BufferSize is the most an endpoint may take from the packet pool;
+// this sets how many of those stay reserved for it while its pipe is open.
+TinyCLR_Result TinyCLR_UsbClient_SetBufferReservation(const TinyCLR_UsbClient_Controller* self, uint32_t pipe, bool write, size_t minimum) {
+#if DEVICE_MEMORY_PROFILE_FACTOR > 5
+    UsClientState * usClientState = reinterpret_cast<UsClientState*>(self->ApiInfo->State);
 
-            memset(reinterpret_cast<uint8_t*>(usClientState->queues[endpoint]), 0x00, usClientState->maxFifoPacketCount[endpoint] * sizeof(USB_PACKET64));
+    int32_t endpoint = write ? usClientState->pipes[pipe].TxEP : usClientState->pipes[pipe].RxEP;
 
-            TinyCLR_UsbClient_ClearEndpoints(usClientState, endpoint);
-        }
-    }
+    if (endpoint == USB_ENDPOINT_NULL)
+        return TinyCLR_Result::InvalidOperation;
 
-    return TinyCLR_Result::Success;
+    return TinyCLR_UsbClient_SetPacketReservation(usClientState, endpoint, minimum, usClientState->maxFifoPacketCount[endpoint]);
 #else
     return TinyCLR_Result::NotSupported;
-#endif  
+#endif
 }
 
 void TinyCLR_UsbClient_Reset(int32_t controllerIndex) {
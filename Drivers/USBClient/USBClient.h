@@ -115,6 +115,8 @@
 // This size must be large than WinUsb xproperty os size (0x8E)
 #define USB_ENDPOINT_CONTROL_BUFFER_SIZE 256
 
+#define USB_PACKET_POOL_END 0xFFFF
+
 struct USB_PACKET64 {
     uint32_t Size;
     uint8_t Buffer[64];
@@ -125,6 +127,36 @@ struct USB_PIPE_MAP {
     uint8_t TxEP;
 };
 
+struct USB_TRANSFER;
+
+typedef void(*USB_TRANSFER_CALLBACK)(USB_TRANSFER* transfer);
+
+struct USB_TRANSFER_SEGMENT {
+    const uint8_t* Data;
+    uint32_t Length;
+};
+
+// Zero copy write submitted through TinyCLR_UsbClient_SubmitTransfer. The descriptor and the segments it points to
+// belong to the caller and must stay untouched until Callback ran. The segments are sent as one USB transfer: full
+// packets are fed to the hardware straight from the segments, only a packet that spans two segments and the short
+// packet at the end are staged. Callback runs from the USB interrupt once the last packet went out, or when the
+// transfer was dropped (pipe closed, endpoint halted, device detached, Result then is not Success).
+struct USB_TRANSFER {
+    const USB_TRANSFER_SEGMENT* Segments;
+    uint32_t SegmentCount;
+    USB_TRANSFER_CALLBACK Callback;
+    void* Context;
+
+    TinyCLR_Result Result;
+    uint32_t Transferred;
+
+    /* owned by the driver while queued */
+    USB_TRANSFER* next;
+    uint32_t segment;
+    uint32_t offset;
+    bool lastPacketSent;
+};
+
 struct UsClientState {
     int32_t controllerIndex;
     bool initialized;
@@ -134,7 +166,7 @@ struct UsClientState {
     TinyCLR_UsbClient_DeviceDescriptor deviceDescriptor;
 
     /* queues & maxPacketSize must be initialized by the HAL */
-    USB_PACKET64** queues;
+    uint16_t** queues;
     uint8_t* currentPacketOffset;
     bool* isTxQueue;
 
@@ -150,7 +182,7 @@ struct UsClientState {
     /* USB hardware information */
     uint8_t address;
     uint8_t deviceState;
-    uint8_t* maxEndpointsPacketSize;
+    uint16_t* maxEndpointsPacketSize;
     uint8_t configurationNum;
     uint32_t firstGetDescriptor;
 
@@ -175,6 +207,21 @@ struct UsClientState {
     uint8_t* fifoPacketCount;
     uint8_t* maxFifoPacketCount;
     uint8_t maxFifoPacketCountDefault;
+    uint8_t* minFifoPacketCount;
+    uint8_t minFifoPacketCountDefault;
+
+    /* packets shared by all endpoints, queues hold indices into the pool. packetPoolCount must be initialized by the HAL */
+    USB_PACKET64* packetPool;
+    uint16_t* packetPoolLinks;
+    uint16_t packetPoolFree;
+    uint16_t packetPoolCount;
+    uint16_t packetPoolReserved;
+    uint16_t packetPoolShared;
+
+    /* submitted transfers per Tx endpoint, a staging packet for each */
+    USB_TRANSFER** transferHead;
+    USB_TRANSFER** transferTail;
+    uint8_t** transferStaging;
 
     uint8_t* controlEndpointBuffer;
 
@@ -206,6 +253,10 @@ size_t TinyCLR_UsbClient_GetWriteBufferSize(const TinyCLR_UsbClient_Controller*
 size_t TinyCLR_UsbClient_GetReadBufferSize(const TinyCLR_UsbClient_Controller* self, uint32_t pipe);
 TinyCLR_Result TinyCLR_UsbClient_SetWriteBufferSize(const TinyCLR_UsbClient_Controller* self, uint32_t pipe, size_t size);
 TinyCLR_Result TinyCLR_UsbClient_SetReadBufferSize(const TinyCLR_UsbClient_Controller* self, uint32_t pipe, size_t size);
+TinyCLR_Result TinyCLR_UsbClient_GetReadSpan(const TinyCLR_UsbClient_Controller* self, uint32_t pipe, const uint8_t*& data, size_t& length);
+TinyCLR_Result TinyCLR_UsbClient_ConsumeReadSpan(const TinyCLR_UsbClient_Controller* self, uint32_t pipe, size_t length);
+TinyCLR_Result TinyCLR_UsbClient_SubmitTransfer(const TinyCLR_UsbClient_Controller* self, uint32_t pipe, USB_TRANSFER* transfer);
+TinyCLR_Result TinyCLR_UsbClient_SetBufferReservation(const TinyCLR_UsbClient_Controller* self, uint32_t pipe, bool write, size_t minimum);
 
 bool TinyCLR_UsbClient_Initialize(UsClientState* usClientState);
 bool TinyCLR_UsbClient_Uninitialize(UsClientState* usClientState);
@@ -519,6 +519,9 @@ int32_t AT91_Dac_GetMinValue(const TinyCLR_Dac_Controller* self);
 int32_t AT91_Dac_GetMaxValue(const TinyCLR_Dac_Controller* self);
 
 // PWM
+// Duty cycles for SetDutyCycles are Q16, this one keeps the output on for the whole period
+#define AT91_PWM_FULL_DUTY_CYCLE (1 << 16)
+
 struct PwmState {
     int32_t controllerIndex;
     uint32_t                        *channelModeReg;
@@ -533,6 +536,12 @@ struct PwmState {
     double                          frequency;
     double                          dutyCycle[MAX_PWM_PER_CONTROLLER];
 
+    // set through SetDutyCycles, only turned into dutyCycle when the frequency changes
+    bool                            isDutyCycleFixed[MAX_PWM_PER_CONTROLLER];
+    uint32_t                        fixedDutyCycle[MAX_PWM_PER_CONTROLLER];
+
+    uint32_t                        periodTicks;
+
     uint16_t initializeCount;
 };
 void AT91_Pwm_AddApi(const TinyCLR_Api_Manager* apiManager);
@@ -543,6 +552,7 @@ TinyCLR_Result AT91_Pwm_Acquire(const TinyCLR_Pwm_Controller* self);
 TinyCLR_Result AT91_Pwm_Release(const TinyCLR_Pwm_Controller* self);
 uint32_t AT91_Pwm_GetGpioPinForChannel(const TinyCLR_Pwm_Controller* self, uint32_t channel);
 TinyCLR_Result AT91_Pwm_SetDesiredFrequency(const TinyCLR_Pwm_Controller* self, double& frequency);
+TinyCLR_Result AT91_Pwm_SetDutyCycles(const TinyCLR_Pwm_Controller* self, const uint32_t* channels, const uint32_t* dutyCycles, size_t count);
 TinyCLR_Result AT91_Pwm_OpenChannel(const TinyCLR_Pwm_Controller* self, uint32_t channel);
 TinyCLR_Result AT91_Pwm_CloseChannel(const TinyCLR_Pwm_Controller* self, uint32_t channel);
 TinyCLR_Result AT91_Pwm_EnableChannel(const TinyCLR_Pwm_Controller* self, uint32_t channel);
@@ -889,6 +899,7 @@ TinyCLR_Result AT91_Deployment_Read(const TinyCLR_Storage_Controller* self, uint
 TinyCLR_Result AT91_Deployment_Write(const TinyCLR_Storage_Controller* self, uint64_t address, size_t& count, const uint8_t* data, uint64_t timeout);
 TinyCLR_Result AT91_Deployment_Erase(const TinyCLR_Storage_Controller* self, uint64_t address, size_t& count, uint64_t timeout);
 TinyCLR_Result AT91_Deployment_IsErased(const TinyCLR_Storage_Controller* self, uint64_t address, size_t count, bool& erased);
+TinyCLR_Result AT91_Deployment_GetSectorHash(const TinyCLR_Storage_Controller* self, uint64_t sector, uint64_t& hash);
 TinyCLR_Result AT91_Deployment_GetBytesPerSector(const TinyCLR_Storage_Controller* self, uint32_t address, int32_t& size);
 TinyCLR_Result AT91_Deployment_GetDescriptor(const TinyCLR_Storage_Controller* self, const TinyCLR_Storage_Descriptor*& descriptor);
 TinyCLR_Result AT91_Deployment_IsPresent(const TinyCLR_Storage_Controller* self, bool& present);
@@ -1303,7 +1314,8 @@ typedef void(*USB_NEXT_CALLBACK)(UsClientState*);
 void TinyCLR_UsbClient_ClearEvent(UsClientState *usClientState, uint32_t event);
 void TinyCLR_UsbClient_ClearEndpoints(UsClientState *usClientState, int32_t endpoint);
 USB_PACKET64* TinyCLR_UsbClient_RxEnqueue(UsClientState* usClientState, int32_t endpoint, bool& disableRx);
-USB_PACKET64* TinyCLR_UsbClient_TxDequeue(UsClientState* usClientState, int32_t endpoint);
+uint32_t TinyCLR_UsbClient_GetPacketRoom(UsClientState* usClientState, int32_t endpoint);
+bool TinyCLR_UsbClient_TxGetPacket(UsClientState* usClientState, int32_t endpoint, const uint8_t*& data, uint32_t& size);
 void TinyCLR_UsbClient_StateCallback(UsClientState* usClientState);
 uint8_t TinyCLR_UsbClient_ControlCallback(UsClientState* usClientState);
 
@@ -1334,6 +1346,7 @@ struct AT91_LCDC {
     static const    uint32_t LCDC_DMAEN = ((uint32_t)0x1 << 0); // (LCDC) DAM Enable
     static const    uint32_t LCDC_DMARST = ((uint32_t)0x1 << 1); // (LCDC) DMA Reset (WO)
     static const    uint32_t LCDC_DMABUSY = ((uint32_t)0x1 << 2); // (LCDC) DMA Reset (WO)
+    static const    uint32_t LCDC_DMAUPDT = ((uint32_t)0x1 << 3); // (LCDC) DMA Configuration Update
 
     /****/ volatile uint32_t LCDC_DMA2DCFG;   // DMA 2D addressing configuration
     static const    uint32_t LCDC_ADDRINC = ((uint32_t)0xFFFF << 0); // (LCDC) Number of 32b words that the DMA must jump when going to the next line
@@ -1491,6 +1504,11 @@ TinyCLR_Result AT91_Display_DrawBuffer(const TinyCLR_Display_Controller* self, i
 TinyCLR_Result AT91_Display_DrawPixel(const TinyCLR_Display_Controller* self, uint32_t x, uint32_t y, uint64_t color);
 TinyCLR_Result AT91_Display_WriteString(const TinyCLR_Display_Controller* self, const char* buffer, size_t length);
 
+// Double buffering, outside the display controller API. Drawing goes to a back buffer and Present shows it
+// at the next vertical blanking; with copyForward what was drawn is carried over into the new back buffer.
+TinyCLR_Result AT91_Display_SetDoubleBuffering(const TinyCLR_Display_Controller* self, bool enable, bool copyForward);
+TinyCLR_Result AT91_Display_Present(const TinyCLR_Display_Controller* self);
+
 //WatchDog
 //////////////////////////////////////////////////////////////////////////////
 // WATCHDOG
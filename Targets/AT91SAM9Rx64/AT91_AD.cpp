@@ -14,8 +14,29 @@
 // limitations under the License.
 
 #include "AT91.h"
+#include "../../Drivers/AdcFilter/AdcFilter.h"
 
-#define MAX_AVERAGE_AMOUNT 5
+// The converter runs continuously over the open channels. A read takes AT91_ADC_SAMPLES fresh conversions of its
+// channel, each one signalled by the channel's end of conversion flag, and filters them with AT91_ADC_FILTER:
+//  AT91_ADC_FILTER_MEDIAN      the median averaged with its two neighbours, spikes in either direction are dropped
+//  AT91_ADC_FILTER_OVERSAMPLE  the rounded mean of all samples, which suits white noise better
+#define AT91_ADC_FILTER_MEDIAN 0
+#define AT91_ADC_FILTER_OVERSAMPLE 1
+
+#ifndef AT91_ADC_FILTER
+#define AT91_ADC_FILTER AT91_ADC_FILTER_MEDIAN
+#endif
+
+#ifndef AT91_ADC_SAMPLES
+#define AT91_ADC_SAMPLES 5
+#endif
+
+#if AT91_ADC_FILTER == AT91_ADC_FILTER_MEDIAN && AT91_ADC_SAMPLES < 3
+#error AT91_ADC_FILTER_MEDIAN needs at least 3 samples
+#endif
+
+// polls of the status register before a conversion is given up on, far above a full sequence at the slowest clock
+#define AT91_ADC_EOC_TIMEOUT 100000
 
 //registers
 #define TOUCHSCREEN_ADC_CONTROLLER_CHANNEL_SELECT                          (*reinterpret_cast<volatile unsigned long *>(0xFFFD0010)) // TSADCC_CHER
@@ -23,6 +44,7 @@
 #define TOUCHSCREEN_ADC_CONTROLLER_MODE_REGISTER                           (*reinterpret_cast<volatile unsigned long *>(0xFFFD0004)) // TSADCC_MR
 #define TOUCHSCREEN_ADC_CONTROLLER_TRIGGER_REGISTER                        (*reinterpret_cast<volatile unsigned long *>(0xFFFD0008)) // TSADCC_TRGR
 #define TOUCHSCREEN_ADC_CONTROLLER_CHANNEL_DATA_REGISTER_BASE_ADDRESS      0xFFFD0030 // TSADCC_TRGR
+#define TOUCHSCREEN_ADC_CONTROLLER_STATUS_REGISTER                         (*reinterpret_cast<volatile unsigned long *>(0xFFFD001C)) // TSADCC_SR
 #define TOTAL_ADC_CONTROLLERS 1
 
 static TinyCLR_Adc_Controller adcControllers[TOTAL_ADC_CONTROLLERS];
@@ -137,62 +159,38 @@ TinyCLR_Result AT91_Adc_CloseChannel(const TinyCLR_Adc_Controller *self, uint32_
     return TinyCLR_Result::Success;
 }
 
-int32_t AT91_Adc_AverageMiddleThreeValues(uint32_t *arrayToSort) {
-    uint32_t valueToReturn;
-
-    int32_t middleArrayPossition = MAX_AVERAGE_AMOUNT / 2;
-    valueToReturn = arrayToSort[middleArrayPossition - 1];
-    valueToReturn += arrayToSort[middleArrayPossition];
-    valueToReturn += arrayToSort[middleArrayPossition + 1];
-
-    return (valueToReturn / 3);
-}
-
-void AT91_Adc_SwapArrayValues_Ascending(uint32_t *arrayToSort, int32_t smallNumberArrayPosition, int32_t largeNumberArrayPosition) {
-    uint32_t smallNumber = arrayToSort[smallNumberArrayPosition];
-    uint32_t largeNumber = arrayToSort[largeNumberArrayPosition];
-    arrayToSort[smallNumberArrayPosition] = largeNumber;
-    arrayToSort[largeNumberArrayPosition] = smallNumber;
-}
-
-void AT91_Adc_SortArray(uint32_t *arrayToSort) {
-    bool isArraySorted = false;
-    int32_t arrayCount;
-
-    while (!isArraySorted) {
-        arrayCount = 0;
-
-        for (int32_t x = 0; x < (MAX_AVERAGE_AMOUNT - 1); x++) {
-            if (arrayToSort[x] < arrayToSort[x + 1])
-                AT91_Adc_SwapArrayValues_Ascending(arrayToSort, x, (x + 1));
-            else
-                arrayCount++;
-        }
-
-        if (arrayCount == (MAX_AVERAGE_AMOUNT - 1))
-            isArraySorted = true;
-    }
+static int32_t AT91_Adc_Filter(uint32_t* samples) {
+#if AT91_ADC_FILTER == AT91_ADC_FILTER_MEDIAN
+    return AdcFilter_Median(samples, AT91_ADC_SAMPLES);
+#else
+    return AdcFilter_Mean(samples, AT91_ADC_SAMPLES);
+#endif
 }
 
 TinyCLR_Result AT91_Adc_ReadChannel(const TinyCLR_Adc_Controller *self, uint32_t channel, int32_t &value) {
-    uint32_t arrayValuesToSort[MAX_AVERAGE_AMOUNT];
-    uint32_t valueToStoreInArray;
+    uint32_t samples[AT91_ADC_SAMPLES];
 
     if (channel >= AT91_Adc_GetChannelCount(self))
         return TinyCLR_Result::ArgumentOutOfRange;
 
     value = 0;
 
-    // get the values
-    for (auto i = 0; i < MAX_AVERAGE_AMOUNT; i++) {
-        AT91_Time_Delay(nullptr, 5);
-        valueToStoreInArray = *(reinterpret_cast<volatile uint32_t *>(TOUCHSCREEN_ADC_CONTROLLER_CHANNEL_DATA_REGISTER_BASE_ADDRESS + (channel * 0x4)));
-        arrayValuesToSort[i] = valueToStoreInArray;
-    }
+    auto data = reinterpret_cast<volatile uint32_t *>(TOUCHSCREEN_ADC_CONTROLLER_CHANNEL_DATA_REGISTER_BASE_ADDRESS + (channel * 0x4));
+
+    // reading the data register clears the end of conversion flag, what is latched there now may be old
+    samples[0] = *data;
+
+    for (auto i = 0; i < AT91_ADC_SAMPLES; i++) {
+        auto timeout = AT91_ADC_EOC_TIMEOUT;
 
-    AT91_Adc_SortArray(arrayValuesToSort);
+        while (!(TOUCHSCREEN_ADC_CONTROLLER_STATUS_REGISTER & (1 << channel)))
+            if (--timeout == 0)
+                return TinyCLR_Result::TimedOut;
+
+        samples[i] = *data & 0x3FF;
+    }
 
-    value = AT91_Adc_AverageMiddleThreeValues(arrayValuesToSort);
+    value = AT91_Adc_Filter(samples);
 
     return TinyCLR_Result::Success;
 }
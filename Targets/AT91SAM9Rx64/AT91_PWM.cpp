@@ -14,6 +14,7 @@
 // limitations under the License.
 
 #include "AT91.h"
+#include "../../Drivers/PwmDuty/PwmDuty.h"
 
 #define PWM_MODE_REGISTER               (*(uint32_t *)(0xFFFC8000))
 #define PWM_ENABLE_REGISTER             (*(uint32_t *)(0xFFFC8004))
@@ -406,16 +407,50 @@ TinyCLR_Result AT91_Pwm_SetPulseParameters(const TinyCLR_Pwm_Controller* self, u
         pulseBeginsOnHighEdge = 0;
 
     *state->channelModeReg = (volatile unsigned long)(registerDividerFlag | (pulseBeginsOnHighEdge << 9) | (1 << 10));
-    *state->channelUpdateReg = (volatile unsigned long)(convertedPeriod / (divider * 7.5));
+    state->periodTicks = (uint32_t)(convertedPeriod / (divider * 7.5));
+
+    *state->channelUpdateReg = (volatile unsigned long)state->periodTicks;
     *state->dutyCycleReg = (volatile unsigned long)(convertedDuration / (divider * 7.5));
 
     state->invert[channel] = polarity;
     state->dutyCycle[channel] = dutyCycle;
+    state->isDutyCycleFixed[channel] = false;
 
     return TinyCLR_Result::Success;
 
 }
 
+// Sets the duty cycles of several channels together. Duty cycles are Q16 fractions of the period, AT91_PWM_FULL_DUTY_CYCLE
+// is always on, and the polarity stays as last set. The duty is scaled from the period ticks kept by SetPulseParameters
+// with integer math only.
+TinyCLR_Result AT91_Pwm_SetDutyCycles(const TinyCLR_Pwm_Controller* self, const uint32_t* channels, const uint32_t* dutyCycles, size_t count) {
+    if (channels == nullptr || dutyCycles == nullptr)
+        return TinyCLR_Result::ArgumentNull;
+
+    auto state = reinterpret_cast<PwmState*>(self->ApiInfo->State);
+
+    // no frequency set yet
+    if (state->periodTicks == 0)
+        return TinyCLR_Result::InvalidOperation;
+
+    for (auto i = 0u; i < count; i++)
+        if (channels[i] >= MAX_PWM_PER_CONTROLLER || !state->isOpened[channels[i]])
+            return TinyCLR_Result::ArgumentOutOfRange;
+
+    // Every controller drives a single channel, the PWMC channels have no common latch to hold several of them back.
+    for (auto i = 0u; i < count; i++) {
+        auto channel = channels[i];
+        auto dutyCycle = dutyCycles[i] > AT91_PWM_FULL_DUTY_CYCLE ? AT91_PWM_FULL_DUTY_CYCLE : dutyCycles[i];
+
+        *state->dutyCycleReg = PwmDuty_GetCompare(dutyCycle, state->periodTicks);
+
+        state->isDutyCycleFixed[channel] = true;
+        state->fixedDutyCycle[channel] = dutyCycle;
+    }
+
+    return TinyCLR_Result::Success;
+}
+
 TinyCLR_Result AT91_Pwm_SetDesiredFrequency(const TinyCLR_Pwm_Controller* self, double& frequency) {
     auto state = reinterpret_cast<PwmState*>(self->ApiInfo->State);
 
@@ -424,10 +459,14 @@ TinyCLR_Result AT91_Pwm_SetDesiredFrequency(const TinyCLR_Pwm_Controller* self,
     // Calculate actual frequency
     frequency = AT91_Pwm_GetActualFrequency(self);
 
-    for (int p = 0; p < MAX_PWM_PER_CONTROLLER; p++)
+    for (int p = 0; p < MAX_PWM_PER_CONTROLLER; p++) {
+        if (state->isDutyCycleFixed[p])
+            state->dutyCycle[p] = (double)state->fixedDutyCycle[p] / AT91_PWM_FULL_DUTY_CYCLE;
+
         if (state->gpioPin[p].number != PIN_NONE)
             if (AT91_Pwm_SetPulseParameters(self, p, state->dutyCycle[p], state->invert[p]) != TinyCLR_Result::Success)
                 return TinyCLR_Result::InvalidOperation;
+    }
 
 
     return TinyCLR_Result::Success;
@@ -488,6 +527,8 @@ void AT91_Pwm_ResetController(int32_t controllerIndex) {
             state->invert[p] = TinyCLR_Pwm_PulsePolarity::ActiveLow;
             state->frequency = 0.0;
             state->dutyCycle[p] = 0.0;
+            state->isDutyCycleFixed[p] = false;
+            state->periodTicks = 0;
 
             if (state->isOpened[p] == true) {
                 AT91_Pwm_DisableChannel(&pwmControllers[controllerIndex], p);
@@ -15,6 +15,7 @@
 
 #include <algorithm>
 #include "AT91.h"
+#include "../../Drivers/RingBuffer/RingBuffer.h"
 
 #define USART_EVENT_POST_DEBOUNCE_TICKS (10 * 10000) // 10ms between each events
 
@@ -26,14 +27,10 @@ struct UartState {
 
     uint8_t *TxBuffer;
     uint8_t *RxBuffer;
-    size_t txBufferCount;
-    size_t txBufferIn;
-    size_t txBufferOut;
+    RingBuffer<uint8_t> txRing;
     size_t txBufferSize;
 
-    size_t rxBufferCount;
-    size_t rxBufferIn;
-    size_t rxBufferOut;
+    RingBuffer<uint8_t> rxRing;
     size_t rxBufferSize;
 
     bool handshaking;
@@ -188,12 +185,16 @@ TinyCLR_Result AT91_Uart_SetReadBufferSize(const TinyCLR_Uart_Controller* self,
     auto state = reinterpret_cast<UartState*>(self->ApiInfo->State);
 
     if (state->rxBufferSize) {
+        state->rxRing.Uninitialize();
+
         memoryProvider->Free(memoryProvider, state->RxBuffer);
     }
 
     state->rxBufferSize = size;
 
-    state->RxBuffer = (uint8_t*)memoryProvider->Allocate(memoryProvider, size);
+    auto capacity = RingBuffer<uint8_t>::GetCapacityFor(size);
+
+    state->RxBuffer = (uint8_t*)memoryProvider->Allocate(memoryProvider, capacity);
 
     if (state->RxBuffer == nullptr) {
         state->rxBufferSize = 0;
@@ -201,6 +202,8 @@ TinyCLR_Result AT91_Uart_SetReadBufferSize(const TinyCLR_Uart_Controller* self,
         return TinyCLR_Result::OutOfMemory;
     }
 
+    state->rxRing.Initialize(state->RxBuffer, capacity);
+
     return TinyCLR_Result::Success;
 }
 
@@ -221,12 +224,16 @@ TinyCLR_Result AT91_Uart_SetWriteBufferSize(const TinyCLR_Uart_Controller* self,
         return TinyCLR_Result::ArgumentInvalid;
 
     if (state->txBufferSize) {
+        state->txRing.Uninitialize();
+
         memoryProvider->Free(memoryProvider, state->TxBuffer);
     }
 
     state->txBufferSize = size;
 
-    state->TxBuffer = (uint8_t*)memoryProvider->Allocate(memoryProvider, size);
+    auto capacity = RingBuffer<uint8_t>::GetCapacityFor(size);
+
+    state->TxBuffer = (uint8_t*)memoryProvider->Allocate(memoryProvider, capacity);
 
     if (state->TxBuffer == nullptr) {
         state->txBufferSize = 0;
@@ -234,6 +241,8 @@ TinyCLR_Result AT91_Uart_SetWriteBufferSize(const TinyCLR_Uart_Controller* self,
         return TinyCLR_Result::OutOfMemory;
     }
 
+    state->txRing.Initialize(state->TxBuffer, capacity);
+
     return TinyCLR_Result::Success;
 }
 
@@ -310,7 +319,7 @@ void AT91_Uart_ReceiveData(int32_t controllerIndex, uint32_t sr) {
 
     auto state = &uartStates[controllerIndex];
     auto canPostEvent = AT91_Uart_CanPostEvent(controllerIndex);
-    bool error = (state->rxBufferCount == state->rxBufferSize) || (sr & AT91_USART::US_OVRE) || (sr & AT91_USART::US_FRAME) || (sr & AT91_USART::US_PARE);
+    bool error = state->rxRing.IsFull() || (sr & AT91_USART::US_OVRE) || (sr & AT91_USART::US_FRAME) || (sr & AT91_USART::US_PARE);
 
     if (sr & AT91_USART::US_OVRE)
         if (canPostEvent) AT91_Uart_SetErrorEvent(controllerIndex, TinyCLR_Uart_Error::Overrun);
@@ -321,7 +330,7 @@ void AT91_Uart_ReceiveData(int32_t controllerIndex, uint32_t sr) {
     if (sr & AT91_USART::US_PARE)
         if (canPostEvent) AT91_Uart_SetErrorEvent(controllerIndex, TinyCLR_Uart_Error::ReceiveParity);
 
-    if (state->rxBufferCount == state->rxBufferSize) {
+    if (state->rxRing.IsFull()) {
         if (canPostEvent) AT91_Uart_SetErrorEvent(controllerIndex, TinyCLR_Uart_Error::BufferFull);
     }
 
@@ -335,31 +344,28 @@ void AT91_Uart_ReceiveData(int32_t controllerIndex, uint32_t sr) {
     }
 
     if (sr & AT91_USART::US_RXRDY) {
-        state->RxBuffer[state->rxBufferIn++] = rxdata;
-
-        state->rxBufferCount++;
-
-        if (state->rxBufferIn == state->rxBufferSize)
-            state->rxBufferIn = 0;
+        state->rxRing.Push(rxdata);
 
         if (state->dataReceivedEventHandler != nullptr) {
             if (canPostEvent) {
-                if (state->rxBufferCount > state->lastEventRxBufferCount) {
+                auto count = state->rxRing.GetCount();
+
+                if (count > state->lastEventRxBufferCount) {
                     // if driver hold event long enough that more than 1 byte
-                    state->dataReceivedEventHandler(state->controller, state->rxBufferCount - state->lastEventRxBufferCount, AT91_Time_GetCurrentProcessorTime());
+                    state->dataReceivedEventHandler(state->controller, count - state->lastEventRxBufferCount, AT91_Time_GetCurrentProcessorTime());
                 }
                 else {
                     // if user use poll to read data and rxBufferCount <= lastEventRxBufferCount, driver send at least 1 byte comming
                     state->dataReceivedEventHandler(state->controller, 1, AT91_Time_GetCurrentProcessorTime());
                 }
 
-                state->lastEventRxBufferCount = state->rxBufferCount;
+                state->lastEventRxBufferCount = count;
             }
         }
     }
 
     // Control rts by software - enable / disable when internal buffer reach 3/4
-    if (state->handshaking && (state->rxBufferCount >= ((state->rxBufferSize * 3) / 4))) {
+    if (state->handshaking && (state->rxRing.GetCount() >= ((state->rxBufferSize * 3) / 4))) {
         usart.US_CR |= AT91_USART::US_RTSDIS;// Write rts to 1
     }
 }
@@ -369,13 +375,9 @@ void AT91_Uart_TransmitData(int32_t controllerIndex) {
 
     auto state = &uartStates[controllerIndex];
 
-    if (state->txBufferCount > 0) {
-        uint8_t txdata = state->TxBuffer[state->txBufferOut++];
+    uint8_t txdata;
 
-        state->txBufferCount--;
-
-        if (state->txBufferOut == state->txBufferSize)
-            state->txBufferOut = 0;
+    if (state->txRing.Pop(txdata)) {
 
         usart.US_THR = txdata; // write TX data
 
@@ -448,14 +450,6 @@ TinyCLR_Result AT91_Uart_Acquire(const TinyCLR_Uart_Controller* self) {
         if (!AT91_Gpio_OpenPin(txPin) || !AT91_Gpio_OpenPin(rxPin))
             return TinyCLR_Result::SharingViolation;
 
-        state->txBufferCount = 0;
-        state->txBufferIn = 0;
-        state->txBufferOut = 0;
-
-        state->rxBufferCount = 0;
-        state->rxBufferIn = 0;
-        state->rxBufferOut = 0;
-
         state->controller = self;
         state->handshaking = false;
         state->enable = false;
@@ -597,25 +591,33 @@ TinyCLR_Result AT91_Uart_SetActiveSettings(const TinyCLR_Uart_Controller* self,
     if (state->txBufferSize == 0) {
         state->txBufferSize = uartTxDefaultBuffersSize[controllerIndex];
 
-        state->TxBuffer = (uint8_t*)memoryProvider->Allocate(memoryProvider, state->txBufferSize);
+        auto capacity = RingBuffer<uint8_t>::GetCapacityFor(state->txBufferSize);
+
+        state->TxBuffer = (uint8_t*)memoryProvider->Allocate(memoryProvider, capacity);
 
         if (state->TxBuffer == nullptr) {
             state->txBufferSize = 0;
 
             return TinyCLR_Result::OutOfMemory;
         }
+
+        state->txRing.Initialize(state->TxBuffer, capacity);
     }
 
     if (state->rxBufferSize == 0) {
         state->rxBufferSize = uartRxDefaultBuffersSize[controllerIndex];
 
-        state->RxBuffer = (uint8_t*)memoryProvider->Allocate(memoryProvider, state->rxBufferSize);
+        auto capacity = RingBuffer<uint8_t>::GetCapacityFor(state->rxBufferSize);
+
+        state->RxBuffer = (uint8_t*)memoryProvider->Allocate(memoryProvider, capacity);
 
         if (state->RxBuffer == nullptr) {
             state->rxBufferSize = 0;
 
             return TinyCLR_Result::OutOfMemory;
         }
+
+        state->rxRing.Initialize(state->RxBuffer, capacity);
     }
 
     usart.US_MR = USMR;
@@ -638,13 +640,6 @@ TinyCLR_Result AT91_Uart_Release(const TinyCLR_Uart_Controller* self) {
     if (state->initializeCount == 0) {
         auto controllerIndex = state->controllerIndex;
 
-        state->txBufferCount = 0;
-        state->txBufferIn = 0;
-        state->txBufferOut = 0;
-
-        state->rxBufferCount = 0;
-        state->rxBufferIn = 0;
-        state->rxBufferOut = 0;
 
         state->handshaking = false;
         state->enable = false;
@@ -663,12 +658,16 @@ TinyCLR_Result AT91_Uart_Release(const TinyCLR_Uart_Controller* self) {
             auto memoryProvider = (const TinyCLR_Memory_Manager*)apiManager->FindDefault(apiManager, TinyCLR_Api_Type::MemoryManager);
 
             if (state->txBufferSize != 0) {
+                state->txRing.Uninitialize();
+
                 memoryProvider->Free(memoryProvider, state->TxBuffer);
 
                 state->txBufferSize = 0;
             }
 
             if (state->rxBufferSize != 0) {
+                state->rxRing.Uninitialize();
+
                 memoryProvider->Free(memoryProvider, state->RxBuffer);
 
                 state->rxBufferSize = 0;
@@ -725,7 +724,7 @@ TinyCLR_Result AT91_Uart_Flush(const TinyCLR_Uart_Controller* self) {
     // Make sute interrupt is enable
     AT91_Uart_TxBufferEmptyInterruptEnable(controllerIndex, true);
 
-    while (state->txBufferCount > 0) {
+    while (!state->txRing.IsEmpty()) {
         AT91_Time_Delay(nullptr, 1);
     }
 
@@ -733,8 +732,6 @@ TinyCLR_Result AT91_Uart_Flush(const TinyCLR_Uart_Controller* self) {
 }
 
 TinyCLR_Result AT91_Uart_Read(const TinyCLR_Uart_Controller* self, uint8_t* buffer, size_t& length) {
-    DISABLE_INTERRUPTS_SCOPED(irq);
-
     auto state = reinterpret_cast<UartState*>(self->ApiInfo->State);
     auto controllerIndex = state->controllerIndex;
 
@@ -744,36 +741,19 @@ TinyCLR_Result AT91_Uart_Read(const TinyCLR_Uart_Controller* self, uint8_t* buff
         return TinyCLR_Result::NotAvailable;
     }
 
-    length = std::min(self->GetBytesToRead(self), length);
-
-    size_t i = 0;
+    // the interrupt handler only moves the head, no need to hold it off while copying out
+    length = state->rxRing.PopN(buffer, length);
 
-    while (i < length) {
-        buffer[i] = state->RxBuffer[state->rxBufferOut];
-
-        state->rxBufferOut++;
-        i++;
-        state->rxBufferCount--;
-
-        if (state->rxBufferOut == state->rxBufferSize)
-            state->rxBufferOut = 0;
-
-        // Control rts by software - enable / disable when internal buffer reach 3/4
-        if (state->handshaking && (state->rxBufferCount < ((state->rxBufferSize * 3) / 4))) {
-            AT91_USART &usart = AT91::USART(controllerIndex);
-            usart.US_CR |= AT91_USART::US_RTSEN;// Write rts to 0
-        }
+    // Control rts by software - enable / disable when internal buffer reach 3/4
+    if (state->handshaking && (state->rxRing.GetCount() < ((state->rxBufferSize * 3) / 4))) {
+        AT91_USART &usart = AT91::USART(controllerIndex);
+        usart.US_CR |= AT91_USART::US_RTSEN;// Write rts to 0
     }
 
     return TinyCLR_Result::Success;
 }
 
 TinyCLR_Result AT91_Uart_Write(const TinyCLR_Uart_Controller* self, const uint8_t* buffer, size_t& length) {
-
-    int32_t i = 0;
-
-    DISABLE_INTERRUPTS_SCOPED(irq);
-
     auto state = reinterpret_cast<UartState*>(self->ApiInfo->State);
 
     auto controllerIndex = state->controllerIndex;
@@ -784,28 +764,15 @@ TinyCLR_Result AT91_Uart_Write(const TinyCLR_Uart_Controller* self, const uint8_
         return TinyCLR_Result::NotAvailable;
     }
 
-    if (state->txBufferCount == state->txBufferSize) {
+    if (state->txRing.IsFull()) {
+        length = 0;
+
         AT91_Uart_SetErrorEvent(controllerIndex, TinyCLR_Uart_Error::BufferFull);
 
         return TinyCLR_Result::Busy;
     }
 
-    length = std::min(state->txBufferSize - state->txBufferCount, length);
-
-
-    while (i < length) {
-
-        state->TxBuffer[state->txBufferIn] = buffer[i];
-
-        state->txBufferCount++;
-
-        i++;
-
-        state->txBufferIn++;
-
-        if (state->txBufferIn == state->txBufferSize)
-            state->txBufferIn = 0;
-    }
+    length = state->txRing.PushN(buffer, length);
 
     if (length > 0) {
         AT91_Uart_TxBufferEmptyInterruptEnable(controllerIndex, true); // Enable Tx to start transfer
@@ -881,19 +848,20 @@ TinyCLR_Result AT91_Uart_SetIsRequestToSendEnabled(const TinyCLR_Uart_Controller
 size_t AT91_Uart_GetBytesToRead(const TinyCLR_Uart_Controller* self) {
     auto state = reinterpret_cast<UartState*>(self->ApiInfo->State);
 
-    return state->rxBufferCount;
+    return state->rxRing.GetCount();
 }
 
 size_t AT91_Uart_GetBytesToWrite(const TinyCLR_Uart_Controller* self) {
     auto state = reinterpret_cast<UartState*>(self->ApiInfo->State);
 
-    return state->txBufferCount;
+    return state->txRing.GetCount();
 }
 
 TinyCLR_Result AT91_Uart_ClearReadBuffer(const TinyCLR_Uart_Controller* self) {
     auto state = reinterpret_cast<UartState*>(self->ApiInfo->State);
 
-    state->rxBufferCount = state->rxBufferIn = state->rxBufferOut = state->lastEventRxBufferCount = 0;
+    state->rxRing.Discard();
+    state->lastEventRxBufferCount = 0;
 
     return TinyCLR_Result::Success;
 }
@@ -901,7 +869,10 @@ TinyCLR_Result AT91_Uart_ClearReadBuffer(const TinyCLR_Uart_Controller* self) {
 TinyCLR_Result AT91_Uart_ClearWriteBuffer(const TinyCLR_Uart_Controller* self) {
     auto state = reinterpret_cast<UartState*>(self->ApiInfo->State);
 
-    state->txBufferCount = state->txBufferIn = state->txBufferOut = 0;
+    // the interrupt handler owns the tail, keep it out while the ring is emptied from this side
+    DISABLE_INTERRUPTS_SCOPED(irq);
+
+    state->txRing.Discard();
 
     return TinyCLR_Result::Success;
 }
@@ -911,6 +882,9 @@ void AT91_Uart_Reset() {
         uartStates[i].txBufferSize = 0;
         uartStates[i].rxBufferSize = 0;
 
+        uartStates[i].txRing.Uninitialize();
+        uartStates[i].rxRing.Uninitialize();
+
         AT91_Uart_Release(&uartControllers[i]);
 
         uartStates[i].initializeCount = 0;
@@ -17,6 +17,7 @@
 #include <algorithm>
 #include <string.h>
 #include "AT91.h"
+#include "../../Drivers/RingBuffer/RingBuffer.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -1034,9 +1035,7 @@ struct CanState {
     TinyCLR_Can_ErrorReceivedHandler   errorEventHandler;
     TinyCLR_Can_MessageReceivedHandler    messageReceivedEventHandler;
 
-    int32_t can_rx_count;
-    int32_t can_rx_in;
-    int32_t can_rx_out;
+    RingBuffer<AT91_Can_Message> rxRing;
 
     size_t can_rxBufferSize;
     size_t can_txBufferSize;
@@ -1297,12 +1296,17 @@ void CopyMessageFromMailBoxToBuffer(uint8_t controllerIndex, uint32_t dwMsr) {
         }
     }
 
-    if (state->can_rx_count > (state->can_rxBufferSize - 3)) {
+    if (state->rxRing.GetCount() > state->can_rxBufferSize - 3) {
         state->errorEventHandler(state->controller, TinyCLR_Can_Error::BufferFull, AT91_Time_GetCurrentProcessorTime());
     }
 
+    size_t available;
+
     // initialize destination pointer
-    AT91_Can_Message *can_msg = &state->canRxMessagesFifo[state->can_rx_in];
+    AT91_Can_Message *can_msg = state->rxRing.GetWriteSpan(available);
+
+    if (can_msg == nullptr)
+        return;
 
     // timestamp
     uint64_t t = AT91_Time_GetCurrentProcessorTime();
@@ -1322,14 +1326,9 @@ void CopyMessageFromMailBoxToBuffer(uint8_t controllerIndex, uint32_t dwMsr) {
 
     can_msg->dataB = state->can_rx.msgData[1]; // Data B
 
-    state->can_rx_count++;
-    state->can_rx_in++;
-
-    if (state->can_rx_in == state->can_rxBufferSize) {
-        state->can_rx_in = 0;
-    }
+    state->rxRing.Commit(1);
 
-    state->messageReceivedEventHandler(state->controller, state->can_rx_count, t);
+    state->messageReceivedEventHandler(state->controller, state->rxRing.GetCount(), t);
 }
 
 void CAN_ProccessMailbox(uint8_t controllerIndex) {
@@ -1469,9 +1468,7 @@ TinyCLR_Result AT91_Can_Acquire(const TinyCLR_Can_Controller* self) {
         AT91_Gpio_ConfigurePin(canTxPins[controllerIndex].number, AT91_Gpio_Direction::Input, canTxPins[controllerIndex].peripheralSelection, AT91_Gpio_ResistorMode::Inactive);
         AT91_Gpio_ConfigurePin(canRxPins[controllerIndex].number, AT91_Gpio_Direction::Input, canRxPins[controllerIndex].peripheralSelection, AT91_Gpio_ResistorMode::Inactive);
 
-        state->can_rx_count = 0;
-        state->can_rx_in = 0;
-        state->can_rx_out = 0;
+        state->rxRing.Uninitialize();
         state->baudrate = 0;
         state->can_rxBufferSize = canDefaultBuffersSize[controllerIndex];
         state->controller = self;
@@ -1521,6 +1518,8 @@ TinyCLR_Result AT91_Can_Release(const TinyCLR_Can_Controller* self) {
         AT91_Gpio_ClosePin(canRxPins[controllerIndex].number);
 
 
+        state->rxRing.Uninitialize();
+
         if (state->canRxMessagesFifo != nullptr) {
             memoryProvider->Free(memoryProvider, state->canRxMessagesFifo);
 
@@ -1540,9 +1539,7 @@ TinyCLR_Result AT91_Can_SoftReset(const TinyCLR_Can_Controller* self) {
 
     auto state = reinterpret_cast<CanState*>(self->ApiInfo->State);
 
-    state->can_rx_count = 0;
-    state->can_rx_in = 0;
-    state->can_rx_out = 0;
+    state->rxRing.Discard();
 
     sCand *pCand = &state->cand;
 
@@ -1673,17 +1670,8 @@ TinyCLR_Result AT91_Can_ReadMessage(const TinyCLR_Can_Controller* self, TinyCLR_
 
     auto state = reinterpret_cast<CanState*>(self->ApiInfo->State);
 
-    if (state->can_rx_count) {
-        DISABLE_INTERRUPTS_SCOPED(irq);
-
-        can_msg = &state->canRxMessagesFifo[state->can_rx_out];
-        state->can_rx_out++;
-
-        if (state->can_rx_out == state->can_rxBufferSize)
-            state->can_rx_out = 0;
-
-        state->can_rx_count--;
-
+    // the interrupt handler only moves the head, the message is copied out without holding it off
+    if ((can_msg = state->rxRing.Peek()) != nullptr) {
         arbitrationId = can_msg->msgId;
         isExtendedId = can_msg->extendedId;
         isRemoteTransmissionRequest = can_msg->remoteTransmissionRequest;
@@ -1694,6 +1682,8 @@ TinyCLR_Result AT91_Can_ReadMessage(const TinyCLR_Can_Controller* self, TinyCLR_
         length = can_msg->length;
 
         timestamp = ((uint64_t)can_msg->timeStampL) | ((uint64_t)can_msg->timeStampH << 32);
+
+        state->rxRing.Consume(1);
     }
 
     return TinyCLR_Result::Success;
@@ -1718,11 +1708,16 @@ TinyCLR_Result AT91_Can_SetBitTiming(const TinyCLR_Can_Controller* self, const T
 
     auto memoryProvider = (const TinyCLR_Memory_Manager*)apiManager->FindDefault(apiManager, TinyCLR_Api_Type::MemoryManager);
 
-    if (state->canRxMessagesFifo == nullptr)
-        state->canRxMessagesFifo = (AT91_Can_Message*)memoryProvider->Allocate(memoryProvider, state->can_rxBufferSize * sizeof(AT91_Can_Message));
-
     if (state->canRxMessagesFifo == nullptr) {
-        return TinyCLR_Result::OutOfMemory;
+        auto capacity = RingBuffer<AT91_Can_Message>::GetCapacityFor(state->can_rxBufferSize);
+
+        state->canRxMessagesFifo = (AT91_Can_Message*)memoryProvider->Allocate(memoryProvider, capacity * sizeof(AT91_Can_Message));
+
+        if (state->canRxMessagesFifo == nullptr) {
+            return TinyCLR_Result::OutOfMemory;
+        }
+
+        state->rxRing.Initialize(state->canRxMessagesFifo, capacity);
     }
 
     state->baudrate = CAN_BR_PHASE2(phase2) | CAN_BR_PHASE1(phase1) | CAN_BR_PROPAG(propagation) | CAN_BR_SJW(synchronizationJumpWidth) | CAN_BR_BRP(baudratePrescaler) | (useMultiBitSampling ? CAN_BR_SMP_THREE : CAN_BR_SMP_ONCE);
@@ -1758,7 +1753,7 @@ TinyCLR_Result AT91_Can_SetBitTiming(const TinyCLR_Can_Controller* self, const T
 size_t AT91_Can_GetMessagesToRead(const TinyCLR_Can_Controller* self) {
     auto state = reinterpret_cast<CanState*>(self->ApiInfo->State);
 
-    return state->can_rx_count;
+    return state->rxRing.GetCount();
 }
 
 TinyCLR_Result AT91_Can_SetMessageReceivedHandler(const TinyCLR_Can_Controller* self, TinyCLR_Can_MessageReceivedHandler handler) {
@@ -1853,9 +1848,7 @@ TinyCLR_Result AT91_Can_ClearReadBuffer(const TinyCLR_Can_Controller* self) {
 
     auto state = reinterpret_cast<CanState*>(self->ApiInfo->State);
 
-    state->can_rx_count = 0;
-    state->can_rx_in = 0;
-    state->can_rx_out = 0;
+    state->rxRing.Discard();
 
     return TinyCLR_Result::Success;
 }
@@ -1931,6 +1924,7 @@ TinyCLR_Result AT91_Can_SetWriteBufferSize(const TinyCLR_Can_Controller* self, s
 void AT91_Can_Reset() {
     for (int i = 0; i < TOTAL_CAN_CONTROLLERS; i++) {
         canStates[i].canRxMessagesFifo = nullptr;
+        canStates[i].rxRing.Uninitialize();
 
         AT91_Can_Release(&canControllers[i]);
 
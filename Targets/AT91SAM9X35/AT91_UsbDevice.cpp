@@ -16,6 +16,16 @@
 #include "AT91.h"
 #include "../../Drivers/USBClient/USBClient.h"
 
+// Packets shared by all USB endpoints and how many of them each open endpoint keeps to itself. The default pool
+// holds what a single pipe used to allocate for its own queues.
+#ifndef AT91_USB_PACKET_POOL_COUNT
+#define AT91_USB_PACKET_POOL_COUNT (AT91_USB_PACKET_FIFO_COUNT * 2)
+#endif
+
+#ifndef AT91_USB_PACKET_FIFO_RESERVED
+#define AT91_USB_PACKET_FIFO_RESERVED 2
+#endif
+
 // -------- UDPHS_IEN : (UDPHS Offset: 0x10) UDPHS Interrupt Enable Register --------
 #define AT91C_UDPHS_DET_SUSPD (0x1 <<  1) // (UDPHS) Suspend Interrupt Enable/Clear/Status
 #define AT91C_UDPHS_MICRO_SOF (0x1 <<  2) // (UDPHS) Micro-SOF Interrupt Enable/Clear/Status
@@ -148,8 +158,8 @@
 #define SHIFT_INTERUPT             8
 
 #define USB_CTRL_WMAXPACKETSIZE0_EP_WRITE                   64
-#define USB_BULK_WMAXPACKETSIZE_EP_WRITE                    64
-#define USB_BULK_WMAXPACKETSIZE_EP_READ                     64
+#define USB_BULK_WMAXPACKETSIZE_EP_WRITE                    AT91_USB_ENDPOINT_SIZE
+#define USB_BULK_WMAXPACKETSIZE_EP_READ                     AT91_USB_ENDPOINT_SIZE
 
 #define USB_MAX_DATA_PACKET_SIZE    64
 
@@ -247,7 +257,10 @@ void AT91_UsbDevice_ClearTxQueue(UsClientState* usClientState, int32_t endpoint)
 __inline void AT91_UsbDevice_PmcEnableUsbClock(void) {
     (*(volatile uint32_t *)0xFFFFFC10) = 1 << AT91C_ID_UDPHS;
     (*(volatile uint32_t *)0xFFFFFC1C) |= AT91C_CKGR_UPLLEN_ENABLED;
+    // bulk packets above 64 bytes only exist at high speed, otherwise keep the port at full speed
+#if AT91_USB_ENDPOINT_SIZE <= 64
     (*(volatile uint32_t *)0xF803C0E0) |= 3; // Full Speed
+#endif
 }
 
 __inline void AT91_UsbDevice_PmcDisableUsbClock(void) {
@@ -554,21 +567,21 @@ void AT91_UsbDevice_TxPacket(UsClientState* usClientState, int32_t endpoint) {
             return;
         }
     }
-    USB_PACKET64* Packet64;
+    const uint8_t* data;
+    uint32_t size;
+    bool packet;
 
     for (;;) {
-        Packet64 = TinyCLR_UsbClient_TxDequeue(usClientState, endpoint);
+        packet = TinyCLR_UsbClient_TxGetPacket(usClientState, endpoint, data, size);
 
-        if (Packet64 == nullptr || Packet64->Size > 0) {
+        if (!packet || size > 0) {
             break;
         }
     }
 
-    if (Packet64) {
-        int32_t i;
-
-        AT91_UsbDevice_WriteEndPoint(endpoint, Packet64->Buffer, Packet64->Size);
-        usbDeviceDrivers[usClientState->controllerIndex].txNeedZLPS[endpoint] = (Packet64->Size == USB_BULK_WMAXPACKETSIZE_EP_WRITE);
+    if (packet) {
+        AT91_UsbDevice_WriteEndPoint(endpoint, const_cast<uint8_t*>(data), size);
+        usbDeviceDrivers[usClientState->controllerIndex].txNeedZLPS[endpoint] = (size == USB_BULK_WMAXPACKETSIZE_EP_WRITE);
     }
     else {
         // send the zero leght packet since we landed on the FIFO boundary before
@@ -769,6 +782,17 @@ void AT91_UsbDevice_EndpointIsr(UsClientState *usClientState, uint32_t endpoint)
             uint8_t *pDest = (uint8_t *)(pFifo->UDPHS_READEPT0 + 16384 * endpoint);
             uint8_t block = len / USB_MAX_DATA_PACKET_SIZE;
             uint8_t rest = len % USB_MAX_DATA_PACKET_SIZE;
+
+            // a high speed packet takes several queue entries, it stays in the bank until there is room for all of them
+            DisableRx = TinyCLR_UsbClient_GetPacketRoom(usClientState, endpoint) < block + (rest > 0 ? 1 : 0);
+
+            if (DisableRx) {
+                pUdp->UDPHS_IEN &= ~(1 << SHIFT_INTERUPT << endpoint);
+                pUdp->UDPHS_EPT[endpoint].UDPHS_EPTCTLDIS = AT91C_UDPHS_RX_BK_RDY;
+
+                return;
+            }
+
             while (block > 0) {
                 USB_PACKET64* Packet64 = TinyCLR_UsbClient_RxEnqueue(usClientState, endpoint, DisableRx);
                 if (!DisableRx) {
@@ -816,6 +840,8 @@ void AT91_UsbDevice_InitializeConfiguration(UsClientState *usClientState) {
         usClientState->controllerIndex = controller;
 
         usClientState->maxFifoPacketCountDefault = AT91_USB_PACKET_FIFO_COUNT;
+        usClientState->minFifoPacketCountDefault = AT91_USB_PACKET_FIFO_RESERVED;
+        usClientState->packetPoolCount = AT91_USB_PACKET_POOL_COUNT;
         usClientState->totalEndpointsCount = AT91_USB_ENDPOINT_COUNT;
         usClientState->totalPipesCount = AT91_USB_PIPE_COUNT;
 
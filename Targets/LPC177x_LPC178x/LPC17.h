@@ -86,6 +86,21 @@ uint32_t LPC17_Dac_GetResolutionInBits(const TinyCLR_Dac_Controller* self);
 int32_t LPC17_Dac_GetMinValue(const TinyCLR_Dac_Controller* self);
 int32_t LPC17_Dac_GetMaxValue(const TinyCLR_Dac_Controller* self);
 
+typedef void(*LPC17_Dac_StreamHandler)(void* param, uint16_t* samples, size_t count, bool underrun);
+
+TinyCLR_Result LPC17_Dac_StartStream(const TinyCLR_Dac_Controller* self, uint32_t channel, uint16_t* buffer, size_t length, double& frequency, bool circular, LPC17_Dac_StreamHandler handler, void* param);
+TinyCLR_Result LPC17_Dac_SubmitStream(const TinyCLR_Dac_Controller* self, uint32_t channel);
+TinyCLR_Result LPC17_Dac_StopStream(const TinyCLR_Dac_Controller* self, uint32_t channel);
+
+// DMA
+typedef void(*LPC17_Dma_Handler)(void* param, bool error);
+
+bool LPC17_DmaInternal_OpenChannel(uint32_t channel);
+bool LPC17_DmaInternal_CloseChannel(uint32_t channel);
+LPC_GPDMACH_TypeDef* LPC17_DmaInternal_GetChannel(uint32_t channel);
+bool LPC17_DmaInternal_SetHandler(uint32_t channel, LPC17_Dma_Handler handler, void* param);
+void LPC17_Dma_Reset();
+
 // GPIO
 enum class LPC17_Gpio_Direction : uint8_t {
     Input = 0,
@@ -182,6 +197,9 @@ bool LPC17_Gpio_ConfigurePin(int32_t pin, LPC17_Gpio_Direction pinDir, LPC17_Gpi
 void LPC17_Gpio_EnableOutputPin(int32_t pin, bool initialState);
 void LPC17_Gpio_EnableInputPin(int32_t pin, TinyCLR_Gpio_PinDriveMode resistor);
 
+// Duty cycles for SetDutyCycles are Q16, this one keeps the output on for the whole period
+#define LPC17_PWM_FULL_DUTY_CYCLE (1 << 16)
+
 struct PwmState {
     int32_t controllerIndex;
 
@@ -199,6 +217,10 @@ struct PwmState {
     double                          frequency;
     double                          dutyCycle[MAX_PWM_PER_CONTROLLER];
 
+    // set through SetDutyCycles, only turned into dutyCycle when the frequency changes
+    bool                            isDutyCycleFixed[MAX_PWM_PER_CONTROLLER];
+    uint32_t                        fixedDutyCycle[MAX_PWM_PER_CONTROLLER];
+
     uint16_t initializeCount;
 };
 
@@ -209,6 +231,12 @@ TinyCLR_Result LPC17_Pwm_Acquire(const TinyCLR_Pwm_Controller* self);
 TinyCLR_Result LPC17_Pwm_Release(const TinyCLR_Pwm_Controller* self);
 uint32_t LPC17_Pwm_GetGpioPinForChannel(const TinyCLR_Pwm_Controller* self, uint32_t channel);
 TinyCLR_Result LPC17_Pwm_SetDesiredFrequency(const TinyCLR_Pwm_Controller* self, double& frequency);
+TinyCLR_Result LPC17_Pwm_SetDutyCycles(const TinyCLR_Pwm_Controller* self, const uint32_t* channels, const uint32_t* dutyCycles, size_t count);
+typedef void(*LPC17_Pwm_SequenceHandler)(void* param, bool error);
+size_t LPC17_Pwm_GetSequenceSampleSize(const TinyCLR_Pwm_Controller* self);
+TinyCLR_Result LPC17_Pwm_EncodeSequence(const TinyCLR_Pwm_Controller* self, uint32_t firstChannel, uint32_t channelCount, const uint32_t* dutyCycles, size_t length, void* pattern);
+TinyCLR_Result LPC17_Pwm_StartSequence(const TinyCLR_Pwm_Controller* self, uint32_t firstChannel, uint32_t channelCount, const void* pattern, size_t length, uint32_t repeatCount, LPC17_Pwm_SequenceHandler handler, void* param);
+TinyCLR_Result LPC17_Pwm_StopSequence(const TinyCLR_Pwm_Controller* self);
 TinyCLR_Result LPC17_Pwm_OpenChannel(const TinyCLR_Pwm_Controller* self, uint32_t channel);
 TinyCLR_Result LPC17_Pwm_CloseChannel(const TinyCLR_Pwm_Controller* self, uint32_t channel);
 TinyCLR_Result LPC17_Pwm_EnableChannel(const TinyCLR_Pwm_Controller* self, uint32_t channel);
@@ -318,6 +346,7 @@ TinyCLR_Result LPC17_Deployment_Read(const TinyCLR_Storage_Controller* self, uin
 TinyCLR_Result LPC17_Deployment_Write(const TinyCLR_Storage_Controller* self, uint64_t address, size_t& count, const uint8_t* data, uint64_t timeout);
 TinyCLR_Result LPC17_Deployment_Erase(const TinyCLR_Storage_Controller* self, uint64_t address, size_t& count, uint64_t timeout);
 TinyCLR_Result LPC17_Deployment_IsErased(const TinyCLR_Storage_Controller* self, uint64_t address, size_t count, bool& erased);
+TinyCLR_Result LPC17_Deployment_GetSectorHash(const TinyCLR_Storage_Controller* self, uint64_t sector, uint64_t& hash);
 TinyCLR_Result LPC17_Deployment_GetBytesPerSector(const TinyCLR_Storage_Controller* self, uint32_t address, int32_t& size);
 TinyCLR_Result LPC17_Deployment_GetDescriptor(const TinyCLR_Storage_Controller* self, const TinyCLR_Storage_Descriptor*& descriptor);
 TinyCLR_Result LPC17_Deployment_IsPresent(const TinyCLR_Storage_Controller* self, bool& present);
@@ -410,7 +439,7 @@ typedef void(*USB_NEXT_CALLBACK)(UsClientState*);
 void TinyCLR_UsbClient_ClearEvent(UsClientState *usClientState, uint32_t event);
 void TinyCLR_UsbClient_ClearEndpoints(UsClientState *usClientState, int32_t endpoint);
 USB_PACKET64* TinyCLR_UsbClient_RxEnqueue(UsClientState* usClientState, int32_t endpoint, bool& disableRx);
-USB_PACKET64* TinyCLR_UsbClient_TxDequeue(UsClientState* usClientState, int32_t endpoint);
+bool TinyCLR_UsbClient_TxGetPacket(UsClientState* usClientState, int32_t endpoint, const uint8_t*& data, uint32_t& size);
 void TinyCLR_UsbClient_StateCallback(UsClientState* usClientState);
 uint8_t TinyCLR_UsbClient_ControlCallback(UsClientState* usClientState);
 
@@ -428,6 +457,11 @@ TinyCLR_Result LPC17_Display_DrawBuffer(const TinyCLR_Display_Controller* self,
 TinyCLR_Result LPC17_Display_DrawPixel(const TinyCLR_Display_Controller* self, uint32_t x, uint32_t y, uint64_t color);
 TinyCLR_Result LPC17_Display_WriteString(const TinyCLR_Display_Controller* self, const char* buffer, size_t length);
 
+// Double buffering, outside the display controller API. Drawing goes to a back buffer and Present shows it
+// at the next vertical blanking; with copyForward what was drawn is carried over into the new back buffer.
+TinyCLR_Result LPC17_Display_SetDoubleBuffering(const TinyCLR_Display_Controller* self, bool enable, bool copyForward);
+TinyCLR_Result LPC17_Display_Present(const TinyCLR_Display_Controller* self);
+
 //Startup
 void LPC17_Startup_Initialize();
 void LPC17_Startup_GetHeap(uint8_t*& start, size_t& length);
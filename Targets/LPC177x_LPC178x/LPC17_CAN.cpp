@@ -17,6 +17,7 @@
 #include <algorithm>
 #include <string.h>
 #include "LPC17.h"
+#include "../../Drivers/RingBuffer/RingBuffer.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -26,7 +27,23 @@ static const uint32_t canDefaultBuffersSize[] = LPC17_CAN_BUFFER_DEFAULT_SIZE;
 
 #define CAN_TRANSFER_TIMEOUT 0xFFFF
 
-#define CAN_MEM_BASE        0xE0038000
+#ifndef LPC17_CAN_TX_BUFFER_DEFAULT_SIZE
+#define LPC17_CAN_TX_BUFFER_DEFAULT_SIZE 32
+#endif
+
+#define CAN_MOD_TPM (1 << 3)
+
+#define CAN_IER_RX_ERRORS (0x01 | (1 << 7) | (1 << 3) | (1 << 5))
+#define CAN_IER_TX (C1IER_TIE1 | C1IER_TIE2 | C1IER_TIE3)
+
+#define CAN_SR_TBS_ALL (0x00000004 | 0x00000400 | 0x00040000)
+
+#define CAN_MEM_BASE        0x40038000 // acceptance filter RAM
+#define CAN_MEM_SIZE        0x800
+
+#define ACCF_STD_ID_MASK        0x7FF
+#define ACCF_EXT_ID_MASK        0x1FFFFFFF
+#define ACCF_STD_DISABLE        (1 << 12)
 
 /* Acceptance filter mode in AFMR register */
 #define ACCF_OFF                0x01
@@ -2008,13 +2025,15 @@ struct CanState {
     const TinyCLR_Can_Controller* provider;
 
     LPC17_Can_Message *canRxMessagesFifo;
+    LPC17_Can_Message *canTxMessagesFifo;
 
     TinyCLR_Can_ErrorReceivedHandler   errorEventHandler;
     TinyCLR_Can_MessageReceivedHandler    messageReceivedEventHandler;
 
-    int32_t can_rx_count;
-    int32_t can_rx_in;
-    int32_t can_rx_out;
+    RingBuffer<LPC17_Can_Message> rxRing;
+    RingBuffer<LPC17_Can_Message> txRing;
+
+    uint32_t can_txPriority;
 
     size_t can_rxBufferSize;
     size_t can_txBufferSize;
@@ -2033,6 +2052,8 @@ static const LPC17_Gpio_Pin canRxPins[] = LPC17_CAN_RX_PINS;
 
 static CanState canStates[TOTAL_CAN_CONTROLLERS];
 
+static bool canFilterInHardware;
+
 static TinyCLR_Can_Controller canControllers[TOTAL_CAN_CONTROLLERS];
 static TinyCLR_Api_Info canApi[TOTAL_CAN_CONTROLLERS];
 
@@ -2157,6 +2178,181 @@ void CAN_SetACCF(uint32_t ACCFMode) {
     return;
 }
 
+static bool CAN_WriteACCF(uint32_t& address, uint32_t value, bool write) {
+    if (address >= CAN_MEM_SIZE)
+        return false;
+
+    if (write)
+        *((volatile uint32_t *)(CAN_MEM_BASE + address)) = value;
+
+    address += 4;
+
+    return true;
+}
+
+static bool CAN_HasFilters(int32_t controllerIndex) {
+    auto state = &canStates[controllerIndex];
+
+    return state->canDataFilter.matchFiltersSize > 0 || state->canDataFilter.groupFiltersSize > 0;
+}
+
+/******************************************************************************
+** Function name:        CAN_BuildACCF_Lookup
+**
+** Descriptions:        Lays out the explicit and group filters of every acquired
+**                      controller in the acceptance filter RAM. Each section is
+**                      ordered by controller then identifier, a controller
+**                      without filters gets full range groups. An identifier
+**                      below 0x800 can arrive in either frame format so it is
+**                      placed in the standard and extended sections.
+**
+** parameters:            write, false only checks the table fits
+** Returned value:        true if the table fits in the acceptance filter RAM
+**
+******************************************************************************/
+static bool CAN_BuildACCF_Lookup(bool write) {
+    uint32_t address = 0;
+    uint32_t pending = 0;
+    bool hasPending = false;
+
+    // Set explicit standard Frame, two entries per word
+    if (write) SFF_sa = address;
+
+    for (auto c = 0; c < TOTAL_CAN_CONTROLLERS; c++) {
+        auto state = &canStates[c];
+
+        if (state->initializeCount == 0 || state->canDataFilter.matchFiltersSize == 0)
+            continue;
+
+        for (auto i = 0; i < state->canDataFilter.matchFiltersSize && state->canDataFilter.matchFilters[i] <= ACCF_STD_ID_MASK; i++) {
+            auto entry = (c << 13) | state->canDataFilter.matchFilters[i];
+
+            if (!hasPending) {
+                pending = entry;
+                hasPending = true;
+            }
+            else {
+                if (!CAN_WriteACCF(address, (pending << 16) | entry, write))
+                    return false;
+
+                hasPending = false;
+            }
+        }
+    }
+
+    if (hasPending && !CAN_WriteACCF(address, (pending << 16) | (pending & ~ACCF_STD_ID_MASK) | ACCF_STD_DISABLE | ACCF_STD_ID_MASK, write))
+        return false;
+
+    // Set group standard Frame, lower and upper bound in one word
+    if (write) SFF_GRP_sa = address;
+
+    for (auto c = 0; c < TOTAL_CAN_CONTROLLERS; c++) {
+        auto state = &canStates[c];
+
+        if (state->initializeCount == 0)
+            continue;
+
+        if (!CAN_HasFilters(c)) {
+            if (!CAN_WriteACCF(address, (((c << 13) | 0) << 16) | (c << 13) | ACCF_STD_ID_MASK, write))
+                return false;
+
+            continue;
+        }
+
+        for (auto i = 0; i < state->canDataFilter.groupFiltersSize && state->canDataFilter.lowerBoundFilters[i] <= ACCF_STD_ID_MASK; i++) {
+            auto upper = state->canDataFilter.upperBoundFilters[i];
+
+            if (upper > ACCF_STD_ID_MASK)
+                upper = ACCF_STD_ID_MASK;
+
+            if (!CAN_WriteACCF(address, (((c << 13) | state->canDataFilter.lowerBoundFilters[i]) << 16) | (c << 13) | upper, write))
+                return false;
+        }
+    }
+
+    // Set explicit extended Frame
+    if (write) EFF_sa = address;
+
+    for (auto c = 0; c < TOTAL_CAN_CONTROLLERS; c++) {
+        auto state = &canStates[c];
+
+        if (state->initializeCount == 0)
+            continue;
+
+        for (auto i = 0; i < state->canDataFilter.matchFiltersSize && state->canDataFilter.matchFilters[i] <= ACCF_EXT_ID_MASK; i++) {
+            if (!CAN_WriteACCF(address, (c << 29) | state->canDataFilter.matchFilters[i], write))
+                return false;
+        }
+    }
+
+    // Set group extended Frame, lower and upper bound in consecutive words
+    if (write) EFF_GRP_sa = address;
+
+    for (auto c = 0; c < TOTAL_CAN_CONTROLLERS; c++) {
+        auto state = &canStates[c];
+
+        if (state->initializeCount == 0)
+            continue;
+
+        if (!CAN_HasFilters(c)) {
+            if (!CAN_WriteACCF(address, (c << 29) | 0, write) || !CAN_WriteACCF(address, (c << 29) | ACCF_EXT_ID_MASK, write))
+                return false;
+
+            continue;
+        }
+
+        for (auto i = 0; i < state->canDataFilter.groupFiltersSize && state->canDataFilter.lowerBoundFilters[i] <= ACCF_EXT_ID_MASK; i++) {
+            auto upper = state->canDataFilter.upperBoundFilters[i];
+
+            if (upper > ACCF_EXT_ID_MASK)
+                upper = ACCF_EXT_ID_MASK;
+
+            if (!CAN_WriteACCF(address, (c << 29) | state->canDataFilter.lowerBoundFilters[i], write) || !CAN_WriteACCF(address, (c << 29) | upper, write))
+                return false;
+        }
+    }
+
+    // Set End of Table
+    if (write) ENDofTable = address;
+
+    return true;
+}
+
+/******************************************************************************
+** Function name:        CAN_ProgramACCF
+**
+** Descriptions:        Moves the filters into the acceptance filter so rejected
+**                      frames never raise an interrupt. Falls back to bypass
+**                      and the software search when the table does not fit.
+**
+** parameters:            None
+** Returned value:        None
+**
+******************************************************************************/
+void CAN_ProgramACCF() {
+    DISABLE_INTERRUPTS_SCOPED(irq);
+
+    auto hasFilters = false;
+
+    for (auto c = 0; c < TOTAL_CAN_CONTROLLERS; c++) {
+        if (canStates[c].initializeCount > 0 && CAN_HasFilters(c))
+            hasFilters = true;
+    }
+
+    if (hasFilters && CAN_BuildACCF_Lookup(false)) {
+        AFMR = ACCF_OFF; // the table can only change while the filter is off
+        CAN_BuildACCF_Lookup(true);
+        AFMR = ACCF_ON;
+
+        canFilterInHardware = true;
+    }
+    else {
+        AFMR = ACCF_BYPASS;
+
+        canFilterInHardware = false;
+    }
+}
+
 bool InsertionSort2CheckOverlap(uint32_t *lowerBounds, uint32_t *upperBounds, int32_t length) {
 
     uint32_t i, j, tmp, tmp2;
@@ -2281,8 +2477,8 @@ void LPC17_Can_AddApi(const TinyCLR_Api_Manager* apiManager) {
 void CAN_ISR_Rx(int32_t controllerIndex) {
     auto state = &canStates[controllerIndex];
 
-    // filter
-    if (state->canDataFilter.groupFiltersSize || state->canDataFilter.matchFiltersSize) {
+    // filter, only needed when the acceptance filter could not hold every filter
+    if (!canFilterInHardware && (state->canDataFilter.groupFiltersSize || state->canDataFilter.matchFiltersSize)) {
         uint32_t ID = controllerIndex == 0 ? C1RID : C2RID;
 
         char passed = 0;
@@ -2306,7 +2502,12 @@ void CAN_ISR_Rx(int32_t controllerIndex) {
         }
     }
 
-    if (state->can_rx_count > (state->can_rxBufferSize - 3)) {
+    size_t available;
+
+    // initialize destination pointer
+    LPC17_Can_Message *can_msg = state->rxRing.GetWriteSpan(available);
+
+    if (can_msg == nullptr || state->rxRing.GetCount() > state->can_rxBufferSize - 3) {
         if (controllerIndex == 0)
             C1CMR = 0x04; // release receive buffer
         else
@@ -2317,9 +2518,6 @@ void CAN_ISR_Rx(int32_t controllerIndex) {
         return;
     }
 
-    // initialize destination pointer
-    LPC17_Can_Message *can_msg = &state->canRxMessagesFifo[state->can_rx_in];
-
     // timestamp
     uint64_t t = LPC17_Time_GetCurrentProcessorTime();
 
@@ -2358,62 +2556,95 @@ void CAN_ISR_Rx(int32_t controllerIndex) {
 
     can_msg->dataB = dataB; // Data B
 
-    state->can_rx_count++;
-    state->can_rx_in++;
+    state->rxRing.Commit(1);
 
-    if (state->can_rx_in == state->can_rxBufferSize) {
-        state->can_rx_in = 0;
-    }
-
-    state->messageReceivedEventHandler(state->provider, state->can_rx_count, LPC17_Time_GetCurrentProcessorTime());
+    state->messageReceivedEventHandler(state->provider, state->rxRing.GetCount(), LPC17_Time_GetCurrentProcessorTime());
 }
-void LPC17_Can_RxInterruptHandler(void *param) {
-    uint32_t status = CANRxSR;
 
-    int32_t controllerIndex;
+/******************************************************************************
+** Function name:        CAN_LoadTxBuffers
+**
+** Descriptions:        Moves queued messages into every free transmit buffer.
+**                      Buffers are sent by the PRIO field (TPM mode), which is
+**                      counted up per message so the queue order is kept on
+**                      the bus. Caller holds interrupts disabled.
+**
+** parameters:            Controller index
+** Returned value:        None
+**
+******************************************************************************/
+void CAN_LoadTxBuffers(int32_t controllerIndex) {
+    auto state = &canStates[controllerIndex];
 
-    DISABLE_INTERRUPTS_SCOPED(irq);
+    volatile unsigned long* txBuffer = controllerIndex == 0 ? &C1TFI1 : &C2TFI1;
+    volatile unsigned long& command = controllerIndex == 0 ? C1CMR : C2CMR;
 
-    if (status & (1 << 8)) {
-        controllerIndex = 0;
+    uint32_t status = controllerIndex == 0 ? C1SR : C2SR;
 
-        auto state = &canStates[controllerIndex];
+    if ((status & CAN_SR_TBS_ALL) == CAN_SR_TBS_ALL)
+        state->can_txPriority = 0;
 
-        uint32_t c1 = CAN1ICR;
+    for (auto buffer = 0; buffer < 3 && !state->txRing.IsEmpty() && state->can_txPriority <= 0xFF; buffer++) {
+        if ((status & (1 << (2 + 8 * buffer))) == 0)
+            continue;
 
-        CAN_ISR_Rx(controllerIndex);
+        auto& m = *state->txRing.Peek();
+        auto regs = txBuffer + (buffer * 4); // TFI, TID, TDA, TDB, 0x10 apart per buffer
 
-        if (c1 & (1 << 3)) {
-            state->errorEventHandler(state->provider, TinyCLR_Can_Error::Overrun, LPC17_Time_GetCurrentProcessorTime());
-        }
-        if (c1 & (1 << 5)) {
-            state->errorEventHandler(state->provider, TinyCLR_Can_Error::Passive, LPC17_Time_GetCurrentProcessorTime());
-        }
-        if (c1 & (1 << 7)) {
-            C1MOD = 1;    // Reset CAN
-            state->errorEventHandler(state->provider, TinyCLR_Can_Error::BusOff, LPC17_Time_GetCurrentProcessorTime());
-        }
+        regs[0] = (m.extendedId ? 0x80000000 : 0) | (m.remoteTransmissionRequest ? 0x40000000 : 0) | ((m.length & 0x0F) << 16) | state->can_txPriority;
+        regs[1] = m.msgId;
+        regs[2] = m.dataA;
+        regs[3] = m.dataB;
 
+        command = 0x01 | (1 << (5 + buffer)); // transmission request, select buffer
+
+        state->can_txPriority++;
+
+        state->txRing.Consume(1);
     }
-    if (status & (1 << 9)) {
-        controllerIndex = 1;
+}
 
-        auto state = &canStates[controllerIndex];
+void CAN_ISR_Tx(int32_t controllerIndex) {
+    auto state = &canStates[controllerIndex];
 
-        uint32_t c2 = CAN2ICR;
+    if (state->canTxMessagesFifo != nullptr)
+        CAN_LoadTxBuffers(controllerIndex);
+}
 
-        CAN_ISR_Rx(controllerIndex);
+void CAN_ISR(int32_t controllerIndex) {
+    auto state = &canStates[controllerIndex];
 
-        if (c2 & (1 << 3)) {
-            state->errorEventHandler(state->provider, TinyCLR_Can_Error::Overrun, LPC17_Time_GetCurrentProcessorTime());
-        }
-        if (c2 & (1 << 5)) {
-            state->errorEventHandler(state->provider, TinyCLR_Can_Error::Passive, LPC17_Time_GetCurrentProcessorTime());
-        }
-        if (c2 & (1 << 7)) {
+    uint32_t icr = controllerIndex == 0 ? CAN1ICR : CAN2ICR; // reading clears everything but RI
+
+    if (icr & 0x01) {
+        CAN_ISR_Rx(controllerIndex);
+    }
+    if (icr & (1 << 3)) {
+        state->errorEventHandler(state->provider, TinyCLR_Can_Error::Overrun, LPC17_Time_GetCurrentProcessorTime());
+    }
+    if (icr & (1 << 5)) {
+        state->errorEventHandler(state->provider, TinyCLR_Can_Error::Passive, LPC17_Time_GetCurrentProcessorTime());
+    }
+    if (icr & (1 << 7)) {
+        if (controllerIndex == 0)
+            C1MOD = 1;    // Reset CAN
+        else
             C2MOD = 1;    // Reset CAN
-            state->errorEventHandler(state->provider, TinyCLR_Can_Error::BusOff, LPC17_Time_GetCurrentProcessorTime());
-        }
+
+        state->errorEventHandler(state->provider, TinyCLR_Can_Error::BusOff, LPC17_Time_GetCurrentProcessorTime());
+    }
+    if (icr & CAN_IER_TX) {
+        CAN_ISR_Tx(controllerIndex);
+    }
+}
+
+void LPC17_Can_InterruptHandler(void *param) {
+    DISABLE_INTERRUPTS_SCOPED(irq);
+
+    // both controllers share one vector, only service those that were configured
+    for (auto controllerIndex = 0; controllerIndex < TOTAL_CAN_CONTROLLERS; controllerIndex++) {
+        if (canStates[controllerIndex].canRxMessagesFifo != nullptr)
+            CAN_ISR(controllerIndex);
     }
 }
 
@@ -2436,11 +2667,11 @@ TinyCLR_Result LPC17_Can_Acquire(const TinyCLR_Can_Controller* self) {
         LPC17_Gpio_ConfigurePin(canTxPins[controllerIndex].number, LPC17_Gpio_Direction::Input, canTxPins[controllerIndex].pinFunction, LPC17_Gpio_ResistorMode::Inactive, LPC17_Gpio_Hysteresis::Disable, LPC17_Gpio_InputPolarity::NotInverted, LPC17_Gpio_SlewRate::StandardMode, LPC17_Gpio_OutputType::PushPull);
         LPC17_Gpio_ConfigurePin(canRxPins[controllerIndex].number, LPC17_Gpio_Direction::Input, canRxPins[controllerIndex].pinFunction, LPC17_Gpio_ResistorMode::Inactive, LPC17_Gpio_Hysteresis::Disable, LPC17_Gpio_InputPolarity::NotInverted, LPC17_Gpio_SlewRate::StandardMode, LPC17_Gpio_OutputType::PushPull);
 
-        state->can_rx_count = 0;
-        state->can_rx_in = 0;
-        state->can_rx_out = 0;
+        state->rxRing.Uninitialize();
+        state->txRing.Uninitialize();
         state->baudrate = 0;
         state->can_rxBufferSize = canDefaultBuffersSize[controllerIndex];
+        state->can_txBufferSize = LPC17_CAN_TX_BUFFER_DEFAULT_SIZE;
         state->provider = self;
         state->enable = false;
 
@@ -2448,18 +2679,20 @@ TinyCLR_Result LPC17_Can_Acquire(const TinyCLR_Can_Controller* self) {
         state->canDataFilter.groupFiltersSize = 0;
 
         state->canRxMessagesFifo = nullptr;
+        state->canTxMessagesFifo = nullptr;
 
         if (controllerIndex == 0)
             LPC_SC->PCONP |= (1 << 13);    // Enable clock to the peripheral
 
         if (controllerIndex == 1)
             LPC_SC->PCONP |= (1 << 14);    // Enable clock to the peripheral
-
-        CAN_SetACCF(ACCF_BYPASS);
     }
 
     state->initializeCount++;
 
+    if (state->initializeCount == 1)
+        CAN_ProgramACCF(); // open the acceptance filter for this controller
+
     return TinyCLR_Result::Success;
 }
 
@@ -2479,15 +2712,31 @@ TinyCLR_Result LPC17_Can_Release(const TinyCLR_Can_Controller* self) {
 
         auto controllerIndex = state->controllerIndex;
 
+        if (controllerIndex == 0)
+            C1IER = 0;
+        else
+            C2IER = 0;
+
+        state->rxRing.Uninitialize();
+        state->txRing.Uninitialize();
+
         if (state->canRxMessagesFifo != nullptr) {
             memoryProvider->Free(memoryProvider, state->canRxMessagesFifo);
 
             state->canRxMessagesFifo = nullptr;
         }
 
+        if (state->canTxMessagesFifo != nullptr) {
+            memoryProvider->Free(memoryProvider, state->canTxMessagesFifo);
+
+            state->canTxMessagesFifo = nullptr;
+        }
+
         CAN_DisableExplicitFilters(controllerIndex);
         CAN_DisableGroupFilters(controllerIndex);
 
+        CAN_ProgramACCF();
+
         LPC17_Gpio_ClosePin(canTxPins[controllerIndex].number);
         LPC17_Gpio_ClosePin(canRxPins[controllerIndex].number);
     }
@@ -2499,9 +2748,13 @@ TinyCLR_Result LPC17_Can_SoftReset(const TinyCLR_Can_Controller* self) {
     auto state = reinterpret_cast<CanState*>(self->ApiInfo->State);
     auto controllerIndex = state->controllerIndex;
 
-    state->can_rx_count = 0;
-    state->can_rx_in = 0;
-    state->can_rx_out = 0;
+    state->rxRing.Discard();
+
+    {
+        DISABLE_INTERRUPTS_SCOPED(irq);
+
+        state->txRing.Discard();
+    }
 
     // Reset CAN
     if (controllerIndex == 0) {
@@ -2509,130 +2762,98 @@ TinyCLR_Result LPC17_Can_SoftReset(const TinyCLR_Can_Controller* self) {
         C1IER = 0;    // Disable Receive Interrupt
         C1GSR = 0;    // Reset error counter when CANxMOD is in reset
         C1BTR = state->baudrate;
-        C1MOD = 0x4;    // CAN in normal operation mode
-        C1IER = 0x01 | (1 << 7) | (1 << 3) | (1 << 5);    // Enable receive interrupts
+        C1MOD = 0x4 | CAN_MOD_TPM;    // CAN in normal operation mode, transmit priority by PRIO field
+        C1IER = CAN_IER_RX_ERRORS | CAN_IER_TX;    // Enable receive, error and transmit interrupts
     }
     else {
         C2MOD = 1;    // Reset CAN
         C2IER = 0;    // Disable Receive Interrupt
         C2GSR = 0;    // Reset error counter when CANxMOD is in reset
         C2BTR = state->baudrate;
-        C2MOD = 0x0;    // CAN in normal operation mode
-        C2IER = 0x01 | (1 << 7) | (1 << 3) | (1 << 5);    // Enable receive interrupts
+        C2MOD = CAN_MOD_TPM;    // CAN in normal operation mode, transmit priority by PRIO field
+        C2IER = CAN_IER_RX_ERRORS | CAN_IER_TX;    // Enable receive, error and transmit interrupts
     }
 
     return TinyCLR_Result::Success;
 }
 
 TinyCLR_Result LPC17_Can_WriteMessage(const TinyCLR_Can_Controller* self, const TinyCLR_Can_Message* messages, size_t& len) {
-    if (len != 1) return TinyCLR_Result::NotSupported;
-
-    auto& m = messages[0];
-    uint32_t arbitrationId = m.ArbitrationId;
-    bool isExtendedId = m.IsExtendedId;
-    bool isRemoteTransmissionRequest = m.IsRemoteTransmissionRequest;
-    const uint8_t* data = m.Data;
-    size_t length = m.Length;
-
-    uint32_t *data32 = (uint32_t*)data;
-
-    uint32_t flags = 0;
-    uint32_t status;
-
     auto state = reinterpret_cast<CanState*>(self->ApiInfo->State);
-    auto controllerIndex = state->controllerIndex;
 
-    if (isExtendedId)
-        flags |= 0x80000000;
+    if (state->canTxMessagesFifo == nullptr) {
+        len = 0;
 
-    if (isRemoteTransmissionRequest)
-        flags |= 0x40000000;
-
-    flags |= (length & 0x0F) << 16;
-
-    uint32_t timeout = CAN_TRANSFER_TIMEOUT;
-
-    while (LPC17_Can_CanWriteMessage(self) == false && timeout-- > 0) {
-        LPC17_Time_Delay(nullptr, 1);
+        return TinyCLR_Result::InvalidOperation;
     }
 
-    if (timeout == 0)
-        return TinyCLR_Result::Busy;
+    size_t count = 0;
+    size_t available;
+    LPC17_Can_Message* txMessages;
 
-    if (controllerIndex == 0) {
-        status = C1SR;
+    // the queue is only filled from here, the transmit buffers can keep draining it while messages are converted
+    while (count < len && (txMessages = state->txRing.GetWriteSpan(available)) != nullptr) {
+        auto converted = std::min(available, len - count);
 
-        if (status & 0x00000004) {
-            C1TFI1 = flags & 0xC00F0000;
-            C1TID1 = arbitrationId;
-            C1TDA1 = data32[0];
-            C1TDB1 = data32[1];
+        for (size_t n = 0; n < converted; n++) {
+            auto& m = messages[count++];
+            auto& can_msg = txMessages[n];
 
-            C1CMR = 0x21;
+            uint32_t *data32 = (uint32_t*)m.Data;
 
-            return TinyCLR_Result::Success;
+            can_msg.msgId = m.ArbitrationId;
+            can_msg.extendedId = m.IsExtendedId;
+            can_msg.remoteTransmissionRequest = m.IsRemoteTransmissionRequest;
+            can_msg.length = m.Length;
+            can_msg.dataA = data32[0];
+            can_msg.dataB = data32[1];
         }
-    }
-    else {
-        status = C2SR;
 
-        if (status & 0x00000004) {
-            C2TFI1 = flags & 0xC00F0000;
-            C2TID1 = arbitrationId;
-            C2TDA1 = data32[0];
-            C2TDB1 = data32[1];
+        state->txRing.Commit(converted);
+    }
 
-            C2CMR = 0x21;
+    {
+        DISABLE_INTERRUPTS_SCOPED(irq);
 
-            return TinyCLR_Result::Success;
-        }
+        CAN_LoadTxBuffers(state->controllerIndex);
     }
 
-    return TinyCLR_Result::Busy;
-}
+    auto result = (count == 0 && len > 0) ? TinyCLR_Result::Busy : TinyCLR_Result::Success;
 
-TinyCLR_Result LPC17_Can_ReadMessage(const TinyCLR_Can_Controller* self, TinyCLR_Can_Message* messages, size_t& len) {
-    if (len != 1) return TinyCLR_Result::NotSupported;
+    len = count;
 
-    auto& m = messages[0];
-    uint32_t& arbitrationId = m.ArbitrationId;
-    bool& isExtendedId = m.IsExtendedId;
-    bool& isRemoteTransmissionRequest = m.IsRemoteTransmissionRequest;
-    uint8_t* data = m.Data;
-    size_t& length = m.Length;
-    uint64_t& timestamp = m.Timestamp;
+    return result;
+}
 
+TinyCLR_Result LPC17_Can_ReadMessage(const TinyCLR_Can_Controller* self, TinyCLR_Can_Message* messages, size_t& len) {
     LPC17_Can_Message *can_msg;
 
-    uint32_t *data32 = (uint32_t*)data;
-
     auto state = reinterpret_cast<CanState*>(self->ApiInfo->State);
 
-    if (state->can_rx_count) {
-        DISABLE_INTERRUPTS_SCOPED(irq);
-
-        can_msg = &state->canRxMessagesFifo[state->can_rx_out];
-        state->can_rx_out++;
+    size_t count = 0;
 
-        if (state->can_rx_out == state->can_rxBufferSize)
-            state->can_rx_out = 0;
+    // the interrupt handler only moves the head, messages are copied out without holding it off
+    while (count < len && (can_msg = state->rxRing.Peek()) != nullptr) {
+        auto& m = messages[count++];
 
-        state->can_rx_count--;
+        uint32_t *data32 = (uint32_t*)m.Data;
 
-        arbitrationId = can_msg->msgId;
-        isExtendedId = can_msg->extendedId;
-        isRemoteTransmissionRequest = can_msg->remoteTransmissionRequest;
+        m.ArbitrationId = can_msg->msgId;
+        m.IsExtendedId = can_msg->extendedId;
+        m.IsRemoteTransmissionRequest = can_msg->remoteTransmissionRequest;
 
         data32[0] = can_msg->dataA;
         data32[1] = can_msg->dataB;
 
-        length = can_msg->length;
+        m.Length = can_msg->length;
 
-        timestamp = ((uint64_t)can_msg->timeStampL) | ((uint64_t)can_msg->timeStampH << 32);
+        m.Timestamp = ((uint64_t)can_msg->timeStampL) | ((uint64_t)can_msg->timeStampH << 32);
+
+        state->rxRing.Consume(1);
     }
 
-    return TinyCLR_Result::Success;
+    len = count;
 
+    return TinyCLR_Result::Success;
 }
 
 TinyCLR_Result LPC17_Can_SetBitTiming(const TinyCLR_Can_Controller* self, const TinyCLR_Can_BitTiming* timing) {
@@ -2650,13 +2871,30 @@ TinyCLR_Result LPC17_Can_SetBitTiming(const TinyCLR_Can_Controller* self, const
     auto state = reinterpret_cast<CanState*>(self->ApiInfo->State);
     auto controllerIndex = state->controllerIndex;
 
-    if (state->canRxMessagesFifo == nullptr)
-        state->canRxMessagesFifo = (LPC17_Can_Message*)memoryProvider->Allocate(memoryProvider, state->can_rxBufferSize * sizeof(LPC17_Can_Message));
-
     if (state->canRxMessagesFifo == nullptr) {
-        return TinyCLR_Result::OutOfMemory;
+        auto capacity = RingBuffer<LPC17_Can_Message>::GetCapacityFor(state->can_rxBufferSize);
+
+        state->canRxMessagesFifo = (LPC17_Can_Message*)memoryProvider->Allocate(memoryProvider, capacity * sizeof(LPC17_Can_Message));
+
+        if (state->canRxMessagesFifo == nullptr) {
+            return TinyCLR_Result::OutOfMemory;
+        }
+
+        state->rxRing.Initialize(state->canRxMessagesFifo, capacity);
     }
 
+    if (state->canTxMessagesFifo == nullptr) {
+        auto capacity = RingBuffer<LPC17_Can_Message>::GetCapacityFor(state->can_txBufferSize);
+
+        state->canTxMessagesFifo = (LPC17_Can_Message*)memoryProvider->Allocate(memoryProvider, capacity * sizeof(LPC17_Can_Message));
+
+        if (state->canTxMessagesFifo == nullptr) {
+            return TinyCLR_Result::OutOfMemory;
+        }
+    }
+
+    state->txRing.Initialize(state->canTxMessagesFifo, state->txRing.GetCapacityFor(state->can_txBufferSize));
+
     state->baudrate = ((phase2 - 1) << 20) | ((phase1 - 1) << 16) | ((baudratePrescaler - 1) << 0);
 
     if (controllerIndex == 0) {
@@ -2666,8 +2904,8 @@ TinyCLR_Result LPC17_Can_SetBitTiming(const TinyCLR_Can_Controller* self, const
         C1IER = 0;    // Disable Receive Interrupt
         C1GSR = 0;    // Reset error counter when CANxMOD is in reset
         C1BTR = state->baudrate;
-        C1MOD = 0x4;    // CAN in normal operation mode
-        C1IER = 0x01 | (1 << 7) | (1 << 3) | (1 << 5);    // Enable receive interrupts
+        C1MOD = 0x4 | CAN_MOD_TPM;    // CAN in normal operation mode, transmit priority by PRIO field
+        C1IER = CAN_IER_RX_ERRORS | CAN_IER_TX;    // Enable receive, error and transmit interrupts
     }
     else {
         SYSCON.PCLKSEL0 |= (1 << 28) | (1 << 30);//CAN1 CAN2 filter
@@ -2676,11 +2914,11 @@ TinyCLR_Result LPC17_Can_SetBitTiming(const TinyCLR_Can_Controller* self, const
         C2IER = 0;    // Disable Receive Interrupt
         C2GSR = 0;    // Reset error counter when CANxMOD is in reset
         C2BTR = state->baudrate;
-        C2MOD = 0x0;    // CAN in normal operation mode
-        C2IER = 0x01 | (1 << 3) | (1 << 5) | (1 << 7);        // Enable receive interrupts
+        C2MOD = CAN_MOD_TPM;    // CAN in normal operation mode, transmit priority by PRIO field
+        C2IER = CAN_IER_RX_ERRORS | CAN_IER_TX;    // Enable receive, error and transmit interrupts
     }
 
-    LPC17_InterruptInternal_Activate(CAN_IRQn, (uint32_t*)&LPC17_Can_RxInterruptHandler, 0);
+    LPC17_InterruptInternal_Activate(CAN_IRQn, (uint32_t*)&LPC17_Can_InterruptHandler, 0);
 
     return TinyCLR_Result::Success;
 }
@@ -2689,7 +2927,7 @@ size_t LPC17_Can_GetMessagesToRead(const TinyCLR_Can_Controller* self) {
 
     auto state = reinterpret_cast<CanState*>(self->ApiInfo->State);
 
-    return state->can_rx_count;
+    return state->rxRing.GetCount();
 }
 
 TinyCLR_Result LPC17_Can_SetMessageReceivedHandler(const TinyCLR_Can_Controller* self, TinyCLR_Can_MessageReceivedHandler handler) {
@@ -2732,6 +2970,8 @@ TinyCLR_Result LPC17_Can_SetExplicitFilters(const TinyCLR_Can_Controller* self,
 
         state->canDataFilter.matchFiltersSize = count;
         state->canDataFilter.matchFilters = _matchFilters;
+
+        CAN_ProgramACCF();
     }
 
     return TinyCLR_Result::Success;
@@ -2775,6 +3015,8 @@ TinyCLR_Result LPC17_Can_SetGroupFilters(const TinyCLR_Can_Controller* self, con
         state->canDataFilter.groupFiltersSize = count;
         state->canDataFilter.lowerBoundFilters = _lowerBoundFilters;
         state->canDataFilter.upperBoundFilters = _upperBoundFilters;
+
+        CAN_ProgramACCF();
     }
 
     return TinyCLR_Result::Success;
@@ -2783,9 +3025,7 @@ TinyCLR_Result LPC17_Can_SetGroupFilters(const TinyCLR_Can_Controller* self, con
 TinyCLR_Result LPC17_Can_ClearReadBuffer(const TinyCLR_Can_Controller* self) {
     auto state = reinterpret_cast<CanState*>(self->ApiInfo->State);
 
-    state->can_rx_count = 0;
-    state->can_rx_in = 0;
-    state->can_rx_out = 0;
+    state->rxRing.Discard();
 
     return TinyCLR_Result::Success;
 }
@@ -2830,20 +3070,51 @@ TinyCLR_Result LPC17_Can_SetReadBufferSize(const TinyCLR_Can_Controller* self, s
 }
 
 size_t LPC17_Can_GetWriteBufferSize(const TinyCLR_Can_Controller* self) {
-    return 1;
+    auto state = reinterpret_cast<CanState*>(self->ApiInfo->State);
+
+    return state->can_txBufferSize == 0 ? LPC17_CAN_TX_BUFFER_DEFAULT_SIZE : state->can_txBufferSize;
 }
 
 TinyCLR_Result LPC17_Can_SetWriteBufferSize(const TinyCLR_Can_Controller* self, size_t size) {
     auto state = reinterpret_cast<CanState*>(self->ApiInfo->State);
 
-    state->can_txBufferSize = 1;
+    if (size == 0)
+        return TinyCLR_Result::ArgumentInvalid;
+
+    // SetBitTiming allocates the queue from this size, one already allocated is replaced and what it held is dropped.
+    // The old queue stays in use if the new one can't be allocated.
+    if (state->canTxMessagesFifo != nullptr) {
+        auto memoryProvider = (const TinyCLR_Memory_Manager*)apiManager->FindDefault(apiManager, TinyCLR_Api_Type::MemoryManager);
+        auto capacity = RingBuffer<LPC17_Can_Message>::GetCapacityFor(size);
+        auto fifo = (LPC17_Can_Message*)memoryProvider->Allocate(memoryProvider, capacity * sizeof(LPC17_Can_Message));
 
-    return size == 1 ? TinyCLR_Result::Success : TinyCLR_Result::NotSupported;
+        if (fifo == nullptr)
+            return TinyCLR_Result::OutOfMemory;
+
+        auto old = state->canTxMessagesFifo;
+
+        {
+            DISABLE_INTERRUPTS_SCOPED(irq);
+
+            state->txRing.Uninitialize();
+            state->txRing.Initialize(fifo, capacity);
+            state->canTxMessagesFifo = fifo;
+        }
+
+        memoryProvider->Free(memoryProvider, old);
+    }
+
+    state->can_txBufferSize = size;
+
+    return TinyCLR_Result::Success;
 }
 
 void LPC17_Can_Reset() {
     for (int i = 0; i < TOTAL_CAN_CONTROLLERS; i++) {
         canStates[i].canRxMessagesFifo = nullptr;
+        canStates[i].canTxMessagesFifo = nullptr;
+        canStates[i].rxRing.Uninitialize();
+        canStates[i].txRing.Uninitialize();
 
         LPC17_Can_Release(&canControllers[i]);
 
@@ -2873,9 +3144,11 @@ bool LPC17_Can_CanWriteMessage(const TinyCLR_Can_Controller* self) {
 
     uint32_t status = controllerIndex == 0 ? C1SR : C2SR;
 
-    if ((status & 0x00000004) &&
-        (status & 0x00000400) &&
-        (status & 0x00040000)) {
+    if ((status & CAN_SR_TBS_ALL) == CAN_SR_TBS_ALL) {
+        canWrite = true;
+    }
+
+    if (!state->txRing.IsFull()) {
         canWrite = true;
     }
     return (state->enable && canWrite);
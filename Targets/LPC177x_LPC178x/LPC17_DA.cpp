@@ -14,6 +14,7 @@
 // limitations under the License.
 
 #include "LPC17.h"
+#include "../../Drivers/DacStream/DacStream.h"
 
 #define DAC_BASE 0x4008C000
 
@@ -28,6 +29,27 @@
 #define LPC17_DAC_PRECISION_BITS 	10	// Number of Bits in the DAC Convertion
 #define LPC17_DAC_MAX_VALUE 	(1<<LPC17_DAC_PRECISION_BITS)
 
+// Streaming output: the DAC counter requests each sample from a GPDMA channel that walks the two halves of the
+// buffer as linked list items.
+#ifndef LPC17_DAC_DMA_CHANNEL
+#define LPC17_DAC_DMA_CHANNEL 1
+#endif
+
+#define LPC17_DAC_DMA_REQUEST 9
+#define LPC17_DAC_PERIPHERAL_CLOCK_HZ (LPC17_SYSTEM_CLOCK_HZ / 2)
+#define LPC17_DAC_MAX_SAMPLE_RATE 1000000
+#define LPC17_DAC_MAX_TRANSFER_SIZE 0xFFF
+
+#define LPC17_DAC_CTRL_DBLBUF_ENA (1 << 1)
+#define LPC17_DAC_CTRL_CNT_ENA (1 << 2)
+#define LPC17_DAC_CTRL_DMA_ENA (1 << 3)
+
+// halfword source and destination, source increment, terminal count interrupt
+#define LPC17_DAC_DMA_CONTROL ((1 << 18) | (1 << 21) | (1 << 26) | (1UL << 31))
+
+// enabled, memory to peripheral, error and terminal count interrupts unmasked
+#define LPC17_DAC_DMA_CONFIGURATION (1 | (LPC17_DAC_DMA_REQUEST << 6) | (1 << 11) | (1 << 14) | (1 << 15))
+
 ///////////////////////////////////////////////////////////////////////////////
 #define TOTAL_DAC_CONTROLLERS 1
 
@@ -36,8 +58,31 @@ static TinyCLR_Api_Info dacApi[TOTAL_DAC_CONTROLLERS];
 
 static const LPC17_Gpio_Pin dacPins[] = LPC17_DAC_PINS;
 
+struct DacDmaItem {
+    uint32_t source;
+    uint32_t destination;
+    uint32_t next;
+    uint32_t control;
+};
+
+struct DacStream {
+    bool active;
+    bool circular;
+    uint16_t* buffer;
+    size_t length;
+    LPC17_Dac_StreamHandler handler;
+    void* param;
+    uint32_t ready;
+    uint32_t submitted;
+    uint32_t playing;
+
+    DacDmaItem items[2];
+};
+
 struct DacState {
     bool isOpened[SIZEOF_ARRAY(dacPins)];
+
+    DacStream streams[SIZEOF_ARRAY(dacPins)];
 };
 
 static DacState dacStates[TOTAL_DAC_CONTROLLERS];
@@ -72,6 +117,155 @@ void LPC17_Dac_AddApi(const TinyCLR_Api_Manager* apiManager) {
     apiManager->SetDefaultName(apiManager, TinyCLR_Api_Type::DacController, dacApi[0].Name);
 }
 
+// A half of the stream buffer has been played. In a circular stream every half has to be submitted again before the
+// output wraps back to it, when none is left the half that starts playing now is stale and reported as an underrun.
+static void LPC17_Dac_HalfPlayed(DacStream* stream, uint32_t half) {
+    auto count = stream->length / 2;
+    auto underrun = false;
+
+    if (stream->circular) {
+        if (stream->ready > 0)
+            stream->ready--;
+
+        underrun = stream->ready == 0;
+    }
+
+    if (stream->handler != nullptr)
+        stream->handler(stream->param, stream->buffer + half * count, count, underrun);
+}
+
+// Hands the oldest half given to the stream handler back for playing, after it has been filled with new samples.
+TinyCLR_Result LPC17_Dac_SubmitStream(const TinyCLR_Dac_Controller* self, uint32_t channel) {
+    if (channel >= SIZEOF_ARRAY(dacPins))
+        return TinyCLR_Result::ArgumentOutOfRange;
+
+    auto state = reinterpret_cast<DacState*>(self->ApiInfo->State);
+    auto stream = &state->streams[channel];
+
+    if (!stream->active || !stream->circular)
+        return TinyCLR_Result::InvalidOperation;
+
+    DISABLE_INTERRUPTS_SCOPED(irq);
+
+    stream->submitted ^= 1;
+
+    if (stream->ready < 2)
+        stream->ready++;
+
+    return TinyCLR_Result::Success;
+}
+
+static TinyCLR_Result LPC17_Dac_EndStream(DacStream* stream) {
+    if (!stream->active)
+        return TinyCLR_Result::Success;
+
+    LPC_DAC->CTRL = 0;
+
+    LPC17_DmaInternal_CloseChannel(LPC17_DAC_DMA_CHANNEL);
+
+    stream->active = false;
+
+    return TinyCLR_Result::Success;
+}
+
+static void LPC17_Dac_DmaHandler(void* param, bool error) {
+    auto stream = reinterpret_cast<DacStream*>(param);
+
+    if (!stream->active)
+        return;
+
+    if (error) {
+        auto handler = stream->handler;
+
+        LPC17_Dac_EndStream(stream);
+
+        if (handler != nullptr)
+            handler(stream->param, nullptr, 0, false);
+
+        return;
+    }
+
+    // every linked list item raises its own terminal count
+    auto half = stream->playing;
+
+    stream->playing ^= 1;
+
+    // a single pass ends here, the output holds the last sample
+    if (half == 1 && !stream->circular)
+        LPC17_Dac_EndStream(stream);
+
+    LPC17_Dac_HalfPlayed(stream, half);
+}
+
+// Plays buffer on an open channel at frequency samples per second, frequency is updated to the rate that is really
+// used. Samples are 16 bit left aligned, the bits below the converter resolution have to be zero: they are written
+// to the DAC register as a halfword and the lowest bit can end up in BIAS. The buffer is played in two halves and
+// handler, which can be null, is called from the DMA interrupt with each half once it has been played. A single
+// pass stops after the second half. A circular stream goes on with the other half and wraps, each half handed to
+// handler has to be filled and given back with SubmitStream before the output gets to it again or it is played
+// again and reported as an underrun. A transfer error stops the stream and is reported with a null half.
+TinyCLR_Result LPC17_Dac_StartStream(const TinyCLR_Dac_Controller* self, uint32_t channel, uint16_t* buffer, size_t length, double& frequency, bool circular, LPC17_Dac_StreamHandler handler, void* param) {
+    if (channel >= SIZEOF_ARRAY(dacPins))
+        return TinyCLR_Result::ArgumentOutOfRange;
+
+    if (buffer == nullptr)
+        return TinyCLR_Result::ArgumentNull;
+
+    auto state = reinterpret_cast<DacState*>(self->ApiInfo->State);
+    auto stream = &state->streams[channel];
+
+    if (!state->isOpened[channel] || stream->active)
+        return TinyCLR_Result::InvalidOperation;
+
+    // each half is one linked list item
+    if (length < 2 || length % 2 != 0 || length / 2 > LPC17_DAC_MAX_TRANSFER_SIZE || ((uint32_t)buffer & 0x01) != 0)
+        return TinyCLR_Result::ArgumentInvalid;
+
+    // the counter is 16 bits
+    if (frequency < (double)LPC17_DAC_PERIPHERAL_CLOCK_HZ / 0x10000 || frequency > LPC17_DAC_MAX_SAMPLE_RATE)
+        return TinyCLR_Result::ArgumentOutOfRange;
+
+    if (!LPC17_DmaInternal_OpenChannel(LPC17_DAC_DMA_CHANNEL))
+        return TinyCLR_Result::SharingViolation;
+
+    auto ticks = DacStream_GetTicks(LPC17_DAC_PERIPHERAL_CLOCK_HZ, frequency);
+
+    stream->active = true;
+    stream->circular = circular;
+    stream->buffer = buffer;
+    stream->length = length;
+    stream->handler = handler;
+    stream->param = param;
+    stream->ready = 2;
+    stream->submitted = 0;
+    stream->playing = 0;
+
+    DacStream_LinkHalves(stream->items, buffer, length, &LPC_DAC->CR, LPC17_DAC_DMA_CONTROL, circular);
+
+    auto dma = LPC17_DmaInternal_GetChannel(LPC17_DAC_DMA_CHANNEL);
+
+    LPC17_DmaInternal_SetHandler(LPC17_DAC_DMA_CHANNEL, &LPC17_Dac_DmaHandler, stream);
+
+    LPC_SC->DMAREQSEL &= ~(1 << LPC17_DAC_DMA_REQUEST);
+
+    DacStream_StartChannel(*dma, stream->items[0], LPC17_DAC_DMA_CONFIGURATION);
+
+    // the counter times each conversion and asks for the next sample
+    LPC_DAC->CNTVAL = ticks - 1;
+    LPC_DAC->CTRL = LPC17_DAC_CTRL_DBLBUF_ENA | LPC17_DAC_CTRL_CNT_ENA | LPC17_DAC_CTRL_DMA_ENA;
+
+    return TinyCLR_Result::Success;
+}
+
+TinyCLR_Result LPC17_Dac_StopStream(const TinyCLR_Dac_Controller* self, uint32_t channel) {
+    if (channel >= SIZEOF_ARRAY(dacPins))
+        return TinyCLR_Result::ArgumentOutOfRange;
+
+    auto state = reinterpret_cast<DacState*>(self->ApiInfo->State);
+
+    return LPC17_Dac_EndStream(&state->streams[channel]);
+}
+
 TinyCLR_Result LPC17_Dac_Acquire(const TinyCLR_Dac_Controller* self) {
     if (self == nullptr)
         return TinyCLR_Result::ArgumentNull;
@@ -110,6 +304,8 @@ TinyCLR_Result LPC17_Dac_CloseChannel(const TinyCLR_Dac_Controller* self, uint32
 
     auto state = reinterpret_cast<DacState*>(self->ApiInfo->State);
 
+    LPC17_Dac_EndStream(&state->streams[channel]);
+
     if (state->isOpened[channel]) {
         DACR = (0 << 6); // This sets the initial starting voltage at 0
 
@@ -0,0 +1,139 @@
+// Copyright GHI Electronics, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "LPC17.h"
+
+// The GPDMA channels share one interrupt, drivers own a channel each and get called for their channel only.
+
+#define LPC17_DMA_CHANNELS 8
+
+struct DmaChannelState {
+    bool isOpened;
+
+    LPC17_Dma_Handler handler;
+    void* param;
+};
+
+static DmaChannelState dmaChannelStates[LPC17_DMA_CHANNELS];
+static uint32_t dmaOpenedChannels;
+
+static LPC_GPDMACH_TypeDef* const dmaChannels[LPC17_DMA_CHANNELS] = {
+    LPC_GPDMACH0, LPC_GPDMACH1, LPC_GPDMACH2, LPC_GPDMACH3, LPC_GPDMACH4, LPC_GPDMACH5, LPC_GPDMACH6, LPC_GPDMACH7
+};
+
+void LPC17_Dma_InterruptHandler(void* param) {
+    INTERRUPT_STARTED_SCOPED(isr);
+
+    auto complete = LPC_GPDMA->IntTCStat;
+    auto error = LPC_GPDMA->IntErrStat;
+
+    LPC_GPDMA->IntTCClear = complete;
+    LPC_GPDMA->IntErrClr = error;
+
+    for (auto channel = 0; channel < LPC17_DMA_CHANNELS; channel++) {
+        auto mask = 1UL << channel;
+        auto& state = dmaChannelStates[channel];
+
+        if (((complete | error) & mask) && state.handler != nullptr)
+            state.handler(state.param, (error & mask) != 0);
+    }
+}
+
+bool LPC17_DmaInternal_OpenChannel(uint32_t channel) {
+    if (channel >= LPC17_DMA_CHANNELS)
+        return false;
+
+    DISABLE_INTERRUPTS_SCOPED(irq);
+
+    if (dmaChannelStates[channel].isOpened)
+        return false;
+
+    if (dmaOpenedChannels == 0) {
+        LPC_SC->PCONP |= (1 << 29);
+
+        LPC_GPDMA->IntTCClear = 0xFF;
+        LPC_GPDMA->IntErrClr = 0xFF;
+        LPC_GPDMA->Config = 0x01; // enabled, little endian
+
+        while (!(LPC_GPDMA->Config & 0x01));
+
+        LPC17_InterruptInternal_Activate(DMA_IRQn, (uint32_t*)&LPC17_Dma_InterruptHandler, 0);
+    }
+
+    dmaChannels[channel]->CConfig = 0;
+
+    LPC_GPDMA->IntTCClear = 1 << channel;
+    LPC_GPDMA->IntErrClr = 1 << channel;
+
+    dmaChannelStates[channel].isOpened = true;
+    dmaChannelStates[channel].handler = nullptr;
+    dmaChannelStates[channel].param = nullptr;
+
+    dmaOpenedChannels |= 1 << channel;
+
+    return true;
+}
+
+// Stops whatever the channel is doing and gives it up. The controller is powered down with the last channel.
+bool LPC17_DmaInternal_CloseChannel(uint32_t channel) {
+    if (channel >= LPC17_DMA_CHANNELS)
+        return false;
+
+    DISABLE_INTERRUPTS_SCOPED(irq);
+
+    if (!dmaChannelStates[channel].isOpened)
+        return false;
+
+    dmaChannels[channel]->CConfig = 0;
+
+    LPC_GPDMA->IntTCClear = 1 << channel;
+    LPC_GPDMA->IntErrClr = 1 << channel;
+
+    dmaChannelStates[channel].isOpened = false;
+    dmaChannelStates[channel].handler = nullptr;
+
+    dmaOpenedChannels &= ~(1 << channel);
+
+    if (dmaOpenedChannels == 0) {
+        LPC17_InterruptInternal_Deactivate(DMA_IRQn);
+
+        LPC_GPDMA->Config = 0;
+        LPC_SC->PCONP &= ~(1 << 29);
+    }
+
+    return true;
+}
+
+LPC_GPDMACH_TypeDef* LPC17_DmaInternal_GetChannel(uint32_t channel) {
+    return channel < LPC17_DMA_CHANNELS ? dmaChannels[channel] : nullptr;
+}
+
+// The handler is called from the interrupt when a transfer with ITC set in its control word is done or the channel
+// had an error, as far as the channel configuration unmasks them (ITC and IE).
+bool LPC17_DmaInternal_SetHandler(uint32_t channel, LPC17_Dma_Handler handler, void* param) {
+    if (channel >= LPC17_DMA_CHANNELS || !dmaChannelStates[channel].isOpened)
+        return false;
+
+    DISABLE_INTERRUPTS_SCOPED(irq);
+
+    dmaChannelStates[channel].handler = handler;
+    dmaChannelStates[channel].param = param;
+
+    return true;
+}
+
+void LPC17_Dma_Reset() {
+    for (auto channel = 0; channel < LPC17_DMA_CHANNELS; channel++)
+        LPC17_DmaInternal_CloseChannel(channel);
+}
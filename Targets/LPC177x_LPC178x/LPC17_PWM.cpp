@@ -14,6 +14,8 @@
 // limitations under the License.
 
 #include "LPC17.h"
+#include "../../Drivers/PwmDuty/PwmDuty.h"
+#include "../../Drivers/PwmSequence/PwmSequence.h"
 
 #define PWM0_BASE 0x40014000
 
@@ -64,6 +66,31 @@
 #define PWM_MICROSECONDS  1000000
 #define PWM_NANOSECONDS   1000000000
 
+#define PWM_TCR_COUNTER_ENABLE (1 << 0)
+#define PWM_TCR_COUNTER_RESET (1 << 1)
+#define PWM_TCR_PWM_ENABLE (1 << 3) // match registers are shadowed, LER latches them at the end of the period
+
+// The PWM blocks have no DMA request, a sequence is paced by the match 0 and match 1 requests of a timer that counts
+// the same period. On match 0 a GPDMA channel writes the next value to the shadow of the match register, on match 1
+// the channel after it sets LER, and the value is latched when the PWM period ends.
+#ifndef LPC17_PWM_SEQUENCER_TIMERS
+#define LPC17_PWM_SEQUENCER_TIMERS { 2, 3 }
+#endif
+
+#ifndef LPC17_PWM_SEQUENCER_DMA_CHANNELS
+#define LPC17_PWM_SEQUENCER_DMA_CHANNELS { 2, 4 }
+#endif
+
+#define LPC17_PWM_SEQUENCER_MAX_LENGTH 0xFFF
+
+// word source and destination
+#define LPC17_PWM_SEQUENCER_DMA_CONTROL ((2 << 18) | (2 << 21))
+#define LPC17_PWM_SEQUENCER_DMA_SOURCE_INCREMENT (1 << 26)
+#define LPC17_PWM_SEQUENCER_DMA_TERMINAL_COUNT (1UL << 31)
+
+// enabled, memory to peripheral, error and terminal count interrupts unmasked
+#define LPC17_PWM_SEQUENCER_DMA_CONFIGURATION (1 | (1 << 11) | (1 << 14) | (1 << 15))
+
 const char* PwmApiNames[] = {
 #if TOTAL_PWM_CONTROLLERS > 0
 "GHIElectronics.TinyCLR.NativeApis.LPC17.PwmController\\0",
@@ -75,6 +102,34 @@ const char* PwmApiNames[] = {
 
 static PwmState pwmStates[TOTAL_PWM_CONTROLLERS];
 
+struct PwmSequenceItem {
+    uint32_t source;
+    uint32_t destination;
+    uint32_t next;
+    uint32_t control;
+};
+
+struct PwmSequence {
+    bool active;
+    uint32_t repeat; // passes left including the current one, 0 while looping
+    uint32_t channel;
+    uint32_t latch;
+    LPC17_Pwm_SequenceHandler handler;
+    void* param;
+
+    PwmSequenceItem items[2]; // pattern and latch
+};
+
+static PwmSequence pwmSequences[TOTAL_PWM_CONTROLLERS];
+
+static const uint32_t pwmSequencerTimers[] = LPC17_PWM_SEQUENCER_TIMERS;
+static const uint32_t pwmSequencerDmaChannels[] = LPC17_PWM_SEQUENCER_DMA_CHANNELS;
+
+// match 0 request of each timer with DMAREQSEL set, match 1 is the next one
+static LPC_TIM_TypeDef* const pwmSequencerTimerRegisters[] = { LPC_TIM0, LPC_TIM1, LPC_TIM2, LPC_TIM3 };
+static const uint32_t pwmSequencerTimerRequests[] = { 0, 2, 4, 14 };
+static const uint32_t pwmSequencerTimerPower[] = { 1, 2, 22, 23 };
+
 static TinyCLR_Pwm_Controller pwmControllers[TOTAL_PWM_CONTROLLERS];
 static TinyCLR_Api_Info pwmApi[TOTAL_PWM_CONTROLLERS];
 
@@ -121,10 +176,10 @@ TinyCLR_Result LPC17_Pwm_OpenChannel(const TinyCLR_Pwm_Controller* self, uint32_
         LPC_SC->PCONP |= PCONP_PCPWM0;
 
         // Reset Timer Counter
-        PWM0TCR |= (1 << 1);
+        PWM0TCR = PWM_TCR_COUNTER_RESET;
         *state->matchAddress[channel] = 0;
         PWM0MCR = (1 << 1); // Reset on MAT0
-        PWM0TCR = 1; // Enable
+        PWM0TCR = PWM_TCR_COUNTER_ENABLE | PWM_TCR_PWM_ENABLE; // Enable
         PWM0PCR |= (1 << (9 + state->match[channel])); // To enable output on the proper channel
     }
     else if (state->channel[channel] == 1) {
@@ -133,10 +188,10 @@ TinyCLR_Result LPC17_Pwm_OpenChannel(const TinyCLR_Pwm_Controller* self, uint32_
         LPC_SC->PCONP |= PCONP_PCPWM1;
 
         // Reset Timer Counter
-        PWM1TCR |= (1 << 1);
+        PWM1TCR = PWM_TCR_COUNTER_RESET;
         *state->matchAddress[channel] = 0;
         PWM1MCR = (1 << 1); // Reset on MAT0
-        PWM1TCR = 1; // Enable
+        PWM1TCR = PWM_TCR_COUNTER_ENABLE | PWM_TCR_PWM_ENABLE; // Enable
         PWM1PCR |= (1 << (9 + (state->match[channel]))); // To enable output on the proper channel
     }
 
@@ -361,25 +416,27 @@ TinyCLR_Result LPC17_Pwm_SetPulseParameters(const TinyCLR_Pwm_Controller* self,
             if ((PWM0MR0 != periodTicks)) {
 
                 // Reset Timer Counter
-                PWM0TCR |= (1 << 1);
+                PWM0TCR = PWM_TCR_COUNTER_RESET;
                 PWM0MR0 = periodTicks;
                 PWM0MCR = (1 << 1); // Reset on MAT0
-                PWM0TCR = 1; // Enable
+                PWM0TCR = PWM_TCR_COUNTER_ENABLE | PWM_TCR_PWM_ENABLE; // Enable
             }
 
             *state->matchAddress[channel] = highTicks;
+            PWM0LER = (1 << 0) | (1 << (state->match[channel] + 1));
         }
         else if (state->channel[channel] == 1) {
             // Re-scale with new frequency!
             if ((PWM1MR0 != periodTicks)) {
                 // Reset Timer Counter
-                PWM1TCR |= (1 << 1);
+                PWM1TCR = PWM_TCR_COUNTER_RESET;
                 PWM1MR0 = periodTicks;
                 PWM1MCR = (1 << 1); // Reset on MAT0
-                PWM1TCR = 1; // Enable
+                PWM1TCR = PWM_TCR_COUNTER_ENABLE | PWM_TCR_PWM_ENABLE; // Enable
             }
 
             *state->matchAddress[channel] = highTicks;
+            PWM1LER = (1 << 0) | (1 << (state->match[channel] + 1));
         }
 
         if (state->outputEnabled[channel] == true) {
@@ -391,6 +448,72 @@ TinyCLR_Result LPC17_Pwm_SetPulseParameters(const TinyCLR_Pwm_Controller* self,
 
     state->invert[channel] = polarity;
     state->dutyCycle[channel] = dutyCycle;
+    state->isDutyCycleFixed[channel] = false;
+
+    return TinyCLR_Result::Success;
+}
+
+// Sets the duty cycles of several channels of the controller together. Duty cycles are Q16 fractions of the period,
+// LPC17_PWM_FULL_DUTY_CYCLE is always on, and the polarity stays as last set. The match registers are shadowed in PWM
+// mode, the new values are latched together through LER when the period ends. A channel that goes to or comes back
+// from always off or always on switches its pin right away, as SetPulseParameters does.
+TinyCLR_Result LPC17_Pwm_SetDutyCycles(const TinyCLR_Pwm_Controller* self, const uint32_t* channels, const uint32_t* dutyCycles, size_t count) {
+    if (channels == nullptr || dutyCycles == nullptr)
+        return TinyCLR_Result::ArgumentNull;
+
+    auto state = reinterpret_cast<PwmState*>(self->ApiInfo->State);
+
+    uint32_t periodTicks = state->controllerIndex == 0 ? PWM0MR0 : PWM1MR0;
+
+    // no frequency set yet
+    if (periodTicks == 0)
+        return TinyCLR_Result::InvalidOperation;
+
+    for (auto i = 0u; i < count; i++)
+        if (channels[i] >= MAX_PWM_PER_CONTROLLER || !state->isOpened[channels[i]])
+            return TinyCLR_Result::ArgumentOutOfRange;
+
+    uint32_t latch = 0;
+    uint32_t resume = 0;
+
+    for (auto i = 0u; i < count; i++) {
+        auto channel = channels[i];
+        auto dutyCycle = dutyCycles[i] > LPC17_PWM_FULL_DUTY_CYCLE ? LPC17_PWM_FULL_DUTY_CYCLE : dutyCycles[i];
+
+        state->isDutyCycleFixed[channel] = true;
+        state->fixedDutyCycle[channel] = dutyCycle;
+
+        if (dutyCycle == 0 || dutyCycle == LPC17_PWM_FULL_DUTY_CYCLE) {
+            LPC17_Gpio_EnableOutputPin(state->gpioPin[channel].number, dutyCycle != 0);
+            state->outputEnabled[channel] = true;
+
+            continue;
+        }
+
+        auto highTicks = PwmDuty_GetCompare(dutyCycle, periodTicks);
+
+        if (state->invert[channel] == TinyCLR_Pwm_PulsePolarity::ActiveLow)
+            highTicks = periodTicks - highTicks;
+
+        *state->matchAddress[channel] = highTicks;
+
+        latch |= 1 << (state->match[channel] + 1);
+
+        if (state->outputEnabled[channel] == true) {
+            resume |= 1 << channel;
+
+            state->outputEnabled[channel] = false;
+        }
+    }
+
+    if (state->controllerIndex == 0)
+        PWM0LER = latch;
+    else
+        PWM1LER = latch;
+
+    for (auto channel = 0; channel < MAX_PWM_PER_CONTROLLER; channel++)
+        if (resume & (1 << channel))
+            LPC17_Pwm_EnableChannel(self, channel);
 
     return TinyCLR_Result::Success;
 }
@@ -398,15 +521,238 @@ TinyCLR_Result LPC17_Pwm_SetPulseParameters(const TinyCLR_Pwm_Controller* self,
 TinyCLR_Result LPC17_Pwm_SetDesiredFrequency(const TinyCLR_Pwm_Controller* self, double& frequency) {
     auto state = reinterpret_cast<PwmState*>(self->ApiInfo->State);
 
+    // the pattern and the pacing timer are made for the current period
+    if (pwmSequences[state->controllerIndex].active)
+        return TinyCLR_Result::InvalidOperation;
+
     state->frequency = frequency;
 
     // Calculate actual frequency
     frequency = LPC17_Pwm_GetActualFrequency(self);
 
-    for (int p = 0; p < MAX_PWM_PER_CONTROLLER; p++)
+    for (int p = 0; p < MAX_PWM_PER_CONTROLLER; p++) {
+        if (state->isDutyCycleFixed[p])
+            state->dutyCycle[p] = (double)state->fixedDutyCycle[p] / LPC17_PWM_FULL_DUTY_CYCLE;
+
         if (state->gpioPin[p].number != PIN_NONE)
             if (LPC17_Pwm_SetPulseParameters(self, p, state->dutyCycle[p], state->invert[p]) != TinyCLR_Result::Success)
                 return TinyCLR_Result::InvalidOperation;
+    }
+
+    return TinyCLR_Result::Success;
+}
+
+// The match registers take 32 bit values, the pattern samples have the same size.
+size_t LPC17_Pwm_GetSequenceSampleSize(const TinyCLR_Pwm_Controller* self) {
+    return sizeof(uint32_t);
+}
+
+// Turns Q16 duty cycles into the pattern StartSequence plays, for the frequency and polarity that are set now.
+// dutyCycles holds length values frame after frame, a frame has one value for each of the channelCount channels
+// starting at firstChannel. pattern takes length samples of GetSequenceSampleSize bytes. Always off and always on
+// are encoded as match values that clear the output with the period start or never.
+TinyCLR_Result LPC17_Pwm_EncodeSequence(const TinyCLR_Pwm_Controller* self, uint32_t firstChannel, uint32_t channelCount, const uint32_t* dutyCycles, size_t length, void* pattern) {
+    if (dutyCycles == nullptr || pattern == nullptr)
+        return TinyCLR_Result::ArgumentNull;
+
+    auto state = reinterpret_cast<PwmState*>(self->ApiInfo->State);
+
+    uint32_t periodTicks = state->controllerIndex == 0 ? PWM0MR0 : PWM1MR0;
+
+    // no frequency set yet
+    if (periodTicks == 0)
+        return TinyCLR_Result::InvalidOperation;
+
+    if (channelCount == 0 || firstChannel + channelCount > MAX_PWM_PER_CONTROLLER)
+        return TinyCLR_Result::ArgumentOutOfRange;
+
+    if (length % channelCount != 0)
+        return TinyCLR_Result::ArgumentInvalid;
+
+    uint32_t activeLow = 0;
+
+    for (auto i = 0u; i < channelCount; i++)
+        if (state->invert[firstChannel + i] == TinyCLR_Pwm_PulsePolarity::ActiveLow)
+            activeLow |= 1 << i;
+
+    PwmSequence_EncodeMatch(dutyCycles, length, channelCount, activeLow, periodTicks, reinterpret_cast<uint32_t*>(pattern));
+
+    return TinyCLR_Result::Success;
+}
+
+// Item 0 runs on the controller's DMA channel from the match 0 request, item 1 on the next channel from match 1.
+static void LPC17_Pwm_StartSequenceDma(int32_t controllerIndex, uint32_t index) {
+    auto& item = pwmSequences[controllerIndex].items[index];
+    auto dma = LPC17_DmaInternal_GetChannel(pwmSequencerDmaChannels[controllerIndex] + index);
+    auto request = pwmSequencerTimerRequests[pwmSequencerTimers[controllerIndex]] + index;
+
+    dma->CSrcAddr = item.source;
+    dma->CDestAddr = item.destination;
+    dma->CLLI = item.next;
+    dma->CControl = item.control;
+    dma->CConfig = LPC17_PWM_SEQUENCER_DMA_CONFIGURATION | (request << 6);
+}
+
+static void LPC17_Pwm_EndSequence(int32_t controllerIndex) {
+    auto sequence = &pwmSequences[controllerIndex];
+
+    if (!sequence->active)
+        return;
+
+    auto timer = pwmSequencerTimers[controllerIndex];
+    auto channel = pwmSequencerDmaChannels[controllerIndex];
+
+    pwmSequencerTimerRegisters[timer]->TCR = 0;
+
+    LPC17_DmaInternal_CloseChannel(channel);
+    LPC17_DmaInternal_CloseChannel(channel + 1);
+
+    // the last value may not have been latched yet
+    if (controllerIndex == 0)
+        PWM0LER = sequence->latch;
+    else
+        PWM1LER = sequence->latch;
+
+    LPC_SC->DMAREQSEL &= ~(3 << pwmSequencerTimerRequests[timer]);
+    LPC_SC->PCONP &= ~(1 << pwmSequencerTimerPower[timer]);
+
+    sequence->active = false;
+}
+
+static void LPC17_Pwm_SequenceDmaHandler(void* param, bool error) {
+    auto sequence = reinterpret_cast<PwmSequence*>(param);
+    auto controllerIndex = (int32_t)(sequence - pwmSequences);
+    auto handler = sequence->handler;
+
+    if (!sequence->active)
+        return;
+
+    if (error) {
+        LPC17_Pwm_EndSequence(controllerIndex);
+
+        if (handler != nullptr)
+            handler(sequence->param, true);
+
+        return;
+    }
+
+    if (sequence->repeat > 1) {
+        // the last value has been written, the next match 0 is a period away
+        sequence->repeat--;
+
+        LPC17_Pwm_StartSequenceDma(controllerIndex, 0);
+
+        return;
+    }
+
+    // the match register keeps the last value
+    if (sequence->repeat == 1)
+        LPC17_Pwm_EndSequence(controllerIndex);
+
+    if (handler != nullptr)
+        handler(sequence->param, false);
+}
+
+// Plays pattern, made by EncodeSequence, on channelCount channels starting at firstChannel. Each period one value is
+// written to the shadow of the match register and latched for the period after. The match registers do not sit next
+// to each other, so a sequence drives a single channel. The pattern is played repeatCount times, zero loops until
+// StopSequence. handler, which can be null, is called from the DMA interrupt when the last pass is done, after every
+// pass while looping, and with error set when a transfer error has stopped the sequence. The channel has to be open
+// with a frequency set, its output follows the pattern once enabled. The pattern is read while playing and has to
+// stay in place.
+TinyCLR_Result LPC17_Pwm_StartSequence(const TinyCLR_Pwm_Controller* self, uint32_t firstChannel, uint32_t channelCount, const void* pattern, size_t length, uint32_t repeatCount, LPC17_Pwm_SequenceHandler handler, void* param) {
+    if (pattern == nullptr)
+        return TinyCLR_Result::ArgumentNull;
+
+    auto state = reinterpret_cast<PwmState*>(self->ApiInfo->State);
+    auto controllerIndex = state->controllerIndex;
+    auto sequence = &pwmSequences[controllerIndex];
+
+    uint32_t periodTicks = controllerIndex == 0 ? PWM0MR0 : PWM1MR0;
+
+    if (sequence->active || periodTicks == 0)
+        return TinyCLR_Result::InvalidOperation;
+
+    if (channelCount == 0 || firstChannel + channelCount > MAX_PWM_PER_CONTROLLER)
+        return TinyCLR_Result::ArgumentOutOfRange;
+
+    if (channelCount != 1)
+        return TinyCLR_Result::NotSupported;
+
+    if (!state->isOpened[firstChannel])
+        return TinyCLR_Result::InvalidOperation;
+
+    if (length == 0 || length > LPC17_PWM_SEQUENCER_MAX_LENGTH || ((uint32_t)pattern & 0x03) != 0)
+        return TinyCLR_Result::ArgumentInvalid;
+
+    if (controllerIndex >= SIZEOF_ARRAY(pwmSequencerTimers) || controllerIndex >= SIZEOF_ARRAY(pwmSequencerDmaChannels) || pwmSequencerTimers[controllerIndex] >= SIZEOF_ARRAY(pwmSequencerTimerRegisters))
+        return TinyCLR_Result::NotSupported;
+
+    auto timer = pwmSequencerTimers[controllerIndex];
+    auto channel = pwmSequencerDmaChannels[controllerIndex];
+
+    if (!LPC17_DmaInternal_OpenChannel(channel))
+        return TinyCLR_Result::SharingViolation;
+
+    if (!LPC17_DmaInternal_OpenChannel(channel + 1)) {
+        LPC17_DmaInternal_CloseChannel(channel);
+
+        return TinyCLR_Result::SharingViolation;
+    }
+
+    auto loop = repeatCount == 0;
+
+    sequence->active = true;
+    sequence->repeat = repeatCount;
+    sequence->channel = firstChannel;
+    sequence->latch = (1 << 0) | (1 << (state->match[firstChannel] + 1));
+    sequence->handler = handler;
+    sequence->param = param;
+
+    sequence->items[0].source = (uint32_t)pattern;
+    sequence->items[0].destination = (uint32_t)state->matchAddress[firstChannel];
+    sequence->items[0].next = loop ? (uint32_t)&sequence->items[0] : 0;
+    sequence->items[0].control = LPC17_PWM_SEQUENCER_DMA_CONTROL | LPC17_PWM_SEQUENCER_DMA_SOURCE_INCREMENT | LPC17_PWM_SEQUENCER_DMA_TERMINAL_COUNT | length;
+
+    // the latch goes on until the sequence ends, setting LER again does no harm
+    sequence->items[1].source = (uint32_t)&sequence->latch;
+    sequence->items[1].destination = controllerIndex == 0 ? (uint32_t)&PWM0LER : (uint32_t)&PWM1LER;
+    sequence->items[1].next = (uint32_t)&sequence->items[1];
+    sequence->items[1].control = LPC17_PWM_SEQUENCER_DMA_CONTROL | LPC17_PWM_SEQUENCER_MAX_LENGTH;
+
+    // a 0% or 100% duty cycle has left the pin a GPIO
+    if (state->outputEnabled[firstChannel] == true) {
+        LPC17_Pwm_EnableChannel(self, firstChannel);
+
+        state->outputEnabled[firstChannel] = false;
+    }
+
+    auto tim = pwmSequencerTimerRegisters[timer];
+
+    LPC_SC->PCONP |= 1 << pwmSequencerTimerPower[timer];
+    LPC_SC->DMAREQSEL |= 3 << pwmSequencerTimerRequests[timer];
+
+    tim->TCR = PWM_TCR_COUNTER_RESET;
+    tim->CTCR = 0;
+    tim->PR = controllerIndex == 0 ? PWM0PR : PWM1PR;
+    tim->MR0 = periodTicks; // both reset on match 0, so the periods are the same
+    tim->MR1 = periodTicks / 2;
+    tim->MCR = (1 << 1);
+    tim->IR = 0x3F;
+
+    LPC17_DmaInternal_SetHandler(channel, &LPC17_Pwm_SequenceDmaHandler, sequence);
+    LPC17_Pwm_StartSequenceDma(controllerIndex, 0);
+    LPC17_Pwm_StartSequenceDma(controllerIndex, 1);
+
+    tim->TCR = PWM_TCR_COUNTER_ENABLE;
+
+    return TinyCLR_Result::Success;
+}
+
+TinyCLR_Result LPC17_Pwm_StopSequence(const TinyCLR_Pwm_Controller* self) {
+    auto state = reinterpret_cast<PwmState*>(self->ApiInfo->State);
+
+    LPC17_Pwm_EndSequence(state->controllerIndex);
 
     return TinyCLR_Result::Success;
 }
@@ -450,6 +796,8 @@ void LPC17_Pwm_Reset() {
 void LPC17_Pwm_ResetController(int32_t controllerIndex) {
     auto state = &pwmStates[controllerIndex];
 
+    LPC17_Pwm_EndSequence(controllerIndex);
+
     for (int p = 0; p < MAX_PWM_PER_CONTROLLER; p++) {
         state->gpioPin[p] = LPC17_Pwm_GetPins(controllerIndex, p);
 
@@ -466,6 +814,7 @@ void LPC17_Pwm_ResetController(int32_t controllerIndex) {
             state->invert[p] = TinyCLR_Pwm_PulsePolarity::ActiveLow;
             state->frequency = 0.0;
             state->dutyCycle[p] = 0.0;
+            state->isDutyCycleFixed[p] = false;
 
             if (state->isOpened[p] == true) {
                 if (controllerIndex == 0)
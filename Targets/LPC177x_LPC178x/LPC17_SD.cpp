@@ -296,53 +296,18 @@
 #define GPDMA_Control_Register_Channel(ChannelNumber)            (*(volatile unsigned long *)(DMA_BASE_ADDR + 0x10C + (ChannelNumber * 0x20)))
 #define GPDMA_Config_Register_Channel(ChannelNumber)            (*(volatile unsigned long *)(DMA_BASE_ADDR + 0x110 + (ChannelNumber * 0x20)))
 
-/******************************************************************************
-** Function name:        DMAHandler
-**
-** Descriptions:        DMA interrupt handler for MCI
-**
-** parameters:            None
-** Returned value:        None
-**
-******************************************************************************/
-
-void DMAHandler(void * p) {
-    uint32_t regVal;
-    static uint32_t DMATCCount, DMAErrCount;
-
-    regVal = GPDMA_INT_TCSTAT;
-    if (regVal) {
-        DMATCCount++;
-        GPDMA_INT_TCCLR |= regVal;
-    }
-
-    regVal = GPDMA_INT_ERR_STAT;
-    if (regVal) {
-        DMAErrCount++;
-        GPDMA_INT_ERR_CLR |= regVal;
-    }
-}
-
 /******************************************************************************
 ** Function name:        DMA_Init
 **
-** Descriptions:        Setup GPDMA clock and install interrupt handler
+** Descriptions:        Take GPDMA channel 0 for the MCI transfers
 **
 ** parameters:            None
-** Returned value:        true or false, false if ISR can't be installed.
+** Returned value:        None
 **
 ******************************************************************************/
 void DMA_Init(void) {
-    LPC_SC->PCONP |= (1 << 29);
-
-    GPDMA_INT_TCCLR = 0xFF;
-    GPDMA_INT_ERR_CLR = 0xFF;
-
-    GPDMA_CONFIG = 0x01;
-
-    while (!(GPDMA_CONFIG & 0x01));
-
-    LPC17_InterruptInternal_Activate(DMA_IRQn, (uint32_t*)&DMAHandler, (void*)0);
+    // transfers are polled, no handler. Already ours when the card is initialized again.
+    LPC17_DmaInternal_OpenChannel(0);
 }
 
 /******************************************************************************
@@ -358,8 +323,9 @@ void DMA_Init(void) {
 ******************************************************************************/
 uint32_t DMA_Move(uint32_t ChannelNum, uint32_t DMAMode) {
 
-    GPDMA_INT_TCCLR = 0xFF;
-    GPDMA_INT_ERR_CLR = 0xFF;
+    // the other channels belong to other drivers
+    GPDMA_INT_TCCLR = (1 << ChannelNum);
+    GPDMA_INT_ERR_CLR = (1 << ChannelNum);
 
     if (DMAMode == M2M) {
         GPDMA_Source_Register_Channel(ChannelNum) = DMA_SRC;
@@ -2267,9 +2233,7 @@ TinyCLR_Result LPC17_SdCard_Release(const TinyCLR_Storage_Controller* self) {
 
         LPC_SC->PCONP &= ~(1 << 28); /* Disable clock to the Mci block */
 
-        LPC_SC->PCONP &= ~(1 << 29); /* Disable clock to the Dma block */
-
-        LPC17_InterruptInternal_Deactivate(DMA_IRQn); /* Disable Interrupt */
+        LPC17_DmaInternal_CloseChannel(0); /* Dma is powered down when no other channel is in use */
 
         auto memoryProvider = (const TinyCLR_Memory_Manager*)apiManager->FindDefault(apiManager, TinyCLR_Api_Type::MemoryManager);
 
@@ -51,6 +51,8 @@ void LPC17_Startup_OnSoftReset(const TinyCLR_Api_Manager* apiManager, const Tiny
 #ifdef INCLUDE_USBCLIENT
     LPC17_UsbDevice_Reset();
 #endif
+
+    LPC17_Dma_Reset();
 }
 
 /*
@@ -237,7 +237,16 @@ uint32_t LPC24_Dac_GetResolutionInBits(const TinyCLR_Dac_Controller* self);
 int32_t LPC24_Dac_GetMinValue(const TinyCLR_Dac_Controller* self);
 int32_t LPC24_Dac_GetMaxValue(const TinyCLR_Dac_Controller* self);
 
+typedef void(*LPC24_Dac_StreamHandler)(void* param, uint16_t* samples, size_t count, bool underrun);
+
+TinyCLR_Result LPC24_Dac_StartStream(const TinyCLR_Dac_Controller* self, uint32_t channel, uint16_t* buffer, size_t length, double& frequency, bool circular, LPC24_Dac_StreamHandler handler, void* param);
+TinyCLR_Result LPC24_Dac_SubmitStream(const TinyCLR_Dac_Controller* self, uint32_t channel);
+TinyCLR_Result LPC24_Dac_StopStream(const TinyCLR_Dac_Controller* self, uint32_t channel);
+
 // PWM
+// Duty cycles for SetDutyCycles are Q16, this one keeps the output on for the whole period
+#define LPC24_PWM_FULL_DUTY_CYCLE (1 << 16)
+
 struct PwmState {
     int32_t                     controllerIndex;
     int32_t                     channel[MAX_PWM_PER_CONTROLLER];
@@ -254,6 +263,10 @@ struct PwmState {
     double                      frequency;
     double                      dutyCycle[MAX_PWM_PER_CONTROLLER];
 
+    // set through SetDutyCycles, only turned into dutyCycle when the frequency changes
+    bool                        isDutyCycleFixed[MAX_PWM_PER_CONTROLLER];
+    uint32_t                    fixedDutyCycle[MAX_PWM_PER_CONTROLLER];
+
     uint16_t initializeCount;
 };
 void LPC24_Pwm_AddApi(const TinyCLR_Api_Manager* apiManager);
@@ -264,6 +277,7 @@ TinyCLR_Result LPC24_Pwm_Acquire(const TinyCLR_Pwm_Controller* self);
 TinyCLR_Result LPC24_Pwm_Release(const TinyCLR_Pwm_Controller* self);
 uint32_t LPC24_Pwm_GetGpioPinForChannel(const TinyCLR_Pwm_Controller* self, uint32_t channel);
 TinyCLR_Result LPC24_Pwm_SetDesiredFrequency(const TinyCLR_Pwm_Controller* self, double& frequency);
+TinyCLR_Result LPC24_Pwm_SetDutyCycles(const TinyCLR_Pwm_Controller* self, const uint32_t* channels, const uint32_t* dutyCycles, size_t count);
 TinyCLR_Result LPC24_Pwm_OpenChannel(const TinyCLR_Pwm_Controller* self, uint32_t channel);
 TinyCLR_Result LPC24_Pwm_CloseChannel(const TinyCLR_Pwm_Controller* self, uint32_t channel);
 TinyCLR_Result LPC24_Pwm_EnableChannel(const TinyCLR_Pwm_Controller* self, uint32_t channel);
@@ -367,6 +381,7 @@ TinyCLR_Result LPC24_Deployment_Read(const TinyCLR_Storage_Controller* self, uin
 TinyCLR_Result LPC24_Deployment_Write(const TinyCLR_Storage_Controller* self, uint64_t address, size_t& count, const uint8_t* data, uint64_t timeout);
 TinyCLR_Result LPC24_Deployment_Erase(const TinyCLR_Storage_Controller* self, uint64_t address, size_t& count, uint64_t timeout);
 TinyCLR_Result LPC24_Deployment_IsErased(const TinyCLR_Storage_Controller* self, uint64_t address, size_t count, bool& erased);
+TinyCLR_Result LPC24_Deployment_GetSectorHash(const TinyCLR_Storage_Controller* self, uint64_t sector, uint64_t& hash);
 TinyCLR_Result LPC24_Deployment_GetBytesPerSector(const TinyCLR_Storage_Controller* self, uint32_t address, int32_t& size);
 TinyCLR_Result LPC24_Deployment_GetDescriptor(const TinyCLR_Storage_Controller* self, const TinyCLR_Storage_Descriptor*& descriptor);
 TinyCLR_Result LPC24_Deployment_IsPresent(const TinyCLR_Storage_Controller* self, bool& present);
@@ -493,7 +508,7 @@ typedef void(*USB_NEXT_CALLBACK)(UsClientState*);
 void TinyCLR_UsbClient_ClearEvent(UsClientState *usClientState, uint32_t event);
 void TinyCLR_UsbClient_ClearEndpoints(UsClientState *usClientState, int32_t endpoint);
 USB_PACKET64* TinyCLR_UsbClient_RxEnqueue(UsClientState* usClientState, int32_t endpoint, bool& disableRx);
-USB_PACKET64* TinyCLR_UsbClient_TxDequeue(UsClientState* usClientState, int32_t endpoint);
+bool TinyCLR_UsbClient_TxGetPacket(UsClientState* usClientState, int32_t endpoint, const uint8_t*& data, uint32_t& size);
 void TinyCLR_UsbClient_StateCallback(UsClientState* usClientState);
 uint8_t TinyCLR_UsbClient_ControlCallback(UsClientState* usClientState);
 
@@ -511,6 +526,11 @@ TinyCLR_Result LPC24_Display_DrawBuffer(const TinyCLR_Display_Controller* self,
 TinyCLR_Result LPC24_Display_DrawPixel(const TinyCLR_Display_Controller* self, uint32_t x, uint32_t y, uint64_t color);
 TinyCLR_Result LPC24_Display_WriteString(const TinyCLR_Display_Controller* self, const char* buffer, size_t length);
 
+// Double buffering, outside the display controller API. Drawing goes to a back buffer and Present shows it
+// at the next vertical blanking; with copyForward what was drawn is carried over into the new back buffer.
+TinyCLR_Result LPC24_Display_SetDoubleBuffering(const TinyCLR_Display_Controller* self, bool enable, bool copyForward);
+TinyCLR_Result LPC24_Display_Present(const TinyCLR_Display_Controller* self);
+
 //Startup
 void LPC24_Startup_Initialize();
 void LPC24_Startup_GetHeap(uint8_t*& start, size_t& length);
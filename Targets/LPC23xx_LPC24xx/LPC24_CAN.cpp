@@ -17,6 +17,7 @@
 #include <algorithm>
 #include <string.h>
 #include "LPC24.h"
+#include "../../Drivers/RingBuffer/RingBuffer.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -2013,9 +2014,7 @@ struct CanState {
     TinyCLR_Can_ErrorReceivedHandler   errorEventHandler;
     TinyCLR_Can_MessageReceivedHandler    messageReceivedEventHandler;
 
-    int32_t can_rx_count;
-    int32_t can_rx_in;
-    int32_t can_rx_out;
+    RingBuffer<LPC24_Can_Message> rxRing;
 
     size_t can_rxBufferSize;
     size_t can_txBufferSize;
@@ -2307,7 +2306,7 @@ void CAN_ISR_Rx(int32_t controllerIndex) {
         }
     }
 
-    if (state->can_rx_count > (state->can_rxBufferSize - 3)) {
+    if (state->rxRing.GetCount() > state->can_rxBufferSize - 3) {
         if (controllerIndex == 0)
             C1CMR = 0x04; // release receive buffer
         else
@@ -2318,8 +2317,13 @@ void CAN_ISR_Rx(int32_t controllerIndex) {
         return;
     }
 
+    size_t available;
+
     // initialize destination pointer
-    LPC24_Can_Message *can_msg = &state->canRxMessagesFifo[state->can_rx_in];
+    LPC24_Can_Message *can_msg = state->rxRing.GetWriteSpan(available);
+
+    if (can_msg == nullptr)
+        return;
 
     // timestamp
     uint64_t t = LPC24_Time_GetCurrentProcessorTime();
@@ -2359,14 +2363,9 @@ void CAN_ISR_Rx(int32_t controllerIndex) {
 
     can_msg->dataB = dataB; // Data B
 
-    state->can_rx_count++;
-    state->can_rx_in++;
-
-    if (state->can_rx_in == state->can_rxBufferSize) {
-        state->can_rx_in = 0;
-    }
+    state->rxRing.Commit(1);
 
-    state->messageReceivedEventHandler(state->provider, state->can_rx_count, t);
+    state->messageReceivedEventHandler(state->provider, state->rxRing.GetCount(), t);
 }
 void LPC24_Can_RxInterruptHandler(void *param) {
     uint32_t status = CANRxSR;
@@ -2437,9 +2436,7 @@ TinyCLR_Result LPC24_Can_Acquire(const TinyCLR_Can_Controller* self) {
         LPC24_Gpio_ConfigurePin(canTxPins[controllerIndex].number, LPC24_Gpio_Direction::Input, canTxPins[controllerIndex].pinFunction, LPC24_Gpio_PinMode::Inactive);
         LPC24_Gpio_ConfigurePin(canRxPins[controllerIndex].number, LPC24_Gpio_Direction::Input, canRxPins[controllerIndex].pinFunction, LPC24_Gpio_PinMode::Inactive);
 
-        state->can_rx_count = 0;
-        state->can_rx_in = 0;
-        state->can_rx_out = 0;
+        state->rxRing.Uninitialize();
         state->baudrate = 0;
         state->can_rxBufferSize = canDefaultBuffersSize[controllerIndex];
         state->provider = self;
@@ -2478,6 +2475,8 @@ TinyCLR_Result LPC24_Can_Release(const TinyCLR_Can_Controller* self) {
     if (state->initializeCount == 0) {
         auto controllerIndex = state->controllerIndex;
 
+        state->rxRing.Uninitialize();
+
         if (state->canRxMessagesFifo != nullptr) {
             memoryProvider->Free(memoryProvider, state->canRxMessagesFifo);
 
@@ -2498,9 +2497,7 @@ TinyCLR_Result LPC24_Can_SoftReset(const TinyCLR_Can_Controller* self) {
     auto state = reinterpret_cast<CanState*>(self->ApiInfo->State);
     auto controllerIndex = state->controllerIndex;
 
-    state->can_rx_count = 0;
-    state->can_rx_in = 0;
-    state->can_rx_out = 0;
+    state->rxRing.Discard();
 
     // Reset CAN
     if (controllerIndex == 0) {
@@ -2608,17 +2605,8 @@ TinyCLR_Result LPC24_Can_ReadMessage(const TinyCLR_Can_Controller* self, TinyCLR
 
     auto state = reinterpret_cast<CanState*>(self->ApiInfo->State);
 
-    if (state->can_rx_count) {
-        DISABLE_INTERRUPTS_SCOPED(irq);
-
-        can_msg = &state->canRxMessagesFifo[state->can_rx_out];
-        state->can_rx_out++;
-
-        if (state->can_rx_out == state->can_rxBufferSize)
-            state->can_rx_out = 0;
-
-        state->can_rx_count--;
-
+    // the interrupt handler only moves the head, the message is copied out without holding it off
+    if ((can_msg = state->rxRing.Peek()) != nullptr) {
         arbitrationId = can_msg->msgId;
         isExtendedId = can_msg->extendedId;
         isRemoteTransmissionRequest = can_msg->remoteTransmissionRequest;
@@ -2629,6 +2617,8 @@ TinyCLR_Result LPC24_Can_ReadMessage(const TinyCLR_Can_Controller* self, TinyCLR
         length = can_msg->length;
 
         timestamp = ((uint64_t)can_msg->timeStampL) | ((uint64_t)can_msg->timeStampH << 32);
+
+        state->rxRing.Consume(1);
     }
 
     return TinyCLR_Result::Success;
@@ -2650,11 +2640,16 @@ TinyCLR_Result LPC24_Can_SetBitTiming(const TinyCLR_Can_Controller* self, const
     auto state = reinterpret_cast<CanState*>(self->ApiInfo->State);
     auto controllerIndex = state->controllerIndex;
 
-    if (state->canRxMessagesFifo == nullptr)
-        state->canRxMessagesFifo = (LPC24_Can_Message*)memoryProvider->Allocate(memoryProvider, state->can_rxBufferSize * sizeof(LPC24_Can_Message));
-
     if (state->canRxMessagesFifo == nullptr) {
-        return TinyCLR_Result::OutOfMemory;
+        auto capacity = RingBuffer<LPC24_Can_Message>::GetCapacityFor(state->can_rxBufferSize);
+
+        state->canRxMessagesFifo = (LPC24_Can_Message*)memoryProvider->Allocate(memoryProvider, capacity * sizeof(LPC24_Can_Message));
+
+        if (state->canRxMessagesFifo == nullptr) {
+            return TinyCLR_Result::OutOfMemory;
+        }
+
+        state->rxRing.Initialize(state->canRxMessagesFifo, capacity);
     }
 
     state->baudrate = ((phase2 - 1) << 20) | ((phase1 - 1) << 16) | ((baudratePrescaler - 1) << 0);
@@ -2695,7 +2690,7 @@ size_t LPC24_Can_GetMessagesToRead(const TinyCLR_Can_Controller* self) {
 
     auto state = reinterpret_cast<CanState*>(self->ApiInfo->State);
 
-    return state->can_rx_count;
+    return state->rxRing.GetCount();
 }
 
 TinyCLR_Result LPC24_Can_SetMessageReceivedHandler(const TinyCLR_Can_Controller* self, TinyCLR_Can_MessageReceivedHandler handler) {
@@ -2789,9 +2784,7 @@ TinyCLR_Result LPC24_Can_SetGroupFilters(const TinyCLR_Can_Controller* self, con
 TinyCLR_Result LPC24_Can_ClearReadBuffer(const TinyCLR_Can_Controller* self) {
     auto state = reinterpret_cast<CanState*>(self->ApiInfo->State);
 
-    state->can_rx_count = 0;
-    state->can_rx_in = 0;
-    state->can_rx_out = 0;
+    state->rxRing.Discard();
 
     return TinyCLR_Result::Success;
 }
@@ -2850,6 +2843,7 @@ TinyCLR_Result LPC24_Can_SetWriteBufferSize(const TinyCLR_Can_Controller* self,
 void LPC24_Can_Reset() {
     for (int i = 0; i < TOTAL_CAN_CONTROLLERS; i++) {
         canStates[i].canRxMessagesFifo = nullptr;
+        canStates[i].rxRing.Uninitialize();
 
         LPC24_Can_Release(&canControllers[i]);
 
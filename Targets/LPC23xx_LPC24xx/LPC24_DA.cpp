@@ -14,6 +14,7 @@
 // limitations under the License.
 
 #include "LPC24.h"
+#include "../../Drivers/DacStream/DacStream.h"
 
 #define DACR (*(volatile unsigned long *)0xE006C000)
 
@@ -21,6 +22,24 @@
 #define LPC24_DAC_PRECISION_BITS 	10	// Number of Bits in the DAC Convertion
 #define LPC24_DAC_MAX_VALUE 	(1<<LPC24_DAC_PRECISION_BITS)
 
+#define DACR_VALUE_MASK 0xFFC0
+
+// Streaming output. The DAC has no counter or DMA request on these parts, a timer match interrupt writes each sample.
+#ifndef LPC24_DAC_TIMER
+#define LPC24_DAC_TIMER 2
+#endif
+
+#ifndef LPC24_DAC_MAX_SAMPLE_RATE
+#define LPC24_DAC_MAX_SAMPLE_RATE 50000
+#endif
+
+#if LPC24_DAC_TIMER == LPC24_TIME_DEFAULT_CONTROLLER_ID
+#error LPC24_DAC_TIMER is the native time timer
+#endif
+
+#define LPC24_DAC_TIMER_POWER (1 << (LPC24_DAC_TIMER < 2 ? LPC24_DAC_TIMER + 1 : LPC24_DAC_TIMER + 20))
+#define LPC24_DAC_TIMER_CLOCK_HZ SYSTEM_CLOCK_HZ
+
 ///////////////////////////////////////////////////////////////////////////////
 #define TOTAL_DAC_CONTROLLERS 1
 
@@ -29,8 +48,22 @@ static TinyCLR_Api_Info dacApi[TOTAL_DAC_CONTROLLERS];
 
 static const LPC24_Gpio_Pin dacPins[] = LPC24_DAC_PINS;
 
+struct DacStream {
+    bool active;
+    bool circular;
+    uint16_t* buffer;
+    size_t length;
+    LPC24_Dac_StreamHandler handler;
+    void* param;
+    uint32_t ready;
+    uint32_t submitted;
+    size_t position;
+};
+
 struct DacState {
     bool isOpened[SIZEOF_ARRAY(dacPins)];
+
+    DacStream streams[SIZEOF_ARRAY(dacPins)];
 };
 
 static DacState dacStates[TOTAL_DAC_CONTROLLERS];
@@ -65,6 +98,153 @@ void LPC24_Dac_AddApi(const TinyCLR_Api_Manager* apiManager) {
     apiManager->SetDefaultName(apiManager, TinyCLR_Api_Type::DacController, dacApi[0].Name);
 }
 
+// A half of the stream buffer has been played. In a circular stream every half has to be submitted again before the
+// output wraps back to it, when none is left the half that starts playing now is stale and reported as an underrun.
+static void LPC24_Dac_HalfPlayed(DacStream* stream, uint32_t half) {
+    auto count = stream->length / 2;
+    auto underrun = false;
+
+    if (stream->circular) {
+        if (stream->ready > 0)
+            stream->ready--;
+
+        underrun = stream->ready == 0;
+    }
+
+    if (stream->handler != nullptr)
+        stream->handler(stream->param, stream->buffer + half * count, count, underrun);
+}
+
+// Hands the oldest half given to the stream handler back for playing, after it has been filled with new samples.
+TinyCLR_Result LPC24_Dac_SubmitStream(const TinyCLR_Dac_Controller* self, uint32_t channel) {
+    if (channel >= SIZEOF_ARRAY(dacPins))
+        return TinyCLR_Result::ArgumentOutOfRange;
+
+    auto state = reinterpret_cast<DacState*>(self->ApiInfo->State);
+    auto stream = &state->streams[channel];
+
+    if (!stream->active || !stream->circular)
+        return TinyCLR_Result::InvalidOperation;
+
+    DISABLE_INTERRUPTS_SCOPED(irq);
+
+    stream->submitted ^= 1;
+
+    if (stream->ready < 2)
+        stream->ready++;
+
+    return TinyCLR_Result::Success;
+}
+
+static TinyCLR_Result LPC24_Dac_EndStream(DacStream* stream) {
+    if (!stream->active)
+        return TinyCLR_Result::Success;
+
+    LPC24XX_TIMER& TIMER = LPC24XX::TIMER(LPC24_DAC_TIMER);
+
+    TIMER.TCR = 0;
+    TIMER.MCR = 0;
+    TIMER.IR = LPC24XX_TIMER::MR0_RESET;
+
+    LPC24_InterruptInternal_Deactivate(LPC24XX_TIMER::getIntNo(LPC24_DAC_TIMER));
+
+    LPC24XX::SYSCON().PCONP &= ~LPC24_DAC_TIMER_POWER;
+
+    stream->active = false;
+
+    return TinyCLR_Result::Success;
+}
+
+void LPC24_Dac_TimerInterruptHandler(void* param) {
+    INTERRUPT_STARTED_SCOPED(isr);
+
+    auto stream = reinterpret_cast<DacStream*>(param);
+
+    LPC24XX::TIMER(LPC24_DAC_TIMER).IR = LPC24XX_TIMER::MR0_RESET;
+
+    if (!stream->active)
+        return;
+
+    DACR = stream->buffer[stream->position++] & DACR_VALUE_MASK;
+
+    if (stream->position == stream->length / 2) {
+        LPC24_Dac_HalfPlayed(stream, 0);
+    }
+    else if (stream->position == stream->length) {
+        stream->position = 0;
+
+        // a single pass ends here, the output holds the last sample
+        if (!stream->circular)
+            LPC24_Dac_EndStream(stream);
+
+        LPC24_Dac_HalfPlayed(stream, 1);
+    }
+}
+
+// Plays buffer on an open channel at frequency samples per second, frequency is updated to the rate that is really
+// used. Samples are 16 bit left aligned, the bits below the converter resolution are dropped. Every sample costs an
+// interrupt, the rate is limited to LPC24_DAC_MAX_SAMPLE_RATE. The buffer is played in two halves and handler, which
+// can be null, is called from the timer interrupt with each half once it has been played. A single pass stops after
+// the second half. A circular stream goes on with the other half and wraps, each half handed to handler has to be
+// filled and given back with SubmitStream before the output gets to it again or it is played again and reported as
+// an underrun.
+TinyCLR_Result LPC24_Dac_StartStream(const TinyCLR_Dac_Controller* self, uint32_t channel, uint16_t* buffer, size_t length, double& frequency, bool circular, LPC24_Dac_StreamHandler handler, void* param) {
+    if (channel >= SIZEOF_ARRAY(dacPins))
+        return TinyCLR_Result::ArgumentOutOfRange;
+
+    if (buffer == nullptr)
+        return TinyCLR_Result::ArgumentNull;
+
+    auto state = reinterpret_cast<DacState*>(self->ApiInfo->State);
+    auto stream = &state->streams[channel];
+
+    if (!state->isOpened[channel] || stream->active)
+        return TinyCLR_Result::InvalidOperation;
+
+    if (length < 2 || length % 2 != 0)
+        return TinyCLR_Result::ArgumentInvalid;
+
+    if (frequency < (double)LPC24_DAC_TIMER_CLOCK_HZ / 0x100000000ull || frequency > LPC24_DAC_MAX_SAMPLE_RATE)
+        return TinyCLR_Result::ArgumentOutOfRange;
+
+    auto ticks = DacStream_GetTicks(LPC24_DAC_TIMER_CLOCK_HZ, frequency);
+
+    stream->active = true;
+    stream->circular = circular;
+    stream->buffer = buffer;
+    stream->length = length;
+    stream->handler = handler;
+    stream->param = param;
+    stream->ready = 2;
+    stream->submitted = 0;
+    stream->position = 0;
+
+    LPC24XX::SYSCON().PCONP |= LPC24_DAC_TIMER_POWER;
+
+    LPC24XX_TIMER& TIMER = LPC24XX::TIMER(LPC24_DAC_TIMER);
+
+    TIMER.TCR = 0x2; // reset
+    TIMER.PR = 0;
+    TIMER.MR0 = ticks - 1;
+    TIMER.MCR = LPC24XX_TIMER::MR0_IRQEN | 0x2; // interrupt and reset on MR0
+    TIMER.IR = LPC24XX_TIMER::MR0_RESET;
+
+    LPC24_InterruptInternal_Activate(LPC24XX_TIMER::getIntNo(LPC24_DAC_TIMER), (uint32_t*)&LPC24_Dac_TimerInterruptHandler, stream);
+
+    TIMER.TCR = LPC24XX_TIMER::TCR_TEN;
+
+    return TinyCLR_Result::Success;
+}
+
+TinyCLR_Result LPC24_Dac_StopStream(const TinyCLR_Dac_Controller* self, uint32_t channel) {
+    if (channel >= SIZEOF_ARRAY(dacPins))
+        return TinyCLR_Result::ArgumentOutOfRange;
+
+    auto state = reinterpret_cast<DacState*>(self->ApiInfo->State);
+
+    return LPC24_Dac_EndStream(&state->streams[channel]);
+}
+
 TinyCLR_Result LPC24_Dac_Acquire(const TinyCLR_Dac_Controller* self) {
     if (self == nullptr)
         return TinyCLR_Result::ArgumentNull;
@@ -102,6 +282,9 @@ TinyCLR_Result LPC24_Dac_CloseChannel(const TinyCLR_Dac_Controller* self, uint32
         return TinyCLR_Result::ArgumentOutOfRange;
 
     auto state = reinterpret_cast<DacState*>(self->ApiInfo->State);
+
+    LPC24_Dac_EndStream(&state->streams[channel]);
+
     if (state->isOpened[channel])
         LPC24_Gpio_ClosePin(dacPins[channel].number);
 
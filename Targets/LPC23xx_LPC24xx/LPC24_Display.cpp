@@ -14,6 +14,7 @@
 // limitations under the License.
 
 #include "LPC24.h"
+#include "../../Drivers/DisplayBlit/DisplayBlit.h"
 
 #ifdef INCLUDE_DISPLAY
 
@@ -432,6 +433,178 @@ static TinyCLR_Api_Info displayApi[TOTAL_DISPLAY_CONTROLLERS];
 
 #define AHBCFG1     (*(volatile unsigned *)0XE01FC188)
 
+// Double buffering. m_LPC24_Display_VituralRam is always the buffer that is drawn into. While double buffered the
+// controller scans out m_LPC24_Display_FrontBuffer instead, and Present swaps the two at the next vertical blanking.
+// With copy forward the region drawn before a Present is copied into the new back buffer once the flip is done,
+// so both buffers hold the same picture without copying whole frames.
+uint16_t* m_LPC24_Display_FrontBuffer = nullptr;
+bool m_LPC24_Display_CopyForward = false;
+bool m_LPC24_Display_FlipPending = false;
+DisplayBlit_Region m_LPC24_Display_DirtyRegion;
+DisplayBlit_Region m_LPC24_Display_StaleRegion;
+
+static uint16_t* LPC24_Display_GetScanoutBuffer() {
+    return m_LPC24_Display_FrontBuffer != nullptr ? m_LPC24_Display_FrontBuffer : m_LPC24_Display_VituralRam;
+}
+
+#define LPC24_DISPLAY_LCD_INT_LNBU (1 << 2)
+
+// The base address register is double buffered, the controller loads it at the start of the next frame and
+// flags that with the base update interrupt status.
+static void LPC24_Display_SetScanoutBuffer(uint16_t* buffer) {
+    LPC24XX_LCDC & LCDC = *(LPC24XX_LCDC *)LPC24XX_LCDC::c_LCDC_Base;
+
+    // base first: a frame start before it would flag the old base as loaded, one after it at worst costs a frame
+    LCDC.LCD_UPBASE = (uint32_t)buffer;
+    LCDC.LCD_INTCLR = LPC24_DISPLAY_LCD_INT_LNBU;
+}
+
+static bool LPC24_Display_IsFlipPending() {
+    LPC24XX_LCDC & LCDC = *(LPC24XX_LCDC *)LPC24XX_LCDC::c_LCDC_Base;
+
+    return (LCDC.LCD_INTRAW & LPC24_DISPLAY_LCD_INT_LNBU) == 0;
+}
+
+static void LPC24_Display_MarkDirty(int32_t x, int32_t y, int32_t width, int32_t height) {
+    if (m_LPC24_Display_FrontBuffer != nullptr)
+        m_LPC24_Display_DirtyRegion.Include(x, y, width, height);
+}
+
+// Maps a rectangle in rotated coordinates to the frame buffer. The size swaps for the 90 degree rotations.
+static void LPC24_Display_GetPhysicalRectangle(int32_t& x, int32_t& y, int32_t& width, int32_t& height) {
+    int32_t screenWidth = m_LPC24_DisplayWidth;
+    int32_t screenHeight = m_LPC24_DisplayHeight;
+    int32_t t;
+
+    switch (m_LPC24_Display_CurrentRotation) {
+    case LPC24xx_LCD_Rotation::rotateNormal_0:
+        break;
+
+    case LPC24xx_LCD_Rotation::rotateCCW_90:
+        t = x;
+        x = y;
+        y = screenHeight - t - width;
+
+        t = width;
+        width = height;
+        height = t;
+
+        break;
+
+    case LPC24xx_LCD_Rotation::rotateCW_90:
+        t = x;
+        x = screenWidth - y - height;
+        y = t;
+
+        t = width;
+        width = height;
+        height = t;
+
+        break;
+
+    case LPC24xx_LCD_Rotation::rotate_180:
+        x = screenWidth - x - width;
+        y = screenHeight - y - height;
+
+        break;
+    }
+}
+
+// Must run before the back buffer is touched: it may still be on screen until a requested flip has happened.
+static void LPC24_Display_WaitForFlip() {
+    if (m_LPC24_Display_FlipPending) {
+        // a controller that was turned off never gets to the flip, it shows the front buffer when turned back on
+        while (m_LPC24_DisplayEnable && LPC24_Display_IsFlipPending());
+
+        m_LPC24_Display_FlipPending = false;
+    }
+
+    if (!m_LPC24_Display_StaleRegion.IsEmpty()) {
+        auto region = m_LPC24_Display_StaleRegion;
+        auto offset = region.top * m_LPC24_DisplayWidth + region.left;
+
+        m_LPC24_Display_StaleRegion.Reset();
+
+        DisplayBlit_Copy(m_LPC24_Display_VituralRam + offset, m_LPC24_DisplayWidth, m_LPC24_Display_FrontBuffer + offset, m_LPC24_DisplayWidth, region.right - region.left, region.bottom - region.top);
+    }
+}
+
+TinyCLR_Result LPC24_Display_SetDoubleBuffering(const TinyCLR_Display_Controller* self, bool enable, bool copyForward) {
+    if (m_LPC24_Display_VituralRam == nullptr)
+        return TinyCLR_Result::InvalidOperation;
+
+    auto memoryProvider = (const TinyCLR_Memory_Manager*)apiManager->FindDefault(apiManager, TinyCLR_Api_Type::MemoryManager);
+
+    LPC24_Display_WaitForFlip();
+
+    if (enable && m_LPC24_Display_FrontBuffer == nullptr) {
+        auto back = (uint16_t*)memoryProvider->Allocate(memoryProvider, m_LPC24_DisplayBufferSize);
+
+        if (back == nullptr)
+            return TinyCLR_Result::OutOfMemory;
+
+        // what is on screen stays there, drawing continues on a copy of it
+        memcpy(back, m_LPC24_Display_VituralRam, m_LPC24_DisplayBufferSize);
+
+        m_LPC24_Display_FrontBuffer = m_LPC24_Display_VituralRam;
+        m_LPC24_Display_VituralRam = back;
+    }
+    else if (!enable && m_LPC24_Display_FrontBuffer != nullptr) {
+        // keep the buffer that is on screen, drawing continues there
+        memoryProvider->Free(memoryProvider, m_LPC24_Display_VituralRam);
+
+        m_LPC24_Display_VituralRam = m_LPC24_Display_FrontBuffer;
+        m_LPC24_Display_FrontBuffer = nullptr;
+    }
+
+    m_LPC24_Display_CopyForward = copyForward;
+    m_LPC24_Display_DirtyRegion.Reset();
+    m_LPC24_Display_StaleRegion.Reset();
+
+    return TinyCLR_Result::Success;
+}
+
+// Shows what was drawn since the last Present at the next vertical blanking. Returns without waiting for it; the
+// next drawing call waits instead, only if it comes before the flip.
+TinyCLR_Result LPC24_Display_Present(const TinyCLR_Display_Controller* self) {
+    if (m_LPC24_DisplayEnable == false || m_LPC24_Display_FrontBuffer == nullptr)
+        return TinyCLR_Result::InvalidOperation;
+
+    LPC24_Display_WaitForFlip();
+
+    auto front = m_LPC24_Display_VituralRam;
+
+    m_LPC24_Display_VituralRam = m_LPC24_Display_FrontBuffer;
+    m_LPC24_Display_FrontBuffer = front;
+
+    LPC24_Display_SetScanoutBuffer(front);
+
+    m_LPC24_Display_FlipPending = true;
+
+    if (m_LPC24_Display_CopyForward)
+        m_LPC24_Display_StaleRegion = m_LPC24_Display_DirtyRegion;
+
+    m_LPC24_Display_DirtyRegion.Reset();
+
+    return TinyCLR_Result::Success;
+}
+
+static void LPC24_Display_FreeBuffers(const TinyCLR_Memory_Manager* memoryProvider) {
+    LPC24_Display_WaitForFlip();
+
+    if (m_LPC24_Display_FrontBuffer != nullptr) {
+        memoryProvider->Free(memoryProvider, m_LPC24_Display_FrontBuffer);
+
+        m_LPC24_Display_FrontBuffer = nullptr;
+    }
+
+    if (m_LPC24_Display_VituralRam != nullptr) {
+        memoryProvider->Free(memoryProvider, m_LPC24_Display_VituralRam);
+
+        m_LPC24_Display_VituralRam = nullptr;
+    }
+}
+
 bool LPC24_Display_Initialize() {
     int32_t i;
     uint32_t * p32;
@@ -486,7 +659,7 @@ bool LPC24_Display_Initialize() {
     if (m_LPC24_Display_VituralRam == nullptr)
         return false;
 
-    LCDC.LCD_UPBASE = (uint32_t)&m_LPC24_Display_VituralRam[0];
+    LCDC.LCD_UPBASE = (uint32_t)LPC24_Display_GetScanoutBuffer();
 
     LPC24_Time_Delay(nullptr, 1000 * 10);
 
@@ -579,6 +752,9 @@ void LPC24_Display_PaintPixel(uint32_t x, uint32_t y, uint8_t c) {
     if (y >= m_LPC24_DisplayHeight)
         return;
 
+    LPC24_Display_WaitForFlip();
+    LPC24_Display_MarkDirty(x, y, 1, 1);
+
     loc = m_LPC24_Display_VituralRam + (y *m_LPC24_DisplayWidth) + (x);
 
     if (c)
@@ -651,6 +827,9 @@ void LPC24_Display_Clear() {
     if (m_LPC24_DisplayEnable == false || m_LPC24_Display_VituralRam == nullptr)
         return;
 
+    LPC24_Display_WaitForFlip();
+    LPC24_Display_MarkDirty(0, 0, m_LPC24_DisplayWidth, m_LPC24_DisplayHeight);
+
     memset((uint32_t*)m_LPC24_Display_VituralRam, 0, m_LPC24_DisplayBufferSize);
 }
 
@@ -728,134 +907,45 @@ int32_t LPC24_Display_GetOrientation() {
     return m_LPC24_Display_CurrentRotation;
 }
 
-void  LPC24_Display_MemCopy(void *dest, void *src, int32_t size) {
-    const int32_t MEMCOPY_BYTES_ALIGNED = 8;
-
-    uint64_t *from64 = (uint64_t *)src;
-    uint64_t *to64 = (uint64_t *)dest;
-
-    int32_t block = size / MEMCOPY_BYTES_ALIGNED;
-    int32_t remainder = size % MEMCOPY_BYTES_ALIGNED;
-
-    while (block > 0) {
-        *to64++ = *from64++;
-        block--;
-    }
-
-    if (remainder > 0) {
-        uint8_t *from8 = (uint8_t *)from64;
-        uint8_t *to8 = (uint8_t *)to64;
-
-        while (remainder > 0) {
-            *to8++ = *from8++;
-
-            remainder--;
-        }
-    }
-}
-
 void LPC24_Display_BitBltEx(int32_t x, int32_t y, int32_t width, int32_t height, uint32_t data[]) {
-
-    int32_t xTo, yTo, xFrom, yFrom;
-    int32_t xOffset = x;
-    int32_t yOffset = y;
-    uint16_t *from = (uint16_t *)data;
+    const uint16_t *from = (const uint16_t *)data;
     uint16_t *to = (uint16_t *)m_LPC24_Display_VituralRam;
 
-
     int32_t screenWidth = m_LPC24_DisplayWidth;
     int32_t screenHeight = m_LPC24_DisplayHeight;
-    int32_t startPx, toAddition;
 
     if (m_LPC24_DisplayEnable == false)
         return;
 
+    int32_t px = x, py = y, pw = width, ph = height;
+
+    LPC24_Display_GetPhysicalRectangle(px, py, pw, ph);
+    LPC24_Display_WaitForFlip();
+    LPC24_Display_MarkDirty(px, py, pw, ph);
+
+    // (x, y, width, height) is in rotated coordinates. A rotated source is a whole frame, its line pitch
+    // is the rotated width; the unrotated source only holds the rectangle.
     switch (m_LPC24_Display_CurrentRotation) {
     case LPC24xx_LCD_Rotation::rotateNormal_0:
-
-        if (xOffset == 0 && yOffset == 0 &&
-            width == screenWidth && height == screenHeight) {
-            LPC24_Display_MemCopy(to, from, (screenWidth*screenHeight * 2));
-        }
-        else {
-            for (yTo = yOffset; yTo < (yOffset + height); yTo++) {
-                LPC24_Display_MemCopy((void*)(to + yTo * screenWidth + xOffset), (void*)(from), (width * 2)); 
-                from += width;
-            }
-        }
+        DisplayBlit_Copy(to + y * screenWidth + x, screenWidth, from, width, width, height);
 
         break;
 
     case LPC24xx_LCD_Rotation::rotateCCW_90:
-
-        startPx = yOffset * screenHeight;
-        xFrom = xOffset + width;
-        yTo = screenHeight - xOffset - width;
-        xTo = yOffset;
-        to += yTo * screenWidth + xTo;
-        toAddition = screenWidth - height;
-
-        for (; yTo < (screenHeight - xOffset); yTo++) {
-            xFrom--;
-            yFrom = startPx + xFrom;
-
-            for (xTo = yOffset; xTo < (yOffset + height); xTo++) {
-                *to++ = from[yFrom];
-                yFrom += screenHeight;
-            }
-
-            to += toAddition;
-        }
+        DisplayBlit_Rotate90(to + (screenHeight - x - width) * screenWidth + y, screenWidth, from + y * screenHeight + x + width - 1, screenHeight, -1, height, width);
 
         break;
 
     case LPC24xx_LCD_Rotation::rotateCW_90:
-
-        startPx = (yOffset + height - 1) * screenHeight;
-        xFrom = xOffset;
-
-        yTo = xOffset;
-        xTo = screenWidth - yOffset - height;
-        to += yTo * screenWidth + xTo;
-        toAddition = screenWidth - height;
-
-        for (; yTo < (xOffset + width); yTo++) {
-            yFrom = startPx + xFrom;
-
-            for (xTo = screenWidth - yOffset - height; xTo < (screenWidth - yOffset); xTo++) {
-                *to++ = from[yFrom];
-                yFrom -= screenHeight;
-            }
-
-            to += toAddition;
-            xFrom++;
-        }
+        DisplayBlit_Rotate90(to + x * screenWidth + screenWidth - y - height, screenWidth, from + (y + height - 1) * screenHeight + x, -screenHeight, 1, height, width);
 
         break;
 
     case LPC24xx_LCD_Rotation::rotate_180:
-
-        xFrom = (yOffset + height - 1) * screenWidth + xOffset + width;
-
-        yTo = screenHeight - yOffset - height;
-        xTo = screenWidth - xOffset - width;
-        to += yTo * screenWidth + xTo;
-        toAddition = screenWidth - width;
-
-        for (; yTo < (screenHeight - yOffset); yTo++) {
-
-            for (xTo = screenWidth - xOffset - width; xTo < (screenWidth - xOffset); xTo++) {
-                xFrom--;
-                *to++ = from[xFrom];
-            }
-
-            to += toAddition;
-            xFrom -= toAddition;
-        }
+        DisplayBlit_Rotate180(to + (screenHeight - y - height) * screenWidth + screenWidth - x - width, screenWidth, from + (y + height - 1) * screenWidth + x + width - 1, screenWidth, width, height);
 
         break;
     }
-
 }
 
 void LPC24_Display_WriteChar(uint8_t c, int32_t row, int32_t col) {
@@ -905,13 +995,9 @@ TinyCLR_Result LPC17_Display_Release(const TinyCLR_Display_Controller* self) {
 
         m_LPC24_DisplayEnable = false;
 
-        if (m_LPC24_Display_VituralRam != nullptr) {
-            auto memoryProvider = (const TinyCLR_Memory_Manager*)apiManager->FindDefault(apiManager, TinyCLR_Api_Type::MemoryManager);
-
-            memoryProvider->Free(memoryProvider, m_LPC24_Display_VituralRam);
+        auto memoryProvider = (const TinyCLR_Memory_Manager*)apiManager->FindDefault(apiManager, TinyCLR_Api_Type::MemoryManager);
 
-            m_LPC24_Display_VituralRam = nullptr;
-        }
+        LPC24_Display_FreeBuffers(memoryProvider);
     }
     return TinyCLR_Result::Success;
 }
@@ -973,11 +1059,7 @@ TinyCLR_Result LPC24_Display_SetConfiguration(const TinyCLR_Display_Controller*
 
         auto memoryProvider = (const TinyCLR_Memory_Manager*)apiManager->FindDefault(apiManager, TinyCLR_Api_Type::MemoryManager);
 
-        if (m_LPC24_Display_VituralRam != nullptr) {
-            memoryProvider->Free(memoryProvider, m_LPC24_Display_VituralRam);
-
-            m_LPC24_Display_VituralRam = nullptr;
-        }
+        LPC24_Display_FreeBuffers(memoryProvider);
 
         m_LPC24_Display_VituralRam = (uint16_t*)((uint8_t*)memoryProvider->Allocate(memoryProvider, m_LPC24_DisplayBufferSize));
 
@@ -1046,6 +1128,9 @@ TinyCLR_Result LPC24_Display_DrawPixel(const TinyCLR_Display_Controller* self, u
     if (y >= m_LPC24_DisplayHeight)
         return TinyCLR_Result::InvalidOperation;
 
+    LPC24_Display_WaitForFlip();
+    LPC24_Display_MarkDirty(x, y, 1, 1);
+
     loc = m_LPC24_Display_VituralRam + (y *m_LPC24_DisplayWidth) + (x);
 
     *loc = rgb565;
@@ -1099,6 +1184,7 @@ void LPC24_Display_AddApi(const TinyCLR_Api_Manager* apiManager) {
     }
 
     m_LPC24_Display_VituralRam = nullptr;
+    m_LPC24_Display_FrontBuffer = nullptr;
 
     apiManager->SetDefaultName(apiManager, TinyCLR_Api_Type::DisplayController, displayApi[0].Name);
 }
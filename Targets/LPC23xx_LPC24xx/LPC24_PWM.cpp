@@ -14,6 +14,7 @@
 // limitations under the License.
 
 #include "LPC24.h"
+#include "../../Drivers/PwmDuty/PwmDuty.h"
 
 #define PWM0_BASE 0xE0014000
 
@@ -71,6 +72,10 @@
 #define PWM_MICROSECONDS  1000000
 #define PWM_NANOSECONDS   1000000000
 
+#define PWM_TCR_COUNTER_ENABLE (1 << 0)
+#define PWM_TCR_COUNTER_RESET (1 << 1)
+#define PWM_TCR_PWM_ENABLE (1 << 3) // match registers are shadowed, LER latches them at the end of the period
+
 const char* PwmApiNames[] = {
 #if TOTAL_PWM_CONTROLLERS > 0
 "GHIElectronics.TinyCLR.NativeApis.LPC24.PwmController\\0",
@@ -128,10 +133,10 @@ TinyCLR_Result LPC24_Pwm_OpenChannel(const TinyCLR_Pwm_Controller* self, uint32_
         LPC24XX::SYSCON().PCONP |= PCONP_PCPWM0;
 
         // Reset Timer Counter
-        PWM0TCR |= (1 << 1);
+        PWM0TCR = PWM_TCR_COUNTER_RESET;
         *state->matchAddress[channel] = 0;
         PWM0MCR = (1 << 1); // Reset on MAT0
-        PWM0TCR = 1; // Enable
+        PWM0TCR = PWM_TCR_COUNTER_ENABLE | PWM_TCR_PWM_ENABLE; // Enable
         PWM0PCR |= (1 << (9 + state->match[channel])); // To enable output on the proper channel
     }
     else if (state->channel[channel] == 1) {
@@ -140,10 +145,10 @@ TinyCLR_Result LPC24_Pwm_OpenChannel(const TinyCLR_Pwm_Controller* self, uint32_
         LPC24XX::SYSCON().PCONP |= PCONP_PCPWM1;
 
         // Reset Timer Counter
-        PWM1TCR |= (1 << 1);
+        PWM1TCR = PWM_TCR_COUNTER_RESET;
         *state->matchAddress[channel] = 0;
         PWM1MCR = (1 << 1); // Reset on MAT0
-        PWM1TCR = 1; // Enable
+        PWM1TCR = PWM_TCR_COUNTER_ENABLE | PWM_TCR_PWM_ENABLE; // Enable
         PWM1PCR |= (1 << (9 + (state->match[channel]))); // To enable output on the proper channel
     }
 
@@ -289,6 +294,8 @@ TinyCLR_Result LPC24_Pwm_SetPulseParameters(const TinyCLR_Pwm_Controller* self,
 
     auto state = reinterpret_cast<PwmState*>(self->ApiInfo->State);
 
+    state->isDutyCycleFixed[channel] = false;
+
     double frequency = state->frequency;
 
     LPC24_Pwm_GetScaleFactor(frequency, period, scale);
@@ -367,25 +374,27 @@ TinyCLR_Result LPC24_Pwm_SetPulseParameters(const TinyCLR_Pwm_Controller* self,
             if ((PWM0MR0 != periodTicks)) {
 
                 // Reset Timer Counter
-                PWM0TCR |= (1 << 1);
+                PWM0TCR = PWM_TCR_COUNTER_RESET;
                 PWM0MR0 = periodTicks;
                 PWM0MCR = (1 << 1); // Reset on MAT0
-                PWM0TCR = 1; // Enable
+                PWM0TCR = PWM_TCR_COUNTER_ENABLE | PWM_TCR_PWM_ENABLE; // Enable
             }
 
             *state->matchAddress[channel] = highTicks;
+            PWM0LER = (1 << 0) | (1 << (state->match[channel] + 1));
         }
         else if (state->channel[channel] == 1) {
             // Re-scale with new frequency!
             if ((PWM1MR0 != periodTicks)) {
                 // Reset Timer Counter
-                PWM1TCR |= (1 << 1);
+                PWM1TCR = PWM_TCR_COUNTER_RESET;
                 PWM1MR0 = periodTicks;
                 PWM1MCR = (1 << 1); // Reset on MAT0
-                PWM1TCR = 1; // Enable
+                PWM1TCR = PWM_TCR_COUNTER_ENABLE | PWM_TCR_PWM_ENABLE; // Enable
             }
 
             *state->matchAddress[channel] = highTicks;
+            PWM1LER = (1 << 0) | (1 << (state->match[channel] + 1));
         }
 
         if (state->outputEnabled[channel] == true) {
@@ -402,6 +411,71 @@ TinyCLR_Result LPC24_Pwm_SetPulseParameters(const TinyCLR_Pwm_Controller* self,
 
 }
 
+// Sets the duty cycles of several channels of the controller together. Duty cycles are Q16 fractions of the period,
+// LPC24_PWM_FULL_DUTY_CYCLE is always on, and the polarity stays as last set. The match registers are shadowed in PWM
+// mode, the new values are latched together through LER when the period ends. A channel that goes to or comes back
+// from always off or always on switches its pin right away, as SetPulseParameters does.
+TinyCLR_Result LPC24_Pwm_SetDutyCycles(const TinyCLR_Pwm_Controller* self, const uint32_t* channels, const uint32_t* dutyCycles, size_t count) {
+    if (channels == nullptr || dutyCycles == nullptr)
+        return TinyCLR_Result::ArgumentNull;
+
+    auto state = reinterpret_cast<PwmState*>(self->ApiInfo->State);
+
+    uint32_t periodTicks = state->controllerIndex == 0 ? PWM0MR0 : PWM1MR0;
+
+    // no frequency set yet
+    if (periodTicks == 0)
+        return TinyCLR_Result::InvalidOperation;
+
+    for (auto i = 0u; i < count; i++)
+        if (channels[i] >= MAX_PWM_PER_CONTROLLER || !state->isOpened[channels[i]])
+            return TinyCLR_Result::ArgumentOutOfRange;
+
+    uint32_t latch = 0;
+    uint32_t resume = 0;
+
+    for (auto i = 0u; i < count; i++) {
+        auto channel = channels[i];
+        auto dutyCycle = dutyCycles[i] > LPC24_PWM_FULL_DUTY_CYCLE ? LPC24_PWM_FULL_DUTY_CYCLE : dutyCycles[i];
+
+        state->isDutyCycleFixed[channel] = true;
+        state->fixedDutyCycle[channel] = dutyCycle;
+
+        if (dutyCycle == 0 || dutyCycle == LPC24_PWM_FULL_DUTY_CYCLE) {
+            LPC24_Gpio_EnableOutputPin(state->gpioPin[channel].number, dutyCycle != 0);
+            state->outputEnabled[channel] = true;
+
+            continue;
+        }
+
+        auto highTicks = PwmDuty_GetCompare(dutyCycle, periodTicks);
+
+        if (state->invert[channel] == TinyCLR_Pwm_PulsePolarity::ActiveLow)
+            highTicks = periodTicks - highTicks;
+
+        *state->matchAddress[channel] = highTicks;
+
+        latch |= 1 << (state->match[channel] + 1);
+
+        if (state->outputEnabled[channel] == true) {
+            resume |= 1 << channel;
+
+            state->outputEnabled[channel] = false;
+        }
+    }
+
+    if (state->controllerIndex == 0)
+        PWM0LER = latch;
+    else
+        PWM1LER = latch;
+
+    for (auto channel = 0; channel < MAX_PWM_PER_CONTROLLER; channel++)
+        if (resume & (1 << channel))
+            LPC24_Pwm_EnableChannel(self, channel);
+
+    return TinyCLR_Result::Success;
+}
+
 TinyCLR_Result LPC24_Pwm_SetDesiredFrequency(const TinyCLR_Pwm_Controller* self, double& frequency) {
     auto state = reinterpret_cast<PwmState*>(self->ApiInfo->State);
     state->frequency = frequency;
@@ -410,10 +484,14 @@ TinyCLR_Result LPC24_Pwm_SetDesiredFrequency(const TinyCLR_Pwm_Controller* self,
     frequency = LPC24_Pwm_GetActualFrequency(self);
 
 
-    for (int p = 0; p < MAX_PWM_PER_CONTROLLER; p++)
+    for (int p = 0; p < MAX_PWM_PER_CONTROLLER; p++) {
+        if (state->isDutyCycleFixed[p])
+            state->dutyCycle[p] = (double)state->fixedDutyCycle[p] / LPC24_PWM_FULL_DUTY_CYCLE;
+
         if (state->gpioPin[p].number != PIN_NONE)
             if (LPC24_Pwm_SetPulseParameters(self, p, state->dutyCycle[p], state->invert[p]) != TinyCLR_Result::Success)
                 return TinyCLR_Result::InvalidOperation;
+    }
 
 
     return TinyCLR_Result::Success;
@@ -480,6 +558,7 @@ void LPC24_Pwm_ResetController(int32_t controllerIndex) {
             state->invert[p] = TinyCLR_Pwm_PulsePolarity::ActiveLow;
             state->frequency = 0.0;
             state->dutyCycle[p] = 0.0;
+            state->isDutyCycleFixed[p] = false;
 
             if (state->isOpened[p] == true) {
                 if (controllerIndex == 0)
@@ -15,6 +15,7 @@
 
 #include <algorithm>
 #include "LPC24.h"
+#include "../../Drivers/RingBuffer/RingBuffer.h"
 
 #define USART_EVENT_POST_DEBOUNCE_TICKS (10 * 10000) // 10ms between each events
 static const uint32_t uartTxDefaultBuffersSize[] = LPC24_UART_DEFAULT_TX_BUFFER_SIZE;
@@ -25,14 +26,10 @@ struct UartState {
 
     uint8_t                             *TxBuffer;
     uint8_t                             *RxBuffer;
-    size_t                              txBufferCount;
-    size_t                              txBufferIn;
-    size_t                              txBufferOut;
+    RingBuffer<uint8_t>                 txRing;
     size_t                              txBufferSize;
 
-    size_t                              rxBufferCount;
-    size_t                              rxBufferIn;
-    size_t                              rxBufferOut;
+    RingBuffer<uint8_t>                 rxRing;
     size_t                              rxBufferSize;
 
     bool                                handshaking;
@@ -157,12 +154,16 @@ TinyCLR_Result LPC24_Uart_SetReadBufferSize(const TinyCLR_Uart_Controller* self,
         return TinyCLR_Result::ArgumentInvalid;
 
     if (state->rxBufferSize) {
+        state->rxRing.Uninitialize();
+
         memoryProvider->Free(memoryProvider, state->RxBuffer);
     }
 
     state->rxBufferSize = size;
 
-    state->RxBuffer = (uint8_t*)memoryProvider->Allocate(memoryProvider, size);
+    auto capacity = RingBuffer<uint8_t>::GetCapacityFor(size);
+
+    state->RxBuffer = (uint8_t*)memoryProvider->Allocate(memoryProvider, capacity);
 
     if (state->RxBuffer == nullptr) {
         state->rxBufferSize = 0;
@@ -170,6 +171,8 @@ TinyCLR_Result LPC24_Uart_SetReadBufferSize(const TinyCLR_Uart_Controller* self,
         return TinyCLR_Result::OutOfMemory;
     }
 
+    state->rxRing.Initialize(state->RxBuffer, capacity);
+
     return TinyCLR_Result::Success;
 }
 
@@ -190,12 +193,16 @@ TinyCLR_Result LPC24_Uart_SetWriteBufferSize(const TinyCLR_Uart_Controller* self
         return TinyCLR_Result::ArgumentInvalid;
 
     if (state->txBufferSize) {
+        state->txRing.Uninitialize();
+
         memoryProvider->Free(memoryProvider, state->TxBuffer);
     }
 
     state->txBufferSize = size;
 
-    state->TxBuffer = (uint8_t*)memoryProvider->Allocate(memoryProvider, size);
+    auto capacity = RingBuffer<uint8_t>::GetCapacityFor(size);
+
+    state->TxBuffer = (uint8_t*)memoryProvider->Allocate(memoryProvider, capacity);
 
     if (state->TxBuffer == nullptr) {
         state->txBufferSize = 0;
@@ -203,6 +210,8 @@ TinyCLR_Result LPC24_Uart_SetWriteBufferSize(const TinyCLR_Uart_Controller* self
         return TinyCLR_Result::OutOfMemory;
     }
 
+    state->txRing.Initialize(state->TxBuffer, capacity);
+
     return TinyCLR_Result::Success;
 }
 
@@ -292,31 +301,26 @@ void LPC24_Uart_ReceiveData(int controllerIndex, uint32_t LSR_Value, uint32_t II
                 auto canPostEvent = LPC24_Uart_CanPostEvent(controllerIndex);
 
                 if (!error) {
-                    if (state->rxBufferCount == state->rxBufferSize) {
+                    if (!state->rxRing.Push(rxdata)) {
                         if (canPostEvent) LPC24_Uart_SetErrorEvent(controllerIndex, TinyCLR_Uart_Error::BufferFull);
 
                         goto clear_status;
                     }
 
-                    state->RxBuffer[state->rxBufferIn++] = rxdata;
-
-                    state->rxBufferCount++;
-
-                    if (state->rxBufferIn == state->rxBufferSize)
-                        state->rxBufferIn = 0;
-
                     if (state->dataReceivedEventHandler != nullptr)
                         if (canPostEvent) {
-                            if (state->rxBufferCount > state->lastEventRxBufferCount) {
+                            auto count = state->rxRing.GetCount();
+
+                            if (count > state->lastEventRxBufferCount) {
                                 // if driver hold event long enough that more than 1 byte
-                                state->dataReceivedEventHandler(state->controller, state->rxBufferCount - state->lastEventRxBufferCount, LPC24_Time_GetCurrentProcessorTime());
+                                state->dataReceivedEventHandler(state->controller, count - state->lastEventRxBufferCount, LPC24_Time_GetCurrentProcessorTime());
                             }
                             else {
                                 // if user use poll to read data and rxBufferCount <= lastEventRxBufferCount, driver send at least 1 byte comming
                                 state->dataReceivedEventHandler(state->controller, 1, LPC24_Time_GetCurrentProcessorTime());
                             }
 
-                            state->lastEventRxBufferCount = state->rxBufferCount;
+                            state->lastEventRxBufferCount = count;
                         }
                 }
 
@@ -352,13 +356,9 @@ void LPC24_Uart_TransmitData(int controllerIndex, uint32_t LSR_Value, uint32_t I
     if ((LSR_Value & LPC24XX_USART::UART_LSR_TE) || (IIR_Value == LPC24XX_USART::UART_IIR_IID_Irpt_THRE)) {
         // Check if CTS is high
         if (LPC24_Uart_CanSend(controllerIndex)) {
-            if (state->txBufferCount > 0) {
-                uint8_t txdata = state->TxBuffer[state->txBufferOut++];
-
-                state->txBufferCount--;
+            uint8_t txdata;
 
-                if (state->txBufferOut == state->txBufferSize)
-                    state->txBufferOut = 0;
+            if (state->txRing.Pop(txdata)) {
 
                 USARTC.SEL1.THR.UART_THR = txdata; // write TX data
 
@@ -419,14 +419,6 @@ TinyCLR_Result LPC24_Uart_Acquire(const TinyCLR_Uart_Controller* self) {
         if (!LPC24_Gpio_OpenPin(txPin) || !LPC24_Gpio_OpenPin(rxPin))
             return TinyCLR_Result::SharingViolation;
 
-        state->txBufferCount = 0;
-        state->txBufferIn = 0;
-        state->txBufferOut = 0;
-
-        state->rxBufferCount = 0;
-        state->rxBufferIn = 0;
-        state->rxBufferOut = 0;
-
         state->controller = self;
         state->handshaking = false;
         state->enable = false;
@@ -626,25 +618,33 @@ TinyCLR_Result LPC24_Uart_SetActiveSettings(const TinyCLR_Uart_Controller* self,
     if (state->txBufferSize == 0) {
         state->txBufferSize = uartTxDefaultBuffersSize[controllerIndex];
 
-        state->TxBuffer = (uint8_t*)memoryProvider->Allocate(memoryProvider, state->txBufferSize);
+        auto capacity = RingBuffer<uint8_t>::GetCapacityFor(state->txBufferSize);
+
+        state->TxBuffer = (uint8_t*)memoryProvider->Allocate(memoryProvider, capacity);
 
         if (state->TxBuffer == nullptr) {
             state->txBufferSize = 0;
 
             return TinyCLR_Result::OutOfMemory;
         }
+
+        state->txRing.Initialize(state->TxBuffer, capacity);
     }
 
     if (state->rxBufferSize == 0) {
         state->rxBufferSize = uartRxDefaultBuffersSize[controllerIndex];
 
-        state->RxBuffer = (uint8_t*)memoryProvider->Allocate(memoryProvider, state->rxBufferSize);
+        auto capacity = RingBuffer<uint8_t>::GetCapacityFor(state->rxBufferSize);
+
+        state->RxBuffer = (uint8_t*)memoryProvider->Allocate(memoryProvider, capacity);
 
         if (state->RxBuffer == nullptr) {
             state->rxBufferSize = 0;
 
             return TinyCLR_Result::OutOfMemory;
         }
+
+        state->rxRing.Initialize(state->RxBuffer, capacity);
     }
 
 
@@ -682,13 +682,6 @@ TinyCLR_Result LPC24_Uart_Release(const TinyCLR_Uart_Controller* self) {
 
         LPC24_Uart_PinConfiguration(controllerIndex, false);
 
-        state->txBufferCount = 0;
-        state->txBufferIn = 0;
-        state->txBufferOut = 0;
-
-        state->rxBufferCount = 0;
-        state->rxBufferIn = 0;
-        state->rxBufferOut = 0;
 
         state->handshaking = false;
 
@@ -713,12 +706,16 @@ TinyCLR_Result LPC24_Uart_Release(const TinyCLR_Uart_Controller* self) {
             auto memoryProvider = (const TinyCLR_Memory_Manager*)apiManager->FindDefault(apiManager, TinyCLR_Api_Type::MemoryManager);
 
             if (state->txBufferSize != 0) {
+                state->txRing.Uninitialize();
+
                 memoryProvider->Free(memoryProvider, state->TxBuffer);
 
                 state->txBufferSize = 0;
             }
 
             if (state->rxBufferSize != 0) {
+                state->rxRing.Uninitialize();
+
                 memoryProvider->Free(memoryProvider, state->RxBuffer);
 
                 state->rxBufferSize = 0;
@@ -776,7 +773,7 @@ TinyCLR_Result LPC24_Uart_Flush(const TinyCLR_Uart_Controller* self) {
     // Make sute interrupt is enable
     LPC24_Uart_TxBufferEmptyInterruptEnable(controllerIndex, true);
 
-    while (state->txBufferCount > 0) {
+    while (!state->txRing.IsEmpty()) {
         LPC24_Time_Delay(nullptr, 1);
     }
 
@@ -784,8 +781,6 @@ TinyCLR_Result LPC24_Uart_Flush(const TinyCLR_Uart_Controller* self) {
 }
 
 TinyCLR_Result LPC24_Uart_Read(const TinyCLR_Uart_Controller* self, uint8_t* buffer, size_t& length) {
-    DISABLE_INTERRUPTS_SCOPED(irq);
-
     auto state = reinterpret_cast<UartState*>(self->ApiInfo->State);
 
     if (state->initializeCount == 0 || state->rxBufferSize == 0) {
@@ -794,30 +789,13 @@ TinyCLR_Result LPC24_Uart_Read(const TinyCLR_Uart_Controller* self, uint8_t* buf
         return TinyCLR_Result::NotAvailable;
     }
 
-    length = std::min(self->GetBytesToRead(self), length);
-
-    size_t i = 0;
-
-    while (i < length) {
-        buffer[i] = state->RxBuffer[state->rxBufferOut];
-
-        state->rxBufferOut++;
-        i++;
-        state->rxBufferCount--;
-
-        if (state->rxBufferOut == state->rxBufferSize)
-            state->rxBufferOut = 0;
-    }
+    // the interrupt handler only moves the head, no need to hold it off while copying out
+    length = state->rxRing.PopN(buffer, length);
 
     return TinyCLR_Result::Success;
 }
 
 TinyCLR_Result LPC24_Uart_Write(const TinyCLR_Uart_Controller* self, const uint8_t* buffer, size_t& length) {
-
-    int32_t i = 0;
-
-    DISABLE_INTERRUPTS_SCOPED(irq);
-
     auto state = reinterpret_cast<UartState*>(self->ApiInfo->State);
 
     auto controllerIndex = state->controllerIndex;
@@ -828,28 +806,15 @@ TinyCLR_Result LPC24_Uart_Write(const TinyCLR_Uart_Controller* self, const uint8
         return TinyCLR_Result::NotAvailable;
     }
 
-    if (state->txBufferCount == state->txBufferSize) {
+    if (state->txRing.IsFull()) {
+        length = 0;
+
         LPC24_Uart_SetErrorEvent(controllerIndex, TinyCLR_Uart_Error::BufferFull);
 
         return TinyCLR_Result::Busy;
     }
 
-    length = std::min(state->txBufferSize - state->txBufferCount, length);
-
-
-    while (i < length) {
-
-        state->TxBuffer[state->txBufferIn] = buffer[i];
-
-        state->txBufferCount++;
-
-        i++;
-
-        state->txBufferIn++;
-
-        if (state->txBufferIn == state->txBufferSize)
-            state->txBufferIn = 0;
-    }
+    length = state->txRing.PushN(buffer, length);
 
     if (length > 0) {
         LPC24_Uart_TxBufferEmptyInterruptEnable(controllerIndex, true); // Enable Tx to start transfer
@@ -927,19 +892,20 @@ TinyCLR_Result LPC24_Uart_SetIsRequestToSendEnabled(const TinyCLR_Uart_Controlle
 size_t LPC24_Uart_GetBytesToRead(const TinyCLR_Uart_Controller* self) {
     auto state = reinterpret_cast<UartState*>(self->ApiInfo->State);
 
-    return  state->rxBufferCount;
+    return state->rxRing.GetCount();
 }
 
 size_t LPC24_Uart_GetBytesToWrite(const TinyCLR_Uart_Controller* self) {
     auto state = reinterpret_cast<UartState*>(self->ApiInfo->State);
 
-    return state->txBufferCount;
+    return state->txRing.GetCount();
 }
 
 TinyCLR_Result LPC24_Uart_ClearReadBuffer(const TinyCLR_Uart_Controller* self) {
     auto state = reinterpret_cast<UartState*>(self->ApiInfo->State);
 
-    state->rxBufferCount = state->rxBufferIn = state->rxBufferOut = state->lastEventRxBufferCount = 0;
+    state->rxRing.Discard();
+    state->lastEventRxBufferCount = 0;
 
     return TinyCLR_Result::Success;
 }
@@ -947,7 +913,10 @@ TinyCLR_Result LPC24_Uart_ClearReadBuffer(const TinyCLR_Uart_Controller* self) {
 TinyCLR_Result LPC24_Uart_ClearWriteBuffer(const TinyCLR_Uart_Controller* self) {
     auto state = reinterpret_cast<UartState*>(self->ApiInfo->State);
 
-    state->txBufferCount = state->txBufferIn = state->txBufferOut = 0;
+    // the interrupt handler owns the tail, keep it out while the ring is emptied from this side
+    DISABLE_INTERRUPTS_SCOPED(irq);
+
+    state->txRing.Discard();
 
     return TinyCLR_Result::Success;
 }
@@ -957,6 +926,9 @@ void LPC24_Uart_Reset() {
         uartStates[i].txBufferSize = 0;
         uartStates[i].rxBufferSize = 0;
 
+        uartStates[i].txRing.Uninitialize();
+        uartStates[i].rxRing.Uninitialize();
+
         LPC24_Uart_Release(&uartControllers[i]);
 
         uartStates[i].initializeCount = 0;
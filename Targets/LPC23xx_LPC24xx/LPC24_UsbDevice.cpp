@@ -17,6 +17,16 @@
 #include "LPC24.h"
 #include "../../Drivers/USBClient/USBClient.h"
 
+// Packets shared by all USB endpoints and how many of them each open endpoint keeps to itself. The default pool
+// holds what a single pipe used to allocate for its own queues.
+#ifndef LPC24_USB_PACKET_POOL_COUNT
+#define LPC24_USB_PACKET_POOL_COUNT (LPC24_USB_PACKET_FIFO_COUNT * 2)
+#endif
+
+#ifndef LPC24_USB_PACKET_FIFO_RESERVED
+#define LPC24_USB_PACKET_FIFO_RESERVED 2
+#endif
+
 ///////////////////////////////////////////////////////////////////////////////////////////
 /// LPC24 USB Hardware state
 ///////////////////////////////////////////////////////////////////////////////////////////
@@ -181,6 +191,8 @@ void LPC24_UsbDevice_InitializeConfiguration(UsClientState *usClientState) {
         usClientState->controllerIndex = controllerIndex;
 
         usClientState->maxFifoPacketCountDefault = LPC24_USB_PACKET_FIFO_COUNT;
+        usClientState->minFifoPacketCountDefault = LPC24_USB_PACKET_FIFO_RESERVED;
+        usClientState->packetPoolCount = LPC24_USB_PACKET_POOL_COUNT;
         usClientState->totalEndpointsCount = LPC24_USB_ENDPOINT_COUNT;
         usClientState->totalPipesCount = LPC24_USB_PIPE_COUNT;
 
@@ -531,22 +543,24 @@ void LPC24_UsbDevice_TxPacket(UsClientState* usClientState, int32_t endpoint) {
     DISABLE_INTERRUPTS_SCOPED(irq);
 
     // transmit a packet on UsbPortNum, if there are no more packets to transmit, then die
-    USB_PACKET64* Packet64;
+    const uint8_t* data;
+    uint32_t size;
+    bool packet;
 
     for (;;) {
-        Packet64 = TinyCLR_UsbClient_TxDequeue(usClientState, endpoint);
+        packet = TinyCLR_UsbClient_TxGetPacket(usClientState, endpoint, data, size);
 
-        if (Packet64 == nullptr || Packet64->Size > 0) {
+        if (!packet || size > 0) {
             break;
         }
     }
 
-    if (Packet64) {
+    if (packet) {
 
-        USB_WriteEP(endpoint, Packet64->Buffer, Packet64->Size);
+        USB_WriteEP(endpoint, const_cast<uint8_t*>(data), size);
 
         usbDeviceDrivers[usClientState->controllerIndex].txNeedZLPS[endpoint] = false;
-        if (Packet64->Size == 64)
+        if (size == 64)
             usbDeviceDrivers[usClientState->controllerIndex].txNeedZLPS[endpoint] = true;
     }
     else {
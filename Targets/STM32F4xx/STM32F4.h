@@ -37,6 +37,7 @@ TinyCLR_Result STM32F4_Flash_Read(const TinyCLR_Storage_Controller* self, uint64
 TinyCLR_Result STM32F4_Flash_Write(const TinyCLR_Storage_Controller* self, uint64_t address, size_t& count, const uint8_t* data, uint64_t timeout);
 TinyCLR_Result STM32F4_Flash_Erase(const TinyCLR_Storage_Controller* self, uint64_t address, size_t& count, uint64_t timeout);
 TinyCLR_Result STM32F4_Flash_IsErased(const TinyCLR_Storage_Controller* self, uint64_t address, size_t count, bool& erased);
+TinyCLR_Result STM32F4_Flash_GetSectorHash(const TinyCLR_Storage_Controller* self, uint64_t sector, uint64_t& hash);
 TinyCLR_Result STM32F4_Flash_GetDescriptor(const TinyCLR_Storage_Controller* self, const TinyCLR_Storage_Descriptor*& descriptor);
 TinyCLR_Result STM32F4_Flash_IsPresent(const TinyCLR_Storage_Controller* self, bool& present);
 TinyCLR_Result STM32F4_Flash_SetPresenceChangedHandler(const TinyCLR_Storage_Controller* self, TinyCLR_Storage_PresenceChangedHandler handler);
@@ -110,6 +111,11 @@ uint32_t STM32F4_Adc_GetResolutionInBits(const TinyCLR_Adc_Controller* self);
 uint32_t STM32F4_Adc_GetChannelCount(const TinyCLR_Adc_Controller* self);
 void STM32F4_Adc_Reset();
 
+typedef void(*STM32F4_Adc_AcquisitionHandler)(void* param, const uint16_t* samples, size_t count);
+
+TinyCLR_Result STM32F4_Adc_StartAcquisition(const TinyCLR_Adc_Controller* self, const uint32_t* channels, size_t channelCount, double& frequency, uint16_t* buffer, size_t length, STM32F4_Adc_AcquisitionHandler handler, void* param);
+TinyCLR_Result STM32F4_Adc_StopAcquisition(const TinyCLR_Adc_Controller* self);
+
 ////////////////////////////////////////////////////////////////////////////////
 //CAN
 ////////////////////////////////////////////////////////////////////////////////
@@ -156,6 +162,12 @@ uint32_t STM32F4_Dac_GetResolutionInBits(const TinyCLR_Dac_Controller* self);
 uint32_t STM32F4_Dac_GetChannelCount(const TinyCLR_Dac_Controller* self);
 void STM32F4_Dac_Reset();
 
+typedef void(*STM32F4_Dac_StreamHandler)(void* param, uint16_t* samples, size_t count, bool underrun);
+
+TinyCLR_Result STM32F4_Dac_StartStream(const TinyCLR_Dac_Controller* self, uint32_t channel, uint16_t* buffer, size_t length, double& frequency, bool circular, STM32F4_Dac_StreamHandler handler, void* param);
+TinyCLR_Result STM32F4_Dac_SubmitStream(const TinyCLR_Dac_Controller* self, uint32_t channel);
+TinyCLR_Result STM32F4_Dac_StopStream(const TinyCLR_Dac_Controller* self, uint32_t channel);
+
 ////////////////////////////////////////////////////////////////////////////////
 //GPIO
 ////////////////////////////////////////////////////////////////////////////////
@@ -189,6 +201,9 @@ void STM32F4_I2c_Reset();
 ////////////////////////////////////////////////////////////////////////////////
 //PWM
 ////////////////////////////////////////////////////////////////////////////////
+// Duty cycles for SetDutyCycles are Q16, this one keeps the output on for the whole period
+#define STM32F4_PWM_FULL_DUTY_CYCLE (1 << 16)
+
 void STM32F4_Pwm_AddApi(const TinyCLR_Api_Manager* apiManager);
 TinyCLR_Result STM32F4_Pwm_Acquire(const TinyCLR_Pwm_Controller* self);
 TinyCLR_Result STM32F4_Pwm_Release(const TinyCLR_Pwm_Controller* self);
@@ -198,11 +213,19 @@ TinyCLR_Result STM32F4_Pwm_EnableChannel(const TinyCLR_Pwm_Controller* self, uin
 TinyCLR_Result STM32F4_Pwm_DisableChannel(const TinyCLR_Pwm_Controller* self, uint32_t channel);
 TinyCLR_Result STM32F4_Pwm_SetPulseParameters(const TinyCLR_Pwm_Controller* self, uint32_t channel, double dutyCycle, TinyCLR_Pwm_PulsePolarity polarity);
 TinyCLR_Result STM32F4_Pwm_SetDesiredFrequency(const TinyCLR_Pwm_Controller* self, double& frequency);
+TinyCLR_Result STM32F4_Pwm_SetDutyCycles(const TinyCLR_Pwm_Controller* self, const uint32_t* channels, const uint32_t* dutyCycles, size_t count);
+typedef void(*STM32F4_Pwm_SequenceHandler)(void* param, bool error);
+size_t STM32F4_Pwm_GetSequenceSampleSize(const TinyCLR_Pwm_Controller* self);
+TinyCLR_Result STM32F4_Pwm_EncodeSequence(const TinyCLR_Pwm_Controller* self, uint32_t firstChannel, uint32_t channelCount, const uint32_t* dutyCycles, size_t length, void* pattern);
+TinyCLR_Result STM32F4_Pwm_StartSequence(const TinyCLR_Pwm_Controller* self, uint32_t firstChannel, uint32_t channelCount, const void* pattern, size_t length, uint32_t repeatCount, STM32F4_Pwm_SequenceHandler handler, void* param);
+TinyCLR_Result STM32F4_Pwm_StopSequence(const TinyCLR_Pwm_Controller* self);
 double STM32F4_Pwm_GetMinFrequency(const TinyCLR_Pwm_Controller* self);
 double STM32F4_Pwm_GetMaxFrequency(const TinyCLR_Pwm_Controller* self);
 double STM32F4_Pwm_GetActualFrequency(const TinyCLR_Pwm_Controller* self);
 uint32_t STM32F4_Pwm_GetChannelCount(const TinyCLR_Pwm_Controller* self);
 void STM32F4_Pwm_Reset();
+bool STM32F4_PwmInternal_ReserveTimer(uint32_t timer);
+void STM32F4_PwmInternal_ReleaseTimer(uint32_t timer);
 
 ////////////////////////////////////////////////////////////////////////////////
 //RTC
@@ -233,6 +256,23 @@ TinyCLR_Result STM32F4_SdCard_SetPresenceChangedHandler(const TinyCLR_Storage_Co
 TinyCLR_Result STM32F4_SdCard_IsPresent(const TinyCLR_Storage_Controller* self, bool& present);
 TinyCLR_Result STM32F4_SdCard_Reset();
 
+#ifdef STM32F4_SD_BENCHMARK
+#define STM32F4_SD_BENCHMARK_RUNS 4
+#define STM32F4_SD_BENCHMARK_MAX_SECTORS 256
+#define STM32F4_SD_BENCHMARK_TIMEOUT 1000
+
+// KB/s per path, 0 where it failed or the device has no SD DMA stream
+struct STM32F4_SdCard_BenchmarkResult {
+    size_t Sectors;
+    uint32_t PolledRead;
+    uint32_t PolledWrite;
+    uint32_t DmaRead;
+    uint32_t DmaWrite;
+};
+
+TinyCLR_Result STM32F4_SdCard_Benchmark(const TinyCLR_Storage_Controller* self, uint64_t address, uint8_t* buffer, STM32F4_SdCard_BenchmarkResult* results);
+#endif
+
 ////////////////////////////////////////////////////////////////////////////////
 //SPI
 ////////////////////////////////////////////////////////////////////////////////
@@ -293,7 +333,7 @@ typedef void(*USB_NEXT_CALLBACK)(UsClientState*);
 void TinyCLR_UsbClient_ClearEvent(UsClientState *usClientState, uint32_t event);
 void TinyCLR_UsbClient_ClearEndpoints(UsClientState *usClientState, int32_t endpoint);
 USB_PACKET64* TinyCLR_UsbClient_RxEnqueue(UsClientState* usClientState, int32_t endpoint, bool& disableRx);
-USB_PACKET64* TinyCLR_UsbClient_TxDequeue(UsClientState* usClientState, int32_t endpoint);
+bool TinyCLR_UsbClient_TxGetPacket(UsClientState* usClientState, int32_t endpoint, const uint8_t*& data, uint32_t& size);
 void TinyCLR_UsbClient_StateCallback(UsClientState* usClientState);
 uint8_t TinyCLR_UsbClient_ControlCallback(UsClientState* usClientState);
 bool TinyCLR_UsbClient_CanReceivePackage(UsClientState* usClientState, int32_t endpoint);
@@ -325,6 +365,32 @@ public:
 bool STM32F4_InterruptInternal_Activate(uint32_t index, uint32_t* isr, void* isrParam);
 bool STM32F4_InterruptInternal_Deactivate(uint32_t index);
 
+////////////////////////////////////////////////////////////////////////////////
+//DMA Internal
+////////////////////////////////////////////////////////////////////////////////
+struct STM32F4_Dma_Stream {
+    uint8_t controller;
+    uint8_t stream;
+    uint8_t channel;
+};
+
+#define DMA_STREAM(controller, stream, channel) { controller, stream, channel }
+#define DMA_STREAM_NONE { 0, 0, 0 }
+
+typedef void(*STM32F4_Dma_Handler)(void* param, uint32_t flags);
+
+bool STM32F4_DmaInternal_OpenStream(const STM32F4_Dma_Stream& dma);
+bool STM32F4_DmaInternal_CloseStream(const STM32F4_Dma_Stream& dma);
+DMA_Stream_TypeDef* STM32F4_DmaInternal_GetStream(const STM32F4_Dma_Stream& dma);
+uint32_t STM32F4_DmaInternal_GetFlags(const STM32F4_Dma_Stream& dma);
+void STM32F4_DmaInternal_ClearFlags(const STM32F4_Dma_Stream& dma, uint32_t flags);
+void STM32F4_DmaInternal_Start(const STM32F4_Dma_Stream& dma, volatile void* peripheral, const void* memory, size_t count, uint32_t configuration, uint32_t fifoConfiguration = 0);
+void STM32F4_DmaInternal_Stop(const STM32F4_Dma_Stream& dma);
+bool STM32F4_DmaInternal_SetHandler(const STM32F4_Dma_Stream& dma, STM32F4_Dma_Handler handler, void* param);
+size_t STM32F4_DmaInternal_GetRemaining(const STM32F4_Dma_Stream& dma);
+bool STM32F4_DmaInternal_IsAccessible(const void* address);
+void STM32F4_Dma_Reset();
+
 ////////////////////////////////////////////////////////////////////////////////
 //GPIO Internal
 ////////////////////////////////////////////////////////////////////////////////
@@ -420,6 +486,25 @@ TinyCLR_Result STM32F4_Display_DrawBuffer(const TinyCLR_Display_Controller* self
 TinyCLR_Result STM32F4_Display_DrawPixel(const TinyCLR_Display_Controller* self, uint32_t x, uint32_t y, uint64_t color);
 TinyCLR_Result STM32F4_Display_WriteString(const TinyCLR_Display_Controller* self, const char* buffer, size_t length);
 
+// Source formats for the driver level drawing below, the values are the DMA2D color modes.
+enum class STM32F4_Display_SourceFormat : uint32_t {
+    Argb8888 = 0,
+    Rgb888 = 1,
+    Rgb565 = 2,
+};
+
+// Frame buffer operations beyond the display controller API. They go through the DMA2D where the part has one
+// and return before it is done; the source must stay untouched until STM32F4_Display_WaitForTransfer returns.
+TinyCLR_Result STM32F4_Display_DrawBufferEx(const TinyCLR_Display_Controller* self, uint32_t x, uint32_t y, uint32_t width, uint32_t height, const uint8_t* data, STM32F4_Display_SourceFormat format);
+TinyCLR_Result STM32F4_Display_BlendBuffer(const TinyCLR_Display_Controller* self, uint32_t x, uint32_t y, uint32_t width, uint32_t height, const uint8_t* data, STM32F4_Display_SourceFormat format, uint8_t alpha);
+TinyCLR_Result STM32F4_Display_FillRectangle(const TinyCLR_Display_Controller* self, uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint64_t color);
+void STM32F4_Display_WaitForTransfer();
+
+// Double buffering, outside the display controller API as well. Drawing goes to a back buffer and Present shows it
+// at the next vertical blanking; with copyForward what was drawn is carried over into the new back buffer.
+TinyCLR_Result STM32F4_Display_SetDoubleBuffering(const TinyCLR_Display_Controller* self, bool enable, bool copyForward);
+TinyCLR_Result STM32F4_Display_Present(const TinyCLR_Display_Controller* self);
+
 void STM32F4_Startup_OnSoftReset(const TinyCLR_Api_Manager* apiManager, const TinyCLR_Interop_Manager* interopManager);
 void STM32F4_Startup_OnSoftResetDevice(const TinyCLR_Api_Manager* apiManager, const TinyCLR_Interop_Manager* interopManager);
 
@@ -15,6 +15,7 @@
 #include <algorithm>
 #include <string.h>
 #include "STM32F4.h"
+#include "../../Drivers/RingBuffer/RingBuffer.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -22,6 +23,10 @@
 
 #define CAN_TRANSFER_TIMEOUT 0xFFFF
 
+#ifndef STM32F4_CAN_TX_BUFFER_DEFAULT_SIZE
+#define STM32F4_CAN_TX_BUFFER_DEFAULT_SIZE 32
+#endif
+
 #define CAN_Mode_Normal             ((uint8_t)0x00)  /*!< normal mode */
 #define CAN_Mode_LoopBack           ((uint8_t)0x01)  /*!< loopback mode */
 #define CAN_Mode_Silent             ((uint8_t)0x02)  /*!< silent mode */
@@ -68,6 +73,9 @@ an empty mailbox */
 #define CAN_Id_Standard             ((uint32_t)0x00000000)  /*!< Standard Id */
 #define CAN_Id_Extended             ((uint32_t)0x00000004)  /*!< Extended Id */
 
+#define CAN_RTR_Data                ((uint32_t)0x00000000)  /*!< Data frame */
+#define CAN_RTR_Remote              ((uint32_t)0x00000002)  /*!< Remote frame */
+
 
 /** @defgroup CAN_receive_FIFO_number_constants
   * @{
@@ -303,6 +311,7 @@ struct CanState {
     const TinyCLR_Can_Controller* provider;
 
     STM32F4_Can_Message *canRxMessagesFifo;
+    STM32F4_Can_TxMessage *canTxMessagesFifo;
 
     STM32F4_Can_InitTypeDef initTypeDef;
     STM32F4_Can_FilterInitTypeDef filterInitTypeDef;
@@ -310,9 +319,8 @@ struct CanState {
     TinyCLR_Can_ErrorReceivedHandler   errorEventHandler;
     TinyCLR_Can_MessageReceivedHandler    messageReceivedEventHandler;
 
-    int32_t can_rx_count;
-    int32_t can_rx_in;
-    int32_t can_rx_out;
+    RingBuffer<STM32F4_Can_Message> rxRing;
+    RingBuffer<STM32F4_Can_TxMessage> txRing;
 
     size_t can_rxBufferSize;
     size_t can_txBufferSize;
@@ -321,6 +329,8 @@ struct CanState {
 
     STM32F4_Can_Filter canDataFilter;
 
+    bool canFilterInHardware;
+
     uint16_t initializeCount;
 
     bool enable;
@@ -587,6 +597,146 @@ void CAN_FilterInit(STM32F4_Can_FilterInitTypeDef* CAN_FilterInitStruct) {
     CAN1->FMR &= ~FMR_FINIT;
 }
 
+#define CAN_FILTER_BANKS_PER_CONTROLLER 14 // CAN2SB left at its reset value, CAN2 owns banks 14 to 27
+
+#define CAN_STD_ID_MASK 0x7FF
+#define CAN_EXT_ID_MASK 0x1FFFFFFF
+
+struct CanFilterSlot {
+    uint32_t id;
+    uint32_t mask;
+};
+
+// Splits [lower, upper] into id/mask pairs that each cover one aligned power of two block.
+static bool CAN_AddFilterRange(CanFilterSlot* slots, size_t& count, size_t maxCount, uint32_t lower, uint32_t upper, uint32_t idMask) {
+    if (upper > idMask)
+        upper = idMask;
+
+    while (lower <= upper) {
+        uint32_t size = 1;
+
+        while ((lower & ((size << 1) - 1)) == 0 && ((size << 1) - 1) <= (upper - lower) && (size << 1) <= (idMask + 1))
+            size <<= 1;
+
+        if (count == maxCount)
+            return false;
+
+        slots[count].id = lower;
+        slots[count].mask = idMask & ~(size - 1);
+        count++;
+
+        lower += size;
+    }
+
+    return true;
+}
+
+// Standard frames use 16 bit mask filters, two per bank, extended frames use one 32 bit mask filter per bank.
+// A filter id below 0x800 can arrive in either frame format so it is placed in both.
+static bool CAN_CompileFilters(const STM32F4_Can_Filter& filter, CanFilterSlot* std, size_t& stdCount, CanFilterSlot* ext, size_t& extCount) {
+    const size_t maxStd = CAN_FILTER_BANKS_PER_CONTROLLER * 2;
+    const size_t maxExt = CAN_FILTER_BANKS_PER_CONTROLLER;
+
+    stdCount = extCount = 0;
+
+    for (auto i = 0; i < filter.matchFiltersSize; i++) {
+        auto id = filter.matchFilters[i];
+
+        if (id <= CAN_STD_ID_MASK && !CAN_AddFilterRange(std, stdCount, maxStd, id, id, CAN_STD_ID_MASK))
+            return false;
+
+        if (!CAN_AddFilterRange(ext, extCount, maxExt, id, id, CAN_EXT_ID_MASK))
+            return false;
+    }
+
+    for (auto i = 0; i < filter.groupFiltersSize; i++) {
+        auto lower = filter.lowerBoundFilters[i];
+        auto upper = filter.upperBoundFilters[i];
+
+        if (lower <= CAN_STD_ID_MASK && !CAN_AddFilterRange(std, stdCount, maxStd, lower, upper, CAN_STD_ID_MASK))
+            return false;
+
+        if (!CAN_AddFilterRange(ext, extCount, maxExt, lower, upper, CAN_EXT_ID_MASK))
+            return false;
+    }
+
+    return ((stdCount + 1) / 2) + extCount <= CAN_FILTER_BANKS_PER_CONTROLLER;
+}
+
+// Loads the controller's filter banks from the explicit and group filters. When they do not fit, a single
+// accept all bank is used and the receive interrupt falls back to the software search.
+void CAN_ProgramFilters(int32_t controllerIndex) {
+    auto state = &canStates[controllerIndex];
+    auto& init = state->filterInitTypeDef;
+
+    CanFilterSlot std[CAN_FILTER_BANKS_PER_CONTROLLER * 2];
+    CanFilterSlot ext[CAN_FILTER_BANKS_PER_CONTROLLER * 2];
+    size_t stdCount, extCount;
+
+    auto firstBank = (controllerIndex == 0 ? 0 : CAN_FILTER_BANKS_PER_CONTROLLER);
+    auto bank = firstBank;
+
+    auto hasFilters = state->canDataFilter.matchFiltersSize > 0 || state->canDataFilter.groupFiltersSize > 0;
+    auto inHardware = hasFilters && CAN_CompileFilters(state->canDataFilter, std, stdCount, ext, extCount);
+
+    init.CAN_FilterFIFOAssignment = CAN_Filter_FIFO0;
+    init.CAN_FilterActivation = ENABLE;
+    init.CAN_FilterMode = CAN_FilterMode_IdMask;
+
+    if (!inHardware) {
+        init.CAN_FilterNumber = bank++;
+        init.CAN_FilterScale = CAN_FilterScale_32bit;
+        init.CAN_FilterIdHigh = 0x0000;
+        init.CAN_FilterIdLow = 0x0000;
+        init.CAN_FilterMaskIdHigh = 0x0000;
+        init.CAN_FilterMaskIdLow = 0x0000;
+
+        CAN_FilterInit(&init);
+    }
+    else {
+        init.CAN_FilterScale = CAN_FilterScale_16bit;
+
+        for (auto i = 0; i < stdCount; i += 2) {
+            auto& second = std[(i + 1 < stdCount) ? i + 1 : i];
+
+            // STID[15:5] RTR[4] IDE[3], IDE masked in so only standard frames match
+            init.CAN_FilterNumber = bank++;
+            init.CAN_FilterIdLow = std[i].id << 5;
+            init.CAN_FilterMaskIdLow = (std[i].mask << 5) | 0x08;
+            init.CAN_FilterIdHigh = second.id << 5;
+            init.CAN_FilterMaskIdHigh = (second.mask << 5) | 0x08;
+
+            CAN_FilterInit(&init);
+        }
+
+        init.CAN_FilterScale = CAN_FilterScale_32bit;
+
+        for (auto i = 0; i < extCount; i++) {
+            // EXID[31:3] IDE[2] RTR[1], IDE set and masked in so only extended frames match
+            auto id = (ext[i].id << 3) | CAN_Id_Extended;
+            auto mask = (ext[i].mask << 3) | CAN_Id_Extended;
+
+            init.CAN_FilterNumber = bank++;
+            init.CAN_FilterIdHigh = id >> 16;
+            init.CAN_FilterIdLow = id & 0xFFFF;
+            init.CAN_FilterMaskIdHigh = mask >> 16;
+            init.CAN_FilterMaskIdLow = mask & 0xFFFF;
+
+            CAN_FilterInit(&init);
+        }
+    }
+
+    init.CAN_FilterActivation = DISABLE;
+
+    while (bank < firstBank + CAN_FILTER_BANKS_PER_CONTROLLER) {
+        init.CAN_FilterNumber = bank++;
+
+        CAN_FilterInit(&init);
+    }
+
+    state->canFilterInHardware = inHardware;
+}
+
 /**
   * @brief  Receives a correct CAN frame.
   * @param  CANx: where x can be 1 or 2 to select the CAN peripheral.
@@ -1102,15 +1252,76 @@ TinyCLR_Result STM32F4_Can_SetReadBufferSize(const TinyCLR_Can_Controller* self,
 }
 
 size_t STM32F4_Can_GetWriteBufferSize(const TinyCLR_Can_Controller* self) {
-    return 1;
+    auto state = reinterpret_cast<CanState*>(self->ApiInfo->State);
+
+    return state->can_txBufferSize == 0 ? STM32F4_CAN_TX_BUFFER_DEFAULT_SIZE : state->can_txBufferSize;
 }
 
 TinyCLR_Result STM32F4_Can_SetWriteBufferSize(const TinyCLR_Can_Controller* self, size_t size) {
     auto state = reinterpret_cast<CanState*>(self->ApiInfo->State);
 
-    state->can_txBufferSize = 1;
+    if (size == 0)
+        return TinyCLR_Result::ArgumentInvalid;
+
+    // SetBitTiming allocates the queue from this size, one already allocated is replaced and what it held is dropped.
+    // The old queue stays in use if the new one can't be allocated.
+    if (state->canTxMessagesFifo != nullptr) {
+        auto memoryProvider = (const TinyCLR_Memory_Manager*)apiManager->FindDefault(apiManager, TinyCLR_Api_Type::MemoryManager);
+        auto capacity = RingBuffer<STM32F4_Can_TxMessage>::GetCapacityFor(size);
+        auto fifo = (STM32F4_Can_TxMessage*)memoryProvider->Allocate(memoryProvider, capacity * sizeof(STM32F4_Can_TxMessage));
+
+        if (fifo == nullptr)
+            return TinyCLR_Result::OutOfMemory;
+
+        auto old = state->canTxMessagesFifo;
+
+        {
+            DISABLE_INTERRUPTS_SCOPED(irq);
+
+            state->txRing.Uninitialize();
+            state->txRing.Initialize(fifo, capacity);
+            state->canTxMessagesFifo = fifo;
+        }
+
+        memoryProvider->Free(memoryProvider, old);
+    }
 
-    return size == 1 ? TinyCLR_Result::Success : TinyCLR_Result::NotSupported;
+    state->can_txBufferSize = size;
+
+    return TinyCLR_Result::Success;
+}
+
+// Moves queued messages into every free mailbox, the TX interrupt stays on while anything is left queued.
+// Caller holds interrupts disabled.
+void STM32F4_Can_FillMailboxes(int32_t controllerIndex) {
+    auto state = &canStates[controllerIndex];
+
+    CAN_TypeDef* CANx = ((controllerIndex == 0) ? CAN1 : CAN2);
+
+    STM32F4_Can_TxMessage* txMessage;
+
+    while ((txMessage = state->txRing.Peek()) != nullptr) {
+        if (CAN_Transmit(CANx, txMessage) == CAN_TxStatus_NoMailBox)
+            break;
+
+        state->txRing.Consume(1);
+    }
+
+    if (!state->txRing.IsEmpty())
+        CANx->IER |= CAN_IT_TME;
+    else
+        CANx->IER &= ~CAN_IT_TME;
+}
+
+void STM32F4_Can_TxInterruptHandler(int32_t controllerIndex) {
+    DISABLE_INTERRUPTS_SCOPED(irq);
+
+    CAN_TypeDef* CANx = ((controllerIndex == 0) ? CAN1 : CAN2);
+
+    CANx->TSR = CAN_TSR_RQCP0 | CAN_TSR_RQCP1 | CAN_TSR_RQCP2;
+
+    if (canStates[controllerIndex].canTxMessagesFifo != nullptr)
+        STM32F4_Can_FillMailboxes(controllerIndex);
 }
 
 void STM32_Can_RxInterruptHandler(int32_t controllerIndex) {
@@ -1153,8 +1364,8 @@ void STM32_Can_RxInterruptHandler(int32_t controllerIndex) {
 
     rtrmode = (((rxMessage.RTR) & 0x02) != 0) ? true : false;
 
-    // Filter
-    if (state->canDataFilter.groupFiltersSize || state->canDataFilter.matchFiltersSize) {
+    // Filter, only needed when the filter banks could not hold every filter
+    if (!state->canFilterInHardware && (state->canDataFilter.groupFiltersSize || state->canDataFilter.matchFiltersSize)) {
         if (state->canDataFilter.groupFiltersSize) {
             if (BinarySearch2(state->canDataFilter.lowerBoundFilters, state->canDataFilter.upperBoundFilters, 0, state->canDataFilter.groupFiltersSize - 1, msgid) >= 0)
                 passed = 1;
@@ -1170,12 +1381,14 @@ void STM32_Can_RxInterruptHandler(int32_t controllerIndex) {
         }
     }
 
-    if (state->can_rx_count > state->can_rxBufferSize - 3) {
+    size_t available;
+
+    STM32F4_Can_Message *can_msg = state->rxRing.GetWriteSpan(available);
+
+    if (can_msg == nullptr || state->rxRing.GetCount() > state->can_rxBufferSize - 3) {
         return;
     }
 
-    STM32F4_Can_Message *can_msg = &state->canRxMessagesFifo[state->can_rx_in];
-
     uint64_t t = STM32F4_Time_GetCurrentProcessorTime();
 
     can_msg->TimeStampL = t & 0xFFFFFFFF;
@@ -1194,24 +1407,21 @@ void STM32_Can_RxInterruptHandler(int32_t controllerIndex) {
 
     can_msg->length = len;
 
-    state->can_rx_count++;
-    state->can_rx_in++;
-
-    if (state->can_rx_in == state->can_rxBufferSize) {
-        state->can_rx_in = 0;
-    }
+    state->rxRing.Commit(1);
 
-    state->messageReceivedEventHandler(state->provider, state->can_rx_count, t);
+    state->messageReceivedEventHandler(state->provider, state->rxRing.GetCount(), t);
 
     return;
 }
 
 void STM32F4_Can_TxInterruptHandler0(void *param) {
     CAN_ErrorHandler(0);
+    STM32F4_Can_TxInterruptHandler(0);
 }
 
 void STM32F4_Can_TxInterruptHandler1(void *param) {
     CAN_ErrorHandler(1);
+    STM32F4_Can_TxInterruptHandler(1);
 }
 
 void STM32F4_Can_RxInterruptHandler0(void *param) {
@@ -1241,15 +1451,20 @@ TinyCLR_Result STM32F4_Can_Acquire(const TinyCLR_Can_Controller* self) {
         STM32F4_GpioInternal_ConfigurePin(canTxPins[controllerIndex].number, STM32F4_Gpio_PortMode::AlternateFunction, STM32F4_Gpio_OutputType::PushPull, STM32F4_Gpio_OutputSpeed::High, STM32F4_Gpio_PullDirection::PullUp, canTxPins[controllerIndex].alternateFunction);
         STM32F4_GpioInternal_ConfigurePin(canRxPins[controllerIndex].number, STM32F4_Gpio_PortMode::AlternateFunction, STM32F4_Gpio_OutputType::PushPull, STM32F4_Gpio_OutputSpeed::High, STM32F4_Gpio_PullDirection::PullUp, canRxPins[controllerIndex].alternateFunction);
 
-        state->can_rx_count = 0;
-        state->can_rx_in = 0;
-        state->can_rx_out = 0;
+        state->rxRing.Uninitialize();
+        state->txRing.Uninitialize();
         state->baudrate = 0;
         state->can_rxBufferSize = canDefaultBuffersSize[controllerIndex];
+        state->can_txBufferSize = STM32F4_CAN_TX_BUFFER_DEFAULT_SIZE;
         state->provider = self;
         state->enable = false;
 
         state->canRxMessagesFifo = nullptr;
+        state->canTxMessagesFifo = nullptr;
+
+        state->canDataFilter.matchFiltersSize = 0;
+        state->canDataFilter.groupFiltersSize = 0;
+        state->canFilterInHardware = false;
     }
 
     state->initializeCount++;
@@ -1274,12 +1489,37 @@ TinyCLR_Result STM32F4_Can_Release(const TinyCLR_Can_Controller* self) {
 
         RCC->APB1ENR &= ((controllerIndex == 0) ? ~RCC_APB1ENR_CAN1EN : ~RCC_APB1ENR_CAN2EN);
 
+        state->rxRing.Uninitialize();
+        state->txRing.Uninitialize();
+
         if (state->canRxMessagesFifo != nullptr) {
             memoryProvider->Free(memoryProvider, state->canRxMessagesFifo);
 
             state->canRxMessagesFifo = nullptr;
         }
 
+        if (state->canTxMessagesFifo != nullptr) {
+            memoryProvider->Free(memoryProvider, state->canTxMessagesFifo);
+
+            state->canTxMessagesFifo = nullptr;
+        }
+
+        state->canDataFilter.matchFiltersSize = 0;
+        state->canDataFilter.groupFiltersSize = 0;
+
+        if (state->canDataFilter.matchFilters != nullptr)
+            memoryProvider->Free(memoryProvider, state->canDataFilter.matchFilters);
+
+        if (state->canDataFilter.lowerBoundFilters != nullptr)
+            memoryProvider->Free(memoryProvider, state->canDataFilter.lowerBoundFilters);
+
+        if (state->canDataFilter.upperBoundFilters != nullptr)
+            memoryProvider->Free(memoryProvider, state->canDataFilter.upperBoundFilters);
+
+        state->canDataFilter.matchFilters = nullptr;
+        state->canDataFilter.lowerBoundFilters = nullptr;
+        state->canDataFilter.upperBoundFilters = nullptr;
+
         STM32F4_GpioInternal_ClosePin(canTxPins[controllerIndex].number);
         STM32F4_GpioInternal_ClosePin(canRxPins[controllerIndex].number);
     }
@@ -1294,9 +1534,13 @@ TinyCLR_Result STM32F4_Can_SoftReset(const TinyCLR_Can_Controller* self) {
 
     CAN_TypeDef* CANx = ((controllerIndex == 0) ? CAN1 : CAN2);
 
-    state->can_rx_count = 0;
-    state->can_rx_in = 0;
-    state->can_rx_out = 0;
+    state->rxRing.Discard();
+
+    {
+        DISABLE_INTERRUPTS_SCOPED(irq);
+
+        state->txRing.Discard();
+    }
 
     RCC->APB1RSTR |= ((controllerIndex == 0) ? RCC_APB1ENR_CAN1EN : RCC_APB1ENR_CAN2EN);
 
@@ -1308,7 +1552,7 @@ TinyCLR_Result STM32F4_Can_SoftReset(const TinyCLR_Can_Controller* self) {
 
     CAN_Initialize(CANx, &state->initTypeDef);
 
-    CAN_FilterInit(&state->filterInitTypeDef);
+    CAN_ProgramFilters(controllerIndex);
 
     CANx->IER |= (CAN_IT_FMP0 | CAN_IT_FF0 | CAN_IT_FOV0 | CAN_IT_EWG | CAN_IT_EPV | CAN_IT_BOF | CAN_IT_LEC | CAN_IT_ERR);
 
@@ -1316,105 +1560,88 @@ TinyCLR_Result STM32F4_Can_SoftReset(const TinyCLR_Can_Controller* self) {
 }
 
 TinyCLR_Result STM32F4_Can_WriteMessage(const TinyCLR_Can_Controller* self, const TinyCLR_Can_Message* messages, size_t& len) {
-    if (len != 1) return TinyCLR_Result::NotSupported;
+    auto state = reinterpret_cast<CanState*>(self->ApiInfo->State);
 
-    auto& m = messages[0];
-    uint32_t arbitrationId = m.ArbitrationId;
-    bool isExtendedId = m.IsExtendedId;
-    bool isRemoteTransmissionRequest = m.IsRemoteTransmissionRequest;
-    const uint8_t* data = m.Data;
-    size_t length = m.Length;
+    if (state->canTxMessagesFifo == nullptr) {
+        len = 0;
 
-    auto state = reinterpret_cast<CanState*>(self->ApiInfo->State);
+        return TinyCLR_Result::InvalidOperation;
+    }
 
-    int32_t controllerIndex = state->controllerIndex;
+    size_t count = 0;
+    size_t available;
+    STM32F4_Can_TxMessage* txMessages;
 
-    uint32_t* data32 = (uint32_t*)data;
+    // the queue is only filled from here, the mailboxes can keep draining it while messages are converted
+    while (count < len && (txMessages = state->txRing.GetWriteSpan(available)) != nullptr) {
+        auto converted = std::min(available, len - count);
 
-    CAN_TypeDef* CANx = ((controllerIndex == 0) ? CAN1 : CAN2);
+        for (size_t n = 0; n < converted; n++) {
+            auto& m = messages[count++];
+            auto& txMessage = txMessages[n];
 
-    uint32_t i = 0;
+            /* Transmit Structure preparation */
+            txMessage.RTR = m.IsRemoteTransmissionRequest ? CAN_RTR_Remote : CAN_RTR_Data;
 
-    uint8_t txmailbox;
+            if (m.IsExtendedId) {
+                txMessage.IDE = CAN_Id_Extended;
+                txMessage.ExtId = m.ArbitrationId;
+            }
+            else {
+                txMessage.IDE = CAN_Id_Standard;
+                txMessage.StdId = m.ArbitrationId;
+            }
 
-    STM32F4_Can_TxMessage txMessage;
+            txMessage.DLC = m.Length & 0x0F;
 
-    /* Transmit Structure preparation */
-    txMessage.RTR = (isRemoteTransmissionRequest == true) ? 1 : 0;
+            for (auto i = 0; i < 8; i++)
+                txMessage.Data[i] = m.Data[i];
+        }
 
-    if (isExtendedId) {
-        txMessage.IDE = CAN_Id_Extended;
-        txMessage.ExtId = arbitrationId;
+        state->txRing.Commit(converted);
     }
-    else {
-        txMessage.IDE = CAN_Id_Standard;
-        txMessage.StdId = arbitrationId;
-    }
-    txMessage.DLC = length & 0x0F;
-
-    txMessage.Data[0] = ((data32[0] >> 0) & 0xFF);
-    txMessage.Data[1] = ((data32[0] >> 8) & 0xFF);
-    txMessage.Data[2] = ((data32[0] >> 16) & 0xFF);
-    txMessage.Data[3] = ((data32[0] >> 24) & 0xFF);
-    txMessage.Data[4] = ((data32[1] >> 0) & 0xFF);
-    txMessage.Data[5] = ((data32[1] >> 8) & 0xFF);
-    txMessage.Data[6] = ((data32[1] >> 16) & 0xFF);
-    txMessage.Data[7] = ((data32[1] >> 24) & 0xFF);
 
-    txmailbox = CAN_Transmit(CANx, &txMessage);
+    {
+        DISABLE_INTERRUPTS_SCOPED(irq);
 
-    while (CAN_TransmitStatus(CANx, txmailbox) != CAN_TxStatus_Ok && i++ < CAN_GetTransferTimeout())
-        STM32F4_Time_Delay(nullptr, 1);
+        STM32F4_Can_FillMailboxes(state->controllerIndex);
+    }
 
-    if (txmailbox == CAN_TxStatus_NoMailBox || i == CAN_GetTransferTimeout()) {
+    auto result = (count == 0 && len > 0) ? TinyCLR_Result::Busy : TinyCLR_Result::Success;
 
-        CAN_CancelTransmit(CANx, txmailbox);
-        CAN_ErrorHandler(controllerIndex);
-        return TinyCLR_Result::InvalidOperation;
-    }
+    len = count;
 
-    return TinyCLR_Result::Success;
+    return result;
 }
 
 TinyCLR_Result STM32F4_Can_ReadMessage(const TinyCLR_Can_Controller* self, TinyCLR_Can_Message* messages, size_t& len) {
-    if (len != 1) return TinyCLR_Result::NotSupported;
-
-    auto& m = messages[0];
-    uint32_t& arbitrationId = m.ArbitrationId;
-    bool& isExtendedId = m.IsExtendedId;
-    bool& isRemoteTransmissionRequest = m.IsRemoteTransmissionRequest;
-    uint8_t* data = m.Data;
-    size_t& length = m.Length;
-    uint64_t& timestamp = m.Timestamp;
-
     auto state = reinterpret_cast<CanState*>(self->ApiInfo->State);
 
     STM32F4_Can_Message *can_msg;
 
-    uint32_t* data32 = (uint32_t*)data;
-
-    if (state->can_rx_count) {
-        DISABLE_INTERRUPTS_SCOPED(irq);
+    size_t count = 0;
 
-        can_msg = &state->canRxMessagesFifo[state->can_rx_out];
-        state->can_rx_out++;
+    // the interrupt handler only moves the head, messages are copied out without holding it off
+    while (count < len && (can_msg = state->rxRing.Peek()) != nullptr) {
+        auto& m = messages[count++];
 
-        if (state->can_rx_out == state->can_rxBufferSize)
-            state->can_rx_out = 0;
+        uint32_t* data32 = (uint32_t*)m.Data;
 
-        state->can_rx_count--;
-
-        arbitrationId = can_msg->MsgID;
-        isExtendedId = can_msg->extendedId;
-        isRemoteTransmissionRequest = can_msg->remoteTransmissionRequest;
-        length = can_msg->length;
+        m.ArbitrationId = can_msg->MsgID;
+        m.IsExtendedId = can_msg->extendedId;
+        m.IsRemoteTransmissionRequest = can_msg->remoteTransmissionRequest;
+        m.Length = can_msg->length;
 
         data32[0] = can_msg->DataA;
         data32[1] = can_msg->DataB;
 
-        timestamp = ((uint64_t)can_msg->TimeStampL) | ((uint64_t)can_msg->TimeStampH << 32);
+        m.Timestamp = ((uint64_t)can_msg->TimeStampL) | ((uint64_t)can_msg->TimeStampH << 32);
+
+        state->rxRing.Consume(1);
     }
 
+    len = count;
+
     return TinyCLR_Result::Success;
 }
 
@@ -1433,13 +1660,30 @@ TinyCLR_Result STM32F4_Can_SetBitTiming(const TinyCLR_Can_Controller* self, cons
 
     CAN_TypeDef* CANx = ((controllerIndex == 0) ? CAN1 : CAN2);
 
-    if (state->canRxMessagesFifo == nullptr)
-        state->canRxMessagesFifo = (STM32F4_Can_Message*)memoryProvider->Allocate(memoryProvider, state->can_rxBufferSize * sizeof(STM32F4_Can_Message));
-
     if (state->canRxMessagesFifo == nullptr) {
-        return TinyCLR_Result::OutOfMemory;
+        auto capacity = RingBuffer<STM32F4_Can_Message>::GetCapacityFor(state->can_rxBufferSize);
+
+        state->canRxMessagesFifo = (STM32F4_Can_Message*)memoryProvider->Allocate(memoryProvider, capacity * sizeof(STM32F4_Can_Message));
+
+        if (state->canRxMessagesFifo == nullptr) {
+            return TinyCLR_Result::OutOfMemory;
+        }
+
+        state->rxRing.Initialize(state->canRxMessagesFifo, capacity);
+    }
+
+    if (state->canTxMessagesFifo == nullptr) {
+        auto capacity = RingBuffer<STM32F4_Can_TxMessage>::GetCapacityFor(state->can_txBufferSize);
+
+        state->canTxMessagesFifo = (STM32F4_Can_TxMessage*)memoryProvider->Allocate(memoryProvider, capacity * sizeof(STM32F4_Can_TxMessage));
+
+        if (state->canTxMessagesFifo == nullptr) {
+            return TinyCLR_Result::OutOfMemory;
+        }
     }
 
+    state->txRing.Initialize(state->canTxMessagesFifo, state->txRing.GetCapacityFor(state->can_txBufferSize));
+
     RCC->APB1RSTR |= ((controllerIndex == 0) ? RCC_APB1ENR_CAN1EN : RCC_APB1ENR_CAN2EN);
 
     STM32F4_Time_Delay(nullptr, 1000);
@@ -1455,7 +1699,7 @@ TinyCLR_Result STM32F4_Can_SetBitTiming(const TinyCLR_Can_Controller* self, cons
     state->initTypeDef.CAN_AWUM = DISABLE;
     state->initTypeDef.CAN_NART = DISABLE;
     state->initTypeDef.CAN_RFLM = DISABLE;
-    state->initTypeDef.CAN_TXFP = DISABLE;
+    state->initTypeDef.CAN_TXFP = ENABLE; // mailboxes go out in request order so queued messages keep their order
     state->initTypeDef.CAN_Mode = CAN_Mode_Normal;
 
     state->initTypeDef.CAN_SJW = ((state->baudrate >> 24) & 0x03);
@@ -1465,18 +1709,7 @@ TinyCLR_Result STM32F4_Can_SetBitTiming(const TinyCLR_Can_Controller* self, cons
 
     CAN_Initialize(CANx, &state->initTypeDef);
 
-    state->filterInitTypeDef.CAN_FilterNumber = (controllerIndex == 0 ? 0 : 14);
-
-    state->filterInitTypeDef.CAN_FilterMode = CAN_FilterMode_IdMask;
-    state->filterInitTypeDef.CAN_FilterScale = CAN_FilterScale_32bit;
-    state->filterInitTypeDef.CAN_FilterIdHigh = 0x0000;
-    state->filterInitTypeDef.CAN_FilterIdLow = 0x0000;
-    state->filterInitTypeDef.CAN_FilterMaskIdHigh = 0x0000;
-    state->filterInitTypeDef.CAN_FilterMaskIdLow = 0x0000;
-    state->filterInitTypeDef.CAN_FilterFIFOAssignment = 0;
-    state->filterInitTypeDef.CAN_FilterActivation = ENABLE;
-
-    CAN_FilterInit(&state->filterInitTypeDef);
+    CAN_ProgramFilters(controllerIndex);
 
     if (controllerIndex == 0) {
         STM32F4_InterruptInternal_Activate(CAN1_TX_IRQn, (uint32_t*)&STM32F4_Can_TxInterruptHandler0, 0);
@@ -1495,7 +1728,7 @@ TinyCLR_Result STM32F4_Can_SetBitTiming(const TinyCLR_Can_Controller* self, cons
 size_t STM32F4_Can_GetMessagesToRead(const TinyCLR_Can_Controller* self) {
     auto state = reinterpret_cast<CanState*>(self->ApiInfo->State);
 
-    return state->can_rx_count;
+    return state->rxRing.GetCount();
 }
 
 TinyCLR_Result STM32F4_Can_SetMessageReceivedHandler(const TinyCLR_Can_Controller* self, TinyCLR_Can_MessageReceivedHandler handler) {
@@ -1530,16 +1763,23 @@ TinyCLR_Result STM32F4_Can_SetExplicitFilters(const TinyCLR_Can_Controller* self
 
     std::sort(_matchFilters, _matchFilters + count);
 
+    uint32_t* oldMatchFilters;
+
     {
         DISABLE_INTERRUPTS_SCOPED(irq);
 
-        auto state = reinterpret_cast<CanState*>(self->ApiInfo->State);
-
+        oldMatchFilters = state->canDataFilter.matchFilters;
 
         state->canDataFilter.matchFiltersSize = count;
         state->canDataFilter.matchFilters = _matchFilters;
+
+        if (state->baudrate != 0)
+            CAN_ProgramFilters(state->controllerIndex);
     }
 
+    if (oldMatchFilters != nullptr)
+        memoryProvider->Free(memoryProvider, oldMatchFilters);
+
     return TinyCLR_Result::Success;
 }
 
@@ -1572,25 +1812,36 @@ TinyCLR_Result STM32F4_Can_SetGroupFilters(const TinyCLR_Can_Controller* self, c
         return TinyCLR_Result::ArgumentInvalid;
     }
 
+    uint32_t* oldLowerBoundFilters;
+    uint32_t* oldUpperBoundFilters;
+
     {
         DISABLE_INTERRUPTS_SCOPED(irq);
 
-        auto state = reinterpret_cast<CanState*>(self->ApiInfo->State);
+        oldLowerBoundFilters = state->canDataFilter.lowerBoundFilters;
+        oldUpperBoundFilters = state->canDataFilter.upperBoundFilters;
 
         state->canDataFilter.groupFiltersSize = count;
         state->canDataFilter.lowerBoundFilters = _lowerBoundFilters;
         state->canDataFilter.upperBoundFilters = _upperBoundFilters;
+
+        if (state->baudrate != 0)
+            CAN_ProgramFilters(state->controllerIndex);
     }
 
+    if (oldLowerBoundFilters != nullptr)
+        memoryProvider->Free(memoryProvider, oldLowerBoundFilters);
+
+    if (oldUpperBoundFilters != nullptr)
+        memoryProvider->Free(memoryProvider, oldUpperBoundFilters);
+
     return TinyCLR_Result::Success;
 }
 
 TinyCLR_Result STM32F4_Can_ClearReadBuffer(const TinyCLR_Can_Controller* self) {
     auto state = reinterpret_cast<CanState*>(self->ApiInfo->State);
 
-    state->can_rx_count = 0;
-    state->can_rx_in = 0;
-    state->can_rx_out = 0;
+    state->rxRing.Discard();
 
     return TinyCLR_Result::Success;
 }
@@ -1606,6 +1857,8 @@ TinyCLR_Result STM32F4_Can_IsWritingAllowed(const TinyCLR_Can_Controller* self,
 
     if ((CANx->TSR&CAN_TSR_TME0) == CAN_TSR_TME0 || (CANx->TSR&CAN_TSR_TME1) == CAN_TSR_TME1 || (CANx->TSR&CAN_TSR_TME2) == CAN_TSR_TME2) allowed = true;
 
+    if (!state->txRing.IsFull()) allowed = true;
+
     return TinyCLR_Result::Success;
 }
 
@@ -1636,6 +1889,12 @@ uint32_t STM32F4_Can_GetSourceClock(const TinyCLR_Can_Controller* self) {
 void STM32F4_Can_Reset() {
     for (int i = 0; i < TOTAL_CAN_CONTROLLERS; i++) {
         canStates[i].canRxMessagesFifo = nullptr;
+        canStates[i].canTxMessagesFifo = nullptr;
+        canStates[i].rxRing.Uninitialize();
+        canStates[i].txRing.Uninitialize();
+        canStates[i].canDataFilter.matchFilters = nullptr;
+        canStates[i].canDataFilter.lowerBoundFilters = nullptr;
+        canStates[i].canDataFilter.upperBoundFilters = nullptr;
 
         STM32F4_Can_Release(&canControllers[i]);
 
@@ -15,6 +15,7 @@
 // limitations under the License.
 
 #include "STM32F4.h"
+#include "../../Drivers/DeploymentIndex/DeploymentIndex.h"
 #include <stdio.h>
 
 #define TOTAL_DEPLOYMENT_CONTROLLERS 1
@@ -30,6 +31,21 @@
 #error Flash programming not allowed for HCLK below 1MHz
 #endif
 
+// Program with the widest parallelism the supply allows. x64 also needs the external VPP supply, a device that has
+// one defines STM32F4_FLASH_VPP.
+#if defined(STM32F4_FLASH_VPP)
+#define STM32F4_FLASH_PROGRAM_SIZE 8
+#elif STM32F4_SUPPLY_VOLTAGE_MV >= 2700
+#define STM32F4_FLASH_PROGRAM_SIZE 4
+#else
+#define STM32F4_FLASH_PROGRAM_SIZE 2
+#endif
+
+// Writes compare a line against the flash first and skip it when it already holds the data.
+#define STM32F4_FLASH_LINE_SIZE 32
+
+#define STM32F4_FLASH_SR_ERRORS (FLASH_SR_WRPERR | FLASH_SR_PGAERR | FLASH_SR_PGPERR | FLASH_SR_PGSERR)
+
 static const uint32_t STM32F4_FLASH_KEY1 = 0x45670123;
 static const uint32_t STM32F4_FLASH_KEY2 = 0xcdef89ab;
 
@@ -55,6 +71,12 @@ struct DeploymentState {
     TinyCLR_Storage_Descriptor storageDescriptor;
     TinyCLR_Startup_DeploymentConfiguration deploymentConfiguration;
 
+    // sectors known to be erased and sectors whose state is known, both filled in as they are checked or changed
+    uint32_t erasedSectors[(SIZEOF_ARRAY(deploymentSectors) + 31) / 32];
+    uint32_t knownSectors[(SIZEOF_ARRAY(deploymentSectors) + 31) / 32];
+
+    DeploymentIndex<SIZEOF_ARRAY(deploymentSectors)> index;
+
     bool isOpened = false;
     bool tableInitialized = false;
 };
@@ -95,6 +117,11 @@ void STM32F4_Flash_EnsureTableInitialized() {
 
         deploymentStates[i].tableInitialized = true;
 
+        memset(deploymentStates[i].erasedSectors, 0, sizeof(deploymentStates[i].erasedSectors));
+        memset(deploymentStates[i].knownSectors, 0, sizeof(deploymentStates[i].knownSectors));
+
+        deploymentStates[i].index.Reset();
+
         for (auto ii = 0; ii < deploymentStates[i].regionCount; ii++) {
             deploymentStates[i].regionAddresses[ii] = deploymentSectors[ii].address;
             deploymentStates[i].regionSizes[ii] = deploymentSectors[ii].size;
@@ -139,6 +166,71 @@ TinyCLR_Result __section("SectionForFlashOperations") STM32F4_Flash_Read(const T
     return TinyCLR_Result::Success;
 }
 
+static void STM32F4_Flash_SetSectorState(const TinyCLR_Storage_Controller* self, uint32_t sector, bool known, bool erased) {
+    auto state = reinterpret_cast<DeploymentState*>(self->ApiInfo->State);
+    auto mask = 1UL << (sector % 32);
+
+    state->knownSectors[sector / 32] = known ? (state->knownSectors[sector / 32] | mask) : (state->knownSectors[sector / 32] & ~mask);
+    state->erasedSectors[sector / 32] = erased ? (state->erasedSectors[sector / 32] | mask) : (state->erasedSectors[sector / 32] & ~mask);
+}
+
+static bool __section("SectionForFlashOperations") STM32F4_Flash_Equals(uint32_t address, const uint8_t* data, uint32_t length) {
+    auto flash = reinterpret_cast<const uint8_t*>(address);
+
+    for (; length >= 4; length -= 4, flash += 4, data += 4)
+        if (*reinterpret_cast<const uint32_t*>(flash) != *reinterpret_cast<const uint32_t*>(data))
+            return false;
+
+    for (; length > 0; length--)
+        if (*flash++ != *data++)
+            return false;
+
+    return true;
+}
+
+// Programs size (1, 2, 4 or 8) bytes with the parallelism matching the access and waits for it to finish.
+static bool __section("SectionForFlashOperations") STM32F4_Flash_ProgramUnit(uint32_t address, const uint8_t* data, uint32_t size) {
+    switch (size) {
+    case 8:
+        STM32F4_FLASH->CR = FLASH_CR_PG | FLASH_CR_PSIZE;
+
+        // a double word goes in as two word accesses
+        *reinterpret_cast<volatile uint32_t*>(address) = *reinterpret_cast<const uint32_t*>(data);
+
+        __ISB();
+
+        *reinterpret_cast<volatile uint32_t*>(address + 4) = *reinterpret_cast<const uint32_t*>(data + 4);
+
+        break;
+
+    case 4:
+        STM32F4_FLASH->CR = FLASH_CR_PG | FLASH_CR_PSIZE_1;
+
+        *reinterpret_cast<volatile uint32_t*>(address) = *reinterpret_cast<const uint32_t*>(data);
+
+        break;
+
+    case 2:
+        STM32F4_FLASH->CR = FLASH_CR_PG | FLASH_CR_PSIZE_0;
+
+        *reinterpret_cast<volatile uint16_t*>(address) = *reinterpret_cast<const uint16_t*>(data);
+
+        break;
+
+    default:
+        STM32F4_FLASH->CR = FLASH_CR_PG;
+
+        *reinterpret_cast<volatile uint8_t*>(address) = *data;
+
+        break;
+    }
+
+    // wait for completion
+    while (STM32F4_FLASH->SR & FLASH_SR_BSY);
+
+    return STM32F4_Flash_Equals(address, data, size);
+}
+
 TinyCLR_Result __section("SectionForFlashOperations") STM32F4_Flash_Write(const TinyCLR_Storage_Controller* self, uint64_t address, size_t& count, const uint8_t* data, uint64_t timeout) {
     if (data == nullptr) return TinyCLR_Result::ArgumentNull;
 
@@ -146,37 +238,61 @@ TinyCLR_Result __section("SectionForFlashOperations") STM32F4_Flash_Write(const
 
     if (bytePerSector <= 0) return TinyCLR_Result::IndexOutOfRange;
 
+    auto state = reinterpret_cast<DeploymentState*>(self->ApiInfo->State);
+
+    // the sectors written to are no longer known to be erased and their hashes are stale
+    for (auto i = 0; i < state->regionCount; i++) {
+        if (state->regionAddresses[i] < address + count && address < state->regionAddresses[i] + state->regionSizes[i]) {
+            STM32F4_Flash_SetSectorState(self, i, false, false);
+
+            state->index.Invalidate(i);
+        }
+    }
+
     if (STM32F4_FLASH->CR & FLASH_CR_LOCK) { // unlock
         STM32F4_FLASH->KEYR = STM32F4_FLASH_KEY1;
         STM32F4_FLASH->KEYR = STM32F4_FLASH_KEY2;
     }
 
-    uint32_t* addressStart = reinterpret_cast<uint32_t*>(address);
-    uint32_t* addressEnd = reinterpret_cast<uint32_t*>(address + count);
-    uint32_t* pBuf = (uint32_t*)data;
+    uint32_t to = static_cast<uint32_t>(address);
+    uint32_t end = to + count;
+    auto result = TinyCLR_Result::Success;
 
-    // enable programming
-    STM32F4_FLASH->CR = FLASH_CR_PG | FLASH_CR_PSIZE_1;
+    while (to < end && result == TinyCLR_Result::Success) {
+        uint32_t lineEnd = (to & ~(STM32F4_FLASH_LINE_SIZE - 1)) + STM32F4_FLASH_LINE_SIZE;
 
-    while (addressStart < addressEnd) {
-        if (*addressStart != *pBuf) {
-            // write data
-            *addressStart = *pBuf;
-            // wait for completion
-            while (STM32F4_FLASH->SR & FLASH_SR_BSY);
-            // check
-            if (*addressStart != *pBuf) {
-                return TinyCLR_Result::InvalidOperation;
+        if (lineEnd > end)
+            lineEnd = end;
+
+        if (STM32F4_Flash_Equals(to, data, lineEnd - to)) {
+            data += lineEnd - to;
+            to = lineEnd;
+
+            continue;
+        }
+
+        while (to < lineEnd) {
+            uint32_t size = STM32F4_FLASH_PROGRAM_SIZE;
+
+            // narrower accesses for the ends that are not aligned to the full width
+            while (size > 1 && ((to & (size - 1)) != 0 || to + size > lineEnd))
+                size /= 2;
+
+            if (!STM32F4_Flash_Equals(to, data, size) && !STM32F4_Flash_ProgramUnit(to, data, size)) {
+                result = TinyCLR_Result::InvalidOperation;
+
+                break;
             }
+
+            to += size;
+            data += size;
         }
-        addressStart++;
-        pBuf++;
     }
 
     // reset & lock the controller
     STM32F4_FLASH->CR = FLASH_CR_LOCK;
 
-    return TinyCLR_Result::Success;
+    return result;
 }
 
 TinyCLR_Result __section("SectionForFlashOperations") STM32F4_Flash_IsErased(const TinyCLR_Storage_Controller* self, uint64_t address, size_t count, bool& erased) {
@@ -185,21 +301,32 @@ TinyCLR_Result __section("SectionForFlashOperations") STM32F4_Flash_IsErased(con
 
     if (sector >= state->regionCount) return TinyCLR_Result::IndexOutOfRange;
 
-    uint32_t* addressStart = reinterpret_cast<uint32_t*>(deploymentSectors[sector].address);
-    uint32_t* addressEnd = reinterpret_cast<uint32_t*>(deploymentSectors[sector].address + deploymentSectors[sector].size);
+    auto mask = 1UL << (sector % 32);
+
+    if (state->knownSectors[sector / 32] & mask) {
+        erased = (state->erasedSectors[sector / 32] & mask) != 0;
+
+        return TinyCLR_Result::Success;
+    }
+
+    // sectors are double word aligned, four double words are checked per pass
+    auto addressStart = reinterpret_cast<const uint64_t*>(deploymentSectors[sector].address);
+    auto addressEnd = reinterpret_cast<const uint64_t*>(deploymentSectors[sector].address + deploymentSectors[sector].size);
 
     erased = true;
 
     while (addressStart < addressEnd) {
-        if (*addressStart != 0xFFFFFFFF) {
+        if ((addressStart[0] & addressStart[1] & addressStart[2] & addressStart[3]) != 0xFFFFFFFFFFFFFFFFULL) {
             erased = false;
 
             break;
         }
 
-        addressStart++;
+        addressStart += 4;
     }
 
+    STM32F4_Flash_SetSectorState(self, sector, true, erased);
+
     return TinyCLR_Result::Success;
 }
 
@@ -218,8 +345,14 @@ TinyCLR_Result __section("SectionForFlashOperations") STM32F4_Flash_Erase(const
         STM32F4_FLASH->KEYR = STM32F4_FLASH_KEY2;
     }
 
+    // errors left over from an earlier operation would be taken for this one's
+    STM32F4_FLASH->SR = STM32F4_FLASH_SR_ERRORS;
+
+    // erase with the same parallelism as programming, the wider the faster
+    uint32_t psize = STM32F4_FLASH_PROGRAM_SIZE == 8 ? FLASH_CR_PSIZE : (STM32F4_FLASH_PROGRAM_SIZE == 4 ? FLASH_CR_PSIZE_1 : FLASH_CR_PSIZE_0);
+
     // enable erasing
-    uint32_t cr = num * FLASH_CR_SNB_0 | FLASH_CR_SER;
+    uint32_t cr = num * FLASH_CR_SNB_0 | FLASH_CR_SER | psize;
     STM32F4_FLASH->CR = cr;
     // start erase
     cr |= FLASH_CR_STRT;
@@ -229,10 +362,35 @@ TinyCLR_Result __section("SectionForFlashOperations") STM32F4_Flash_Erase(const
     // wait for completion
     while (STM32F4_FLASH->SR & FLASH_SR_BSY);
 
+    auto errors = STM32F4_FLASH->SR & STM32F4_FLASH_SR_ERRORS;
+
+    STM32F4_FLASH->SR = errors;
+
     // reset & lock the controller
     STM32F4_FLASH->CR = FLASH_CR_LOCK;
 
-    TinyCLR_Result::Success;
+    // a failed erase leaves the sector in an unknown state, only a successful one is remembered as erased
+    STM32F4_Flash_SetSectorState(self, sector, errors == 0, errors == 0);
+
+    state->index.Invalidate(sector);
+
+    return errors == 0 ? TinyCLR_Result::Success : TinyCLR_Result::InvalidOperation;
+}
+
+// Content hash of a deployment sector for the debugger to compare against the image, see DeploymentIndex.h.
+TinyCLR_Result STM32F4_Flash_GetSectorHash(const TinyCLR_Storage_Controller* self, uint64_t sector, uint64_t& hash) {
+    auto state = reinterpret_cast<DeploymentState*>(self->ApiInfo->State);
+
+    if (sector >= state->regionCount) return TinyCLR_Result::IndexOutOfRange;
+
+    if (!state->index.Get(sector, hash)) {
+        // the flash is memory mapped, the sector is hashed in place
+        hash = DeploymentIndex_Hash(DEPLOYMENT_INDEX_HASH_BASIS, reinterpret_cast<const uint8_t*>(deploymentSectors[sector].address), deploymentSectors[sector].size);
+
+        state->index.Set(sector, hash);
+    }
+
+    return TinyCLR_Result::Success;
 }
 
 TinyCLR_Result STM32F4_Flash_Acquire(const TinyCLR_Storage_Controller* self) {
@@ -16,6 +16,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "STM32F4.h"
+#include "../../Drivers/DisplayBlit/DisplayBlit.h"
 
 #ifdef INCLUDE_DISPLAY
 
@@ -362,6 +363,10 @@ void STM32F4_Display_PrintChracter(uint32_t x, uint32_t y, uint8_t c);
 void STM32F4_Display_TextShiftColUp();
 void STM32F4_Display_Clear();
 void STM32F4_Display_GetRotatedDimensions(int32_t *screenWidth, int32_t *screenHeight);
+static uint16_t* STM32F4_Display_GetScanoutBuffer();
+static void STM32F4_Display_MarkDirty(int32_t x, int32_t y, int32_t width, int32_t height);
+static void STM32F4_Display_GetPhysicalRectangle(int32_t& x, int32_t& y, int32_t& width, int32_t& height);
+static void STM32F4_Display_FreeBuffers(const TinyCLR_Memory_Manager* memoryProvider);
 
 int32_t STM32F4_Display_GetWidth();
 int32_t STM32F4_Display_GetHeight();
@@ -568,6 +573,10 @@ bool STM32F4_Display_Initialize() {
 
     RCC->APB2ENR |= RCC_APB2ENR_LTDCEN;
 
+#ifdef DMA2D
+    RCC->AHB1ENR |= RCC_AHB1ENR_DMA2DEN;
+#endif
+
     //HorizontalSyncPolarity
     if (m_STM32F4_DisplayHorizontalSyncPolarity == false)
         hltdc_F.Init.HSPolarity = LTDC_HSPOLARITY_AL;
@@ -628,7 +637,7 @@ bool STM32F4_Display_Initialize() {
     if (m_STM32F4_Display_VituralRam == nullptr)
         return false;
 
-    pLayerCfg.FBStartAdress = (uint32_t)m_STM32F4_Display_VituralRam;
+    pLayerCfg.FBStartAdress = (uint32_t)STM32F4_Display_GetScanoutBuffer();
 
     /* Alpha constant (255 == totally opaque) */
     pLayerCfg.Alpha = 255;
@@ -659,6 +668,12 @@ bool STM32F4_Display_Initialize() {
 }
 
 bool STM32F4_Display_Uninitialize() {
+    STM32F4_Display_WaitForTransfer();
+
+#ifdef DMA2D
+    RCC->AHB1ENR &= ~RCC_AHB1ENR_DMA2DEN;
+#endif
+
     RCC->APB2ENR &= ~RCC_APB2ENR_LTDCEN;
 
     return true;
@@ -727,6 +742,9 @@ void STM32F4_Display_PaintPixel(uint32_t x, uint32_t y, uint8_t c) {
     if (y >= m_STM32F4_DisplayHeight)
         return;
 
+    STM32F4_Display_WaitForTransfer();
+    STM32F4_Display_MarkDirty(x, y, 1, 1);
+
     loc = m_STM32F4_Display_VituralRam + (y *m_STM32F4_DisplayWidth) + (x);
 
     if (c)
@@ -799,6 +817,9 @@ void STM32F4_Display_Clear() {
     if (m_STM32F4_DisplayEnable == false || m_STM32F4_Display_VituralRam == nullptr)
         return;
 
+    STM32F4_Display_WaitForTransfer();
+    STM32F4_Display_MarkDirty(0, 0, m_STM32F4_DisplayWidth, m_STM32F4_DisplayHeight);
+
     memset((uint32_t*)m_STM32F4_Display_VituralRam, 0, m_STM32F4_DisplayBufferSize);
 }
 
@@ -873,134 +894,60 @@ int32_t STM32F4_Display_GetOrientation() {
     return m_STM32F4_Display_CurrentRotation;
 }
 
-void  STM32F4_Display_MemCopy(void *dest, void *src, int32_t size) {
-    const int32_t MEMCOPY_BYTES_ALIGNED = 8;
-
-    uint64_t *from64 = (uint64_t *)src;
-    uint64_t *to64 = (uint64_t *)dest;
-
-    int32_t block = size / MEMCOPY_BYTES_ALIGNED;
-    int32_t remainder = size % MEMCOPY_BYTES_ALIGNED;
-
-    while (block > 0) {
-        *to64++ = *from64++;
-        block--;
-    }
-
-    if (remainder > 0) {
-        uint8_t *from8 = (uint8_t *)from64;
-        uint8_t *to8 = (uint8_t *)to64;
-
-        while (remainder > 0) {
-            *to8++ = *from8++;
-
-            remainder--;
-        }
-    }
-}
-
-void STM32F4_Display_BitBltEx(int32_t x, int32_t y, int32_t width, int32_t height, uint32_t data[]) {
-
-    int32_t xTo, yTo, xFrom, yFrom;
-    int32_t xOffset = x;
-    int32_t yOffset = y;
-    uint16_t *from = (uint16_t *)data;
+// Copies a 16bpp block to the rotated rectangle (x, y, width, height). from is the source pixel that goes to
+// (x, y) and fromStride the source line pitch in pixels.
+static void STM32F4_Display_Blit(int32_t x, int32_t y, int32_t width, int32_t height, const uint16_t* from, int32_t fromStride) {
     uint16_t *to = (uint16_t *)m_STM32F4_Display_VituralRam;
 
-
     int32_t screenWidth = m_STM32F4_DisplayWidth;
     int32_t screenHeight = m_STM32F4_DisplayHeight;
-    int32_t startPx, toAddition;
-
-    if (m_STM32F4_DisplayEnable == false)
-        return;
 
     switch (m_STM32F4_Display_CurrentRotation) {
     case STM32F4xx_LCD_Rotation::rotateNormal_0:
-
-        if (xOffset == 0 && yOffset == 0 &&
-            width == screenWidth && height == screenHeight) {
-            STM32F4_Display_MemCopy(to, from, (screenWidth*screenHeight * 2));
-        }
-        else {
-            for (yTo = yOffset; yTo < (yOffset + height); yTo++) {
-                STM32F4_Display_MemCopy((void*)(to + yTo * screenWidth + xOffset), (void*)(from), (width * 2)); 
-                from += width;
-            }
-        }
+        DisplayBlit_Copy(to + y * screenWidth + x, screenWidth, from, fromStride, width, height);
 
         break;
 
     case STM32F4xx_LCD_Rotation::rotateCCW_90:
-
-        startPx = yOffset * screenHeight;
-        xFrom = xOffset + width;
-        yTo = screenHeight - xOffset - width;
-        xTo = yOffset;
-        to += yTo * screenWidth + xTo;
-        toAddition = screenWidth - height;
-
-        for (; yTo < (screenHeight - xOffset); yTo++) {
-            xFrom--;
-            yFrom = startPx + xFrom;
-
-            for (xTo = yOffset; xTo < (yOffset + height); xTo++) {
-                *to++ = from[yFrom];
-                yFrom += screenHeight;
-            }
-
-            to += toAddition;
-        }
+        DisplayBlit_Rotate90(to + (screenHeight - x - width) * screenWidth + y, screenWidth, from + width - 1, fromStride, -1, height, width);
 
         break;
 
     case STM32F4xx_LCD_Rotation::rotateCW_90:
-
-        startPx = (yOffset + height - 1) * screenHeight;
-        xFrom = xOffset;
-
-        yTo = xOffset;
-        xTo = screenWidth - yOffset - height;
-        to += yTo * screenWidth + xTo;
-        toAddition = screenWidth - height;
-
-        for (; yTo < (xOffset + width); yTo++) {
-            yFrom = startPx + xFrom;
-
-            for (xTo = screenWidth - yOffset - height; xTo < (screenWidth - yOffset); xTo++) {
-                *to++ = from[yFrom];
-                yFrom -= screenHeight;
-            }
-
-            to += toAddition;
-            xFrom++;
-        }
+        DisplayBlit_Rotate90(to + x * screenWidth + screenWidth - y - height, screenWidth, from + (height - 1) * fromStride, -fromStride, 1, height, width);
 
         break;
 
     case STM32F4xx_LCD_Rotation::rotate_180:
+        DisplayBlit_Rotate180(to + (screenHeight - y - height) * screenWidth + screenWidth - x - width, screenWidth, from + (height - 1) * fromStride + width - 1, fromStride, width, height);
 
-        xFrom = (yOffset + height - 1) * screenWidth + xOffset + width;
+        break;
+    }
+}
 
-        yTo = screenHeight - yOffset - height;
-        xTo = screenWidth - xOffset - width;
-        to += yTo * screenWidth + xTo;
-        toAddition = screenWidth - width;
+void STM32F4_Display_BitBltEx(int32_t x, int32_t y, int32_t width, int32_t height, uint32_t data[]) {
+    const uint16_t *from = (const uint16_t *)data;
 
-        for (; yTo < (screenHeight - yOffset); yTo++) {
+    if (m_STM32F4_DisplayEnable == false)
+        return;
 
-            for (xTo = screenWidth - xOffset - width; xTo < (screenWidth - xOffset); xTo++) {
-                xFrom--;
-                *to++ = from[xFrom];
-            }
+    int32_t px = x, py = y, pw = width, ph = height;
 
-            to += toAddition;
-            xFrom -= toAddition;
-        }
+    STM32F4_Display_GetPhysicalRectangle(px, py, pw, ph);
+    STM32F4_Display_WaitForTransfer();
+    STM32F4_Display_MarkDirty(px, py, pw, ph);
 
-        break;
+    // (x, y, width, height) is in rotated coordinates. A rotated source is a whole frame, its line pitch
+    // is the rotated width; the unrotated source only holds the rectangle.
+    if (m_STM32F4_Display_CurrentRotation == STM32F4xx_LCD_Rotation::rotateNormal_0) {
+        STM32F4_Display_Blit(x, y, width, height, from, width);
     }
+    else {
+        int32_t rotatedWidth, rotatedHeight;
 
+        STM32F4_Display_GetRotatedDimensions(&rotatedWidth, &rotatedHeight);
+        STM32F4_Display_Blit(x, y, width, height, from + y * rotatedWidth + x, rotatedWidth);
+    }
 }
 
 void STM32F4_Display_WriteChar(uint8_t c, int32_t row, int32_t col) {
@@ -1051,13 +998,9 @@ TinyCLR_Result STM32F4_Display_Release(const TinyCLR_Display_Controller* self) {
 
         m_STM32F4_DisplayEnable = false;
 
-        if (m_STM32F4_Display_VituralRam != nullptr) {
-            auto memoryProvider = (const TinyCLR_Memory_Manager*)apiManager->FindDefault(apiManager, TinyCLR_Api_Type::MemoryManager);
-
-            memoryProvider->Free(memoryProvider, m_STM32F4_Display_VituralRam);
+        auto memoryProvider = (const TinyCLR_Memory_Manager*)apiManager->FindDefault(apiManager, TinyCLR_Api_Type::MemoryManager);
 
-            m_STM32F4_Display_VituralRam = nullptr;
-        }
+        STM32F4_Display_FreeBuffers(memoryProvider);
     }
 
     return TinyCLR_Result::Success;
@@ -1120,11 +1063,7 @@ TinyCLR_Result STM32F4_Display_SetConfiguration(const TinyCLR_Display_Controller
 
         auto memoryProvider = (const TinyCLR_Memory_Manager*)apiManager->FindDefault(apiManager, TinyCLR_Api_Type::MemoryManager);
 
-        if (m_STM32F4_Display_VituralRam != nullptr) {
-            memoryProvider->Free(memoryProvider, m_STM32F4_Display_VituralRam);
-
-            m_STM32F4_Display_VituralRam = nullptr;
-        }
+        STM32F4_Display_FreeBuffers(memoryProvider);
 
         m_STM32F4_Display_VituralRam = (uint16_t*)((uint8_t*)memoryProvider->Allocate(memoryProvider, m_STM32F4_DisplayBufferSize));
 
@@ -1179,8 +1118,416 @@ TinyCLR_Result STM32F4_Display_GetConfiguration(const TinyCLR_Display_Controller
     return TinyCLR_Result::InvalidOperation;
 }
 
+// Maps a rectangle in rotated coordinates to the frame buffer. The size swaps for the 90 degree rotations.
+static void STM32F4_Display_GetPhysicalRectangle(int32_t& x, int32_t& y, int32_t& width, int32_t& height) {
+    int32_t screenWidth = m_STM32F4_DisplayWidth;
+    int32_t screenHeight = m_STM32F4_DisplayHeight;
+    int32_t t;
+
+    switch (m_STM32F4_Display_CurrentRotation) {
+    case STM32F4xx_LCD_Rotation::rotateNormal_0:
+        break;
+
+    case STM32F4xx_LCD_Rotation::rotateCCW_90:
+        t = x;
+        x = y;
+        y = screenHeight - t - width;
+
+        t = width;
+        width = height;
+        height = t;
+
+        break;
+
+    case STM32F4xx_LCD_Rotation::rotateCW_90:
+        t = x;
+        x = screenWidth - y - height;
+        y = t;
+
+        t = width;
+        width = height;
+        height = t;
+
+        break;
+
+    case STM32F4xx_LCD_Rotation::rotate_180:
+        x = screenWidth - x - width;
+        y = screenHeight - y - height;
+
+        break;
+    }
+}
+
+static size_t STM32F4_Display_GetSourcePixelSize(STM32F4_Display_SourceFormat format) {
+    switch (format) {
+    case STM32F4_Display_SourceFormat::Argb8888: return 4;
+    case STM32F4_Display_SourceFormat::Rgb888: return 3;
+    default: return 2;
+    }
+}
+
+static uint16_t STM32F4_Display_ToRgb565(uint32_t rgb) {
+    return ((rgb & 0xF80000) >> 8) | ((rgb & 0x00FC00) >> 5) | ((rgb & 0x0000F8) >> 3);
+}
+
+static TinyCLR_Result STM32F4_Display_CheckRectangle(uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+    if (m_STM32F4_DisplayEnable == false || m_STM32F4_Display_VituralRam == nullptr)
+        return TinyCLR_Result::InvalidOperation;
+
+    if (x + width > (uint32_t)STM32F4_Display_GetWidth() || y + height > (uint32_t)STM32F4_Display_GetHeight())
+        return TinyCLR_Result::ArgumentOutOfRange;
+
+    return TinyCLR_Result::Success;
+}
+
+// CPU path for what the DMA2D cannot do (rotated frame buffer, parts without one): converts each source pixel
+// and, when blending, mixes it into the frame buffer with its own alpha scaled by the constant alpha.
+static void STM32F4_Display_DrawPixels(int32_t x, int32_t y, int32_t width, int32_t height, const uint8_t* data, int32_t sourceStride, STM32F4_Display_SourceFormat format, uint32_t alpha, bool blend) {
+    auto pixelSize = STM32F4_Display_GetSourcePixelSize(format);
+
+    STM32F4_Display_WaitForTransfer();
+
+    for (auto row = 0; row < height; row++) {
+        for (auto column = 0; column < width; column++) {
+            uint32_t r, g, b, a = 0xFF;
+
+            switch (format) {
+            case STM32F4_Display_SourceFormat::Argb8888:
+                a = data[3];
+
+                // fall through, the remaining bytes are laid out like RGB888
+
+            case STM32F4_Display_SourceFormat::Rgb888:
+                b = data[0];
+                g = data[1];
+                r = data[2];
+
+                break;
+
+            default:
+                auto p = (uint32_t)(data[0] | (data[1] << 8));
+
+                r = ((p >> 8) & 0xF8) | (p >> 13);
+                g = ((p >> 3) & 0xFC) | ((p >> 9) & 0x03);
+                b = ((p << 3) & 0xF8) | ((p >> 2) & 0x07);
+
+                break;
+            }
+
+            data += pixelSize;
+
+            int32_t px = x + column, py = y + row, pw = 1, ph = 1;
+
+            STM32F4_Display_GetPhysicalRectangle(px, py, pw, ph);
+
+            auto to = m_STM32F4_Display_VituralRam + py * m_STM32F4_DisplayWidth + px;
+
+            if (blend) {
+                a = (a * alpha + 127) / 255;
+
+                auto d = (uint32_t)*to;
+                auto dr = ((d >> 8) & 0xF8) | (d >> 13);
+                auto dg = ((d >> 3) & 0xFC) | ((d >> 9) & 0x03);
+                auto db = ((d << 3) & 0xF8) | ((d >> 2) & 0x07);
+
+                r = (r * a + dr * (255 - a) + 127) / 255;
+                g = (g * a + dg * (255 - a) + 127) / 255;
+                b = (b * a + db * (255 - a) + 127) / 255;
+            }
+
+            *to = STM32F4_Display_ToRgb565((r << 16) | (g << 8) | b);
+        }
+
+        data += (sourceStride - width) * pixelSize;
+    }
+}
+
+#ifdef DMA2D
+#define STM32F4_DISPLAY_DMA2D_MODE_M2M_PFC DMA2D_CR_MODE_0
+#define STM32F4_DISPLAY_DMA2D_MODE_M2M_BLEND DMA2D_CR_MODE_1
+#define STM32F4_DISPLAY_DMA2D_MODE_R2M (DMA2D_CR_MODE_0 | DMA2D_CR_MODE_1)
+
+#define STM32F4_DISPLAY_DMA2D_COLOR_MODE_RGB565 2
+#define STM32F4_DISPLAY_DMA2D_ALPHA_MODE_MULTIPLY 2
+
+// Starts a DMA2D transfer into a frame buffer rectangle (physical coordinates) and returns without waiting for
+// it. Only the previous transfer is waited for; the source has to stay untouched until the transfer is done,
+// everything in this driver that reads or writes the frame buffer waits through STM32F4_Display_WaitForTransfer.
+// sourceOffset is the number of source pixels skipped from the end of one line to the start of the next.
+static void STM32F4_Display_StartTransfer(uint32_t mode, const uint8_t* source, STM32F4_Display_SourceFormat format, uint32_t alpha, uint32_t color, int32_t sourceOffset, int32_t x, int32_t y, int32_t width, int32_t height) {
+    int32_t screenWidth = m_STM32F4_DisplayWidth;
+
+    auto output = m_STM32F4_Display_VituralRam + y * screenWidth + x;
+
+    STM32F4_Display_WaitForTransfer();
+
+    DMA2D->CR = mode;
+    DMA2D->OPFCCR = STM32F4_DISPLAY_DMA2D_COLOR_MODE_RGB565;
+    DMA2D->OMAR = (uint32_t)output;
+    DMA2D->OOR = screenWidth - width;
+    DMA2D->NLR = (width << DMA2D_NLR_PL_Pos) | height;
+
+    if (mode == STM32F4_DISPLAY_DMA2D_MODE_R2M) {
+        DMA2D->OCOLR = color;
+    }
+    else {
+        // the constant alpha only applies when it is less than opaque, per pixel alpha always does
+        DMA2D->FGMAR = (uint32_t)source;
+        DMA2D->FGOR = sourceOffset;
+        DMA2D->FGPFCCR = ((uint32_t)format << DMA2D_FGPFCCR_CM_Pos) | (alpha << DMA2D_FGPFCCR_ALPHA_Pos) | (alpha < 0xFF ? (STM32F4_DISPLAY_DMA2D_ALPHA_MODE_MULTIPLY << DMA2D_FGPFCCR_AM_Pos) : 0);
+
+        if (mode == STM32F4_DISPLAY_DMA2D_MODE_M2M_BLEND) {
+            DMA2D->BGMAR = (uint32_t)output;
+            DMA2D->BGOR = screenWidth - width;
+            DMA2D->BGPFCCR = STM32F4_DISPLAY_DMA2D_COLOR_MODE_RGB565 << DMA2D_BGPFCCR_CM_Pos;
+        }
+    }
+
+    DMA2D->CR |= DMA2D_CR_START;
+}
+#endif
+
+// Double buffering. m_STM32F4_Display_VituralRam is always the buffer that is drawn into. While double buffered the
+// controller scans out m_STM32F4_Display_FrontBuffer instead, and Present swaps the two at the next vertical blanking.
+// With copy forward the region drawn before a Present is copied into the new back buffer once the flip is done,
+// so both buffers hold the same picture without copying whole frames.
+uint16_t* m_STM32F4_Display_FrontBuffer = nullptr;
+bool m_STM32F4_Display_CopyForward = false;
+bool m_STM32F4_Display_FlipPending = false;
+DisplayBlit_Region m_STM32F4_Display_DirtyRegion;
+DisplayBlit_Region m_STM32F4_Display_StaleRegion;
+
+static uint16_t* STM32F4_Display_GetScanoutBuffer() {
+    return m_STM32F4_Display_FrontBuffer != nullptr ? m_STM32F4_Display_FrontBuffer : m_STM32F4_Display_VituralRam;
+}
+
+// The layer registers are shadowed, the new address is taken over at the next vertical blanking.
+static void STM32F4_Display_SetScanoutBuffer(uint16_t* buffer) {
+    LTDC_Layer2->CFBAR = (uint32_t)buffer;
+    LTDC->SRCR = LTDC_SRCR_VBR;
+}
+
+static bool STM32F4_Display_IsFlipPending() {
+    return (LTDC->SRCR & LTDC_SRCR_VBR) != 0;
+}
+
+static void STM32F4_Display_MarkDirty(int32_t x, int32_t y, int32_t width, int32_t height) {
+    if (m_STM32F4_Display_FrontBuffer != nullptr)
+        m_STM32F4_Display_DirtyRegion.Include(x, y, width, height);
+}
+
+// Must run before the back buffer is touched: it may still be on screen until a requested flip has happened.
+static void STM32F4_Display_WaitForFlip() {
+    if (m_STM32F4_Display_FlipPending) {
+        // a controller that was turned off never gets to the flip, it shows the front buffer when turned back on
+        while (m_STM32F4_DisplayEnable && STM32F4_Display_IsFlipPending());
+
+        m_STM32F4_Display_FlipPending = false;
+    }
+
+    if (!m_STM32F4_Display_StaleRegion.IsEmpty()) {
+        auto region = m_STM32F4_Display_StaleRegion;
+        auto offset = region.top * m_STM32F4_DisplayWidth + region.left;
+
+        m_STM32F4_Display_StaleRegion.Reset();
+
+#ifdef DMA2D
+        STM32F4_Display_StartTransfer(STM32F4_DISPLAY_DMA2D_MODE_M2M_PFC, (const uint8_t*)(m_STM32F4_Display_FrontBuffer + offset), STM32F4_Display_SourceFormat::Rgb565, 0xFF, 0, m_STM32F4_DisplayWidth - (region.right - region.left), region.left, region.top, region.right - region.left, region.bottom - region.top);
+#else
+        DisplayBlit_Copy(m_STM32F4_Display_VituralRam + offset, m_STM32F4_DisplayWidth, m_STM32F4_Display_FrontBuffer + offset, m_STM32F4_DisplayWidth, region.right - region.left, region.bottom - region.top);
+#endif
+    }
+}
+
+TinyCLR_Result STM32F4_Display_SetDoubleBuffering(const TinyCLR_Display_Controller* self, bool enable, bool copyForward) {
+    if (m_STM32F4_Display_VituralRam == nullptr)
+        return TinyCLR_Result::InvalidOperation;
+
+    auto memoryProvider = (const TinyCLR_Memory_Manager*)apiManager->FindDefault(apiManager, TinyCLR_Api_Type::MemoryManager);
+
+    STM32F4_Display_WaitForTransfer();
+
+    if (enable && m_STM32F4_Display_FrontBuffer == nullptr) {
+        auto back = (uint16_t*)memoryProvider->Allocate(memoryProvider, m_STM32F4_DisplayBufferSize);
+
+        if (back == nullptr)
+            return TinyCLR_Result::OutOfMemory;
+
+        // what is on screen stays there, drawing continues on a copy of it
+        memcpy(back, m_STM32F4_Display_VituralRam, m_STM32F4_DisplayBufferSize);
+
+        m_STM32F4_Display_FrontBuffer = m_STM32F4_Display_VituralRam;
+        m_STM32F4_Display_VituralRam = back;
+    }
+    else if (!enable && m_STM32F4_Display_FrontBuffer != nullptr) {
+        // keep the buffer that is on screen, drawing continues there
+        memoryProvider->Free(memoryProvider, m_STM32F4_Display_VituralRam);
+
+        m_STM32F4_Display_VituralRam = m_STM32F4_Display_FrontBuffer;
+        m_STM32F4_Display_FrontBuffer = nullptr;
+    }
+
+    m_STM32F4_Display_CopyForward = copyForward;
+    m_STM32F4_Display_DirtyRegion.Reset();
+    m_STM32F4_Display_StaleRegion.Reset();
+
+    return TinyCLR_Result::Success;
+}
+
+// Shows what was drawn since the last Present at the next vertical blanking. Returns without waiting for it; the
+// next drawing call waits instead, only if it comes before the flip.
+TinyCLR_Result STM32F4_Display_Present(const TinyCLR_Display_Controller* self) {
+    if (m_STM32F4_DisplayEnable == false || m_STM32F4_Display_FrontBuffer == nullptr)
+        return TinyCLR_Result::InvalidOperation;
+
+    STM32F4_Display_WaitForTransfer();
+
+    auto front = m_STM32F4_Display_VituralRam;
+
+    m_STM32F4_Display_VituralRam = m_STM32F4_Display_FrontBuffer;
+    m_STM32F4_Display_FrontBuffer = front;
+
+    STM32F4_Display_SetScanoutBuffer(front);
+
+    m_STM32F4_Display_FlipPending = true;
+
+    if (m_STM32F4_Display_CopyForward)
+        m_STM32F4_Display_StaleRegion = m_STM32F4_Display_DirtyRegion;
+
+    m_STM32F4_Display_DirtyRegion.Reset();
+
+    return TinyCLR_Result::Success;
+}
+
+static void STM32F4_Display_FreeBuffers(const TinyCLR_Memory_Manager* memoryProvider) {
+    STM32F4_Display_WaitForTransfer();
+
+    if (m_STM32F4_Display_FrontBuffer != nullptr) {
+        memoryProvider->Free(memoryProvider, m_STM32F4_Display_FrontBuffer);
+
+        m_STM32F4_Display_FrontBuffer = nullptr;
+    }
+
+    if (m_STM32F4_Display_VituralRam != nullptr) {
+        memoryProvider->Free(memoryProvider, m_STM32F4_Display_VituralRam);
+
+        m_STM32F4_Display_VituralRam = nullptr;
+    }
+}
+
+void STM32F4_Display_WaitForTransfer() {
+    STM32F4_Display_WaitForFlip();
+
+#ifdef DMA2D
+    while (DMA2D->CR & DMA2D_CR_START);
+
+    DMA2D->IFCR = DMA2D_IFCR_CTEIF | DMA2D_IFCR_CTCIF | DMA2D_IFCR_CCEIF;
+#endif
+}
+
+// data is the source pixel for (x, y), sourceStride the source line pitch in pixels.
+static TinyCLR_Result STM32F4_Display_Draw(uint32_t x, uint32_t y, uint32_t width, uint32_t height, const uint8_t* data, int32_t sourceStride, STM32F4_Display_SourceFormat format, uint32_t alpha, bool blend) {
+    auto result = STM32F4_Display_CheckRectangle(x, y, width, height);
+
+    if (result != TinyCLR_Result::Success)
+        return result;
+
+    if (data == nullptr)
+        return TinyCLR_Result::ArgumentNull;
+
+    if (width == 0 || height == 0)
+        return TinyCLR_Result::Success;
+
+    int32_t px = x, py = y, pw = width, ph = height;
+
+    STM32F4_Display_GetPhysicalRectangle(px, py, pw, ph);
+    STM32F4_Display_MarkDirty(px, py, pw, ph);
+
+#ifdef DMA2D
+    if (m_STM32F4_Display_CurrentRotation == STM32F4xx_LCD_Rotation::rotateNormal_0) {
+        STM32F4_Display_StartTransfer(blend ? STM32F4_DISPLAY_DMA2D_MODE_M2M_BLEND : STM32F4_DISPLAY_DMA2D_MODE_M2M_PFC, data, format, alpha, 0, sourceStride - width, x, y, width, height);
+
+        return TinyCLR_Result::Success;
+    }
+#endif
+
+    if (format == STM32F4_Display_SourceFormat::Rgb565 && !blend) {
+        STM32F4_Display_WaitForTransfer();
+        STM32F4_Display_Blit(x, y, width, height, (const uint16_t*)data, sourceStride);
+    }
+    else {
+        STM32F4_Display_DrawPixels(x, y, width, height, data, sourceStride, format, alpha, blend);
+    }
+
+    return TinyCLR_Result::Success;
+}
+
 TinyCLR_Result STM32F4_Display_DrawBuffer(const TinyCLR_Display_Controller* self, uint32_t x, uint32_t y, uint32_t width, uint32_t height, const uint8_t* data) {
-    STM32F4_Display_BitBltEx(x, y, width, height, (uint32_t*)data);
+    if (m_STM32F4_DisplayEnable == false)
+        return TinyCLR_Result::Success;
+
+    int32_t sourceStride = width;
+
+    // DrawBuffer keeps its layout: a rotated source is a whole frame, the unrotated one only holds the rectangle.
+    // The other drawing calls always take the rectangle alone.
+    if (m_STM32F4_Display_CurrentRotation != STM32F4xx_LCD_Rotation::rotateNormal_0 && data != nullptr) {
+        int32_t rotatedHeight;
+
+        STM32F4_Display_GetRotatedDimensions(&sourceStride, &rotatedHeight);
+
+        data += (y * sourceStride + x) * sizeof(uint16_t);
+    }
+
+    auto result = STM32F4_Display_Draw(x, y, width, height, data, sourceStride, STM32F4_Display_SourceFormat::Rgb565, 0xFF, false);
+
+    // the core does not wait for the transfer, data must not be read any more once this returns
+    STM32F4_Display_WaitForTransfer();
+
+    return result;
+}
+
+TinyCLR_Result STM32F4_Display_DrawBufferEx(const TinyCLR_Display_Controller* self, uint32_t x, uint32_t y, uint32_t width, uint32_t height, const uint8_t* data, STM32F4_Display_SourceFormat format) {
+    return STM32F4_Display_Draw(x, y, width, height, data, width, format, 0xFF, false);
+}
+
+TinyCLR_Result STM32F4_Display_BlendBuffer(const TinyCLR_Display_Controller* self, uint32_t x, uint32_t y, uint32_t width, uint32_t height, const uint8_t* data, STM32F4_Display_SourceFormat format, uint8_t alpha) {
+    if (alpha == 0)
+        return STM32F4_Display_CheckRectangle(x, y, width, height);
+
+    // an opaque source without per pixel alpha is a plain copy
+    auto blend = alpha < 0xFF || format == STM32F4_Display_SourceFormat::Argb8888;
+
+    return STM32F4_Display_Draw(x, y, width, height, data, width, format, alpha, blend);
+}
+
+TinyCLR_Result STM32F4_Display_FillRectangle(const TinyCLR_Display_Controller* self, uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint64_t color) {
+    auto result = STM32F4_Display_CheckRectangle(x, y, width, height);
+
+    if (result != TinyCLR_Result::Success || width == 0 || height == 0)
+        return result;
+
+    int32_t px = x, py = y, pw = width, ph = height;
+    auto rgb565 = STM32F4_Display_ToRgb565((uint32_t)color);
+
+    // a filled rectangle stays one rectangle under every rotation
+    STM32F4_Display_GetPhysicalRectangle(px, py, pw, ph);
+    STM32F4_Display_MarkDirty(px, py, pw, ph);
+
+#ifdef DMA2D
+    STM32F4_Display_StartTransfer(STM32F4_DISPLAY_DMA2D_MODE_R2M, nullptr, STM32F4_Display_SourceFormat::Rgb565, 0xFF, rgb565, 0, px, py, pw, ph);
+#else
+    STM32F4_Display_WaitForTransfer();
+
+    auto to = m_STM32F4_Display_VituralRam + py * m_STM32F4_DisplayWidth + px;
+
+    for (auto row = 0; row < ph; row++) {
+        for (auto column = 0; column < pw; column++)
+            to[column] = rgb565;
+
+        to += m_STM32F4_DisplayWidth;
+    }
+#endif
+
     return TinyCLR_Result::Success;
 }
 
@@ -1192,11 +1539,15 @@ TinyCLR_Result STM32F4_Display_DrawPixel(const TinyCLR_Display_Controller* self,
     if (m_STM32F4_DisplayEnable == false)
         return TinyCLR_Result::InvalidOperation;
 
+    STM32F4_Display_WaitForTransfer();
+
     if (x >= m_STM32F4_DisplayWidth)
         return TinyCLR_Result::InvalidOperation;
     if (y >= m_STM32F4_DisplayHeight)
         return TinyCLR_Result::InvalidOperation;
 
+    STM32F4_Display_MarkDirty(x, y, 1, 1);
+
     loc = m_STM32F4_Display_VituralRam + (y *m_STM32F4_DisplayWidth) + (x);
 
     *loc = rgb565;
@@ -1250,6 +1601,7 @@ void STM32F4_Display_AddApi(const TinyCLR_Api_Manager* apiManager) {
     }
 
     m_STM32F4_Display_VituralRam = nullptr;
+    m_STM32F4_Display_FrontBuffer = nullptr;
 
     apiManager->SetDefaultName(apiManager, TinyCLR_Api_Type::DisplayController, displayApi[0].Name);
 }
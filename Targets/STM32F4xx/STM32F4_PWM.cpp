@@ -15,6 +15,8 @@
 // limitations under the License.
 
 #include "STM32F4.h"
+#include "../../Drivers/PwmDuty/PwmDuty.h"
+#include "../../Drivers/PwmSequence/PwmSequence.h"
 
 #if STM32F4_APB1_CLOCK_HZ == STM32F4_AHB_CLOCK_HZ
 #define PWM1_CLK_HZ (STM32F4_APB1_CLOCK_HZ)
@@ -43,6 +45,13 @@
 
 #define STM32F4_MIN_PWM_FREQUENCY 1
 
+// Sequences are paced by the update DMA request of the controller's timer, indexed by controller
+#ifndef STM32F4_PWM_SEQUENCER_DMA_STREAMS
+#define STM32F4_PWM_SEQUENCER_DMA_STREAMS { DMA_STREAM(2, 5, 6), DMA_STREAM(1, 1, 3), DMA_STREAM(1, 2, 5), DMA_STREAM(1, 6, 2), DMA_STREAM(1, 0, 6), DMA_STREAM_NONE, DMA_STREAM_NONE, DMA_STREAM(2, 1, 7) }
+#endif
+
+#define STM32F4_PWM_SEQUENCER_DMA_CONFIGURATION (DMA_SxCR_PL_1 | DMA_SxCR_MINC | DMA_SxCR_DIR_0 | DMA_SxCR_TCIE | DMA_SxCR_TEIE)
+
 typedef  TIM_TypeDef* ptr_TIM_TypeDef;
 
 struct PwmState {
@@ -58,6 +67,18 @@ struct PwmState {
     double              theoryFreq;
     double              dutyCycle[PWM_PER_CONTROLLER];
 
+    // set through SetDutyCycles, only turned into dutyCycle when the frequency changes
+    bool                isDutyCycleFixed[PWM_PER_CONTROLLER];
+    uint32_t            fixedDutyCycle[PWM_PER_CONTROLLER];
+
+    // pattern playback, see StartSequence
+    bool                sequenceActive;
+    uint32_t            sequenceRepeat; // passes left including the current one, 0 while looping
+    const void*         sequencePattern;
+    size_t              sequenceLength;
+    STM32F4_Pwm_SequenceHandler sequenceHandler;
+    void*               sequenceParam;
+
     uint32_t            period;
     uint32_t            presc;
     uint32_t            timer;
@@ -70,6 +91,7 @@ void STM32F4_Pwm_ResetController(int32_t controllerIndex);
 STM32F4_Gpio_Pin* STM32F4_Pwm_GetGpioPinForChannel(const TinyCLR_Pwm_Controller* self, uint32_t channel);
 
 static const STM32F4_Gpio_Pin pwmPins[][PWM_PER_CONTROLLER] = STM32F4_PWM_PINS;
+static const STM32F4_Dma_Stream pwmSequencerDmaStreams[] = STM32F4_PWM_SEQUENCER_DMA_STREAMS;
 
 const char* PwmApiNames[] = {
 #if TOTAL_PWM_CONTROLLERS > 0
@@ -118,6 +140,9 @@ const char* PwmApiNames[] = {
 
 static PwmState pwmStates[TOTAL_PWM_CONTROLLERS];
 
+// Timers taken by other drivers as conversion triggers, bit n for TIMn.
+static uint32_t pwmReservedTimers;
+
 static TinyCLR_Pwm_Controller pwmControllers[TOTAL_PWM_CONTROLLERS];
 static TinyCLR_Api_Info pwmApi[TOTAL_PWM_CONTROLLERS];
 
@@ -420,14 +445,63 @@ TinyCLR_Result STM32F4_Pwm_SetPulseParameters(const TinyCLR_Pwm_Controller* self
 
     state->invert[channel] = polarity;
     state->dutyCycle[channel] = dutyCycle;
+    state->isDutyCycleFixed[channel] = false;
 
     return TinyCLR_Result::Success;
 
 }
 
+// Sets the duty cycles of several channels of the timer together. Duty cycles are Q16 fractions of the period,
+// STM32F4_PWM_FULL_DUTY_CYCLE is always on, and the polarity stays as last set. The compare registers are preloaded
+// and update events are held back while they are written, so all channels switch at the same update event and no
+// period runs with a mix of old and new values.
+TinyCLR_Result STM32F4_Pwm_SetDutyCycles(const TinyCLR_Pwm_Controller* self, const uint32_t* channels, const uint32_t* dutyCycles, size_t count) {
+    if (channels == nullptr || dutyCycles == nullptr)
+        return TinyCLR_Result::ArgumentNull;
+
+    auto state = reinterpret_cast<PwmState*>(self->ApiInfo->State);
+
+    ptr_TIM_TypeDef treg = state->timReg;
+
+    // no frequency set yet
+    if (state->period == 0)
+        return TinyCLR_Result::InvalidOperation;
+
+    for (auto i = 0u; i < count; i++)
+        if (channels[i] >= PWM_PER_CONTROLLER || !state->isOpened[channels[i]])
+            return TinyCLR_Result::ArgumentOutOfRange;
+
+    treg->CR1 |= TIM_CR1_UDIS;
+
+    for (auto i = 0u; i < count; i++) {
+        auto channel = channels[i];
+        auto dutyCycle = dutyCycles[i] > STM32F4_PWM_FULL_DUTY_CYCLE ? STM32F4_PWM_FULL_DUTY_CYCLE : dutyCycles[i];
+        auto duration = PwmDuty_GetCompare(dutyCycle, state->period);
+
+        if (state->timer == 2 || state->timer == 5)
+            ((__IO uint32_t*)&treg->CCR1)[channel] = duration;
+        else
+            *(__IO uint16_t*)&((uint32_t*)&treg->CCR1)[channel] = duration;
+
+        state->isDutyCycleFixed[channel] = true;
+        state->fixedDutyCycle[channel] = dutyCycle;
+    }
+
+    treg->CR1 &= ~TIM_CR1_UDIS;
+
+    if ((treg->CR1 & TIM_CR1_CEN) == 0) // timer stopped, nothing to wait for
+        treg->EGR = TIM_EGR_UG;
+
+    return TinyCLR_Result::Success;
+}
+
 TinyCLR_Result STM32F4_Pwm_SetDesiredFrequency(const TinyCLR_Pwm_Controller* self, double& frequency) {
     auto state = reinterpret_cast<PwmState*>(self->ApiInfo->State);
 
+    // the pattern is made for the current period
+    if (state->sequenceActive)
+        return TinyCLR_Result::InvalidOperation;
+
     // If detected a different, save desired frequency
     state->theoryFreq = frequency;
 
@@ -435,10 +509,167 @@ TinyCLR_Result STM32F4_Pwm_SetDesiredFrequency(const TinyCLR_Pwm_Controller* sel
     frequency = STM32F4_Pwm_GetActualFrequency(self);
 
     // Update channel if frequency had different
-    for (int p = 0; p < PWM_PER_CONTROLLER; p++)
+    for (int p = 0; p < PWM_PER_CONTROLLER; p++) {
+        if (state->isDutyCycleFixed[p])
+            state->dutyCycle[p] = (double)state->fixedDutyCycle[p] / STM32F4_PWM_FULL_DUTY_CYCLE;
+
         if (state->gpioPin[p].number != PIN_NONE)
             if (STM32F4_Pwm_SetPulseParameters(self, p, state->dutyCycle[p], state->invert[p]) != TinyCLR_Result::Success)
                 return TinyCLR_Result::InvalidOperation;
+    }
+
+    return TinyCLR_Result::Success;
+}
+
+// Compare values are 32 bits on TIM2 and TIM5 and 16 bits on the other timers, the pattern samples have the same size.
+size_t STM32F4_Pwm_GetSequenceSampleSize(const TinyCLR_Pwm_Controller* self) {
+    auto state = reinterpret_cast<PwmState*>(self->ApiInfo->State);
+
+    return (state->timer == 2 || state->timer == 5) ? sizeof(uint32_t) : sizeof(uint16_t);
+}
+
+// Turns Q16 duty cycles into the pattern StartSequence plays, for the frequency that is set now. dutyCycles holds
+// length values frame after frame, a frame has one value for each of the channelCount channels starting at
+// firstChannel. pattern takes length samples of GetSequenceSampleSize bytes. The polarity is applied by the timer
+// and does not change the pattern, so it only has to be encoded again when the frequency changes.
+TinyCLR_Result STM32F4_Pwm_EncodeSequence(const TinyCLR_Pwm_Controller* self, uint32_t firstChannel, uint32_t channelCount, const uint32_t* dutyCycles, size_t length, void* pattern) {
+    if (dutyCycles == nullptr || pattern == nullptr)
+        return TinyCLR_Result::ArgumentNull;
+
+    auto state = reinterpret_cast<PwmState*>(self->ApiInfo->State);
+
+    // no frequency set yet
+    if (state->period == 0)
+        return TinyCLR_Result::InvalidOperation;
+
+    if (channelCount == 0 || firstChannel + channelCount > PWM_PER_CONTROLLER)
+        return TinyCLR_Result::ArgumentOutOfRange;
+
+    if (length % channelCount != 0)
+        return TinyCLR_Result::ArgumentInvalid;
+
+    if (STM32F4_Pwm_GetSequenceSampleSize(self) == sizeof(uint32_t))
+        PwmSequence_EncodeCompare(dutyCycles, length, state->period, reinterpret_cast<uint32_t*>(pattern));
+    else
+        PwmSequence_EncodeCompare(dutyCycles, length, state->period, reinterpret_cast<uint16_t*>(pattern));
+
+    return TinyCLR_Result::Success;
+}
+
+static void STM32F4_Pwm_StartSequenceDma(PwmState* state) {
+    auto size = (state->timer == 2 || state->timer == 5) ? (DMA_SxCR_MSIZE_1 | DMA_SxCR_PSIZE_1) : (DMA_SxCR_MSIZE_0 | DMA_SxCR_PSIZE_0);
+    auto circular = state->sequenceRepeat == 0 ? DMA_SxCR_CIRC : 0;
+
+    STM32F4_DmaInternal_Start(pwmSequencerDmaStreams[state->controllerIndex], &state->timReg->DMAR, state->sequencePattern, state->sequenceLength, STM32F4_PWM_SEQUENCER_DMA_CONFIGURATION | size | circular);
+}
+
+static void STM32F4_Pwm_EndSequence(PwmState* state) {
+    if (!state->sequenceActive)
+        return;
+
+    state->timReg->DIER &= ~TIM_DIER_UDE;
+
+    STM32F4_DmaInternal_CloseStream(pwmSequencerDmaStreams[state->controllerIndex]);
+
+    state->sequenceActive = false;
+}
+
+static void STM32F4_Pwm_SequenceDmaHandler(void* param, uint32_t flags) {
+    auto state = reinterpret_cast<PwmState*>(param);
+    auto handler = state->sequenceHandler;
+
+    if (flags & DMA_LISR_TEIF0) {
+        // the stream has disabled itself
+        STM32F4_Pwm_EndSequence(state);
+
+        if (handler != nullptr)
+            handler(state->sequenceParam, true);
+
+        return;
+    }
+
+    if (flags & DMA_LISR_TCIF0) {
+        if (state->sequenceRepeat > 1) {
+            // the last frame has been moved, the next update request is a period away
+            state->sequenceRepeat--;
+
+            STM32F4_Pwm_StartSequenceDma(state);
+
+            return;
+        }
+
+        // the compare registers keep the last frame
+        if (state->sequenceRepeat == 1)
+            STM32F4_Pwm_EndSequence(state);
+
+        if (handler != nullptr)
+            handler(state->sequenceParam, false);
+    }
+}
+
+// Plays pattern, made by EncodeSequence, on channelCount channels starting at firstChannel. Every update event of
+// the timer asks for the next frame, a DMA burst through DMAR moves it into the preloaded compare registers and it
+// drives the period after. The pattern is played repeatCount times, zero loops until StopSequence. handler, which
+// can be null, is called from the DMA interrupt when the last pass is done, after every pass while looping, and with
+// error set when a transfer error has stopped the sequence. The channels have to be open with a frequency set, their
+// outputs follow the pattern once enabled. The pattern is read while playing and has to stay in place.
+TinyCLR_Result STM32F4_Pwm_StartSequence(const TinyCLR_Pwm_Controller* self, uint32_t firstChannel, uint32_t channelCount, const void* pattern, size_t length, uint32_t repeatCount, STM32F4_Pwm_SequenceHandler handler, void* param) {
+    if (pattern == nullptr)
+        return TinyCLR_Result::ArgumentNull;
+
+    auto state = reinterpret_cast<PwmState*>(self->ApiInfo->State);
+
+    if (state->sequenceActive || state->period == 0)
+        return TinyCLR_Result::InvalidOperation;
+
+    if (channelCount == 0 || firstChannel + channelCount > PWM_PER_CONTROLLER)
+        return TinyCLR_Result::ArgumentOutOfRange;
+
+    for (auto channel = firstChannel; channel < firstChannel + channelCount; channel++)
+        if (!state->isOpened[channel])
+            return TinyCLR_Result::InvalidOperation;
+
+    auto size = STM32F4_Pwm_GetSequenceSampleSize(self);
+
+    // NDTR is 16 bits and a pass ends on a whole frame
+    if (length == 0 || length > 0xFFFF || length % channelCount != 0)
+        return TinyCLR_Result::ArgumentInvalid;
+
+    if (((uint32_t)pattern & (size - 1)) != 0 || !STM32F4_DmaInternal_IsAccessible(pattern))
+        return TinyCLR_Result::ArgumentInvalid;
+
+    if (state->controllerIndex >= SIZEOF_ARRAY(pwmSequencerDmaStreams) || pwmSequencerDmaStreams[state->controllerIndex].controller == 0)
+        return TinyCLR_Result::NotSupported;
+
+    if (!STM32F4_DmaInternal_OpenStream(pwmSequencerDmaStreams[state->controllerIndex]))
+        return TinyCLR_Result::SharingViolation;
+
+    auto treg = state->timReg;
+
+    state->sequenceActive = true;
+    state->sequenceRepeat = repeatCount;
+    state->sequencePattern = pattern;
+    state->sequenceLength = length;
+    state->sequenceHandler = handler;
+    state->sequenceParam = param;
+
+    // a burst writes CCRx of the first channel and the ones after it
+    auto base = ((uint32_t)&treg->CCR1 - (uint32_t)treg) / sizeof(uint32_t) + firstChannel;
+
+    treg->DCR = (base << TIM_DCR_DBA_Pos) | ((channelCount - 1) << TIM_DCR_DBL_Pos);
+
+    STM32F4_DmaInternal_SetHandler(pwmSequencerDmaStreams[state->controllerIndex], &STM32F4_Pwm_SequenceDmaHandler, state);
+    STM32F4_Pwm_StartSequenceDma(state);
+
+    treg->DIER |= TIM_DIER_UDE;
+
+    return TinyCLR_Result::Success;
+}
+
+TinyCLR_Result STM32F4_Pwm_StopSequence(const TinyCLR_Pwm_Controller* self) {
+    auto state = reinterpret_cast<PwmState*>(self->ApiInfo->State);
+
+    STM32F4_Pwm_EndSequence(state);
 
     return TinyCLR_Result::Success;
 }
@@ -446,6 +677,16 @@ TinyCLR_Result STM32F4_Pwm_SetDesiredFrequency(const TinyCLR_Pwm_Controller* sel
 TinyCLR_Result STM32F4_Pwm_Acquire(const TinyCLR_Pwm_Controller* self) {
     auto state = reinterpret_cast<PwmState*>(self->ApiInfo->State);
 
+#ifdef STM32F4_TIME_TIMER
+    // the timer keeps native time
+    if (state->controllerIndex + 1 == STM32F4_TIME_TIMER)
+        return TinyCLR_Result::SharingViolation;
+#endif
+
+    // the timer is driving a conversion trigger for another driver
+    if (pwmReservedTimers & (1 << state->timer))
+        return TinyCLR_Result::SharingViolation;
+
     if (state->initializeCount == 0)
         STM32F4_Pwm_ResetController(state->controllerIndex);
 
@@ -467,6 +708,22 @@ TinyCLR_Result STM32F4_Pwm_Release(const TinyCLR_Pwm_Controller* self) {
     return TinyCLR_Result::Success;
 }
 
+// Takes a timer away from the PWM controllers, fails while its controller is acquired or the timer is already reserved.
+bool STM32F4_PwmInternal_ReserveTimer(uint32_t timer) {
+    auto controllerIndex = timer - 1;
+
+    if ((pwmReservedTimers & (1 << timer)) || (controllerIndex < TOTAL_PWM_CONTROLLERS && pwmStates[controllerIndex].initializeCount > 0))
+        return false;
+
+    pwmReservedTimers |= (1 << timer);
+
+    return true;
+}
+
+void STM32F4_PwmInternal_ReleaseTimer(uint32_t timer) {
+    pwmReservedTimers &= ~(1 << timer);
+}
+
 void STM32F4_Pwm_Reset() {
     if (TOTAL_PWM_CONTROLLERS > 0) pwmStates[0].timReg = TIM1;
     if (TOTAL_PWM_CONTROLLERS > 1) pwmStates[1].timReg = TIM2;
@@ -494,12 +751,15 @@ void STM32F4_Pwm_Reset() {
 void STM32F4_Pwm_ResetController(int32_t controllerIndex) {
     auto state = &pwmStates[controllerIndex];
 
+    STM32F4_Pwm_EndSequence(state);
+
     for (int p = 0; p < PWM_PER_CONTROLLER; p++) {
         state->gpioPin[p].number = pwmPins[controllerIndex][p].number;
         state->gpioPin[p].alternateFunction = pwmPins[controllerIndex][p].alternateFunction;
 
         if (state->gpioPin[p].number != PIN_NONE) {
             state->dutyCycle[p] = 0;
+            state->isDutyCycleFixed[p] = false;
             state->invert[p] = TinyCLR_Pwm_PulsePolarity::ActiveLow;
         }
 
@@ -1073,6 +1073,13 @@ SD_Error SD_ReadBlock(uint8_t *readbuff, uint32_t ReadAddr, uint16_t BlockSize);
 SD_Error SD_WriteBlock(uint8_t *writebuff, uint32_t WriteAddr, uint16_t BlockSize);
 SDTransferState SD_GetTransferState(void);
 SD_Error SD_StopTransfer(void);
+#ifdef STM32F4_SD_DMA_STREAM
+SD_Error SD_ReadMultiBlocks(uint8_t *readbuff, uint32_t ReadAddr, uint16_t BlockSize, uint32_t NumberOfBlocks);
+SD_Error SD_WriteMultiBlocks(uint8_t *writebuff, uint32_t WriteAddr, uint16_t BlockSize, uint32_t NumberOfBlocks);
+
+/* Keeps the stream's word count and the SDIO data length well inside their limits */
+#define SD_DMA_MAX_BLOCKS 128
+#endif
 SD_Error SD_SendStatus(uint32_t *pcardstatus);
 SD_Error SD_SendSDStatus(uint32_t *psdstatus);
 
@@ -1999,6 +2006,192 @@ SD_Error SD_WriteBlock(uint8_t *writebuff, uint32_t WriteAddr, uint16_t BlockSiz
     return(errorstatus);
 }
 
+#ifdef STM32F4_SD_DMA_STREAM
+static const STM32F4_Dma_Stream sdCardDmaStream = STM32F4_SD_DMA_STREAM;
+
+/* The SDIO is the flow controller, the stream moves 4 words per burst through its FIFO */
+#define SD_DMA_CONFIGURATION        (DMA_SxCR_PFCTRL | DMA_SxCR_MINC | DMA_SxCR_PSIZE_1 | DMA_SxCR_MSIZE_1 | DMA_SxCR_PL_0 | DMA_SxCR_PL_1 | DMA_SxCR_PBURST_0 | DMA_SxCR_MBURST_0)
+#define SD_DMA_FIFO_CONFIGURATION   (DMA_SxFCR_DMDIS | DMA_SxFCR_FTH_0 | DMA_SxFCR_FTH_1)
+
+/**
+  * @brief  Waits for the end of a DMA data transfer and releases the stream.
+  * @param  ErrorFlags: SDIO flags that abort the transfer.
+  * @retval SD_Error: SD Card Error code.
+  */
+static SD_Error SD_WaitDmaTransfer(uint32_t ErrorFlags) {
+    SD_Error errorstatus = SD_OK;
+    uint32_t timeout = SD_DATATIMEOUT;
+
+    while (!(SDIO->STA & (SDIO_FLAG_DATAEND | ErrorFlags)) && !(STM32F4_DmaInternal_GetFlags(sdCardDmaStream) & DMA_LISR_TEIF0));
+
+    if (SDIO_GetFlagStatus(SDIO_FLAG_DTIMEOUT) != RESET) {
+        errorstatus = SD_DATA_TIMEOUT;
+    }
+    else if (SDIO_GetFlagStatus(SDIO_FLAG_DCRCFAIL) != RESET) {
+        errorstatus = SD_DATA_CRC_FAIL;
+    }
+    else if ((ErrorFlags & SDIO_FLAG_RXOVERR) && SDIO_GetFlagStatus(SDIO_FLAG_RXOVERR) != RESET) {
+        errorstatus = SD_RX_OVERRUN;
+    }
+    else if ((ErrorFlags & SDIO_FLAG_TXUNDERR) && SDIO_GetFlagStatus(SDIO_FLAG_TXUNDERR) != RESET) {
+        errorstatus = SD_TX_UNDERRUN;
+    }
+    else if (SDIO_GetFlagStatus(SDIO_FLAG_STBITERR) != RESET) {
+        errorstatus = SD_START_BIT_ERR;
+    }
+    else {
+        /*!< The stream may still be draining its FIFO after the SDIO reported data end */
+        while (!(STM32F4_DmaInternal_GetFlags(sdCardDmaStream) & (DMA_LISR_TCIF0 | DMA_LISR_TEIF0)) && (timeout > 0)) {
+            timeout--;
+        }
+
+        if (timeout == 0 || (STM32F4_DmaInternal_GetFlags(sdCardDmaStream) & DMA_LISR_TEIF0)) {
+            errorstatus = SD_ERROR;
+        }
+    }
+
+    STM32F4_DmaInternal_Stop(sdCardDmaStream);
+
+    SDIO->DCTRL = 0x0;
+
+    /*!< Clear all the static flags */
+    SDIO_ClearFlag(SDIO_STATIC_FLAGS);
+
+    return(errorstatus);
+}
+
+/**
+  * @brief  Allows to read blocks from a specified address in a card using DMA.
+  *         More than one block is read with CMD18 READ_MULT_BLOCK followed by
+  *         CMD12 STOP_TRANSMISSION.
+  * @param  readbuff: pointer to the buffer that will contain the received data,
+  *         must be word aligned and reachable by the DMA.
+  * @param  ReadAddr: Address from where data are to be read.
+  * @param  BlockSize: the SD card Data block size. The Block size should be 512.
+  * @param  NumberOfBlocks: number of blocks to be read, at most SD_DMA_MAX_BLOCKS.
+  * @retval SD_Error: SD Card Error code.
+  */
+SD_Error SD_ReadMultiBlocks(uint8_t *readbuff, uint32_t ReadAddr, uint16_t BlockSize, uint32_t NumberOfBlocks) {
+    SD_Error errorstatus = SD_OK;
+    uint8_t command = NumberOfBlocks > 1 ? SD_CMD_READ_MULT_BLOCK : SD_CMD_READ_SINGLE_BLOCK;
+
+    TransferError = SD_OK;
+    TransferEnd = 0;
+    StopCondition = NumberOfBlocks > 1 ? 1 : 0;
+
+    SDIO->DCTRL = 0x0;
+
+    if (CardType == SDIO_HIGH_CAPACITY_SD_CARD) {
+        BlockSize = 512;
+        ReadAddr /= 512;
+    }
+
+    /* Set Block Size for Card */
+    SDIO_SendCommand((uint32_t)BlockSize, SD_CMD_SET_BLOCKLEN, SDIO_Response_Short);
+
+    errorstatus = CmdResp1Error(SD_CMD_SET_BLOCKLEN);
+
+    if (SD_OK != errorstatus) {
+        return(errorstatus);
+    }
+
+    /*!< The stream must be armed before the data path starts filling the FIFO */
+    SDIO->DCTRL |= SDIO_DCTRL_DMAEN;
+
+    STM32F4_DmaInternal_Start(sdCardDmaStream, &SDIO->FIFO, readbuff, NumberOfBlocks * BlockSize / 4, SD_DMA_CONFIGURATION, SD_DMA_FIFO_CONFIGURATION);
+
+    SDIO_DataConfig(NumberOfBlocks * BlockSize, (uint32_t)9 << 4, SDIO_TransferDir_ToSDIO);
+
+    /*!< Send CMD18 READ_MULT_BLOCK or CMD17 READ_SINGLE_BLOCK */
+    SDIO_SendCommand((uint32_t)ReadAddr, command, SDIO_Response_Short);
+
+    errorstatus = CmdResp1Error(command);
+
+    if (errorstatus != SD_OK) {
+        STM32F4_DmaInternal_Stop(sdCardDmaStream);
+
+        SDIO->DCTRL = 0x0;
+
+        return(errorstatus);
+    }
+
+    errorstatus = SD_WaitDmaTransfer(SDIO_FLAG_DCRCFAIL | SDIO_FLAG_DTIMEOUT | SDIO_FLAG_RXOVERR | SDIO_FLAG_STBITERR);
+
+    if (StopCondition == 1) {
+        SD_Error stopstatus = SD_StopTransfer();
+
+        if (errorstatus == SD_OK) {
+            errorstatus = stopstatus;
+        }
+    }
+
+    return(errorstatus);
+}
+
+/**
+  * @brief  Allows to write blocks starting from a specified address in a card
+  *         using DMA. More than one block is written with CMD25 WRITE_MULT_BLOCK
+  *         followed by CMD12 STOP_TRANSMISSION.
+  * @param  writebuff: pointer to the buffer that contain the data to be transferred,
+  *         must be word aligned and reachable by the DMA.
+  * @param  WriteAddr: Address from where data are to be written.
+  * @param  BlockSize: the SD card Data block size. The Block size should be 512.
+  * @param  NumberOfBlocks: number of blocks to be written, at most SD_DMA_MAX_BLOCKS.
+  * @retval SD_Error: SD Card Error code.
+  */
+SD_Error SD_WriteMultiBlocks(uint8_t *writebuff, uint32_t WriteAddr, uint16_t BlockSize, uint32_t NumberOfBlocks) {
+    SD_Error errorstatus = SD_OK;
+    uint8_t command = NumberOfBlocks > 1 ? SD_CMD_WRITE_MULT_BLOCK : SD_CMD_WRITE_SINGLE_BLOCK;
+
+    TransferError = SD_OK;
+    TransferEnd = 0;
+    StopCondition = NumberOfBlocks > 1 ? 1 : 0;
+
+    SDIO->DCTRL = 0x0;
+
+    if (CardType == SDIO_HIGH_CAPACITY_SD_CARD) {
+        BlockSize = 512;
+        WriteAddr /= 512;
+    }
+
+    /* Set Block Size for Card */
+    SDIO_SendCommand((uint32_t)BlockSize, SD_CMD_SET_BLOCKLEN, SDIO_Response_Short);
+
+    errorstatus = CmdResp1Error(SD_CMD_SET_BLOCKLEN);
+
+    if (SD_OK != errorstatus) {
+        return(errorstatus);
+    }
+
+    /*!< Send CMD25 WRITE_MULT_BLOCK or CMD24 WRITE_SINGLE_BLOCK */
+    SDIO_SendCommand((uint32_t)WriteAddr, command, SDIO_Response_Short);
+
+    errorstatus = CmdResp1Error(command);
+
+    if (errorstatus != SD_OK) {
+        return(errorstatus);
+    }
+
+    SDIO->DCTRL |= SDIO_DCTRL_DMAEN;
+
+    STM32F4_DmaInternal_Start(sdCardDmaStream, &SDIO->FIFO, writebuff, NumberOfBlocks * BlockSize / 4, SD_DMA_CONFIGURATION | DMA_SxCR_DIR_0, SD_DMA_FIFO_CONFIGURATION);
+
+    SDIO_DataConfig(NumberOfBlocks * BlockSize, (uint32_t)9 << 4, SDIO_TransferDir_ToCard);
+
+    errorstatus = SD_WaitDmaTransfer(SDIO_FLAG_DCRCFAIL | SDIO_FLAG_DTIMEOUT | SDIO_FLAG_TXUNDERR | SDIO_FLAG_STBITERR);
+
+    if (StopCondition == 1) {
+        SD_Error stopstatus = SD_StopTransfer();
+
+        if (errorstatus == SD_OK) {
+            errorstatus = stopstatus;
+        }
+    }
+
+    return(errorstatus);
+}
+#endif
+
 /**
   * @brief  Gets the cuurent data transfer state.
   * @param  None
@@ -2614,6 +2807,8 @@ struct SdCardState {
     TinyCLR_Storage_Descriptor descriptor;
 
     uint16_t initializeCount;
+
+    bool dmaEnabled;
 };
 
 static const STM32F4_Gpio_Pin sdCardData0Pins[] = STM32F4_SD_DATA0_PINS;
@@ -2694,6 +2889,10 @@ TinyCLR_Result STM32F4_SdCard_Acquire(const TinyCLR_Storage_Controller* self) {
 
         SD_DeInit();
 
+#ifdef STM32F4_SD_DMA_STREAM
+        state->dmaEnabled = STM32F4_DmaInternal_OpenStream(sdCardDmaStream);
+#endif
+
         auto trycount = 3;
     tryinit:
         if (SD_Init() == SD_OK) {
@@ -2726,6 +2925,13 @@ TinyCLR_Result STM32F4_SdCard_Release(const TinyCLR_Storage_Controller* self) {
 
         SD_DeInit();
 
+#ifdef STM32F4_SD_DMA_STREAM
+        if (state->dmaEnabled)
+            STM32F4_DmaInternal_CloseStream(sdCardDmaStream);
+
+        state->dmaEnabled = false;
+#endif
+
         RCC->APB2ENR &= ~(1 << 11);
 
         auto memoryProvider = (const TinyCLR_Memory_Manager*)apiManager->FindDefault(apiManager, TinyCLR_Api_Type::MemoryManager);
@@ -2743,7 +2949,9 @@ TinyCLR_Result STM32F4_SdCard_Release(const TinyCLR_Storage_Controller* self) {
     return TinyCLR_Result::Success;
 }
 
-TinyCLR_Result STM32F4_SdCard_Write(const TinyCLR_Storage_Controller* self, uint64_t address, size_t& count, const uint8_t* data, uint64_t timeout) {
+// One block at a time, a block that fails is stopped and tried again until the card does not come back to the
+// transfer state within timeout.
+static TinyCLR_Result STM32F4_SdCard_WritePolled(uint64_t address, size_t count, const uint8_t* data, uint64_t timeout) {
     int32_t index = 0;
 
     int32_t to;
@@ -2778,7 +2986,7 @@ TinyCLR_Result STM32F4_SdCard_Write(const TinyCLR_Storage_Controller* self, uint
     return TinyCLR_Result::Success;
 }
 
-TinyCLR_Result STM32F4_SdCard_Read(const TinyCLR_Storage_Controller* self, uint64_t address, size_t& count, uint8_t* data, uint64_t timeout) {
+static TinyCLR_Result STM32F4_SdCard_ReadPolled(uint64_t address, size_t count, uint8_t* data, uint64_t timeout) {
     int32_t index = 0;
 
     int32_t to;
@@ -2812,6 +3020,129 @@ TinyCLR_Result STM32F4_SdCard_Read(const TinyCLR_Storage_Controller* self, uint6
     return TinyCLR_Result::Success;
 }
 
+#ifdef STM32F4_SD_DMA_STREAM
+static bool STM32F4_SdCard_CanUseDma(const SdCardState* state, const uint8_t* data) {
+    return state->dmaEnabled && ((uint32_t)data & 0x03) == 0 && STM32F4_DmaInternal_IsAccessible(data);
+}
+
+// Up to SD_DMA_MAX_BLOCKS per command. A command that fails is stopped and the rest, from its first block on,
+// goes through the polled path with its retries.
+static TinyCLR_Result STM32F4_SdCard_TransferDma(uint64_t address, size_t count, uint8_t* data, uint64_t timeout, bool write) {
+    int32_t to;
+
+    auto sectorCount = count;
+
+    auto sectorNum = address;
+
+    while (sectorCount) {
+        auto blocks = sectorCount < SD_DMA_MAX_BLOCKS ? sectorCount : SD_DMA_MAX_BLOCKS;
+
+        to = timeout;
+
+        while (SD_GetStatus() != SD_TRANSFER_OK && to--) {
+            STM32F4_Time_Delay(nullptr, 1);
+        }
+
+        if (to <= 0)
+            return TinyCLR_Result::TimedOut;
+
+        auto result = write ? SD_WriteMultiBlocks(data, sectorNum * STM32F4_SD_SECTOR_SIZE, STM32F4_SD_SECTOR_SIZE, blocks) : SD_ReadMultiBlocks(data, sectorNum * STM32F4_SD_SECTOR_SIZE, STM32F4_SD_SECTOR_SIZE, blocks);
+
+        if (result != SD_OK) {
+            SD_StopTransfer();
+
+            return write ? STM32F4_SdCard_WritePolled(sectorNum, sectorCount, data, timeout) : STM32F4_SdCard_ReadPolled(sectorNum, sectorCount, data, timeout);
+        }
+
+        data += blocks * STM32F4_SD_SECTOR_SIZE;
+        sectorNum += blocks;
+        sectorCount -= blocks;
+    }
+
+    return TinyCLR_Result::Success;
+}
+#endif
+
+TinyCLR_Result STM32F4_SdCard_Write(const TinyCLR_Storage_Controller* self, uint64_t address, size_t& count, const uint8_t* data, uint64_t timeout) {
+#ifdef STM32F4_SD_DMA_STREAM
+    if (STM32F4_SdCard_CanUseDma(reinterpret_cast<SdCardState*>(self->ApiInfo->State), data))
+        return STM32F4_SdCard_TransferDma(address, count, const_cast<uint8_t*>(data), timeout, true);
+#endif
+
+    return STM32F4_SdCard_WritePolled(address, count, data, timeout);
+}
+
+TinyCLR_Result STM32F4_SdCard_Read(const TinyCLR_Storage_Controller* self, uint64_t address, size_t& count, uint8_t* data, uint64_t timeout) {
+#ifdef STM32F4_SD_DMA_STREAM
+    if (STM32F4_SdCard_CanUseDma(reinterpret_cast<SdCardState*>(self->ApiInfo->State), data))
+        return STM32F4_SdCard_TransferDma(address, count, data, timeout, false);
+#endif
+
+    return STM32F4_SdCard_ReadPolled(address, count, data, timeout);
+}
+
+#ifdef STM32F4_SD_BENCHMARK
+static const size_t sdCardBenchmarkRuns[STM32F4_SD_BENCHMARK_RUNS] = { 1, 8, 64, 256 };
+
+// KB/s of one run, 0 when it failed.
+static uint32_t STM32F4_SdCard_MeasureRun(uint64_t address, size_t count, uint8_t* buffer, bool write, bool dma) {
+    auto start = STM32F4_Time_GetCurrentProcessorTime();
+    auto result = TinyCLR_Result::InvalidOperation;
+
+#ifdef STM32F4_SD_DMA_STREAM
+    if (dma)
+        result = STM32F4_SdCard_TransferDma(address, count, buffer, STM32F4_SD_BENCHMARK_TIMEOUT, write);
+    else
+#endif
+        result = write ? STM32F4_SdCard_WritePolled(address, count, buffer, STM32F4_SD_BENCHMARK_TIMEOUT) : STM32F4_SdCard_ReadPolled(address, count, buffer, STM32F4_SD_BENCHMARK_TIMEOUT);
+
+    // processor time is in 100ns units
+    auto elapsed = STM32F4_Time_GetCurrentProcessorTime() - start;
+
+    if (result != TinyCLR_Result::Success || elapsed == 0)
+        return 0;
+
+    return static_cast<uint32_t>(((uint64_t)count * STM32F4_SD_SECTOR_SIZE * 10000000 / 1024) / elapsed);
+}
+
+// Throughput of runs of 1, 8, 64 and 256 sectors at address, polled and, where the device has the stream, by DMA.
+// buffer holds STM32F4_SD_BENCHMARK_MAX_SECTORS sectors and must be word aligned outside CCM RAM for the DMA runs.
+// Writes put back what was read first, so the card keeps its contents. Built with STM32F4_SD_BENCHMARK, for a
+// debugger or a test build to call on a board with a card in it.
+TinyCLR_Result STM32F4_SdCard_Benchmark(const TinyCLR_Storage_Controller* self, uint64_t address, uint8_t* buffer, STM32F4_SdCard_BenchmarkResult* results) {
+    auto state = reinterpret_cast<SdCardState*>(self->ApiInfo->State);
+    size_t count = STM32F4_SD_BENCHMARK_MAX_SECTORS;
+
+    if (buffer == nullptr || results == nullptr)
+        return TinyCLR_Result::ArgumentNull;
+
+    if (STM32F4_SdCard_ReadPolled(address, count, buffer, STM32F4_SD_BENCHMARK_TIMEOUT) != TinyCLR_Result::Success)
+        return TinyCLR_Result::InvalidOperation;
+
+    for (auto i = 0; i < STM32F4_SD_BENCHMARK_RUNS; i++) {
+        auto& result = results[i];
+        auto sectors = sdCardBenchmarkRuns[i];
+
+        result.Sectors = sectors;
+        result.PolledRead = STM32F4_SdCard_MeasureRun(address, sectors, buffer, false, false);
+        result.PolledWrite = STM32F4_SdCard_MeasureRun(address, sectors, buffer, true, false);
+        result.DmaRead = 0;
+        result.DmaWrite = 0;
+
+#ifdef STM32F4_SD_DMA_STREAM
+        if (STM32F4_SdCard_CanUseDma(state, buffer)) {
+            result.DmaRead = STM32F4_SdCard_MeasureRun(address, sectors, buffer, false, true);
+            result.DmaWrite = STM32F4_SdCard_MeasureRun(address, sectors, buffer, true, true);
+        }
+#else
+        (void)state;
+#endif
+    }
+
+    return TinyCLR_Result::Success;
+}
+#endif
+
 TinyCLR_Result STM32F4_SdCard_IsErased(const TinyCLR_Storage_Controller* self, uint64_t address, size_t count, bool& erased) {
     erased = true;
 
@@ -2856,6 +3187,7 @@ TinyCLR_Result STM32F4_SdCard_Reset() {
         STM32F4_SdCard_Close(&sdCardControllers[i]);
         STM32F4_SdCard_Release(&sdCardControllers[i]);
         sdCardStates[i].initializeCount = 0;
+        sdCardStates[i].dmaEnabled = false;
     }
 
     return TinyCLR_Result::Success;
@@ -15,11 +15,13 @@
 // limitations under the License.
 
 #include "STM32F4.h"
+#include "../../Drivers/SpiTransfer/SpiTransfer.h"
 #include <string.h>
 
 bool STM32F4_Spi_Transaction_Start(int32_t controllerIndex);
 bool STM32F4_Spi_Transaction_Stop(int32_t controllerIndex);
 bool STM32F4_Spi_Transaction_nWrite8_nRead8(int32_t controllerIndex);
+bool STM32F4_Spi_Transaction_nWrite8_nRead8_Dma(int32_t controllerIndex);
 
 typedef  SPI_TypeDef* ptr_SPI_TypeDef;
 
@@ -32,6 +34,18 @@ static const STM32F4_Gpio_Pin spiMosiPins[] = STM32F4_SPI_MOSI_PINS;
 
 static ptr_SPI_TypeDef spiPortRegs[TOTAL_SPI_CONTROLLERS];
 
+#ifdef STM32F4_SPI_DMA_THRESHOLD
+#ifndef STM32F4_SPI_RX_DMA_STREAMS
+#define STM32F4_SPI_RX_DMA_STREAMS { DMA_STREAM(2, 0, 3), DMA_STREAM(1, 3, 0), DMA_STREAM(1, 0, 0), DMA_STREAM(2, 0, 4), DMA_STREAM(2, 3, 2), DMA_STREAM(2, 6, 1) }
+#endif
+#ifndef STM32F4_SPI_TX_DMA_STREAMS
+#define STM32F4_SPI_TX_DMA_STREAMS { DMA_STREAM(2, 5, 3), DMA_STREAM(1, 4, 0), DMA_STREAM(1, 5, 0), DMA_STREAM(2, 1, 4), DMA_STREAM(2, 4, 2), DMA_STREAM(2, 5, 1) }
+#endif
+
+static const STM32F4_Dma_Stream spiRxDmaStreams[] = STM32F4_SPI_RX_DMA_STREAMS;
+static const STM32F4_Dma_Stream spiTxDmaStreams[] = STM32F4_SPI_TX_DMA_STREAMS;
+#endif
+
 const char* spiApiNames[TOTAL_SPI_CONTROLLERS] = {
 #if TOTAL_SPI_CONTROLLERS > 0
 "GHIElectronics.TinyCLR.NativeApis.STM32F4.SpiController\\0",
@@ -71,6 +85,8 @@ struct SpiState {
 
     TinyCLR_Spi_Mode spiMode;
 
+    bool dmaEnabled;
+
     uint16_t initializeCount;
 };
 
@@ -167,56 +183,60 @@ bool STM32F4_Spi_Transaction_Stop(int32_t controllerIndex) {
 bool STM32F4_Spi_Transaction_nWrite8_nRead8(int32_t controllerIndex) {
     auto state = &spiStates[controllerIndex];
 
-    ptr_SPI_TypeDef spi = spiPortRegs[controllerIndex];
-
-    uint8_t* outBuf = state->writeBuffer;
-    uint8_t* inBuf = state->readBuffer;
-    int32_t outLen = state->writeLength;
-    int32_t inLen = state->readLength;
+#ifdef STM32F4_SPI_DMA_THRESHOLD
+    auto length = state->writeLength > state->readLength ? state->writeLength : state->readLength;
 
-    int32_t num = outLen > inLen ? outLen : inLen;
-    int32_t i = 0;
-    int32_t ii = 0;
-    uint8_t out = outLen > 0 ? outBuf[0] : 0;
-    uint8_t in;
-
-    while (!(spi->SR & SPI_SR_TXE)); // wait for Tx empty
+    if (state->dmaEnabled && length >= STM32F4_SPI_DMA_THRESHOLD && STM32F4_DmaInternal_IsAccessible(state->writeBuffer) && STM32F4_DmaInternal_IsAccessible(state->readBuffer))
+        return STM32F4_Spi_Transaction_nWrite8_nRead8_Dma(controllerIndex);
+#endif
 
-    spi->DR = out; // write first word
+    SpiTransfer_Polled(*spiPortRegs[controllerIndex], state->writeBuffer, state->writeLength, state->readBuffer, state->readLength);
 
-    while (++i < num) {
-        if (i < outLen) {
-            out = outBuf[i]; // get new output data
-        }
-        else {
-            out = 0;
-        }
+    return true;
+}
 
-        while (!(spi->SR & SPI_SR_RXNE));
+#ifdef STM32F4_SPI_DMA_THRESHOLD
+// The streams of one controller for SpiTransfer.
+struct STM32F4_Spi_Dma {
+    int32_t controllerIndex;
 
-        in = spi->DR; // read input
+    void StartRx(volatile void* peripheral, const void* memory, size_t count, uint32_t configuration) {
+        STM32F4_DmaInternal_Start(spiRxDmaStreams[controllerIndex], peripheral, memory, count, configuration);
+    }
 
-        while (!(spi->SR & SPI_SR_TXE)); // wait for Tx empty
+    void StartTx(volatile void* peripheral, const void* memory, size_t count, uint32_t configuration) {
+        STM32F4_DmaInternal_Start(spiTxDmaStreams[controllerIndex], peripheral, memory, count, configuration);
+    }
 
-        spi->DR = out; // start output
+    uint32_t WaitRx(size_t count) {
+        // worst case is the slowest prescaler, plus 1ms of slack
+        auto minClockFrequency = STM32F4_Spi_GetMinClockFrequency(&spiControllers[controllerIndex]);
+        auto timeout = ((uint64_t)count * 8 * 10000000) / minClockFrequency + 10000;
+        auto currentTicks = STM32F4_Time_GetCurrentProcessorTime();
+        auto flags = 0U;
 
-        if (ii < inLen) {
-            inBuf[ii] = (uint8_t)in; // save input data
+        while (((flags = STM32F4_DmaInternal_GetFlags(spiRxDmaStreams[controllerIndex])) & (DMA_LISR_TCIF0 | DMA_LISR_TEIF0)) == 0) {
+            if (STM32F4_Time_GetCurrentProcessorTime() - currentTicks > timeout)
+                return 0;
         }
 
-        ii++;
+        return flags;
     }
 
-    while (!(spi->SR & SPI_SR_RXNE));
+    void Stop() {
+        STM32F4_DmaInternal_Stop(spiTxDmaStreams[controllerIndex]);
+        STM32F4_DmaInternal_Stop(spiRxDmaStreams[controllerIndex]);
+    }
+};
 
-    in = spi->DR; // read last input
+bool STM32F4_Spi_Transaction_nWrite8_nRead8_Dma(int32_t controllerIndex) {
+    auto state = &spiStates[controllerIndex];
 
-    if (ii < inLen) {
-        inBuf[ii] = (uint8_t)in; // save last input
-    }
+    STM32F4_Spi_Dma dma = { controllerIndex };
 
-    return true;
+    return SpiTransfer_Dma(*spiPortRegs[controllerIndex], dma, state->writeBuffer, state->writeLength, state->readBuffer, state->readLength);
 }
+#endif
 
 TinyCLR_Result STM32F4_Spi_TransferSequential(const TinyCLR_Spi_Controller* self, const uint8_t* writeBuffer, size_t& writeLength, uint8_t* readBuffer, size_t& readLength, bool deselectAfter) {
     if (STM32F4_Spi_Write(self, writeBuffer, writeLength) != TinyCLR_Result::Success)
@@ -452,6 +472,18 @@ TinyCLR_Result STM32F4_Spi_Acquire(const TinyCLR_Spi_Controller* self) {
 
         spi->CR1 = SPI_CR1_SSM | SPI_CR1_SSI | SPI_CR1_MSTR | SPI_CR1_SPE;
 
+        state->dmaEnabled = false;
+
+#ifdef STM32F4_SPI_DMA_THRESHOLD
+        // streams shared with another driver fall back to polling
+        if (STM32F4_DmaInternal_OpenStream(spiRxDmaStreams[controllerIndex])) {
+            if (STM32F4_DmaInternal_OpenStream(spiTxDmaStreams[controllerIndex]))
+                state->dmaEnabled = true;
+            else
+                STM32F4_DmaInternal_CloseStream(spiRxDmaStreams[controllerIndex]);
+        }
+#endif
+
         STM32F4_GpioInternal_ConfigurePin(sclk.number, STM32F4_Gpio_PortMode::AlternateFunction, STM32F4_Gpio_OutputType::PushPull, STM32F4_Gpio_OutputSpeed::VeryHigh, STM32F4_Gpio_PullDirection::None, sclk.alternateFunction);
         STM32F4_GpioInternal_ConfigurePin(miso.number, STM32F4_Gpio_PortMode::AlternateFunction, STM32F4_Gpio_OutputType::PushPull, STM32F4_Gpio_OutputSpeed::VeryHigh, STM32F4_Gpio_PullDirection::None, miso.alternateFunction);
         STM32F4_GpioInternal_ConfigurePin(mosi.number, STM32F4_Gpio_PortMode::AlternateFunction, STM32F4_Gpio_OutputType::PushPull, STM32F4_Gpio_OutputSpeed::VeryHigh, STM32F4_Gpio_PullDirection::None, mosi.alternateFunction);
@@ -518,6 +550,15 @@ TinyCLR_Result STM32F4_Spi_Release(const TinyCLR_Spi_Controller* self) {
         STM32F4_GpioInternal_ClosePin(miso.number);
         STM32F4_GpioInternal_ClosePin(mosi.number);
 
+#ifdef STM32F4_SPI_DMA_THRESHOLD
+        if (state->dmaEnabled) {
+            STM32F4_DmaInternal_CloseStream(spiRxDmaStreams[controllerIndex]);
+            STM32F4_DmaInternal_CloseStream(spiTxDmaStreams[controllerIndex]);
+
+            state->dmaEnabled = false;
+        }
+#endif
+
         if (state->chipSelectLine != PIN_NONE) {
             STM32F4_GpioInternal_ClosePin(state->chipSelectLine);
 
@@ -15,21 +15,49 @@
 // limitations under the License.
 
 #include "STM32F4.h"
+#include "../../Drivers/TimerWheel/TimerWheel.h"
 
 #define TIMER_IDLE_VALUE  0x0000FFFFFFFFFFFFFull
 
 #define TOTAL_TIME_CONTROLLERS 1
+
+// A device can run native time off a 32 bit timer instead of SysTick by defining STM32F4_TIME_TIMER as 2 or 5. The
+// timer counts freely at its input clock and is extended to 64 bits by counting overflows, next events use a
+// compare match. Time is then read without disabling interrupts and there is no periodic tick to reprogram.
+#ifdef STM32F4_TIME_TIMER
+#if STM32F4_TIME_TIMER == 2
+#define STM32F4_TIME_TIM TIM2
+#define STM32F4_TIME_TIM_IRQn TIM2_IRQn
+#define STM32F4_TIME_TIM_APB1ENR RCC_APB1ENR_TIM2EN
+#elif STM32F4_TIME_TIMER == 5
+#define STM32F4_TIME_TIM TIM5
+#define STM32F4_TIME_TIM_IRQn TIM5_IRQn
+#define STM32F4_TIME_TIM_APB1ENR RCC_APB1ENR_TIM5EN
+#else
+#error STM32F4_TIME_TIMER must be 2 or 5, the 32 bit timers
+#endif
+
+// APB1 timers run at twice the bus clock unless the bus is undivided
+#define SLOW_CLOCKS_PER_SECOND (STM32F4_APB1_CLOCK_HZ == STM32F4_AHB_CLOCK_HZ ? STM32F4_APB1_CLOCK_HZ : STM32F4_APB1_CLOCK_HZ * 2)
+#else
 #define SLOW_CLOCKS_PER_SECOND STM32F4_AHB_CLOCK_HZ
+#endif
+
 #define SLOW_CLOCKS_TEN_MHZ_GCD           1000000   // GCD(SLOW_CLOCKS_PER_SECOND, 10M)
 #define SLOW_CLOCKS_MILLISECOND_GCD          1000   // GCD(SLOW_CLOCKS_PER_SECOND, 1k)
 #define CLOCK_COMMON_FACTOR               1000000   // GCD(STM32F4_SYSTEM_CLOCK_HZ, 1M)
 #define CORTEXM_SLEEP_USEC_FIXED_OVERHEAD_CLOCKS 3
 
+#ifndef STM32F4_TIME_WHEEL_RESOLUTION
+#define STM32F4_TIME_WHEEL_RESOLUTION (SLOW_CLOCKS_PER_SECOND / 1000)
+#endif
+
 struct TimeState {
     int32_t controllerIndex;
     uint64_t m_lastRead;
     uint32_t m_currentTick;
     uint32_t m_periodTicks;
+    volatile uint32_t m_overflows;
 
     TinyCLR_NativeTime_Callback m_DequeuAndExecute;
 
@@ -92,6 +120,10 @@ void STM32F4_Time_AddApi(const TinyCLR_Api_Manager* apiManager) {
 }
 
 static uint64_t timerNextEvent;   // tick time of next event to be scheduled
+static uint64_t coreNextEvent;    // the runtime's part of it, timerNextEvent also covers the timer wheel
+
+static void STM32F4_Time_ScheduleEvent(const TinyCLR_NativeTime_Controller* self);
+static void STM32F4_Time_Dispatch(const TinyCLR_NativeTime_Controller* self);
 
 uint64_t STM32F4_Time_GetTimeForProcessorTicks(const TinyCLR_NativeTime_Controller* self, uint64_t ticks) {
     ticks *= (10000000 / SLOW_CLOCKS_TEN_MHZ_GCD);
@@ -114,6 +146,176 @@ uint64_t STM32F4_Time_GetCurrentProcessorTime() {
     return STM32F4_Time_GetTimeForProcessorTicks(nullptr, STM32F4_Time_GetCurrentProcessorTicks(nullptr));
 }
 
+TinyCLR_Result STM32F4_Time_SetNextTickCallbackTime(const TinyCLR_NativeTime_Controller* self, uint64_t processorTicks) {
+    DISABLE_INTERRUPTS_SCOPED(irq);
+
+    coreNextEvent = processorTicks;
+
+    STM32F4_Time_ScheduleEvent(self);
+
+    return TinyCLR_Result::Success;
+}
+
+// The hardware keeps one event, the earlier of what the runtime asked for and the next timer wheel expiry.
+static void STM32F4_Time_UpdateNextEvent() {
+    auto wheelNextEvent = TimerWheel_GetNextEvent();
+
+    timerNextEvent = wheelNextEvent < coreNextEvent ? wheelNextEvent : coreNextEvent;
+}
+
+static void STM32F4_Time_ScheduleTimerWheel() {
+    DISABLE_INTERRUPTS_SCOPED(irq);
+
+    STM32F4_Time_ScheduleEvent(nullptr);
+}
+
+// Runs what is due at the event: the timer wheel callbacks, then the runtime's work, which schedules its next event
+// again if it has one.
+static void STM32F4_Time_Dispatch(const TinyCLR_NativeTime_Controller* self) {
+    auto state = reinterpret_cast<TimeState*>(self->ApiInfo->State);
+    auto ticks = STM32F4_Time_GetCurrentProcessorTicks(self);
+
+    TimerWheel_Expire(ticks);
+
+    if (ticks >= coreNextEvent) {
+        coreNextEvent = TIMER_IDLE_VALUE;
+
+        state->m_DequeuAndExecute();
+    }
+
+    DISABLE_INTERRUPTS_SCOPED(irq);
+
+    STM32F4_Time_ScheduleEvent(self);
+}
+
+#ifdef STM32F4_TIME_TIMER
+uint64_t STM32F4_Time_GetCurrentProcessorTicks(const TinyCLR_NativeTime_Controller* self) {
+    TimeState* state = ((self == nullptr) ? &timeStates[0] : reinterpret_cast<TimeState*>(self->ApiInfo->State));
+
+    uint32_t high, low, pending;
+
+    // Read again until no overflow was counted in between. An overflow that is not counted yet, because this runs
+    // with interrupts disabled or from a higher priority, shows as a pending update with a counter that has wrapped.
+    do {
+        high = state->m_overflows;
+        low = STM32F4_TIME_TIM->CNT;
+        pending = STM32F4_TIME_TIM->SR & TIM_SR_UIF;
+    } while (high != state->m_overflows);
+
+    if (pending && low < 0x80000000)
+        high++;
+
+    return ((uint64_t)high << 32) | low;
+}
+
+// Sets the compare match for timerNextEvent. An event that is due already is raised right away, one that is more
+// than an overflow away is set when its overflow has come.
+static void STM32F4_Time_ScheduleCompare() {
+    auto ticks = STM32F4_Time_GetCurrentProcessorTicks(nullptr);
+
+    if ((timerNextEvent >> 32) == (ticks >> 32) && timerNextEvent > ticks) {
+        STM32F4_TIME_TIM->CCR1 = (uint32_t)timerNextEvent;
+        STM32F4_TIME_TIM->DIER |= TIM_DIER_CC1IE;
+
+        // the counter may have gone past the compare value while it was set
+        if (STM32F4_Time_GetCurrentProcessorTicks(nullptr) < timerNextEvent)
+            return;
+    }
+    else if (timerNextEvent > ticks) {
+        STM32F4_TIME_TIM->DIER &= ~TIM_DIER_CC1IE;
+
+        return;
+    }
+
+    STM32F4_TIME_TIM->DIER |= TIM_DIER_CC1IE;
+    STM32F4_TIME_TIM->EGR = TIM_EGR_CC1G;
+}
+
+static void STM32F4_Time_ScheduleEvent(const TinyCLR_NativeTime_Controller* self) {
+    STM32F4_Time_UpdateNextEvent();
+
+    STM32F4_Time_ScheduleCompare();
+}
+
+void STM32F4_Time_Interrupt(void* param) {
+    INTERRUPT_STARTED_SCOPED(isr);
+
+    auto state = &timeStates[0];
+    auto sr = STM32F4_TIME_TIM->SR;
+
+    if (sr & TIM_SR_UIF) {
+        // counted and cleared together, a reader that interrupts this must not see one without the other
+        DISABLE_INTERRUPTS_SCOPED(irq);
+
+        state->m_overflows++;
+
+        STM32F4_TIME_TIM->SR = ~TIM_SR_UIF;
+    }
+
+    if (sr & TIM_SR_CC1IF) {
+        STM32F4_TIME_TIM->SR = ~TIM_SR_CC1IF;
+
+        if ((STM32F4_TIME_TIM->DIER & TIM_DIER_CC1IE) && STM32F4_Time_GetCurrentProcessorTicks(nullptr) >= timerNextEvent) {
+            STM32F4_TIME_TIM->DIER &= ~TIM_DIER_CC1IE;
+
+            STM32F4_Time_Dispatch(&timeControllers[0]);
+
+            return;
+        }
+    }
+
+    if (sr & (TIM_SR_UIF | TIM_SR_CC1IF))
+        STM32F4_Time_ScheduleCompare();
+}
+
+extern "C" {
+
+    void SysTick_Handler(void *param) {
+        // not started while the timer keeps time
+    }
+
+}
+
+TinyCLR_Result STM32F4_Time_Initialize(const TinyCLR_NativeTime_Controller* self) {
+    timerNextEvent = TIMER_IDLE_VALUE;
+    coreNextEvent = TIMER_IDLE_VALUE;
+
+    TimeState* state = ((self == nullptr) ? &timeStates[0] : reinterpret_cast<TimeState*>(self->ApiInfo->State));
+
+    state->m_overflows = 0;
+
+    RCC->APB1ENR |= STM32F4_TIME_TIM_APB1ENR;
+
+    // free running over the full 32 bits, only an overflow raises an update
+    STM32F4_TIME_TIM->CR1 = TIM_CR1_URS;
+    STM32F4_TIME_TIM->PSC = 0;
+    STM32F4_TIME_TIM->ARR = 0xFFFFFFFF;
+    STM32F4_TIME_TIM->CCMR1 = 0;
+    STM32F4_TIME_TIM->EGR = TIM_EGR_UG;
+    STM32F4_TIME_TIM->CNT = 0;
+    STM32F4_TIME_TIM->SR = 0;
+    STM32F4_TIME_TIM->DIER = TIM_DIER_UIE;
+
+    STM32F4_InterruptInternal_Activate(STM32F4_TIME_TIM_IRQn, (uint32_t*)&STM32F4_Time_Interrupt, 0);
+
+    STM32F4_TIME_TIM->CR1 |= TIM_CR1_CEN;
+
+    TimerWheel_Initialize(&timeControllers[0], STM32F4_TIME_WHEEL_RESOLUTION, &STM32F4_Time_ScheduleTimerWheel);
+
+    return TinyCLR_Result::Success;
+}
+
+TinyCLR_Result STM32F4_Time_Uninitialize(const TinyCLR_NativeTime_Controller* self) {
+    STM32F4_InterruptInternal_Deactivate(STM32F4_TIME_TIM_IRQn);
+
+    STM32F4_TIME_TIM->CR1 = 0;
+    STM32F4_TIME_TIM->DIER = 0;
+
+    RCC->APB1ENR &= ~STM32F4_TIME_TIM_APB1ENR;
+
+    return TinyCLR_Result::Success;
+}
+#else
 uint64_t STM32F4_Time_GetCurrentProcessorTicks(const TinyCLR_NativeTime_Controller* self) {
     DISABLE_INTERRUPTS_SCOPED(irq);
 
@@ -142,16 +344,14 @@ uint64_t STM32F4_Time_GetCurrentProcessorTicks(const TinyCLR_NativeTime_Controll
     return (uint64_t)(state->m_lastRead);
 }
 
-TinyCLR_Result STM32F4_Time_SetNextTickCallbackTime(const TinyCLR_NativeTime_Controller* self, uint64_t processorTicks) {
+static void STM32F4_Time_ScheduleEvent(const TinyCLR_NativeTime_Controller* self) {
     uint64_t ticks;
 
-    DISABLE_INTERRUPTS_SCOPED(irq);
-
     TimeState* state = ((self == nullptr) ? &timeStates[0] : reinterpret_cast<TimeState*>(self->ApiInfo->State));
 
     ticks = STM32F4_Time_GetCurrentProcessorTicks(self);
 
-    timerNextEvent = processorTicks;
+    STM32F4_Time_UpdateNextEvent();
 
     if (timerNextEvent >= TIMER_IDLE_VALUE) {
         if (ticks >= TIMER_IDLE_VALUE) {
@@ -174,7 +374,19 @@ TinyCLR_Result STM32F4_Time_SetNextTickCallbackTime(const TinyCLR_NativeTime_Con
     }
     else {
         if (ticks >= timerNextEvent) { // missed event
-            state->m_DequeuAndExecute();
+            // the runtime gets its work done before SetNextTickCallbackTime returns, as it always did. Timer wheel
+            // callbacks only ever run from the SysTick handler, never inside SetNextTickCallbackTime or
+            // TimerWheel_Start, so the wheel pends it.
+            auto runtimeDue = self != nullptr && ticks >= coreNextEvent;
+
+            if (!runtimeDue || TimerWheel_GetNextEvent() <= ticks)
+                SCB->ICSR = SCB_ICSR_PENDSTSET_Msk;
+
+            if (runtimeDue) {
+                coreNextEvent = TIMER_IDLE_VALUE;
+
+                state->m_DequeuAndExecute();
+            }
         }
         else {
             state->m_periodTicks = (timerNextEvent - ticks);
@@ -187,8 +399,6 @@ TinyCLR_Result STM32F4_Time_SetNextTickCallbackTime(const TinyCLR_NativeTime_Con
             }
         }
     }
-
-    return TinyCLR_Result::Success;
 }
 
 extern "C" {
@@ -198,15 +408,15 @@ extern "C" {
 
         auto controllerIndex = 0; // default index if no specific
 
-        auto state = &timeStates[controllerIndex];
-
         auto self = &timeControllers[controllerIndex];
 
         if (STM32F4_Time_GetCurrentProcessorTicks(self) >= timerNextEvent) { // handle event
-            state->m_DequeuAndExecute();
+            STM32F4_Time_Dispatch(self);
         }
         else {
-            STM32F4_Time_SetNextTickCallbackTime(self, timerNextEvent);
+            DISABLE_INTERRUPTS_SCOPED(irq);
+
+            STM32F4_Time_ScheduleEvent(self);
         }
     }
 
@@ -214,6 +424,7 @@ extern "C" {
 
 TinyCLR_Result STM32F4_Time_Initialize(const TinyCLR_NativeTime_Controller* self) {
     timerNextEvent = TIMER_IDLE_VALUE;
+    coreNextEvent = TIMER_IDLE_VALUE;
 
     TimeState* state = ((self == nullptr) ? &timeStates[0] : reinterpret_cast<TimeState*>(self->ApiInfo->State));
 
@@ -226,6 +437,8 @@ TinyCLR_Result STM32F4_Time_Initialize(const TinyCLR_NativeTime_Controller* self
 
     state->Reload(state->m_periodTicks);
 
+    TimerWheel_Initialize(&timeControllers[0], STM32F4_TIME_WHEEL_RESOLUTION, &STM32F4_Time_ScheduleTimerWheel);
+
     return TinyCLR_Result::Success;
 }
 
@@ -234,6 +447,7 @@ TinyCLR_Result STM32F4_Time_Uninitialize(const TinyCLR_NativeTime_Controller* se
 
     return TinyCLR_Result::Success;
 }
+#endif
 
 TinyCLR_Result STM32F4_Time_SetTickCallback(const TinyCLR_NativeTime_Controller* self, TinyCLR_NativeTime_Callback callback) {
     TimeState* state = ((self == nullptr) ? &timeStates[0] : reinterpret_cast<TimeState*>(self->ApiInfo->State));
@@ -15,7 +15,9 @@
 // limitations under the License.
 
 #include <algorithm>
+#include <string.h>
 #include "STM32F4.h"
+#include "../../Drivers/RingBuffer/RingBuffer.h"
 
 #define USART_EVENT_POST_DEBOUNCE_TICKS (10 * 10000) // 10ms between each events
 // StopBits
@@ -32,6 +34,14 @@ bool STM32F4_Uart_CanSend(int controllerIndex);
 void STM32F4_Uart_TxBufferEmptyInterruptEnable(int controllerIndex, bool enable);
 void STM32F4_Uart_RxBufferFullInterruptEnable(int controllerIndex, bool enable);
 void STM32F4_Uart_Reset();
+bool STM32F4_Uart_RxDmaStart(int controllerIndex);
+void STM32F4_Uart_RxDmaStop(int controllerIndex);
+void STM32F4_Uart_RxDmaSync(int controllerIndex);
+bool STM32F4_Uart_TxDmaStart(int controllerIndex);
+void STM32F4_Uart_TxDmaStop(int controllerIndex);
+void STM32F4_Uart_TxDmaKick(int controllerIndex);
+size_t STM32F4_Uart_TxDmaAbort(int controllerIndex);
+bool STM32F4_Uart_TxDmaWriteDirect(int controllerIndex, const uint8_t* buffer, size_t& length);
 
 typedef USART_TypeDef* USART_TypeDef_Ptr;
 
@@ -41,14 +51,10 @@ struct UartState {
     uint8_t *TxBuffer;
     uint8_t *RxBuffer;
 
-    size_t txBufferCount;
-    size_t txBufferIn;
-    size_t txBufferOut;
+    RingBuffer<uint8_t> txRing;
     size_t txBufferSize;
 
-    size_t rxBufferCount;
-    size_t rxBufferIn;
-    size_t rxBufferOut;
+    RingBuffer<uint8_t> rxRing;
     size_t rxBufferSize;
 
     USART_TypeDef_Ptr portReg;
@@ -65,6 +71,14 @@ struct UartState {
     uint16_t initializeCount;
     uint64_t lastEventTime;
     size_t lastEventRxBufferCount;
+
+    bool rxDmaEnabled;
+    bool rxDmaOverflow;
+    size_t rxDmaPending;
+
+    bool txDmaEnabled;
+    bool txDmaDirect;
+    size_t txDmaLength;
 };
 
 static const STM32F4_Gpio_Pin uartTxPins[] = STM32F4_UART_TX_PINS;
@@ -74,6 +88,29 @@ static const STM32F4_Gpio_Pin uartRtsPins[] = STM32F4_UART_RTS_PINS;
 static const uint32_t uartRxDefaultBuffersSize[] = STM32F4_UART_DEFAULT_RX_BUFFER_SIZE;
 static const uint32_t uartTxDefaultBuffersSize[] = STM32F4_UART_DEFAULT_TX_BUFFER_SIZE;
 
+#ifdef STM32F4_UART_RX_DMA
+#ifndef STM32F4_UART_RX_DMA_STREAMS
+// USART1, USART2, USART3, UART4, UART5, USART6
+#define STM32F4_UART_RX_DMA_STREAMS { DMA_STREAM(2, 2, 4), DMA_STREAM(1, 5, 4), DMA_STREAM(1, 1, 4), DMA_STREAM(1, 2, 4), DMA_STREAM(1, 0, 4), DMA_STREAM(2, 1, 5) }
+#endif
+
+#define UART_RX_DMA_MAX_BUFFER_SIZE 0xFFFF
+
+static const STM32F4_Dma_Stream uartRxDmaStreams[] = STM32F4_UART_RX_DMA_STREAMS;
+#endif
+
+#ifdef STM32F4_UART_TX_DMA
+#ifndef STM32F4_UART_TX_DMA_STREAMS
+// USART1, USART2, USART3, UART4, UART5, USART6
+#define STM32F4_UART_TX_DMA_STREAMS { DMA_STREAM(2, 7, 4), DMA_STREAM(1, 6, 4), DMA_STREAM(1, 3, 4), DMA_STREAM(1, 4, 4), DMA_STREAM(1, 7, 4), DMA_STREAM(2, 6, 5) }
+#endif
+
+#define UART_TX_DMA_MAX_TRANSFER_SIZE 0xFFFF
+#define UART_TX_DMA_STALL_TIMEOUT_MS 100
+
+static const STM32F4_Dma_Stream uartTxDmaStreams[] = STM32F4_UART_TX_DMA_STREAMS;
+#endif
+
 static UartState uartStates[TOTAL_UART_CONTROLLERS];
 static TinyCLR_Uart_Controller uartControllers[TOTAL_UART_CONTROLLERS];
 static TinyCLR_Api_Info uartApi[TOTAL_UART_CONTROLLERS];
@@ -196,19 +233,34 @@ TinyCLR_Result STM32F4_Uart_SetReadBufferSize(const TinyCLR_Uart_Controller* sel
     if (size <= 0)
         return TinyCLR_Result::ArgumentInvalid;
 
+    if (state->rxDmaEnabled)
+        STM32F4_Uart_RxDmaStop(state->controllerIndex);
+
+    state->rxRing.Uninitialize();
+
     if (state->RxBuffer) {
         memoryProvider->Free(memoryProvider, state->RxBuffer);
     }
 
     state->rxBufferSize = 0;
 
-    state->RxBuffer = (uint8_t*)memoryProvider->Allocate(memoryProvider, size);
+    auto capacity = RingBuffer<uint8_t>::GetCapacityFor(size);
+
+    state->RxBuffer = (uint8_t*)memoryProvider->Allocate(memoryProvider, capacity);
 
     if (state->RxBuffer == nullptr) {
         return TinyCLR_Result::OutOfMemory;
     }
 
     state->rxBufferSize = size;
+    state->rxRing.Initialize(state->RxBuffer, capacity);
+
+    if (state->portReg->CR1 & USART_CR1_UE) {
+        state->lastEventRxBufferCount = 0;
+
+        if (!STM32F4_Uart_RxDmaStart(state->controllerIndex))
+            STM32F4_Uart_RxBufferFullInterruptEnable(state->controllerIndex, true);
+    }
 
     return TinyCLR_Result::Success;
 }
@@ -227,19 +279,32 @@ TinyCLR_Result STM32F4_Uart_SetWriteBufferSize(const TinyCLR_Uart_Controller* se
     if (size <= 0)
         return TinyCLR_Result::ArgumentInvalid;
 
+    if (state->txDmaEnabled)
+        STM32F4_Uart_TxDmaStop(state->controllerIndex);
+
+    state->txRing.Uninitialize();
+
     if (state->TxBuffer) {
         memoryProvider->Free(memoryProvider, state->TxBuffer);
     }
 
     state->txBufferSize = 0;
 
-    state->TxBuffer = (uint8_t*)memoryProvider->Allocate(memoryProvider, size);
+    auto capacity = RingBuffer<uint8_t>::GetCapacityFor(size);
+
+    state->TxBuffer = (uint8_t*)memoryProvider->Allocate(memoryProvider, capacity);
 
     if (state->TxBuffer == nullptr) {
         return TinyCLR_Result::OutOfMemory;
     }
 
     state->txBufferSize = size;
+    state->txRing.Initialize(state->TxBuffer, capacity);
+
+    if (state->portReg->CR1 & USART_CR1_UE) {
+        if (!STM32F4_Uart_TxDmaStart(state->controllerIndex))
+            STM32F4_Uart_TxBufferEmptyInterruptEnable(state->controllerIndex, true);
+    }
 
     return TinyCLR_Result::Success;
 }
@@ -254,73 +319,127 @@ bool STM32F4_Uart_CanPostEvent(int8_t controllerIndex) {
     return canPost;
 }
 
+void STM32F4_Uart_RaiseErrors(UartState* state, uint16_t sr, bool bufferFull) {
+    if (bufferFull) {
+        state->errorEventHandler(state->controller, TinyCLR_Uart_Error::BufferFull, STM32F4_Time_GetCurrentProcessorTime());
+    }
+
+    if (sr & USART_SR_ORE) {
+        state->errorEventHandler(state->controller, TinyCLR_Uart_Error::Overrun, STM32F4_Time_GetCurrentProcessorTime());
+    }
+
+    if (sr & USART_SR_FE) {
+        state->errorEventHandler(state->controller, TinyCLR_Uart_Error::Frame, STM32F4_Time_GetCurrentProcessorTime());
+    }
+
+    if (sr & USART_SR_PE) {
+        state->errorEventHandler(state->controller, TinyCLR_Uart_Error::ReceiveParity, STM32F4_Time_GetCurrentProcessorTime());
+    }
+}
+
+#ifdef STM32F4_UART_RX_DMA
+// Publishes what the stream has written since the last call and raises a single event for all of it.
+void STM32F4_Uart_RxDmaPublish(UartState* state, uint16_t sr, bool canPostEvent) {
+    STM32F4_Uart_RxDmaSync(state->controllerIndex);
+
+    if (state->errorEventHandler != nullptr && (state->rxDmaOverflow || canPostEvent))
+        STM32F4_Uart_RaiseErrors(state, canPostEvent ? sr : 0, state->rxDmaOverflow);
+
+    state->rxDmaOverflow = false;
+
+    if (state->dataReceivedEventHandler != nullptr && state->rxDmaPending > 0) {
+        state->dataReceivedEventHandler(state->controller, state->rxDmaPending, STM32F4_Time_GetCurrentProcessorTime());
+
+        state->lastEventRxBufferCount = state->rxRing.GetCount();
+    }
+
+    state->rxDmaPending = 0;
+}
+
+void STM32F4_Uart_RxDmaInterrupt(void* param, uint32_t flags) {
+    DISABLE_INTERRUPTS_SCOPED(irq);
+
+    auto state = reinterpret_cast<UartState*>(param);
+
+    STM32F4_Uart_RxDmaPublish(state, 0, false);
+}
+#endif
+
+#ifdef STM32F4_UART_TX_DMA
+void STM32F4_Uart_TxDmaInterrupt(void* param, uint32_t flags) {
+    DISABLE_INTERRUPTS_SCOPED(irq);
+
+    auto state = reinterpret_cast<UartState*>(param);
+
+    if (state->txDmaLength == 0)
+        return;
+
+    // a transfer error stops the stream, drop the chunk rather than stall the ring
+    if (!state->txDmaDirect)
+        state->txRing.Consume(state->txDmaLength);
+
+    state->txDmaDirect = false;
+    state->txDmaLength = 0;
+
+    STM32F4_Uart_TxDmaKick(state->controllerIndex);
+}
+#endif
+
 void STM32F4_Uart_InterruptHandler(int8_t controllerIndex) {
     DISABLE_INTERRUPTS_SCOPED(irq);
 
     auto state = reinterpret_cast<UartState*>(&uartStates[controllerIndex]);
     auto sr = (uint16_t)(state->portReg->SR);
     auto canPostEvent = STM32F4_Uart_CanPostEvent(controllerIndex);
-    bool error = (state->rxBufferCount == state->rxBufferSize) || (sr & USART_SR_ORE) || (sr & USART_SR_FE) || (sr & USART_SR_PE);
+    bool error = state->rxRing.IsFull() || (sr & USART_SR_ORE) || (sr & USART_SR_FE) || (sr & USART_SR_PE);
 
-    if (sr & USART_SR_RXNE || sr & USART_SR_ORE || sr & USART_SR_FE || sr & USART_SR_PE) {
-        uint8_t data = (uint8_t)(state->portReg->DR); // read RX data
-
-        if (state->errorEventHandler != nullptr && canPostEvent) {
-            if (state->rxBufferCount == state->rxBufferSize) {
-                state->errorEventHandler(state->controller, TinyCLR_Uart_Error::BufferFull, STM32F4_Time_GetCurrentProcessorTime());
-            }
+#ifdef STM32F4_UART_RX_DMA
+    if (state->rxDmaEnabled && (sr & (USART_SR_IDLE | USART_SR_ORE | USART_SR_FE | USART_SR_PE | USART_SR_NE))) {
+        // IDLE and the error flags clear on SR then DR read; leave DR alone if the stream has a byte pending
+        if (!(state->portReg->SR & USART_SR_RXNE))
+            (void)state->portReg->DR;
 
-            if (sr & USART_SR_ORE) {
-                state->errorEventHandler(state->controller, TinyCLR_Uart_Error::Overrun, STM32F4_Time_GetCurrentProcessorTime());
-            }
+        STM32F4_Uart_RxDmaPublish(state, sr, canPostEvent);
+    }
+#endif
 
-            if (sr & USART_SR_FE) {
-                state->errorEventHandler(state->controller, TinyCLR_Uart_Error::Frame, STM32F4_Time_GetCurrentProcessorTime());
-            }
+    if (!state->rxDmaEnabled && (sr & USART_SR_RXNE || sr & USART_SR_ORE || sr & USART_SR_FE || sr & USART_SR_PE)) {
+        uint8_t data = (uint8_t)(state->portReg->DR); // read RX data
 
-            if (sr & USART_SR_PE) {
-                state->errorEventHandler(state->controller, TinyCLR_Uart_Error::ReceiveParity, STM32F4_Time_GetCurrentProcessorTime());
-            }
+        if (state->errorEventHandler != nullptr && canPostEvent) {
+            STM32F4_Uart_RaiseErrors(state, sr, state->rxRing.IsFull());
         }
 
         if (error)
             return;
 
         if (sr & USART_SR_RXNE) {
-            state->RxBuffer[state->rxBufferIn++] = data;
-
-            state->rxBufferCount++;
-
-            if (state->rxBufferIn == state->rxBufferSize)
-                state->rxBufferIn = 0;
+            state->rxRing.Push(data);
 
             if (state->dataReceivedEventHandler != nullptr) {
                 if (canPostEvent) {
-                    if (state->rxBufferCount > state->lastEventRxBufferCount) {
+                    auto count = state->rxRing.GetCount();
+
+                    if (count > state->lastEventRxBufferCount) {
                         // if driver hold event long enough that more than 1 byte
-                        state->dataReceivedEventHandler(state->controller, state->rxBufferCount - state->lastEventRxBufferCount, STM32F4_Time_GetCurrentProcessorTime());
+                        state->dataReceivedEventHandler(state->controller, count - state->lastEventRxBufferCount, STM32F4_Time_GetCurrentProcessorTime());
                     }
                     else {
                         // if user use poll to read data and rxBufferCount <= lastEventRxBufferCount, driver send at least 1 byte comming
                         state->dataReceivedEventHandler(state->controller, 1, STM32F4_Time_GetCurrentProcessorTime());
                     }
 
-                    state->lastEventRxBufferCount = state->rxBufferCount;
+                    state->lastEventRxBufferCount = count;
                 }
             }
         }
     }
 
-    if (sr & USART_SR_TXE) {
+    if (!state->txDmaEnabled && (sr & USART_SR_TXE)) {
         if (STM32F4_Uart_CanSend(controllerIndex)) {
-            if (state->txBufferCount > 0) {
-                uint8_t data = state->TxBuffer[state->txBufferOut++];
-
-                state->txBufferCount--;
-
-                if (state->txBufferOut == state->txBufferSize)
-                    state->txBufferOut = 0;
+            uint8_t data;
 
+            if (state->txRing.Pop(data)) {
                 state->portReg->DR = data; // write TX data
             }
             else {
@@ -395,14 +514,6 @@ TinyCLR_Result STM32F4_Uart_Acquire(const TinyCLR_Uart_Controller* self) {
         if (!STM32F4_GpioInternal_OpenPin(uartRxPins[controllerIndex].number) || !STM32F4_GpioInternal_OpenPin(uartTxPins[controllerIndex].number))
             return TinyCLR_Result::SharingViolation;
 
-        state->txBufferCount = 0;
-        state->txBufferIn = 0;
-        state->txBufferOut = 0;
-
-        state->rxBufferCount = 0;
-        state->rxBufferIn = 0;
-        state->rxBufferOut = 0;
-
         state->controller = self;
         state->handshaking = false;
         state->enable = false;
@@ -413,6 +524,17 @@ TinyCLR_Result STM32F4_Uart_Acquire(const TinyCLR_Uart_Controller* self) {
         state->TxBuffer = nullptr;
         state->RxBuffer = nullptr;
 
+        state->txRing.Uninitialize();
+        state->rxRing.Uninitialize();
+
+        state->rxDmaEnabled = false;
+        state->rxDmaOverflow = false;
+        state->rxDmaPending = 0;
+
+        state->txDmaEnabled = false;
+        state->txDmaDirect = false;
+        state->txDmaLength = 0;
+
         if (STM32F4_Uart_SetWriteBufferSize(self, uartTxDefaultBuffersSize[controllerIndex]) != TinyCLR_Result::Success || STM32F4_Uart_SetReadBufferSize(self, uartRxDefaultBuffersSize[controllerIndex]) != TinyCLR_Result::Success)
             return TinyCLR_Result::OutOfMemory;
 
@@ -593,8 +715,11 @@ TinyCLR_Result STM32F4_Uart_SetActiveSettings(const TinyCLR_Uart_Controller* sel
 #endif
     }
 
-    STM32F4_Uart_TxBufferEmptyInterruptEnable(controllerIndex, true);
-    STM32F4_Uart_RxBufferFullInterruptEnable(controllerIndex, true);
+    if (!STM32F4_Uart_TxDmaStart(controllerIndex))
+        STM32F4_Uart_TxBufferEmptyInterruptEnable(controllerIndex, true);
+
+    if (!STM32F4_Uart_RxDmaStart(controllerIndex))
+        STM32F4_Uart_RxBufferFullInterruptEnable(controllerIndex, true);
 
     state->portReg->CR1 |= USART_CR1_UE; // start uart
 
@@ -613,6 +738,12 @@ TinyCLR_Result STM32F4_Uart_Release(const TinyCLR_Uart_Controller* self) {
     if (state->initializeCount == 0) {
         int32_t controllerIndex = state->controllerIndex;
 
+        if (state->rxDmaEnabled)
+            STM32F4_Uart_RxDmaStop(controllerIndex);
+
+        if (state->txDmaEnabled)
+            STM32F4_Uart_TxDmaStop(controllerIndex);
+
         state->portReg->CR1 = 0; // stop uart
 
         switch (controllerIndex) {
@@ -695,9 +826,11 @@ TinyCLR_Result STM32F4_Uart_Release(const TinyCLR_Uart_Controller* self) {
         if (apiManager != nullptr) {
             auto memoryProvider = (const TinyCLR_Memory_Manager*)apiManager->FindDefault(apiManager, TinyCLR_Api_Type::MemoryManager);
 
+            state->txRing.Uninitialize();
+            state->rxRing.Uninitialize();
+
             memoryProvider->Free(memoryProvider, state->TxBuffer);
             memoryProvider->Free(memoryProvider, state->RxBuffer);
-
         }
 
         STM32F4_GpioInternal_ClosePin(uartRxPins[controllerIndex].number);
@@ -743,6 +876,226 @@ void STM32F4_Uart_RxBufferFullInterruptEnable(int controllerIndex, bool enable)
     }
 }
 
+bool STM32F4_Uart_RxDmaStart(int controllerIndex) {
+#ifdef STM32F4_UART_RX_DMA
+    auto state = &uartStates[controllerIndex];
+
+    if (controllerIndex >= SIZEOF_ARRAY(uartRxDmaStreams))
+        return false;
+
+    auto& dma = uartRxDmaStreams[controllerIndex];
+    auto capacity = state->rxRing.GetCapacity();
+    auto usable = capacity > 0 && capacity <= UART_RX_DMA_MAX_BUFFER_SIZE && STM32F4_DmaInternal_IsAccessible(state->RxBuffer);
+
+    // a running port is being reconfigured, the stream restarts on an empty ring
+    if (state->rxDmaEnabled)
+        STM32F4_Uart_RxDmaStop(controllerIndex);
+
+    if (!usable || !STM32F4_DmaInternal_OpenStream(dma))
+        return false;
+
+    state->rxDmaEnabled = true;
+
+    STM32F4_Uart_RxBufferFullInterruptEnable(controllerIndex, false);
+
+    state->rxRing.Initialize(state->RxBuffer, capacity);
+    state->lastEventRxBufferCount = 0;
+    state->rxDmaOverflow = false;
+    state->rxDmaPending = 0;
+
+    // The stream is the ring's producer from here on, the IDLE and half/full transfer interrupts commit its progress
+    STM32F4_DmaInternal_SetHandler(dma, &STM32F4_Uart_RxDmaInterrupt, state);
+    STM32F4_DmaInternal_Start(dma, &state->portReg->DR, state->RxBuffer, capacity, DMA_SxCR_PL_1 | DMA_SxCR_MINC | DMA_SxCR_CIRC | DMA_SxCR_HTIE | DMA_SxCR_TCIE);
+
+    state->portReg->CR3 |= USART_CR3_DMAR | USART_CR3_EIE;
+    state->portReg->CR1 |= USART_CR1_IDLEIE | USART_CR1_PEIE;
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+void STM32F4_Uart_RxDmaStop(int controllerIndex) {
+#ifdef STM32F4_UART_RX_DMA
+    auto state = &uartStates[controllerIndex];
+
+    state->portReg->CR1 &= ~(USART_CR1_IDLEIE | USART_CR1_PEIE);
+    state->portReg->CR3 &= ~(USART_CR3_DMAR | USART_CR3_EIE);
+
+    STM32F4_DmaInternal_CloseStream(uartRxDmaStreams[controllerIndex]);
+
+    state->rxDmaEnabled = false;
+#endif
+}
+
+void STM32F4_Uart_RxDmaSync(int controllerIndex) {
+#ifdef STM32F4_UART_RX_DMA
+    auto state = &uartStates[controllerIndex];
+    auto capacity = state->rxRing.GetCapacity();
+    auto in = capacity - STM32F4_DmaInternal_GetRemaining(uartRxDmaStreams[controllerIndex]);
+    auto received = (in - state->rxRing.GetHeadIndex()) & (capacity - 1);
+
+    // the stream has wrapped over unread data, the reader skips to the newest capacity bytes
+    if (received > state->rxRing.GetFree())
+        state->rxDmaOverflow = true;
+
+    state->rxRing.Commit(received);
+    state->rxDmaPending += received;
+#endif
+}
+
+bool STM32F4_Uart_TxDmaStart(int controllerIndex) {
+#ifdef STM32F4_UART_TX_DMA
+    auto state = &uartStates[controllerIndex];
+
+    if (controllerIndex >= SIZEOF_ARRAY(uartTxDmaStreams) || !STM32F4_DmaInternal_IsAccessible(state->TxBuffer))
+        return false;
+
+    auto& dma = uartTxDmaStreams[controllerIndex];
+
+    if (!state->txDmaEnabled) {
+        if (!STM32F4_DmaInternal_OpenStream(dma))
+            return false;
+
+        state->txDmaEnabled = true;
+    }
+
+    DISABLE_INTERRUPTS_SCOPED(irq);
+
+    // a running port is being reconfigured, whatever the stream had not sent yet stays queued
+    STM32F4_Uart_TxDmaAbort(controllerIndex);
+
+    STM32F4_Uart_TxBufferEmptyInterruptEnable(controllerIndex, false);
+    STM32F4_DmaInternal_SetHandler(dma, &STM32F4_Uart_TxDmaInterrupt, state);
+
+    state->portReg->CR3 |= USART_CR3_DMAT;
+
+    STM32F4_Uart_TxDmaKick(controllerIndex);
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+void STM32F4_Uart_TxDmaStop(int controllerIndex) {
+#ifdef STM32F4_UART_TX_DMA
+    auto state = &uartStates[controllerIndex];
+
+    state->portReg->CR3 &= ~USART_CR3_DMAT;
+
+    STM32F4_DmaInternal_CloseStream(uartTxDmaStreams[controllerIndex]);
+
+    state->txDmaEnabled = false;
+    state->txDmaDirect = false;
+    state->txDmaLength = 0;
+#endif
+}
+
+// Starts the next contiguous run of the ring if nothing is in flight. Caller holds interrupts disabled.
+void STM32F4_Uart_TxDmaKick(int controllerIndex) {
+#ifdef STM32F4_UART_TX_DMA
+    auto state = &uartStates[controllerIndex];
+
+    if (state->txDmaLength > 0)
+        return;
+
+    size_t length;
+    auto data = state->txRing.GetReadSpan(length);
+
+    if (data == nullptr)
+        return;
+
+    length = std::min(length, (size_t)UART_TX_DMA_MAX_TRANSFER_SIZE);
+
+    state->txDmaLength = length;
+
+    STM32F4_DmaInternal_Start(uartTxDmaStreams[controllerIndex], &state->portReg->DR, data, length, DMA_SxCR_PL_0 | DMA_SxCR_DIR_0 | DMA_SxCR_MINC | DMA_SxCR_TCIE | DMA_SxCR_TEIE);
+#endif
+}
+
+// Stops the stream wherever it is and drops what it already sent from the ring. Caller holds interrupts disabled.
+// Returns the bytes the stream sent.
+size_t STM32F4_Uart_TxDmaAbort(int controllerIndex) {
+#ifdef STM32F4_UART_TX_DMA
+    auto state = &uartStates[controllerIndex];
+    auto& dma = uartTxDmaStreams[controllerIndex];
+
+    if (state->txDmaLength == 0)
+        return 0;
+
+    STM32F4_DmaInternal_Stop(dma);
+
+    auto sent = state->txDmaLength - STM32F4_DmaInternal_GetRemaining(dma);
+
+    if (!state->txDmaDirect)
+        state->txRing.Consume(sent);
+
+    state->txDmaDirect = false;
+    state->txDmaLength = 0;
+
+    return sent;
+#else
+    return 0;
+#endif
+}
+
+// Sends straight from the caller's buffer when the ring is idle and the write would not fit it anyway.
+// Returns once the stream is done so the buffer only has to outlive this call. A stream that makes no
+// progress for UART_TX_DMA_STALL_TIMEOUT_MS, held off by CTS for one, is abandoned and length is cut to
+// what it sent.
+bool STM32F4_Uart_TxDmaWriteDirect(int controllerIndex, const uint8_t* buffer, size_t& length) {
+#ifdef STM32F4_UART_TX_DMA
+    auto state = &uartStates[controllerIndex];
+
+    if (!state->txDmaEnabled || length <= state->txBufferSize || length > UART_TX_DMA_MAX_TRANSFER_SIZE || !STM32F4_DmaInternal_IsAccessible(buffer))
+        return false;
+
+    auto& dma = uartTxDmaStreams[controllerIndex];
+
+    {
+        DISABLE_INTERRUPTS_SCOPED(irq);
+
+        if (state->txDmaLength > 0 || !state->txRing.IsEmpty())
+            return false;
+
+        state->txDmaDirect = true;
+        state->txDmaLength = length;
+
+        STM32F4_DmaInternal_Start(dma, &state->portReg->DR, buffer, length, DMA_SxCR_PL_0 | DMA_SxCR_DIR_0 | DMA_SxCR_MINC | DMA_SxCR_TCIE | DMA_SxCR_TEIE);
+    }
+
+    auto remaining = length;
+    auto progressTime = STM32F4_Time_GetCurrentProcessorTime();
+
+    while (state->txDmaDirect) {
+        STM32F4_Time_Delay(nullptr, 1);
+
+        auto now = STM32F4_Time_GetCurrentProcessorTime();
+        auto left = STM32F4_DmaInternal_GetRemaining(dma);
+
+        if (left != remaining) {
+            remaining = left;
+            progressTime = now;
+        }
+        else if (now - progressTime > UART_TX_DMA_STALL_TIMEOUT_MS * 10000ULL) { // 100ns units
+            DISABLE_INTERRUPTS_SCOPED(irq);
+
+            // the interrupt may have finished it meanwhile, all of it went then
+            if (state->txDmaDirect)
+                length = STM32F4_Uart_TxDmaAbort(controllerIndex);
+
+            break;
+        }
+    }
+
+    return true;
+#else
+    return false;
+#endif
+}
+
 bool STM32F4_Uart_CanSend(int controllerIndex) {
     auto state = &uartStates[controllerIndex];
     bool value;
@@ -756,7 +1109,7 @@ TinyCLR_Result STM32F4_Uart_Flush(const TinyCLR_Uart_Controller* self) {
     auto state = reinterpret_cast<UartState*>(self->ApiInfo->State);
 
     if (state->initializeCount) {
-        while (state->txBufferCount > 0) {
+        while (!state->txRing.IsEmpty()) {
             STM32F4_Time_Delay(nullptr, 1);
         }
     }
@@ -765,38 +1118,27 @@ TinyCLR_Result STM32F4_Uart_Flush(const TinyCLR_Uart_Controller* self) {
 }
 
 TinyCLR_Result STM32F4_Uart_Read(const TinyCLR_Uart_Controller* self, uint8_t* buffer, size_t& length) {
-    DISABLE_INTERRUPTS_SCOPED(irq);
-
     auto state = reinterpret_cast<UartState*>(self->ApiInfo->State);
 
     if (state->initializeCount == 0) {
         return TinyCLR_Result::NotAvailable;
     }
 
-    length = std::min(self->GetBytesToRead(self), length);
-
-    size_t i = 0;
+    if (state->rxDmaEnabled) {
+        DISABLE_INTERRUPTS_SCOPED(irq);
 
-    while (i < length) {
-        buffer[i++] = state->RxBuffer[state->rxBufferOut];
-
-        state->rxBufferOut++;
+        STM32F4_Uart_RxDmaSync(state->controllerIndex);
+    }
 
-        state->rxBufferCount--;
+    state->rxRing.SkipOverwritten();
 
-        if (state->rxBufferOut == state->rxBufferSize)
-            state->rxBufferOut = 0;
-    }
+    // only the producer moves the head, the copy itself needs no interrupt masking
+    length = state->rxRing.PopN(buffer, length);
 
     return TinyCLR_Result::Success;
 }
 
 TinyCLR_Result STM32F4_Uart_Write(const TinyCLR_Uart_Controller* self, const uint8_t* buffer, size_t& length) {
-
-    int32_t i = 0;
-
-    DISABLE_INTERRUPTS_SCOPED(irq);
-
     auto state = reinterpret_cast<UartState*>(self->ApiInfo->State);
 
     int32_t controllerIndex = state->controllerIndex;
@@ -805,29 +1147,29 @@ TinyCLR_Result STM32F4_Uart_Write(const TinyCLR_Uart_Controller* self, const uin
         return TinyCLR_Result::NotAvailable;
     }
 
-    length = std::min(state->txBufferSize - state->txBufferCount, length);
+    if (STM32F4_Uart_TxDmaWriteDirect(controllerIndex, buffer, length))
+        return TinyCLR_Result::Success;
+
+    if (state->txRing.IsFull()) {
+        length = 0;
 
-    if (state->txBufferCount == state->txBufferSize) {
         if (state->errorEventHandler != nullptr)
             state->errorEventHandler(state->controller, TinyCLR_Uart_Error::BufferFull, STM32F4_Time_GetCurrentProcessorTime());
 
         return TinyCLR_Result::Success;
     }
 
-    while (i < length) {
-
-        state->TxBuffer[state->txBufferIn] = buffer[i++];
-
-        state->txBufferCount++;
-
-        state->txBufferIn++;
-
-        if (state->txBufferIn == state->txBufferSize)
-            state->txBufferIn = 0;
-    }
+    length = state->txRing.PushN(buffer, length);
 
     if (length > 0) {
-        STM32F4_Uart_TxBufferEmptyInterruptEnable(controllerIndex, true); // Enable Tx to start transfer
+        if (state->txDmaEnabled) {
+            DISABLE_INTERRUPTS_SCOPED(irq);
+
+            STM32F4_Uart_TxDmaKick(controllerIndex);
+        }
+        else {
+            STM32F4_Uart_TxBufferEmptyInterruptEnable(controllerIndex, true); // Enable Tx to start transfer
+        }
     }
 
     return TinyCLR_Result::Success;
@@ -900,19 +1242,38 @@ TinyCLR_Result STM32F4_Uart_SetIsRequestToSendEnabled(const TinyCLR_Uart_Control
 size_t STM32F4_Uart_GetBytesToRead(const TinyCLR_Uart_Controller* self) {
     auto state = reinterpret_cast<UartState*>(self->ApiInfo->State);
 
-    return state->rxBufferCount;
+    if (state->rxDmaEnabled) {
+        DISABLE_INTERRUPTS_SCOPED(irq);
+
+        STM32F4_Uart_RxDmaSync(state->controllerIndex);
+    }
+
+    return state->rxRing.GetCount();
 }
 
 size_t STM32F4_Uart_GetBytesToWrite(const TinyCLR_Uart_Controller* self) {
     auto state = reinterpret_cast<UartState*>(self->ApiInfo->State);
 
-    return state->txBufferCount;
+    return state->txRing.GetCount();
 }
 
 TinyCLR_Result STM32F4_Uart_ClearReadBuffer(const TinyCLR_Uart_Controller* self) {
     auto state = reinterpret_cast<UartState*>(self->ApiInfo->State);
 
-    state->rxBufferCount = state->rxBufferIn = state->rxBufferOut = state->lastEventRxBufferCount = 0;
+    if (state->rxDmaEnabled) {
+        DISABLE_INTERRUPTS_SCOPED(irq);
+
+        // the stream keeps writing at its own position, drop everything up to it
+        STM32F4_Uart_RxDmaSync(state->controllerIndex);
+
+        state->rxRing.Discard();
+        state->lastEventRxBufferCount = state->rxDmaPending = 0;
+
+        return TinyCLR_Result::Success;
+    }
+
+    state->rxRing.Discard();
+    state->lastEventRxBufferCount = 0;
 
     return TinyCLR_Result::Success;
 }
@@ -920,7 +1281,18 @@ TinyCLR_Result STM32F4_Uart_ClearReadBuffer(const TinyCLR_Uart_Controller* self)
 TinyCLR_Result STM32F4_Uart_ClearWriteBuffer(const TinyCLR_Uart_Controller* self) {
     auto state = reinterpret_cast<UartState*>(self->ApiInfo->State);
 
-    state->txBufferCount = state->txBufferIn = state->txBufferOut = 0;
+    DISABLE_INTERRUPTS_SCOPED(irq);
+
+#ifdef STM32F4_UART_TX_DMA
+    if (state->txDmaEnabled && state->txDmaLength > 0 && !state->txDmaDirect) {
+        STM32F4_DmaInternal_Stop(uartTxDmaStreams[state->controllerIndex]);
+
+        state->txDmaLength = 0;
+    }
+#endif
+
+    // the interrupt handler is the consumer, it is held off while the ring is emptied from this side
+    state->txRing.Discard();
 
     return TinyCLR_Result::Success;
 }
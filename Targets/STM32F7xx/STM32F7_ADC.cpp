@@ -15,6 +15,8 @@
 // limitations under the License.
 
 #include "STM32F7.h"
+#include "../../Drivers/AdcScan/AdcScan.h"
+#include "../../Drivers/TriggerTimer/TriggerTimer.h"
 
 #define STM32F7_AD_SAMPLE_TIME 2   // sample time = 28 cycles
 #define ADCx ADC1
@@ -26,6 +28,49 @@
 
 #define TOTAL_ADC_CONTROLLERS 1
 
+// Buffered acquisition converts a sequence of channels every time the trigger timer updates, its TRGO starts the
+// scan and DMA moves the results into a circular buffer.
+#ifndef STM32F7_ADC_TRIGGER_TIMER
+#define STM32F7_ADC_TRIGGER_TIMER 6
+#endif
+
+#if STM32F7_ADC_TRIGGER_TIMER == 2
+#define STM32F7_ADC_TRIGGER_TIM TIM2
+#define STM32F7_ADC_TRIGGER_TIM_APB1ENR RCC_APB1ENR_TIM2EN
+#define STM32F7_ADC_TRIGGER_EXTSEL 11
+#elif STM32F7_ADC_TRIGGER_TIMER == 4
+#define STM32F7_ADC_TRIGGER_TIM TIM4
+#define STM32F7_ADC_TRIGGER_TIM_APB1ENR RCC_APB1ENR_TIM4EN
+#define STM32F7_ADC_TRIGGER_EXTSEL 12
+#elif STM32F7_ADC_TRIGGER_TIMER == 5
+#define STM32F7_ADC_TRIGGER_TIM TIM5
+#define STM32F7_ADC_TRIGGER_TIM_APB1ENR RCC_APB1ENR_TIM5EN
+#define STM32F7_ADC_TRIGGER_EXTSEL 4
+#elif STM32F7_ADC_TRIGGER_TIMER == 6
+#define STM32F7_ADC_TRIGGER_TIM TIM6
+#define STM32F7_ADC_TRIGGER_TIM_APB1ENR RCC_APB1ENR_TIM6EN
+#define STM32F7_ADC_TRIGGER_EXTSEL 13
+#else
+#error STM32F7_ADC_TRIGGER_TIMER must be 2, 4, 5 or 6, the APB1 timers whose TRGO can start a regular sequence
+#endif
+
+#if defined(STM32F7_TIME_TIMER) && STM32F7_TIME_TIMER == STM32F7_ADC_TRIGGER_TIMER
+#error STM32F7_ADC_TRIGGER_TIMER is keeping native time
+#endif
+
+#ifndef STM32F7_ADC_DMA_STREAM
+#define STM32F7_ADC_DMA_STREAM DMA_STREAM(2, 4, 0)
+#endif
+
+// APB1 timers run at twice the bus clock unless the bus is undivided, ADCCLK is PCLK2 / 2
+#define STM32F7_ADC_TRIGGER_CLOCK_HZ (STM32F7_APB1_CLOCK_HZ == STM32F7_AHB_CLOCK_HZ ? STM32F7_APB1_CLOCK_HZ : STM32F7_APB1_CLOCK_HZ * 2)
+#define STM32F7_ADC_CLOCK_HZ (STM32F7_APB2_CLOCK_HZ / 2)
+#define STM32F7_ADC_CONVERSION_CYCLES 12
+
+
+static const uint16_t adcSampleCycles[] = { 3, 15, 28, 56, 84, 112, 144, 480 };
+static const STM32F7_Dma_Stream adcDmaStream = STM32F7_ADC_DMA_STREAM;
+
 static const uint32_t adcPins[] = STM32F7_ADC_PINS;
 
 static TinyCLR_Adc_Controller adcControllers[TOTAL_ADC_CONTROLLERS];
@@ -37,6 +82,13 @@ const char* adcApiNames[TOTAL_ADC_CONTROLLERS] = {
 
 struct AdcState {
     bool isOpen[STM32F7_AD_NUM];
+
+    bool acquiring;
+    bool internalChannels;
+    uint16_t* buffer;
+    size_t length;
+    STM32F7_Adc_AcquisitionHandler handler;
+    void* param;
 };
 
 static AdcState adcStates[TOTAL_ADC_CONTROLLERS];
@@ -129,6 +181,12 @@ TinyCLR_Result STM32F7_Adc_CloseChannel(const TinyCLR_Adc_Controller* self, uint
 }
 
 TinyCLR_Result STM32F7_Adc_ReadChannel(const TinyCLR_Adc_Controller* self, uint32_t channel, int32_t& value) {
+    auto state = reinterpret_cast<AdcState*>(self->ApiInfo->State);
+
+    // the sequence and trigger belong to the acquisition
+    if (state->acquiring)
+        return TinyCLR_Result::InvalidOperation;
+
     // check if this channel is listed in the STM32F7_AD_CHANNELS array
     value = 0;
 
@@ -189,8 +247,149 @@ bool STM32F7_Adc_IsChannelModeSupported(const TinyCLR_Adc_Controller* self, Tiny
     return mode == TinyCLR_Adc_ChannelMode::SingleEnded;
 }
 
+static void STM32F7_Adc_DmaHandler(void* param, uint32_t flags) {
+    auto self = reinterpret_cast<const TinyCLR_Adc_Controller*>(param);
+    auto state = reinterpret_cast<AdcState*>(self->ApiInfo->State);
+    auto handler = state->handler;
+    auto handlerParam = state->param;
+    auto half = state->length / 2;
+
+    if (flags & DMA_LISR_TEIF0) {
+        // the stream has disabled itself, nothing more will arrive
+        STM32F7_Adc_StopAcquisition(self);
+
+        handler(handlerParam, nullptr, 0);
+
+        return;
+    }
+
+    // both halves are reported in order when the interrupt was held off for a whole half
+    if (flags & DMA_LISR_HTIF0) {
+        SCB_InvalidateDCache_by_Addr((uint32_t*)state->buffer, half * sizeof(uint16_t));
+
+        handler(handlerParam, state->buffer, half);
+    }
+
+    if (flags & DMA_LISR_TCIF0) {
+        SCB_InvalidateDCache_by_Addr((uint32_t*)(state->buffer + half), half * sizeof(uint16_t));
+
+        handler(handlerParam, state->buffer + half, half);
+    }
+}
+
+// Converts the channels, which have to be open, as one scan at frequency scans per second until stopped. The scans
+// are stored one after the other in buffer, each in the order of the channels array, and buffer is reused once
+// full. handler is called from the DMA interrupt with every half that was filled and has to be done with it before
+// the same half comes around again; a transfer error stops the acquisition and is reported with a null half.
+// frequency is updated to the rate the trigger timer actually runs at.
+TinyCLR_Result STM32F7_Adc_StartAcquisition(const TinyCLR_Adc_Controller* self, const uint32_t* channels, size_t channelCount, double& frequency, uint16_t* buffer, size_t length, STM32F7_Adc_AcquisitionHandler handler, void* param) {
+    auto state = reinterpret_cast<AdcState*>(self->ApiInfo->State);
+
+    if (channels == nullptr || buffer == nullptr || handler == nullptr)
+        return TinyCLR_Result::ArgumentNull;
+
+    if (state->acquiring)
+        return TinyCLR_Result::InvalidOperation;
+
+    if (!AdcScan_IsValidLength(channelCount, length))
+        return TinyCLR_Result::ArgumentInvalid;
+
+    if (((uint32_t)buffer & 0x1F) != 0 || !STM32F7_DmaInternal_IsAccessible(buffer))
+        return TinyCLR_Result::ArgumentInvalid;
+
+    // each half is invalidated in the data cache before it is handed out, so it can not share a cache line
+    if ((length * sizeof(uint16_t) / 2) % 32 != 0)
+        return TinyCLR_Result::ArgumentInvalid;
+
+    auto internalChannels = false;
+
+    for (auto i = 0u; i < channelCount; i++) {
+        if (channels[i] >= STM32F7_AD_NUM || !state->isOpen[channels[i]])
+            return TinyCLR_Result::ArgumentOutOfRange;
+
+        if (channels[i] == 16 || channels[i] == 17)
+            internalChannels = true;
+    }
+
+    // a scan has to be done before the next trigger or the sequence overruns
+    auto scanCycles = channelCount * (adcSampleCycles[STM32F7_AD_SAMPLE_TIME] + STM32F7_ADC_CONVERSION_CYCLES);
+    auto maximum = (double)STM32F7_ADC_CLOCK_HZ / scanCycles;
+    auto minimum = (double)STM32F7_ADC_TRIGGER_CLOCK_HZ / 0x100000000ull;
+
+    if (frequency < minimum || frequency > maximum)
+        return TinyCLR_Result::ArgumentOutOfRange;
+
+#ifdef INCLUDE_PWM
+    if (!STM32F7_PwmInternal_ReserveTimer(STM32F7_ADC_TRIGGER_TIMER))
+        return TinyCLR_Result::SharingViolation;
+#endif
+
+    if (!STM32F7_DmaInternal_OpenStream(adcDmaStream)) {
+#ifdef INCLUDE_PWM
+        STM32F7_PwmInternal_ReleaseTimer(STM32F7_ADC_TRIGGER_TIMER);
+#endif
+
+        return TinyCLR_Result::SharingViolation;
+    }
+
+    state->buffer = buffer;
+    state->length = length;
+    state->handler = handler;
+    state->param = param;
+    state->internalChannels = internalChannels;
+    state->acquiring = true;
+
+    AdcScan_ProgramSequence(*ADCx, channels, channelCount);
+
+    if (internalChannels)
+        ADC->CCR |= ADC_CCR_TSVREFE;
+
+    RCC->APB1ENR |= STM32F7_ADC_TRIGGER_TIM_APB1ENR;
+
+    frequency = TriggerTimer_Program(*STM32F7_ADC_TRIGGER_TIM, STM32F7_ADC_TRIGGER_CLOCK_HZ, frequency);
+
+    SCB_CleanInvalidateDCache_by_Addr((uint32_t*)buffer, length * sizeof(uint16_t));
+
+    STM32F7_DmaInternal_SetHandler(adcDmaStream, &STM32F7_Adc_DmaHandler, (void*)self);
+    STM32F7_DmaInternal_Start(adcDmaStream, &ADCx->DR, buffer, length, ADC_SCAN_DMA_CONFIGURATION);
+
+    AdcScan_EnableTrigger(*ADCx, STM32F7_ADC_TRIGGER_EXTSEL);
+
+    STM32F7_ADC_TRIGGER_TIM->CR1 = TIM_CR1_CEN;
+
+    return TinyCLR_Result::Success;
+}
+
+TinyCLR_Result STM32F7_Adc_StopAcquisition(const TinyCLR_Adc_Controller* self) {
+    auto state = reinterpret_cast<AdcState*>(self->ApiInfo->State);
+
+    if (!state->acquiring)
+        return TinyCLR_Result::Success;
+
+    STM32F7_ADC_TRIGGER_TIM->CR1 = 0;
+    STM32F7_ADC_TRIGGER_TIM->CR2 = 0;
+
+    // back to the single software started conversion ReadChannel expects
+    AdcScan_Reset(*ADCx);
+
+    if (state->internalChannels)
+        ADC->CCR &= ~ADC_CCR_TSVREFE;
+
+    STM32F7_DmaInternal_CloseStream(adcDmaStream);
+
+#ifdef INCLUDE_PWM
+    STM32F7_PwmInternal_ReleaseTimer(STM32F7_ADC_TRIGGER_TIMER);
+#endif
+
+    state->acquiring = false;
+
+    return TinyCLR_Result::Success;
+}
+
 void STM32F7_Adc_Reset() {
     for (auto c = 0; c < TOTAL_ADC_CONTROLLERS; c++) {
+        STM32F7_Adc_StopAcquisition(&adcControllers[c]);
+
         for (auto i = 0; i < STM32F7_AD_NUM; i++) {
             STM32F7_Adc_CloseChannel(&adcControllers[c], i);
 
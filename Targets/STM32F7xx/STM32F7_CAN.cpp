@@ -15,6 +15,7 @@
 #include <algorithm>
 #include <string.h>
 #include "STM32F7.h"
+#include "../../Drivers/RingBuffer/RingBuffer.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -310,9 +311,7 @@ struct CanState {
     TinyCLR_Can_ErrorReceivedHandler   errorEventHandler;
     TinyCLR_Can_MessageReceivedHandler    messageReceivedEventHandler;
 
-    int32_t can_rx_count;
-    int32_t can_rx_in;
-    int32_t can_rx_out;
+    RingBuffer<STM32F7_Can_Message> rxRing;
 
     size_t can_rxBufferSize;
     size_t can_txBufferSize;
@@ -1171,11 +1170,16 @@ void STM32_Can_RxInterruptHandler(int32_t controllerIndex) {
         }
     }
 
-    if (state->can_rx_count > state->can_rxBufferSize - 3) {
+    if (state->rxRing.GetCount() > state->can_rxBufferSize - 3) {
         return;
     }
 
-    STM32F7_Can_Message *can_msg = &state->canRxMessagesFifo[state->can_rx_in];
+    size_t available;
+
+    STM32F7_Can_Message *can_msg = state->rxRing.GetWriteSpan(available);
+
+    if (can_msg == nullptr)
+        return;
 
     uint64_t t = STM32F7_Time_GetCurrentProcessorTime();
 
@@ -1195,14 +1199,9 @@ void STM32_Can_RxInterruptHandler(int32_t controllerIndex) {
 
     can_msg->length = len;
 
-    state->can_rx_count++;
-    state->can_rx_in++;
-
-    if (state->can_rx_in == state->can_rxBufferSize) {
-        state->can_rx_in = 0;
-    }
+    state->rxRing.Commit(1);
 
-    state->messageReceivedEventHandler(state->provider, state->can_rx_count, t);
+    state->messageReceivedEventHandler(state->provider, state->rxRing.GetCount(), t);
 
     return;
 }
@@ -1242,9 +1241,7 @@ TinyCLR_Result STM32F7_Can_Acquire(const TinyCLR_Can_Controller* self) {
         STM32F7_GpioInternal_ConfigurePin(canTxPins[controllerIndex].number, STM32F7_Gpio_PortMode::AlternateFunction, STM32F7_Gpio_OutputType::PushPull, STM32F7_Gpio_OutputSpeed::High, STM32F7_Gpio_PullDirection::PullUp, canTxPins[controllerIndex].alternateFunction);
         STM32F7_GpioInternal_ConfigurePin(canRxPins[controllerIndex].number, STM32F7_Gpio_PortMode::AlternateFunction, STM32F7_Gpio_OutputType::PushPull, STM32F7_Gpio_OutputSpeed::High, STM32F7_Gpio_PullDirection::PullUp, canRxPins[controllerIndex].alternateFunction);
 
-        state->can_rx_count = 0;
-        state->can_rx_in = 0;
-        state->can_rx_out = 0;
+        state->rxRing.Uninitialize();
         state->baudrate = 0;
         state->can_rxBufferSize = canDefaultBuffersSize[controllerIndex];
         state->provider = self;
@@ -1275,6 +1272,8 @@ TinyCLR_Result STM32F7_Can_Release(const TinyCLR_Can_Controller* self) {
 
         RCC->APB1ENR &= ((controllerIndex == 0) ? ~RCC_APB1ENR_CAN1EN : ~RCC_APB1ENR_CAN2EN);
 
+        state->rxRing.Uninitialize();
+
         if (state->canRxMessagesFifo != nullptr) {
             memoryProvider->Free(memoryProvider, state->canRxMessagesFifo);
 
@@ -1295,9 +1294,7 @@ TinyCLR_Result STM32F7_Can_SoftReset(const TinyCLR_Can_Controller* self) {
 
     CAN_TypeDef* CANx = ((controllerIndex == 0) ? CAN1 : CAN2);
 
-    state->can_rx_count = 0;
-    state->can_rx_in = 0;
-    state->can_rx_out = 0;
+    state->rxRing.Discard();
 
     RCC->APB1RSTR |= ((controllerIndex == 0) ? RCC_APB1ENR_CAN1EN : RCC_APB1ENR_CAN2EN);
 
@@ -1394,17 +1391,8 @@ TinyCLR_Result STM32F7_Can_ReadMessage(const TinyCLR_Can_Controller* self, TinyC
 
     uint32_t* data32 = (uint32_t*)data;
 
-    if (state->can_rx_count) {
-        DISABLE_INTERRUPTS_SCOPED(irq);
-
-        can_msg = &state->canRxMessagesFifo[state->can_rx_out];
-        state->can_rx_out++;
-
-        if (state->can_rx_out == state->can_rxBufferSize)
-            state->can_rx_out = 0;
-
-        state->can_rx_count--;
-
+    // the interrupt handler only moves the head, the message is copied out without holding it off
+    if ((can_msg = state->rxRing.Peek()) != nullptr) {
         arbitrationId = can_msg->MsgID;
         isExtendedId = can_msg->extendedId;
         isRemoteTransmissionRequest = can_msg->remoteTransmissionRequest;
@@ -1414,6 +1402,8 @@ TinyCLR_Result STM32F7_Can_ReadMessage(const TinyCLR_Can_Controller* self, TinyC
         data32[1] = can_msg->DataB;
 
         timestamp = ((uint64_t)can_msg->TimeStampL) | ((uint64_t)can_msg->TimeStampH << 32);
+
+        state->rxRing.Consume(1);
     }
 
     return TinyCLR_Result::Success;
@@ -1435,11 +1425,16 @@ TinyCLR_Result STM32F7_Can_SetBitTiming(const TinyCLR_Can_Controller* self, cons
 
     CAN_TypeDef* CANx = ((controllerIndex == 0) ? CAN1 : CAN2);
 
-    if (state->canRxMessagesFifo == nullptr)
-        state->canRxMessagesFifo = (STM32F7_Can_Message*)memoryProvider->Allocate(memoryProvider, state->can_rxBufferSize * sizeof(STM32F7_Can_Message));
-
     if (state->canRxMessagesFifo == nullptr) {
-        return TinyCLR_Result::OutOfMemory;
+        auto capacity = RingBuffer<STM32F7_Can_Message>::GetCapacityFor(state->can_rxBufferSize);
+
+        state->canRxMessagesFifo = (STM32F7_Can_Message*)memoryProvider->Allocate(memoryProvider, capacity * sizeof(STM32F7_Can_Message));
+
+        if (state->canRxMessagesFifo == nullptr) {
+            return TinyCLR_Result::OutOfMemory;
+        }
+
+        state->rxRing.Initialize(state->canRxMessagesFifo, capacity);
     }
 
     RCC->APB1RSTR |= ((controllerIndex == 0) ? RCC_APB1ENR_CAN1EN : RCC_APB1ENR_CAN2EN);
@@ -1497,7 +1492,7 @@ TinyCLR_Result STM32F7_Can_SetBitTiming(const TinyCLR_Can_Controller* self, cons
 size_t STM32F7_Can_GetMessagesToRead(const TinyCLR_Can_Controller* self) {
     auto state = reinterpret_cast<CanState*>(self->ApiInfo->State);
 
-    return state->can_rx_count;
+    return state->rxRing.GetCount();
 }
 
 TinyCLR_Result STM32F7_Can_SetMessageReceivedHandler(const TinyCLR_Can_Controller* self, TinyCLR_Can_MessageReceivedHandler handler) {
@@ -1590,9 +1585,7 @@ TinyCLR_Result STM32F7_Can_SetGroupFilters(const TinyCLR_Can_Controller* self, c
 TinyCLR_Result STM32F7_Can_ClearReadBuffer(const TinyCLR_Can_Controller* self) {
     auto state = reinterpret_cast<CanState*>(self->ApiInfo->State);
 
-    state->can_rx_count = 0;
-    state->can_rx_in = 0;
-    state->can_rx_out = 0;
+    state->rxRing.Discard();
 
     return TinyCLR_Result::Success;
 }
@@ -1637,6 +1630,7 @@ uint32_t STM32F7_Can_GetSourceClock(const TinyCLR_Can_Controller* self) {
 void STM32F7_Can_Reset() {
     for (int i = 0; i < TOTAL_CAN_CONTROLLERS; i++) {
         canStates[i].canRxMessagesFifo = nullptr;
+        canStates[i].rxRing.Uninitialize();
 
         STM32F7_Can_Release(&canControllers[i]);
 
@@ -15,6 +15,7 @@
 // limitations under the License.
 
 #include "STM32F7.h"
+#include "../../Drivers/TriggerTimer/TriggerTimer.h"
 
 #ifdef INCLUDE_DAC
 ///////////////////////////////////////////////////////////////////////////////
@@ -24,15 +25,47 @@
 #define STM32F7_DAC_FIRST_PIN 4
 #define STM32F7_DAC_RESOLUTION_INT_BIT 12
 
+// Streaming output paces each channel with the TRGO of a basic timer and feeds it by DMA
+#ifndef STM32F7_DAC_TRIGGER_TIMERS
+#define STM32F7_DAC_TRIGGER_TIMERS { 7, 6 }
+#endif
+
+#ifndef STM32F7_DAC_DMA_STREAMS
+#define STM32F7_DAC_DMA_STREAMS { DMA_STREAM(1, 5, 7), DMA_STREAM(1, 6, 7) }
+#endif
+
+// APB1 timers run at twice the bus clock unless the bus is undivided
+#define STM32F7_DAC_TRIGGER_CLOCK_HZ (STM32F7_APB1_CLOCK_HZ == STM32F7_AHB_CLOCK_HZ ? STM32F7_APB1_CLOCK_HZ : STM32F7_APB1_CLOCK_HZ * 2)
+#define STM32F7_DAC_MAX_SAMPLE_RATE 1000000
+
+#define STM32F7_DAC_DMA_CONFIGURATION (DMA_SxCR_PL_1 | DMA_SxCR_MSIZE_0 | DMA_SxCR_PSIZE_0 | DMA_SxCR_MINC | DMA_SxCR_DIR_0 | DMA_SxCR_HTIE | DMA_SxCR_TCIE | DMA_SxCR_TEIE)
+
 static TinyCLR_Dac_Controller dacControllers[TOTAL_DAC_CONTROLLERS];
 static TinyCLR_Api_Info dacApi[TOTAL_DAC_CONTROLLERS];
 
+struct DacStream {
+    bool active;
+    bool circular;
+    uint16_t* buffer;
+    size_t length;
+    STM32F7_Dac_StreamHandler handler;
+    void* param;
+    uint32_t ready;
+    uint32_t submitted;
+    uint32_t channel;
+};
+
 struct DacState {
     bool isOpened[STM32F7_DAC_CHANNEL_NUMS];
+
+    DacStream streams[STM32F7_DAC_CHANNEL_NUMS];
 };
 
 static DacState dacStates[TOTAL_DAC_CONTROLLERS];
 
+static const uint32_t dacTriggerTimers[] = STM32F7_DAC_TRIGGER_TIMERS;
+static const STM32F7_Dma_Stream dacDmaStreams[] = STM32F7_DAC_DMA_STREAMS;
+
 const char* dacApiNames[TOTAL_DAC_CONTROLLERS] = {
     "GHIElectronics.TinyCLR.NativeApis.STM32F7.DacController\\0"
 };
@@ -63,6 +96,190 @@ void STM32F7_Dac_AddApi(const TinyCLR_Api_Manager* apiManager) {
     apiManager->SetDefaultName(apiManager, TinyCLR_Api_Type::DacController, dacApi[0].Name);
 }
 
+// A half of the stream buffer has been played. In a circular stream every half has to be submitted again before the
+// output wraps back to it, when none is left the half that starts playing now is stale and reported as an underrun.
+static void STM32F7_Dac_HalfPlayed(DacStream* stream, uint32_t half) {
+    auto count = stream->length / 2;
+    auto underrun = false;
+
+    if (stream->circular) {
+        if (stream->ready > 0)
+            stream->ready--;
+
+        underrun = stream->ready == 0;
+    }
+
+    if (stream->handler != nullptr)
+        stream->handler(stream->param, stream->buffer + half * count, count, underrun);
+}
+
+// Hands the oldest half given to the stream handler back for playing, after it has been filled with new samples.
+TinyCLR_Result STM32F7_Dac_SubmitStream(const TinyCLR_Dac_Controller* self, uint32_t channel) {
+    if (channel >= STM32F7_DAC_CHANNEL_NUMS)
+        return TinyCLR_Result::ArgumentOutOfRange;
+
+    auto state = reinterpret_cast<DacState*>(self->ApiInfo->State);
+    auto stream = &state->streams[channel];
+
+    if (!stream->active || !stream->circular)
+        return TinyCLR_Result::InvalidOperation;
+
+    auto count = stream->length / 2;
+
+    // the DMA reads memory, the new samples must not be left in the data cache
+    SCB_CleanDCache_by_Addr((uint32_t*)(stream->buffer + stream->submitted * count), count * sizeof(uint16_t));
+
+    DISABLE_INTERRUPTS_SCOPED(irq);
+
+    stream->submitted ^= 1;
+
+    if (stream->ready < 2)
+        stream->ready++;
+
+    return TinyCLR_Result::Success;
+}
+
+static TinyCLR_Result STM32F7_Dac_EndStream(DacStream* stream) {
+    if (!stream->active)
+        return TinyCLR_Result::Success;
+
+    auto timer = dacTriggerTimers[stream->channel];
+    auto shift = stream->channel ? 16 : 0;
+
+    (timer == 6 ? TIM6 : TIM7)->CR1 = 0;
+
+    DAC->CR &= ~((DAC_CR_TEN1 | DAC_CR_TSEL1 | DAC_CR_DMAEN1) << shift);
+
+    STM32F7_DmaInternal_CloseStream(dacDmaStreams[stream->channel]);
+
+#ifdef INCLUDE_PWM
+    STM32F7_PwmInternal_ReleaseTimer(timer);
+#endif
+
+    stream->active = false;
+
+    return TinyCLR_Result::Success;
+}
+
+static void STM32F7_Dac_DmaHandler(void* param, uint32_t flags) {
+    auto stream = reinterpret_cast<DacStream*>(param);
+
+    if (flags & DMA_LISR_TEIF0) {
+        auto handler = stream->handler;
+
+        // the stream has disabled itself
+        STM32F7_Dac_EndStream(stream);
+
+        if (handler != nullptr)
+            handler(stream->param, nullptr, 0, false);
+
+        return;
+    }
+
+    if (flags & DMA_LISR_HTIF0)
+        STM32F7_Dac_HalfPlayed(stream, 0);
+
+    if (flags & DMA_LISR_TCIF0) {
+        // a single pass ends here, the output holds the last sample
+        if (!stream->circular)
+            STM32F7_Dac_EndStream(stream);
+
+        STM32F7_Dac_HalfPlayed(stream, 1);
+    }
+}
+
+// Plays buffer on an open channel at frequency samples per second, frequency is updated to the rate that is really
+// used. Samples are 16 bit left aligned, the bits below the converter resolution are dropped. The buffer is played
+// in two halves and handler, which can be null, is called from the DMA interrupt with each half once it has been
+// played. A single pass stops after the second half. A circular stream goes on with the other half and wraps, each
+// half handed to handler has to be filled and given back with SubmitStream before the output gets to it again or
+// it is played again and reported as an underrun. A transfer error stops the stream and is reported with a null
+// half.
+TinyCLR_Result STM32F7_Dac_StartStream(const TinyCLR_Dac_Controller* self, uint32_t channel, uint16_t* buffer, size_t length, double& frequency, bool circular, STM32F7_Dac_StreamHandler handler, void* param) {
+    if (channel >= STM32F7_DAC_CHANNEL_NUMS)
+        return TinyCLR_Result::ArgumentOutOfRange;
+
+    if (buffer == nullptr)
+        return TinyCLR_Result::ArgumentNull;
+
+    auto state = reinterpret_cast<DacState*>(self->ApiInfo->State);
+    auto stream = &state->streams[channel];
+    auto timer = dacTriggerTimers[channel];
+
+    if (!state->isOpened[channel] || stream->active)
+        return TinyCLR_Result::InvalidOperation;
+
+    if (timer != 6 && timer != 7)
+        return TinyCLR_Result::NotSupported;
+
+    // NDTR is 16 bits
+    if (length < 2 || length % 2 != 0 || length > 0xFFFF)
+        return TinyCLR_Result::ArgumentInvalid;
+
+    if (((uint32_t)buffer & 0x1F) != 0 || !STM32F7_DmaInternal_IsAccessible(buffer))
+        return TinyCLR_Result::ArgumentInvalid;
+
+    // halves are cleaned from the data cache when submitted, so they can not share a cache line
+    if ((length * sizeof(uint16_t) / 2) % 32 != 0)
+        return TinyCLR_Result::ArgumentInvalid;
+
+    if (frequency < (double)STM32F7_DAC_TRIGGER_CLOCK_HZ / 0x100000000ull || frequency > STM32F7_DAC_MAX_SAMPLE_RATE)
+        return TinyCLR_Result::ArgumentOutOfRange;
+
+#ifdef INCLUDE_PWM
+    if (!STM32F7_PwmInternal_ReserveTimer(timer))
+        return TinyCLR_Result::SharingViolation;
+#endif
+
+    if (!STM32F7_DmaInternal_OpenStream(dacDmaStreams[channel])) {
+#ifdef INCLUDE_PWM
+        STM32F7_PwmInternal_ReleaseTimer(timer);
+#endif
+
+        return TinyCLR_Result::SharingViolation;
+    }
+
+    stream->active = true;
+    stream->circular = circular;
+    stream->buffer = buffer;
+    stream->length = length;
+    stream->handler = handler;
+    stream->param = param;
+    stream->ready = 2;
+    stream->submitted = 0;
+    stream->channel = channel;
+
+    auto tim = timer == 6 ? TIM6 : TIM7;
+
+    RCC->APB1ENR |= timer == 6 ? RCC_APB1ENR_TIM6EN : RCC_APB1ENR_TIM7EN;
+
+    frequency = TriggerTimer_Program(*tim, STM32F7_DAC_TRIGGER_CLOCK_HZ, frequency);
+
+    SCB_CleanDCache_by_Addr((uint32_t*)buffer, length * sizeof(uint16_t));
+
+    STM32F7_DmaInternal_SetHandler(dacDmaStreams[channel], &STM32F7_Dac_DmaHandler, stream);
+    STM32F7_DmaInternal_Start(dacDmaStreams[channel], channel ? &DAC->DHR12L2 : &DAC->DHR12L1, buffer, length, STM32F7_DAC_DMA_CONFIGURATION | (circular ? DMA_SxCR_CIRC : 0));
+
+    // TIM6 is trigger 0 and TIM7 trigger 2
+    auto shift = channel ? 16 : 0;
+    auto control = DAC_CR_TEN1 | DAC_CR_DMAEN1 | (timer == 6 ? 0 : DAC_CR_TSEL1_1);
+
+    DAC->CR = (DAC->CR & ~((DAC_CR_TEN1 | DAC_CR_TSEL1 | DAC_CR_DMAEN1) << shift)) | (control << shift);
+
+    tim->CR1 = TIM_CR1_CEN;
+
+    return TinyCLR_Result::Success;
+}
+
+TinyCLR_Result STM32F7_Dac_StopStream(const TinyCLR_Dac_Controller* self, uint32_t channel) {
+    if (channel >= STM32F7_DAC_CHANNEL_NUMS)
+        return TinyCLR_Result::ArgumentOutOfRange;
+
+    auto state = reinterpret_cast<DacState*>(self->ApiInfo->State);
+
+    return STM32F7_Dac_EndStream(&state->streams[channel]);
+}
+
 TinyCLR_Result STM32F7_Dac_Acquire(const TinyCLR_Dac_Controller* self) {
     if (self == nullptr)
         return TinyCLR_Result::ArgumentNull;
@@ -104,6 +321,8 @@ TinyCLR_Result STM32F7_Dac_OpenChannel(const TinyCLR_Dac_Controller* self, uint3
 TinyCLR_Result STM32F7_Dac_CloseChannel(const TinyCLR_Dac_Controller* self, uint32_t channel) {
     auto state = reinterpret_cast<DacState*>(self->ApiInfo->State);
 
+    STM32F7_Dac_EndStream(&state->streams[channel]);
+
     if (channel) {
         DAC->CR &= ~DAC_CR_EN2; // disable channel 2
     }
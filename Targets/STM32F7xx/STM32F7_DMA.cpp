@@ -0,0 +1,211 @@
+// Copyright GHI Electronics, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "STM32F7.h"
+
+#define TOTAL_DMA_CONTROLLERS 2
+#define TOTAL_DMA_STREAMS_PER_CONTROLLER 8
+
+#define DMA_FLAG_MASK (DMA_LISR_FEIF0 | DMA_LISR_DMEIF0 | DMA_LISR_TEIF0 | DMA_LISR_HTIF0 | DMA_LISR_TCIF0)
+
+static const uint8_t dmaFlagShift[4] = { 0, 6, 16, 22 };
+
+static bool dmaStreamReserved[TOTAL_DMA_CONTROLLERS][TOTAL_DMA_STREAMS_PER_CONTROLLER];
+
+struct DmaStreamHandler {
+    STM32F7_Dma_Handler handler;
+    void* param;
+};
+
+static DmaStreamHandler dmaStreamHandlers[TOTAL_DMA_CONTROLLERS][TOTAL_DMA_STREAMS_PER_CONTROLLER];
+
+static const IRQn_Type dmaStreamIrqs[TOTAL_DMA_CONTROLLERS][TOTAL_DMA_STREAMS_PER_CONTROLLER] = {
+    { DMA1_Stream0_IRQn, DMA1_Stream1_IRQn, DMA1_Stream2_IRQn, DMA1_Stream3_IRQn, DMA1_Stream4_IRQn, DMA1_Stream5_IRQn, DMA1_Stream6_IRQn, DMA1_Stream7_IRQn },
+    { DMA2_Stream0_IRQn, DMA2_Stream1_IRQn, DMA2_Stream2_IRQn, DMA2_Stream3_IRQn, DMA2_Stream4_IRQn, DMA2_Stream5_IRQn, DMA2_Stream6_IRQn, DMA2_Stream7_IRQn }
+};
+
+static bool STM32F7_DmaInternal_IsValid(const STM32F7_Dma_Stream& dma) {
+    return dma.controller > 0 && dma.controller <= TOTAL_DMA_CONTROLLERS && dma.stream < TOTAL_DMA_STREAMS_PER_CONTROLLER;
+}
+
+static DMA_TypeDef* STM32F7_DmaInternal_GetController(const STM32F7_Dma_Stream& dma) {
+    return dma.controller == 1 ? DMA1 : DMA2;
+}
+
+static void STM32F7_DmaInternal_InterruptHandler(int32_t controller, int32_t stream) {
+    INTERRUPT_STARTED_SCOPED(isr);
+
+    STM32F7_Dma_Stream dma = { (uint8_t)(controller + 1), (uint8_t)stream, 0 };
+
+    auto flags = STM32F7_DmaInternal_GetFlags(dma);
+    auto& entry = dmaStreamHandlers[controller][stream];
+
+    STM32F7_DmaInternal_ClearFlags(dma, flags);
+
+    if (entry.handler != nullptr)
+        entry.handler(entry.param, flags);
+}
+
+void STM32F7_Dma1_Stream0_Interrupt(void* param) { STM32F7_DmaInternal_InterruptHandler(0, 0); }
+void STM32F7_Dma1_Stream1_Interrupt(void* param) { STM32F7_DmaInternal_InterruptHandler(0, 1); }
+void STM32F7_Dma1_Stream2_Interrupt(void* param) { STM32F7_DmaInternal_InterruptHandler(0, 2); }
+void STM32F7_Dma1_Stream3_Interrupt(void* param) { STM32F7_DmaInternal_InterruptHandler(0, 3); }
+void STM32F7_Dma1_Stream4_Interrupt(void* param) { STM32F7_DmaInternal_InterruptHandler(0, 4); }
+void STM32F7_Dma1_Stream5_Interrupt(void* param) { STM32F7_DmaInternal_InterruptHandler(0, 5); }
+void STM32F7_Dma1_Stream6_Interrupt(void* param) { STM32F7_DmaInternal_InterruptHandler(0, 6); }
+void STM32F7_Dma1_Stream7_Interrupt(void* param) { STM32F7_DmaInternal_InterruptHandler(0, 7); }
+void STM32F7_Dma2_Stream0_Interrupt(void* param) { STM32F7_DmaInternal_InterruptHandler(1, 0); }
+void STM32F7_Dma2_Stream1_Interrupt(void* param) { STM32F7_DmaInternal_InterruptHandler(1, 1); }
+void STM32F7_Dma2_Stream2_Interrupt(void* param) { STM32F7_DmaInternal_InterruptHandler(1, 2); }
+void STM32F7_Dma2_Stream3_Interrupt(void* param) { STM32F7_DmaInternal_InterruptHandler(1, 3); }
+void STM32F7_Dma2_Stream4_Interrupt(void* param) { STM32F7_DmaInternal_InterruptHandler(1, 4); }
+void STM32F7_Dma2_Stream5_Interrupt(void* param) { STM32F7_DmaInternal_InterruptHandler(1, 5); }
+void STM32F7_Dma2_Stream6_Interrupt(void* param) { STM32F7_DmaInternal_InterruptHandler(1, 6); }
+void STM32F7_Dma2_Stream7_Interrupt(void* param) { STM32F7_DmaInternal_InterruptHandler(1, 7); }
+
+typedef void(*DmaStreamInterrupt)(void* param);
+
+static const DmaStreamInterrupt dmaStreamInterrupts[TOTAL_DMA_CONTROLLERS][TOTAL_DMA_STREAMS_PER_CONTROLLER] = {
+    { &STM32F7_Dma1_Stream0_Interrupt, &STM32F7_Dma1_Stream1_Interrupt, &STM32F7_Dma1_Stream2_Interrupt, &STM32F7_Dma1_Stream3_Interrupt, &STM32F7_Dma1_Stream4_Interrupt, &STM32F7_Dma1_Stream5_Interrupt, &STM32F7_Dma1_Stream6_Interrupt, &STM32F7_Dma1_Stream7_Interrupt },
+    { &STM32F7_Dma2_Stream0_Interrupt, &STM32F7_Dma2_Stream1_Interrupt, &STM32F7_Dma2_Stream2_Interrupt, &STM32F7_Dma2_Stream3_Interrupt, &STM32F7_Dma2_Stream4_Interrupt, &STM32F7_Dma2_Stream5_Interrupt, &STM32F7_Dma2_Stream6_Interrupt, &STM32F7_Dma2_Stream7_Interrupt }
+};
+
+bool STM32F7_DmaInternal_OpenStream(const STM32F7_Dma_Stream& dma) {
+    if (!STM32F7_DmaInternal_IsValid(dma) || dmaStreamReserved[dma.controller - 1][dma.stream])
+        return false;
+
+    dmaStreamReserved[dma.controller - 1][dma.stream] = true;
+
+    RCC->AHB1ENR |= (dma.controller == 1) ? RCC_AHB1ENR_DMA1EN : RCC_AHB1ENR_DMA2EN;
+
+    auto stream = STM32F7_DmaInternal_GetStream(dma);
+
+    stream->CR = 0;
+
+    while (stream->CR & DMA_SxCR_EN);
+
+    STM32F7_DmaInternal_ClearFlags(dma, DMA_FLAG_MASK);
+
+    return true;
+}
+
+bool STM32F7_DmaInternal_CloseStream(const STM32F7_Dma_Stream& dma) {
+    if (!STM32F7_DmaInternal_IsValid(dma))
+        return false;
+
+    if (dmaStreamReserved[dma.controller - 1][dma.stream]) {
+        STM32F7_DmaInternal_SetHandler(dma, nullptr, nullptr);
+        STM32F7_DmaInternal_Stop(dma);
+
+        dmaStreamReserved[dma.controller - 1][dma.stream] = false;
+    }
+
+    return true;
+}
+
+DMA_Stream_TypeDef* STM32F7_DmaInternal_GetStream(const STM32F7_Dma_Stream& dma) {
+    auto base = (dma.controller == 1) ? DMA1_Stream0_BASE : DMA2_Stream0_BASE;
+
+    return (DMA_Stream_TypeDef*)(base + dma.stream * (DMA1_Stream1_BASE - DMA1_Stream0_BASE));
+}
+
+uint32_t STM32F7_DmaInternal_GetFlags(const STM32F7_Dma_Stream& dma) {
+    auto controller = STM32F7_DmaInternal_GetController(dma);
+    auto isr = dma.stream < 4 ? controller->LISR : controller->HISR;
+
+    return (isr >> dmaFlagShift[dma.stream & 0x03]) & DMA_FLAG_MASK;
+}
+
+void STM32F7_DmaInternal_ClearFlags(const STM32F7_Dma_Stream& dma, uint32_t flags) {
+    auto controller = STM32F7_DmaInternal_GetController(dma);
+    auto value = (flags & DMA_FLAG_MASK) << dmaFlagShift[dma.stream & 0x03];
+
+    if (dma.stream < 4)
+        controller->LIFCR = value;
+    else
+        controller->HIFCR = value;
+}
+
+void STM32F7_DmaInternal_Start(const STM32F7_Dma_Stream& dma, volatile void* peripheral, const void* memory, size_t count, uint32_t configuration, uint32_t fifoConfiguration) {
+    auto stream = STM32F7_DmaInternal_GetStream(dma);
+
+    // the address and count registers ignore writes while the stream is enabled
+    stream->CR &= ~DMA_SxCR_EN;
+
+    while (stream->CR & DMA_SxCR_EN);
+
+    STM32F7_DmaInternal_ClearFlags(dma, DMA_FLAG_MASK);
+
+    stream->PAR = (uint32_t)peripheral;
+    stream->M0AR = (uint32_t)memory;
+    stream->NDTR = count;
+    stream->FCR = fifoConfiguration; // 0 selects direct mode
+    stream->CR = configuration | (((uint32_t)dma.channel << DMA_SxCR_CHSEL_Pos) & DMA_SxCR_CHSEL_Msk);
+    stream->CR |= DMA_SxCR_EN;
+}
+
+void STM32F7_DmaInternal_Stop(const STM32F7_Dma_Stream& dma) {
+    auto stream = STM32F7_DmaInternal_GetStream(dma);
+
+    stream->CR &= ~DMA_SxCR_EN;
+
+    while (stream->CR & DMA_SxCR_EN);
+
+    STM32F7_DmaInternal_ClearFlags(dma, DMA_FLAG_MASK);
+}
+
+bool STM32F7_DmaInternal_SetHandler(const STM32F7_Dma_Stream& dma, STM32F7_Dma_Handler handler, void* param) {
+    if (!STM32F7_DmaInternal_IsValid(dma))
+        return false;
+
+    auto& entry = dmaStreamHandlers[dma.controller - 1][dma.stream];
+    auto irq = dmaStreamIrqs[dma.controller - 1][dma.stream];
+
+    if (handler != nullptr) {
+        entry.param = param;
+        entry.handler = handler;
+
+        STM32F7_InterruptInternal_Activate(irq, (uint32_t*)dmaStreamInterrupts[dma.controller - 1][dma.stream], 0);
+    }
+    else {
+        STM32F7_InterruptInternal_Deactivate(irq);
+
+        entry.handler = nullptr;
+        entry.param = nullptr;
+    }
+
+    return true;
+}
+
+size_t STM32F7_DmaInternal_GetRemaining(const STM32F7_Dma_Stream& dma) {
+    return STM32F7_DmaInternal_GetStream(dma)->NDTR;
+}
+
+bool STM32F7_DmaInternal_IsAccessible(const void* address) {
+    // the instruction TCM is only reachable by the core, the data TCM is through the AHBS port
+    if ((uint32_t)address < RAMITCM_BASE + 0x4000)
+        return false;
+
+    return true;
+}
+
+void STM32F7_Dma_Reset() {
+    for (auto c = 0; c < TOTAL_DMA_CONTROLLERS; c++) {
+        for (auto s = 0; s < TOTAL_DMA_STREAMS_PER_CONTROLLER; s++) {
+            STM32F7_Dma_Stream dma = { (uint8_t)(c + 1), (uint8_t)s, 0 };
+
+            STM32F7_DmaInternal_CloseStream(dma);
+        }
+    }
+}
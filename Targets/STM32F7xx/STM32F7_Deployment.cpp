@@ -20,6 +20,7 @@
 #endif
 
 #include "STM32F7.h"
+#include "../../Drivers/DeploymentIndex/DeploymentIndex.h"
 #include <stdio.h>
 
 #define TOTAL_DEPLOYMENT_CONTROLLERS 1
@@ -71,6 +72,19 @@
 #error Flash programming not allowed for HCLK below 1MHz
 #endif
 
+// Program with the widest parallelism the supply allows. x64 also needs the external VPP supply, a device that has
+// one defines STM32F7_FLASH_VPP.
+#if defined(STM32F7_FLASH_VPP)
+#define STM32F7_FLASH_PROGRAM_SIZE 8
+#elif STM32F7_SUPPLY_VOLTAGE_MV >= 2700
+#define STM32F7_FLASH_PROGRAM_SIZE 4
+#else
+#define STM32F7_FLASH_PROGRAM_SIZE 2
+#endif
+
+// Writes compare a line against the flash first and skip it when it already holds the data.
+#define STM32F7_FLASH_LINE_SIZE 32
+
 static const uint32_t STM32F7_FLASH_KEY1 = 0x45670123;
 static const uint32_t STM32F7_FLASH_KEY2 = 0xcdef89ab;
 
@@ -96,6 +110,12 @@ struct DeploymentState {
     TinyCLR_Storage_Descriptor storageDescriptor;
     TinyCLR_Startup_DeploymentConfiguration deploymentConfiguration;
 
+    // sectors known to be erased and sectors whose state is known, both filled in as they are checked or changed
+    uint32_t erasedSectors[(SIZEOF_ARRAY(deploymentSectors) + 31) / 32];
+    uint32_t knownSectors[(SIZEOF_ARRAY(deploymentSectors) + 31) / 32];
+
+    DeploymentIndex<SIZEOF_ARRAY(deploymentSectors)> index;
+
     bool isOpened = false;
     bool tableInitialized = false;
 };
@@ -136,6 +156,11 @@ void STM32F7_Flash_EnsureTableInitialized() {
 
         deploymentStates[i].tableInitialized = true;
 
+        memset(deploymentStates[i].erasedSectors, 0, sizeof(deploymentStates[i].erasedSectors));
+        memset(deploymentStates[i].knownSectors, 0, sizeof(deploymentStates[i].knownSectors));
+
+        deploymentStates[i].index.Reset();
+
         for (auto ii = 0; ii < deploymentStates[i].regionCount; ii++) {
             deploymentStates[i].regionAddresses[ii] = deploymentSectors[ii].address;
             deploymentStates[i].regionSizes[ii] = deploymentSectors[ii].size;
@@ -181,6 +206,80 @@ TinyCLR_Result __section("SectionForFlashOperations") STM32F7_Flash_Read(const T
 }
 
 
+static void STM32F7_Flash_SetSectorState(const TinyCLR_Storage_Controller* self, uint32_t sector, bool known, bool erased) {
+    auto state = reinterpret_cast<DeploymentState*>(self->ApiInfo->State);
+    auto mask = 1UL << (sector % 32);
+
+    state->knownSectors[sector / 32] = known ? (state->knownSectors[sector / 32] | mask) : (state->knownSectors[sector / 32] & ~mask);
+    state->erasedSectors[sector / 32] = erased ? (state->erasedSectors[sector / 32] | mask) : (state->erasedSectors[sector / 32] & ~mask);
+}
+
+static bool __section("SectionForFlashOperations") STM32F7_Flash_Equals(uint32_t address, const uint8_t* data, uint32_t length) {
+    auto flash = reinterpret_cast<const uint8_t*>(address);
+
+    for (; length >= 4; length -= 4, flash += 4, data += 4)
+        if (*reinterpret_cast<const uint32_t*>(flash) != *reinterpret_cast<const uint32_t*>(data))
+            return false;
+
+    for (; length > 0; length--)
+        if (*flash++ != *data++)
+            return false;
+
+    return true;
+}
+
+// Programs size (1, 2, 4 or 8) bytes with the parallelism matching the access and waits up to timeout microseconds
+// for it.
+static bool __section("SectionForFlashOperations") STM32F7_Flash_ProgramUnit(uint32_t address, const uint8_t* data, uint32_t size, uint64_t timeout) {
+    STM32F7_FLASH->CR &= CR_PSIZE_MASK;
+    STM32F7_FLASH->CR |= size == 8 ? FLASH_PSIZE_DOUBLE_WORD : (size == 4 ? FLASH_PSIZE_WORD : (size == 2 ? FLASH_PSIZE_HALF_WORD : FLASH_PSIZE_BYTE));
+    STM32F7_FLASH->CR |= FLASH_CR_EOPIE;
+    STM32F7_FLASH->CR |= FLASH_CR_PG;
+
+    // write data
+    switch (size) {
+    case 8:
+        // a double word goes in as two word accesses
+        *reinterpret_cast<volatile uint32_t*>(address) = *reinterpret_cast<const uint32_t*>(data);
+
+        __ISB();
+
+        *reinterpret_cast<volatile uint32_t*>(address + 4) = *reinterpret_cast<const uint32_t*>(data + 4);
+
+        break;
+
+    case 4:
+        *reinterpret_cast<volatile uint32_t*>(address) = *reinterpret_cast<const uint32_t*>(data);
+
+        break;
+
+    case 2:
+        *reinterpret_cast<volatile uint16_t*>(address) = *reinterpret_cast<const uint16_t*>(data);
+
+        break;
+
+    default:
+        *reinterpret_cast<volatile uint8_t*>(address) = *data;
+
+        break;
+    }
+
+    __DSB();
+
+    // wait for completion
+    while (((STM32F7_FLASH->SR & FLASH_SR_EOP) == 0) || (STM32F7_FLASH->SR & FLASH_SR_BSY)) {
+        if (timeout == 0)
+            return false;
+
+        STM32F7_Time_Delay(nullptr, 1);
+        timeout--;
+    }
+
+    STM32F7_FLASH->SR |= FLASH_SR_EOP;
+
+    return STM32F7_Flash_Equals(address, data, size);
+}
+
 TinyCLR_Result __section("SectionForFlashOperations") STM32F7_Flash_Write(const TinyCLR_Storage_Controller* self, uint64_t address, size_t& count, const uint8_t* data, uint64_t timeout) {
     if (data == nullptr) return TinyCLR_Result::ArgumentNull;
 
@@ -188,6 +287,17 @@ TinyCLR_Result __section("SectionForFlashOperations") STM32F7_Flash_Write(const
 
     if (bytePerSector <= 0) return TinyCLR_Result::IndexOutOfRange;
 
+    auto state = reinterpret_cast<DeploymentState*>(self->ApiInfo->State);
+
+    // the sectors written to are no longer known to be erased and their hashes are stale
+    for (auto i = 0; i < state->regionCount; i++) {
+        if (state->regionAddresses[i] < address + count && address < state->regionAddresses[i] + state->regionSizes[i]) {
+            STM32F7_Flash_SetSectorState(self, i, false, false);
+
+            state->index.Invalidate(i);
+        }
+    }
+
     STM32F7_Startup_CacheDisable();
 
     if (STM32F7_FLASH->CR & FLASH_CR_LOCK) { // unlock
@@ -199,52 +309,41 @@ TinyCLR_Result __section("SectionForFlashOperations") STM32F7_Flash_Write(const
 
     STM32F7_FLASH->SR = (FLASH_SR_EOP | FLASH_SR_OPERR | FLASH_SR_WRPERR | FLASH_SR_PGAERR | FLASH_SR_PGPERR | FLASH_SR_ERSERR);
 
-    uint32_t* addressStart = reinterpret_cast<uint32_t*>(address);
-    uint32_t* addressEnd = reinterpret_cast<uint32_t*>(address + count);
-    uint32_t* pBuf = (uint32_t*)data;
+    uint32_t to = static_cast<uint32_t>(address);
+    uint32_t end = to + count;
+    auto result = TinyCLR_Result::Success;
 
-    // enable programming
-    auto to = timeout * 1000;
+    while (to < end && result == TinyCLR_Result::Success) {
+        uint32_t lineEnd = (to & ~(STM32F7_FLASH_LINE_SIZE - 1)) + STM32F7_FLASH_LINE_SIZE;
 
-    while (addressStart < addressEnd) {
-        if (*addressStart != *pBuf) {
+        if (lineEnd > end)
+            lineEnd = end;
 
-            STM32F7_FLASH->CR &= CR_PSIZE_MASK;
-            STM32F7_FLASH->CR |= FLASH_PSIZE_WORD;
-            STM32F7_FLASH->CR |= FLASH_CR_EOPIE;
-            STM32F7_FLASH->CR |= FLASH_CR_PG;
+        if (STM32F7_Flash_Equals(to, data, lineEnd - to)) {
+            data += lineEnd - to;
+            to = lineEnd;
 
-            // write data
-            *addressStart = *pBuf;
+            continue;
+        }
 
-            __DSB();
+        while (to < lineEnd) {
+            uint32_t size = STM32F7_FLASH_PROGRAM_SIZE;
 
-            // wait for completion
-            to = timeout;
+            // narrower accesses for the ends that are not aligned to the full width
+            while (size > 1 && ((to & (size - 1)) != 0 || to + size > lineEnd))
+                size /= 2;
 
-            while (((STM32F7_FLASH->SR & FLASH_SR_EOP) == 0) || (STM32F7_FLASH->SR & FLASH_SR_BSY)) {
-                STM32F7_Time_Delay(nullptr, 1);
-                to--;
+            if (!STM32F7_Flash_Equals(to, data, size) && !STM32F7_Flash_ProgramUnit(to, data, size, timeout)) {
+                result = TinyCLR_Result::InvalidOperation;
 
-                if (to == 0)
-                    goto end_programing;
+                break;
             }
 
-            STM32F7_FLASH->SR |= FLASH_SR_EOP;
-
-            if (*addressStart != *pBuf) {
-                to = 0;
-
-                goto end_programing;
-            }
+            to += size;
+            data += size;
         }
-
-        addressStart++;
-        pBuf++;
     }
 
-end_programing:
-
     STM32F7_FLASH->CR &= (~FLASH_CR_PG);
 
     // reset & lock the controller
@@ -252,7 +351,7 @@ end_programing:
 
     STM32F7_Startup_CacheEnable();
 
-    return timeout != 0 ? TinyCLR_Result::Success : TinyCLR_Result::InvalidOperation;
+    return result;
 }
 
 TinyCLR_Result __section("SectionForFlashOperations") STM32F7_Flash_IsErased(const TinyCLR_Storage_Controller* self, uint64_t address, size_t count, bool& erased) {
@@ -261,21 +360,32 @@ TinyCLR_Result __section("SectionForFlashOperations") STM32F7_Flash_IsErased(con
 
     if (sector >= state->regionCount) return TinyCLR_Result::IndexOutOfRange;
 
-    uint32_t* addressStart = reinterpret_cast<uint32_t*>(deploymentSectors[sector].address);
-    uint32_t* addressEnd = reinterpret_cast<uint32_t*>(deploymentSectors[sector].address + deploymentSectors[sector].size);
+    auto mask = 1UL << (sector % 32);
+
+    if (state->knownSectors[sector / 32] & mask) {
+        erased = (state->erasedSectors[sector / 32] & mask) != 0;
+
+        return TinyCLR_Result::Success;
+    }
+
+    // sectors are double word aligned, four double words are checked per pass
+    auto addressStart = reinterpret_cast<const uint64_t*>(deploymentSectors[sector].address);
+    auto addressEnd = reinterpret_cast<const uint64_t*>(deploymentSectors[sector].address + deploymentSectors[sector].size);
 
     erased = true;
 
     while (addressStart < addressEnd) {
-        if (*addressStart != 0xFFFFFFFF) {
+        if ((addressStart[0] & addressStart[1] & addressStart[2] & addressStart[3]) != 0xFFFFFFFFFFFFFFFFULL) {
             erased = false;
 
             break;
         }
 
-        addressStart++;
+        addressStart += 4;
     }
 
+    STM32F7_Flash_SetSectorState(self, sector, true, erased);
+
     return TinyCLR_Result::Success;
 }
 
@@ -296,7 +406,8 @@ TinyCLR_Result __section("SectionForFlashOperations") STM32F7_Flash_Erase(const
 
     STM32F7_FLASH->SR = (FLASH_SR_EOP | FLASH_SR_OPERR | FLASH_SR_WRPERR | FLASH_SR_PGAERR | FLASH_SR_PGPERR | FLASH_SR_ERSERR);
 
-    STM32F7_FLASH->CR = FLASH_PSIZE_WORD;
+    // erase with the same parallelism as programming, the wider the faster
+    STM32F7_FLASH->CR = STM32F7_FLASH_PROGRAM_SIZE == 8 ? FLASH_PSIZE_DOUBLE_WORD : (STM32F7_FLASH_PROGRAM_SIZE == 4 ? FLASH_PSIZE_WORD : FLASH_PSIZE_HALF_WORD);
     STM32F7_FLASH->CR |= FLASH_CR_EOPIE;
     STM32F7_FLASH->CR |= (num << 3);
     STM32F7_FLASH->CR |= FLASH_CR_SER;
@@ -307,6 +418,10 @@ TinyCLR_Result __section("SectionForFlashOperations") STM32F7_Flash_Erase(const
     // wait for completion
     while (((STM32F7_FLASH->SR & FLASH_SR_EOP) == 0) || (STM32F7_FLASH->SR & FLASH_SR_BSY));
 
+    auto errors = STM32F7_FLASH->SR & (FLASH_SR_OPERR | FLASH_SR_WRPERR | FLASH_SR_PGAERR | FLASH_SR_PGPERR | FLASH_SR_ERSERR);
+
+    STM32F7_FLASH->SR = errors;
+
     STM32F7_FLASH->CR &= (~FLASH_CR_SER);
     STM32F7_FLASH->CR &= SECTOR_MASK;
 
@@ -315,7 +430,28 @@ TinyCLR_Result __section("SectionForFlashOperations") STM32F7_Flash_Erase(const
 
     STM32F7_Startup_CacheEnable();
 
-    TinyCLR_Result::Success;
+    // a failed erase leaves the sector in an unknown state, only a successful one is remembered as erased
+    STM32F7_Flash_SetSectorState(self, sector, errors == 0, errors == 0);
+
+    state->index.Invalidate(sector);
+
+    return errors == 0 ? TinyCLR_Result::Success : TinyCLR_Result::InvalidOperation;
+}
+
+// Content hash of a deployment sector for the debugger to compare against the image, see DeploymentIndex.h.
+TinyCLR_Result STM32F7_Flash_GetSectorHash(const TinyCLR_Storage_Controller* self, uint64_t sector, uint64_t& hash) {
+    auto state = reinterpret_cast<DeploymentState*>(self->ApiInfo->State);
+
+    if (sector >= state->regionCount) return TinyCLR_Result::IndexOutOfRange;
+
+    if (!state->index.Get(sector, hash)) {
+        // the flash is memory mapped, the sector is hashed in place
+        hash = DeploymentIndex_Hash(DEPLOYMENT_INDEX_HASH_BASIS, reinterpret_cast<const uint8_t*>(deploymentSectors[sector].address), deploymentSectors[sector].size);
+
+        state->index.Set(sector, hash);
+    }
+
+    return TinyCLR_Result::Success;
 }
 
 TinyCLR_Result STM32F7_Flash_Acquire(const TinyCLR_Storage_Controller* self) {
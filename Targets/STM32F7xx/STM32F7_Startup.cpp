@@ -51,6 +51,7 @@ void STM32F7_Startup_OnSoftReset(const TinyCLR_Api_Manager* apiManager, const Ti
 #ifdef INCLUDE_USBCLIENT
     STM32F7_UsbDevice_Reset();
 #endif
+    STM32F7_Dma_Reset();
 }
 
 #ifndef FLASH
@@ -16,6 +16,7 @@
 
 #include <algorithm>
 #include "STM32F7.h"
+#include "../../Drivers/RingBuffer/RingBuffer.h"
 
 #define USART_EVENT_POST_DEBOUNCE_TICKS (10 * 10000) // 10ms between each events
 // StopBits
@@ -41,14 +42,10 @@ struct UartState {
     uint8_t *TxBuffer;
     uint8_t *RxBuffer;
 
-    size_t txBufferCount;
-    size_t txBufferIn;
-    size_t txBufferOut;
+    RingBuffer<uint8_t> txRing;
     size_t txBufferSize;
 
-    size_t rxBufferCount;
-    size_t rxBufferIn;
-    size_t rxBufferOut;
+    RingBuffer<uint8_t> rxRing;
     size_t rxBufferSize;
 
     USART_TypeDef_Ptr portReg;
@@ -203,12 +200,16 @@ TinyCLR_Result STM32F7_Uart_SetReadBufferSize(const TinyCLR_Uart_Controller* sel
         return TinyCLR_Result::ArgumentInvalid;
 
     if (state->rxBufferSize) {
+        state->rxRing.Uninitialize();
+
         memoryProvider->Free(memoryProvider, state->RxBuffer);
     }
 
     state->rxBufferSize = size;
 
-    state->RxBuffer = (uint8_t*)memoryProvider->Allocate(memoryProvider, size);
+    auto capacity = RingBuffer<uint8_t>::GetCapacityFor(size);
+
+    state->RxBuffer = (uint8_t*)memoryProvider->Allocate(memoryProvider, capacity);
 
     if (state->RxBuffer == nullptr) {
         state->rxBufferSize = 0;
@@ -216,6 +217,8 @@ TinyCLR_Result STM32F7_Uart_SetReadBufferSize(const TinyCLR_Uart_Controller* sel
         return TinyCLR_Result::OutOfMemory;
     }
 
+    state->rxRing.Initialize(state->RxBuffer, capacity);
+
     return TinyCLR_Result::Success;
 }
 
@@ -236,12 +239,16 @@ TinyCLR_Result STM32F7_Uart_SetWriteBufferSize(const TinyCLR_Uart_Controller* se
         return TinyCLR_Result::ArgumentInvalid;
 
     if (state->txBufferSize) {
+        state->txRing.Uninitialize();
+
         memoryProvider->Free(memoryProvider, state->TxBuffer);
     }
 
     state->txBufferSize = size;
 
-    state->TxBuffer = (uint8_t*)memoryProvider->Allocate(memoryProvider, size);
+    auto capacity = RingBuffer<uint8_t>::GetCapacityFor(size);
+
+    state->TxBuffer = (uint8_t*)memoryProvider->Allocate(memoryProvider, capacity);
 
     if (state->TxBuffer == nullptr) {
         state->txBufferSize = 0;
@@ -249,6 +256,8 @@ TinyCLR_Result STM32F7_Uart_SetWriteBufferSize(const TinyCLR_Uart_Controller* se
         return TinyCLR_Result::OutOfMemory;
     }
 
+    state->txRing.Initialize(state->TxBuffer, capacity);
+
     return TinyCLR_Result::Success;
 }
 
@@ -268,13 +277,13 @@ void STM32F7_Uart_InterruptHandler(int8_t controllerIndex) {
     auto state = reinterpret_cast<UartState*>(&uartStates[controllerIndex]);
     auto sr = (uint16_t)(state->portReg->ISR);
     auto canPostEvent = STM32F7_Uart_CanPostEvent(controllerIndex);
-    bool error = (state->rxBufferCount == state->rxBufferSize) || (sr & USART_ISR_ORE) || (sr & USART_ISR_FE) || (sr & USART_ISR_PE);
+    bool error = state->rxRing.IsFull() || (sr & USART_ISR_ORE) || (sr & USART_ISR_FE) || (sr & USART_ISR_PE);
 
     if (sr & USART_ISR_RXNE || sr & USART_ISR_ORE || sr & USART_ISR_FE || sr & USART_ISR_PE) {
         uint8_t data = (uint8_t)(state->portReg->RDR); // read RX data
 
         if (state->errorEventHandler != nullptr && canPostEvent) {
-            if (state->rxBufferCount == state->rxBufferSize) {
+            if (state->rxRing.IsFull()) {
                 state->errorEventHandler(state->controller, TinyCLR_Uart_Error::BufferFull, STM32F7_Time_GetCurrentProcessorTime());
             }
 
@@ -298,25 +307,22 @@ void STM32F7_Uart_InterruptHandler(int8_t controllerIndex) {
             return;
 
         if (sr & USART_ISR_RXNE) {
-            state->RxBuffer[state->rxBufferIn++] = data;
-
-            state->rxBufferCount++;
-
-            if (state->rxBufferIn == state->rxBufferSize)
-                state->rxBufferIn = 0;
+            state->rxRing.Push(data);
 
             if (state->dataReceivedEventHandler != nullptr) {
                 if (canPostEvent) {
-                    if (state->rxBufferCount > state->lastEventRxBufferCount) {
+                    auto count = state->rxRing.GetCount();
+
+                    if (count > state->lastEventRxBufferCount) {
                         // if driver hold event long enough that more than 1 byte
-                        state->dataReceivedEventHandler(state->controller, state->rxBufferCount - state->lastEventRxBufferCount, STM32F7_Time_GetCurrentProcessorTime());
+                        state->dataReceivedEventHandler(state->controller, count - state->lastEventRxBufferCount, STM32F7_Time_GetCurrentProcessorTime());
                     }
                     else {
                         // if user use poll to read data and rxBufferCount <= lastEventRxBufferCount, driver send at least 1 byte comming
                         state->dataReceivedEventHandler(state->controller, 1, STM32F7_Time_GetCurrentProcessorTime());
                     }
 
-                    state->lastEventRxBufferCount = state->rxBufferCount;
+                    state->lastEventRxBufferCount = count;
                 }
             }
         }
@@ -324,14 +330,9 @@ void STM32F7_Uart_InterruptHandler(int8_t controllerIndex) {
 
     if (sr & USART_ISR_TXE) {
         if (STM32F7_Uart_CanSend(controllerIndex)) {
-            if (state->txBufferCount > 0) {
-                uint8_t data = state->TxBuffer[state->txBufferOut++];
-
-                state->txBufferCount--;
-
-                if (state->txBufferOut == state->txBufferSize)
-                    state->txBufferOut = 0;
+            uint8_t data;
 
+            if (state->txRing.Pop(data)) {
                 state->portReg->TDR = data; // write TX data
 
             }
@@ -404,14 +405,6 @@ TinyCLR_Result STM32F7_Uart_Acquire(const TinyCLR_Uart_Controller* self) {
         if (!STM32F7_GpioInternal_OpenPin(uartRxPins[controllerIndex].number) || !STM32F7_GpioInternal_OpenPin(uartTxPins[controllerIndex].number))
             return TinyCLR_Result::SharingViolation;
 
-        state->txBufferCount = 0;
-        state->txBufferIn = 0;
-        state->txBufferOut = 0;
-
-        state->rxBufferCount = 0;
-        state->rxBufferIn = 0;
-        state->rxBufferOut = 0;
-
         state->portReg = uartPortRegs[controllerIndex];
         state->controller = self;
 
@@ -700,12 +693,16 @@ TinyCLR_Result STM32F7_Uart_Release(const TinyCLR_Uart_Controller* self) {
             auto memoryProvider = (const TinyCLR_Memory_Manager*)apiManager->FindDefault(apiManager, TinyCLR_Api_Type::MemoryManager);
 
             if (state->txBufferSize != 0) {
+                state->txRing.Uninitialize();
+
                 memoryProvider->Free(memoryProvider, state->TxBuffer);
 
                 state->txBufferSize = 0;
             }
 
             if (state->rxBufferSize != 0) {
+                state->rxRing.Uninitialize();
+
                 memoryProvider->Free(memoryProvider, state->RxBuffer);
 
                 state->rxBufferSize = 0;
@@ -731,6 +728,9 @@ void STM32F7_Uart_Reset() {
         uartStates[i].txBufferSize = 0;
         uartStates[i].rxBufferSize = 0;
 
+        uartStates[i].txRing.Uninitialize();
+        uartStates[i].rxRing.Uninitialize();
+
         STM32F7_Uart_Release(&uartControllers[i]);
 
         uartStates[i].tableInitialized = false;
@@ -773,7 +773,7 @@ TinyCLR_Result STM32F7_Uart_Flush(const TinyCLR_Uart_Controller* self) {
     auto state = reinterpret_cast<UartState*>(self->ApiInfo->State);
 
     if (state->initializeCount) {
-        while (state->txBufferCount > 0) {
+        while (!state->txRing.IsEmpty()) {
             STM32F7_Time_Delay(nullptr, 1);
         }
     }
@@ -782,38 +782,19 @@ TinyCLR_Result STM32F7_Uart_Flush(const TinyCLR_Uart_Controller* self) {
 }
 
 TinyCLR_Result STM32F7_Uart_Read(const TinyCLR_Uart_Controller* self, uint8_t* buffer, size_t& length) {
-    DISABLE_INTERRUPTS_SCOPED(irq);
-
     auto state = reinterpret_cast<UartState*>(self->ApiInfo->State);
 
     if (state->initializeCount == 0) {
         return TinyCLR_Result::NotAvailable;
     }
 
-    length = std::min(self->GetBytesToRead(self), length);
-
-    size_t i = 0;
-
-    while (i < length) {
-        buffer[i++] = state->RxBuffer[state->rxBufferOut];
-
-        state->rxBufferOut++;
-
-        state->rxBufferCount--;
-
-        if (state->rxBufferOut == state->rxBufferSize)
-            state->rxBufferOut = 0;
-    }
+    // the interrupt handler only moves the head, no need to hold it off while copying out
+    length = state->rxRing.PopN(buffer, length);
 
     return TinyCLR_Result::Success;
 }
 
 TinyCLR_Result STM32F7_Uart_Write(const TinyCLR_Uart_Controller* self, const uint8_t* buffer, size_t& length) {
-
-    int32_t i = 0;
-
-    DISABLE_INTERRUPTS_SCOPED(irq);
-
     auto state = reinterpret_cast<UartState*>(self->ApiInfo->State);
 
     int32_t controllerIndex = state->controllerIndex;
@@ -822,26 +803,16 @@ TinyCLR_Result STM32F7_Uart_Write(const TinyCLR_Uart_Controller* self, const uin
         return TinyCLR_Result::NotAvailable;
     }
 
-    length = std::min(state->txBufferSize - state->txBufferCount, length);
+    if (state->txRing.IsFull()) {
+        length = 0;
 
-    if (state->txBufferCount == state->txBufferSize) {
         if (state->errorEventHandler != nullptr)
             state->errorEventHandler(state->controller, TinyCLR_Uart_Error::BufferFull, STM32F7_Time_GetCurrentProcessorTime());
 
         return TinyCLR_Result::Success;
     }
 
-    while (i < length) {
-
-        state->TxBuffer[state->txBufferIn] = buffer[i++];
-
-        state->txBufferCount++;
-
-        state->txBufferIn++;
-
-        if (state->txBufferIn == state->txBufferSize)
-            state->txBufferIn = 0;
-    }
+    length = state->txRing.PushN(buffer, length);
 
     if (length > 0) {
         STM32F7_Uart_TxBufferEmptyInterruptEnable(controllerIndex, true); // Enable Tx to start transfer
@@ -917,19 +888,20 @@ TinyCLR_Result STM32F7_Uart_SetIsRequestToSendEnabled(const TinyCLR_Uart_Control
 size_t STM32F7_Uart_GetBytesToRead(const TinyCLR_Uart_Controller* self) {
     auto state = reinterpret_cast<UartState*>(self->ApiInfo->State);
 
-    return state->rxBufferCount;
+    return state->rxRing.GetCount();
 }
 
 size_t STM32F7_Uart_GetBytesToWrite(const TinyCLR_Uart_Controller* self) {
     auto state = reinterpret_cast<UartState*>(self->ApiInfo->State);
 
-    return state->txBufferCount;
+    return state->txRing.GetCount();
 }
 
 TinyCLR_Result STM32F7_Uart_ClearReadBuffer(const TinyCLR_Uart_Controller* self) {
     auto state = reinterpret_cast<UartState*>(self->ApiInfo->State);
 
-    state->rxBufferCount = state->rxBufferIn = state->rxBufferOut = state->lastEventRxBufferCount = 0;
+    state->rxRing.Discard();
+    state->lastEventRxBufferCount = 0;
 
     return TinyCLR_Result::Success;
 }
@@ -937,7 +909,10 @@ TinyCLR_Result STM32F7_Uart_ClearReadBuffer(const TinyCLR_Uart_Controller* self)
 TinyCLR_Result STM32F7_Uart_ClearWriteBuffer(const TinyCLR_Uart_Controller* self) {
     auto state = reinterpret_cast<UartState*>(self->ApiInfo->State);
 
-    state->txBufferCount = state->txBufferIn = state->txBufferOut = 0;
+    // the interrupt handler owns the tail, keep it out while the ring is emptied from this side
+    DISABLE_INTERRUPTS_SCOPED(irq);
+
+    state->txRing.Discard();
 
     return TinyCLR_Result::Success;
 }
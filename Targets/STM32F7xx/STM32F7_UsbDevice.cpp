@@ -18,6 +18,16 @@
 #include "STM32F7.h"
 #include "../../Drivers/USBClient/USBClient.h"
 
+// Packets shared by all USB endpoints and how many of them each open endpoint keeps to itself. The default pool
+// holds what a single pipe used to allocate for its own queues.
+#ifndef STM32F7_USB_PACKET_POOL_COUNT
+#define STM32F7_USB_PACKET_POOL_COUNT (STM32F7_USB_PACKET_FIFO_COUNT * 2)
+#endif
+
+#ifndef STM32F7_USB_PACKET_FIFO_RESERVED
+#define STM32F7_USB_PACKET_FIFO_RESERVED 2
+#endif
+
 #define OTG_FS_BASE           (0x50000000)
 #define OTG_FS                ((OTG_TypeDef *) OTG_FS_BASE)
 
@@ -266,6 +276,8 @@ void STM32F7_UsbDevice_InitializeConfiguration(UsClientState *usClientState) {
         usClientState->controllerIndex = controller;
 
         usClientState->maxFifoPacketCountDefault = STM32F7_USB_PACKET_FIFO_COUNT;
+        usClientState->minFifoPacketCountDefault = STM32F7_USB_PACKET_FIFO_RESERVED;
+        usClientState->packetPoolCount = STM32F7_USB_PACKET_POOL_COUNT;
         usClientState->totalEndpointsCount = STM32F7_USB_ENDPOINT_COUNT;
         usClientState->totalPipesCount = STM32F7_USB_PIPE_COUNT;
 
@@ -474,12 +486,10 @@ void STM32F7_UsbDevice_EndpointInInterrupt(OTG_TypeDef* OTG, UsClientState* usCl
             }
         }
         else if (usClientState->queues[ep] != 0 && usClientState->isTxQueue[ep]) { // Tx data endpoint
+            const uint8_t* data;
 
-            USB_PACKET64* Packet64 = TinyCLR_UsbClient_TxDequeue(usClientState, ep);
-
-            if (Packet64) {  // data to send
-                ps = (uint32_t*)Packet64->Buffer;
-                count = Packet64->Size;
+            if (TinyCLR_UsbClient_TxGetPacket(usClientState, ep, data, count)) {  // data to send, possibly straight from the writer's buffer
+                ps = (uint32_t*)data;
             }
         }
 
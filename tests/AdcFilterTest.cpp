@@ -0,0 +1,181 @@
+// Copyright GHI Electronics, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Runs noisy sample streams through the AdcFilter median and mean and compares them with the bubble sort and
+// middle three average the AT91 ADC drivers used before.
+
+#include <chrono>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Drivers/AdcFilter/AdcFilter.h"
+#include "Test.h"
+
+#define SAMPLES 5
+#define READS 100000
+#define FULL_SCALE 0x3FF
+
+static void SortDescending(uint32_t* samples, int32_t count) {
+    auto sorted = false;
+
+    while (!sorted) {
+        sorted = true;
+
+        for (auto i = 0; i < count - 1; i++) {
+            if (samples[i] < samples[i + 1]) {
+                auto t = samples[i];
+
+                samples[i] = samples[i + 1];
+                samples[i + 1] = t;
+                sorted = false;
+            }
+        }
+    }
+}
+
+static uint32_t OldMiddleThree(uint32_t* samples, int32_t count) {
+    auto middle = count / 2;
+
+    SortDescending(samples, count);
+
+    return (samples[middle - 1] + samples[middle] + samples[middle + 1]) / 3;
+}
+
+static double Gaussian() {
+    auto u = (rand() + 1.0) / (RAND_MAX + 2.0);
+    auto v = (rand() + 1.0) / (RAND_MAX + 2.0);
+
+    return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * v);
+}
+
+// A slowly moving level with gaussian noise, now and then a spike to either rail.
+static uint32_t NextSample(double level, double sigma, int spikePercent) {
+    if (rand() % 100 < spikePercent)
+        return rand() % 2 ? FULL_SCALE : 0;
+
+    auto value = level + sigma * Gaussian();
+
+    return value < 0 ? 0 : value > FULL_SCALE ? FULL_SCALE : (uint32_t)(value + 0.5);
+}
+
+static void CheckSelect() {
+    for (auto round = 0; round < 10000; round++) {
+        uint32_t samples[16], sorted[16];
+        auto count = 1 + rand() % 16;
+        auto k = rand() % count;
+
+        // few distinct values so ties are common
+        for (auto i = 0; i < count; i++)
+            samples[i] = sorted[i] = rand() % (round % 2 ? 4 : FULL_SCALE + 1);
+
+        SortDescending(sorted, count);
+        AdcFilter_Select(samples, count, k);
+
+        TEST_CHECK(samples[k] == sorted[count - 1 - k]);
+
+        for (auto i = 0; i < k; i++)
+            TEST_CHECK(samples[i] <= samples[k]);
+
+        for (auto i = k + 1; i < count; i++)
+            TEST_CHECK(samples[i] >= samples[k]);
+    }
+}
+
+// Same value as the old algorithm for every read, odd sample counts only since the old one needs a middle.
+static void CheckMedianMatchesOld() {
+    for (auto count = 3; count <= 15; count += 2) {
+        for (auto round = 0; round < 20000; round++) {
+            uint32_t a[15], b[15];
+
+            for (auto i = 0; i < count; i++)
+                a[i] = b[i] = NextSample(rand() % (FULL_SCALE + 1), 8.0, 10);
+
+            TEST_CHECK(AdcFilter_Median(a, count) == OldMiddleThree(b, count));
+        }
+    }
+}
+
+static void CheckMean() {
+    uint32_t samples[SAMPLES] = { 1, 2, 2, 2, 2 };
+
+    TEST_CHECK(AdcFilter_Mean(samples, SAMPLES) == 2);
+
+    samples[0] = 3;
+
+    TEST_CHECK(AdcFilter_Mean(samples, SAMPLES) == 2); // 2.2
+
+    samples[0] = samples[1] = 4;
+
+    TEST_CHECK(AdcFilter_Mean(samples, SAMPLES) == 3); // 2.8
+}
+
+// Mean absolute error of each filter against the noise free level, and the time a read takes.
+static void Compare(const char* name, double sigma, int spikePercent) {
+    static uint32_t stream[READS][SAMPLES];
+    static uint32_t work[READS][SAMPLES];
+    static uint32_t results[READS];
+    static double levels[READS];
+
+    for (auto r = 0; r < READS; r++) {
+        levels[r] = FULL_SCALE / 2 + (FULL_SCALE / 3) * sin(r * 0.001);
+
+        for (auto i = 0; i < SAMPLES; i++)
+            stream[r][i] = NextSample(levels[r], sigma, spikePercent);
+    }
+
+    double errors[3] = { 0, 0, 0 };
+    double nanoseconds[3];
+
+    for (auto filter = 0; filter < 3; filter++) {
+        memcpy(work, stream, sizeof(work));
+
+        auto start = std::chrono::steady_clock::now();
+
+        for (auto r = 0; r < READS; r++) {
+            switch (filter) {
+            case 0: results[r] = OldMiddleThree(work[r], SAMPLES); break;
+            case 1: results[r] = AdcFilter_Median(work[r], SAMPLES); break;
+            case 2: results[r] = AdcFilter_Mean(work[r], SAMPLES); break;
+            }
+        }
+
+        nanoseconds[filter] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / READS;
+
+        for (auto r = 0; r < READS; r++)
+            errors[filter] += fabs(results[r] - levels[r]) / READS;
+    }
+
+    printf("%-10s error old %6.2f median %6.2f mean %6.2f, ns per read old %5.1f median %5.1f mean %5.1f\n", name, errors[0], errors[1], errors[2], nanoseconds[0], nanoseconds[1], nanoseconds[2]);
+
+    // the median gives what the old code gave, so no accuracy is lost
+    TEST_CHECK(errors[1] == errors[0]);
+
+    // without spikes the mean of all samples is the better estimate of white noise
+    if (spikePercent == 0)
+        TEST_CHECK(errors[2] <= errors[0]);
+}
+
+int main() {
+    srand(1);
+
+    CheckSelect();
+    CheckMedianMatchesOld();
+    CheckMean();
+
+    Compare("white", 6.0, 0);
+    Compare("spikes", 6.0, 5);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,128 @@
+// Copyright GHI Electronics, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Runs the AdcScan register programming against register blocks in memory and checks the sequence, converter and
+// DMA stream configuration the STM32F4/F7 ADC drivers get from it. Built against the STM32F429 device header.
+
+#include <string.h>
+
+#include "stm32f4xx.h"
+#include "Drivers/AdcScan/AdcScan.h"
+#include "Test.h"
+
+#define FIELD(value, name) (((value) & name##_Msk) >> name##_Pos)
+
+static uint32_t GetRank(const ADC_TypeDef& adc, uint32_t rank) {
+    auto index = rank - 1;
+    auto sqr = index < 6 ? adc.SQR3 : index < 12 ? adc.SQR2 : adc.SQR1;
+
+    return (sqr >> ((index % 6) * 5)) & 0x1F;
+}
+
+static void CheckSequence(const uint32_t* channels, size_t count) {
+    ADC_TypeDef adc;
+
+    memset(&adc, 0xFF, sizeof(adc));
+
+    AdcScan_ProgramSequence(adc, channels, count);
+
+    TEST_CHECK(FIELD(adc.SQR1, ADC_SQR1_L) == count - 1);
+
+    for (auto rank = 1u; rank <= count; rank++)
+        TEST_CHECK(GetRank(adc, rank) == channels[rank - 1]);
+
+    // nothing but the ranks in use and the length
+    for (auto rank = count + 1; rank <= ADC_SCAN_MAX_SEQUENCE_LENGTH; rank++)
+        TEST_CHECK(GetRank(adc, rank) == 0);
+
+    TEST_CHECK((adc.SQR1 & ~(ADC_SQR1_L | ADC_SQR1_SQ13 | ADC_SQR1_SQ14 | ADC_SQR1_SQ15 | ADC_SQR1_SQ16)) == 0);
+
+    TEST_CHECK(adc.CR1 == ADC_CR1_SCAN);
+    TEST_CHECK(adc.CR2 == ADC_CR2_ADON);
+    TEST_CHECK(adc.SR == 0);
+}
+
+static void CheckSequences() {
+    uint32_t one[] = { 5 };
+    uint32_t eight[] = { 3, 0, 17, 9, 1, 5, 6, 7 };
+    uint32_t sixteen[16];
+
+    for (auto i = 0; i < 16; i++)
+        sixteen[i] = 15 - i + (i % 3);
+
+    CheckSequence(one, 1);
+    CheckSequence(eight, 8);
+    CheckSequence(sixteen, 6);
+    CheckSequence(sixteen, 12);
+    CheckSequence(sixteen, 16);
+}
+
+static void CheckStartAndReset() {
+    ADC_TypeDef adc;
+
+    memset(&adc, 0, sizeof(adc));
+
+    // TIM3 TRGO on the F4
+    AdcScan_EnableTrigger(adc, 8);
+
+    TEST_CHECK(FIELD(adc.CR2, ADC_CR2_EXTSEL) == 8);
+    TEST_CHECK(FIELD(adc.CR2, ADC_CR2_EXTEN) == 1); // rising edge
+    TEST_CHECK((adc.CR2 & (ADC_CR2_ADON | ADC_CR2_DMA | ADC_CR2_DDS)) == (ADC_CR2_ADON | ADC_CR2_DMA | ADC_CR2_DDS));
+    TEST_CHECK((adc.CR2 & (ADC_CR2_SWSTART | ADC_CR2_CONT | ADC_CR2_JEXTEN)) == 0);
+
+    adc.CR1 = ADC_CR1_SCAN;
+    adc.SQR1 = 15 * ADC_SQR1_L_0;
+    adc.SR = ADC_SR_OVR;
+
+    AdcScan_Reset(adc);
+
+    TEST_CHECK(adc.CR2 == ADC_CR2_ADON);
+    TEST_CHECK(adc.CR1 == 0);
+    TEST_CHECK(adc.SQR1 == 0);
+    TEST_CHECK(adc.SR == 0);
+}
+
+static void CheckDma() {
+    uint32_t configuration = ADC_SCAN_DMA_CONFIGURATION;
+
+    TEST_CHECK(FIELD(configuration, DMA_SxCR_DIR) == 0); // peripheral to memory
+    TEST_CHECK(FIELD(configuration, DMA_SxCR_PSIZE) == 1); // halfwords
+    TEST_CHECK(FIELD(configuration, DMA_SxCR_MSIZE) == 1);
+    TEST_CHECK(configuration & DMA_SxCR_MINC);
+    TEST_CHECK(!(configuration & DMA_SxCR_PINC));
+    TEST_CHECK(configuration & DMA_SxCR_CIRC);
+    TEST_CHECK((configuration & (DMA_SxCR_HTIE | DMA_SxCR_TCIE | DMA_SxCR_TEIE)) == (DMA_SxCR_HTIE | DMA_SxCR_TCIE | DMA_SxCR_TEIE));
+
+    // the stream helper enables the stream and selects the request channel
+    TEST_CHECK((configuration & (DMA_SxCR_EN | DMA_SxCR_CHSEL | DMA_SxCR_DBM | DMA_SxCR_PFCTRL)) == 0);
+
+    // the buffer splits into two halves of whole scans, the count fits NDTR
+    TEST_CHECK(AdcScan_IsValidLength(1, 2));
+    TEST_CHECK(AdcScan_IsValidLength(3, 6));
+    TEST_CHECK(AdcScan_IsValidLength(16, 0xFFE0));
+    TEST_CHECK(!AdcScan_IsValidLength(3, 3));
+    TEST_CHECK(!AdcScan_IsValidLength(3, 9));
+    TEST_CHECK(!AdcScan_IsValidLength(1, 0));
+    TEST_CHECK(!AdcScan_IsValidLength(0, 2));
+    TEST_CHECK(!AdcScan_IsValidLength(17, 34));
+    TEST_CHECK(!AdcScan_IsValidLength(1, 0x10000));
+}
+
+int main() {
+    CheckSequences();
+    CheckStartAndReset();
+    CheckDma();
+
+    return TEST_RESULT();
+}
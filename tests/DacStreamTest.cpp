@@ -0,0 +1,138 @@
+// Copyright GHI Electronics, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Checks the DacStream counter arithmetic and walks the GPDMA linked list it builds the way the controller does, with
+// list items and a channel register block in memory.
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "Drivers/DacStream/DacStream.h"
+#include "Test.h"
+
+// the LPC17 DAC counter runs from the 60 MHz peripheral clock and is 16 bits
+#define COUNTER_CLOCK_HZ 60000000
+
+#define CONTROL_FLAGS ((1 << 18) | (1 << 21) | (1 << 26) | (1UL << 31))
+#define CONTROL_SIZE_MASK 0xFFF
+
+// host addresses do not fit the controller's 32 bit fields
+struct Item {
+    uintptr_t source;
+    uintptr_t destination;
+    uintptr_t next;
+    uintptr_t control;
+};
+
+struct Channel {
+    uintptr_t CSrcAddr;
+    uintptr_t CDestAddr;
+    uintptr_t CLLI;
+    uintptr_t CControl;
+    uint32_t CConfig;
+};
+
+static void CheckTicks() {
+    for (auto requested = (double)COUNTER_CLOCK_HZ / 0x10000; requested <= 1000000; requested *= 1.1) {
+        auto frequency = requested;
+        auto ticks = DacStream_GetTicks(COUNTER_CLOCK_HZ, frequency);
+
+        TEST_CHECK(ticks >= 1 && ticks <= 0x10000);
+        TEST_CHECK(frequency == (double)COUNTER_CLOCK_HZ / ticks);
+        TEST_CHECK(fabs(ticks - COUNTER_CLOCK_HZ / requested) <= 0.5);
+    }
+
+    double frequency = 44100;
+
+    TEST_CHECK(DacStream_GetTicks(COUNTER_CLOCK_HZ, frequency) == 1361); // 1360.5 rounds up
+
+    frequency = 8000;
+
+    TEST_CHECK(DacStream_GetTicks(COUNTER_CLOCK_HZ, frequency) == 7500 && frequency == 8000);
+}
+
+// Plays the chain loaded into channel like the controller: one item's samples, then the linked one, until the link
+// is zero or limit samples went out. Returns the samples written to the destination in order.
+static size_t Play(Channel& channel, volatile uint16_t* destination, uint16_t* played, size_t limit) {
+    size_t count = 0;
+
+    while (count < limit) {
+        TEST_CHECK(channel.CDestAddr == (uintptr_t)destination);
+
+        auto source = (const uint16_t*)channel.CSrcAddr;
+
+        for (auto i = 0u; i < (channel.CControl & CONTROL_SIZE_MASK) && count < limit; i++)
+            played[count++] = source[i];
+
+        if (channel.CLLI == 0)
+            break;
+
+        auto next = (const Item*)channel.CLLI;
+
+        channel.CSrcAddr = next->source;
+        channel.CDestAddr = next->destination;
+        channel.CLLI = next->next;
+        channel.CControl = next->control;
+    }
+
+    return count;
+}
+
+static void CheckChain(size_t length, bool circular) {
+    uint16_t buffer[64];
+    uint16_t played[256];
+    volatile uint16_t destination;
+    Item items[2];
+    Channel channel;
+
+    for (auto i = 0u; i < length; i++)
+        buffer[i] = (uint16_t)(i * 64);
+
+    memset(items, 0xFF, sizeof(items));
+    memset(&channel, 0, sizeof(channel));
+
+    DacStream_LinkHalves(items, buffer, length, &destination, CONTROL_FLAGS, circular);
+    DacStream_StartChannel(channel, items[0], 0x4A41);
+
+    TEST_CHECK(channel.CConfig == 0x4A41);
+
+    for (auto i = 0; i < 2; i++) {
+        TEST_CHECK(items[i].source == (uintptr_t)(buffer + i * length / 2));
+        TEST_CHECK((items[i].control & CONTROL_SIZE_MASK) == length / 2);
+        TEST_CHECK((items[i].control & ~CONTROL_SIZE_MASK) == CONTROL_FLAGS);
+    }
+
+    TEST_CHECK(items[0].next == (uintptr_t)&items[1]);
+    TEST_CHECK(items[1].next == (circular ? (uintptr_t)&items[0] : 0));
+
+    // a single pass plays the buffer once, a circular one wraps back to the first sample
+    auto count = Play(channel, &destination, played, circular ? length * 3 + 1 : sizeof(played) / sizeof(played[0]));
+
+    TEST_CHECK(count == (circular ? length * 3 + 1 : length));
+
+    for (auto i = 0u; i < count; i++)
+        TEST_CHECK(played[i] == buffer[i % length]);
+}
+
+int main() {
+    CheckTicks();
+
+    CheckChain(2, false);
+    CheckChain(2, true);
+    CheckChain(10, false);
+    CheckChain(64, true);
+
+    return TEST_RESULT();
+}
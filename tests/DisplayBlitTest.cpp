@@ -0,0 +1,258 @@
+// Copyright GHI Electronics, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Checks the display blit kernels against the per-pixel loops BitBltEx used before, for every rotation: full
+// frames, odd frame and rectangle sizes, odd offsets, and rectangles that end on and around the strip edges of the
+// rotations. The whole frame buffer is compared, so a write outside the rectangle fails too. Prints the
+// throughput of the old loops and the kernels per rotation.
+
+#include <chrono>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "Drivers/DisplayBlit/DisplayBlit.h"
+#include "Test.h"
+
+enum Rotation { Normal0, CounterClockwise90, Clockwise90, Rotate180 };
+
+static const char* rotationNames[] = { "0", "90 ccw", "90 cw", "180" };
+
+// BitBltEx as it was, one pixel at a time. (x, y, width, height) is in rotated coordinates, a rotated source is a
+// whole frame with the rotated width as its line pitch, the unrotated one only holds the rectangle. The unrotated
+// rows went through a MemCopy helper that made unaligned 64 bit accesses, memcpy stands in for it.
+static void OldBitBlt(Rotation rotation, uint16_t* to, int32_t screenWidth, int32_t screenHeight, int32_t xOffset, int32_t yOffset, int32_t width, int32_t height, const uint16_t* from) {
+    int32_t xTo, yTo, xFrom, yFrom, startPx, toAddition;
+
+    switch (rotation) {
+    case Normal0:
+        for (yTo = yOffset; yTo < (yOffset + height); yTo++) {
+            memcpy(to + yTo * screenWidth + xOffset, from, width * 2);
+            from += width;
+        }
+
+        break;
+
+    case CounterClockwise90:
+        startPx = yOffset * screenHeight;
+        xFrom = xOffset + width;
+        yTo = screenHeight - xOffset - width;
+        xTo = yOffset;
+        to += yTo * screenWidth + xTo;
+        toAddition = screenWidth - height;
+
+        for (; yTo < (screenHeight - xOffset); yTo++) {
+            xFrom--;
+            yFrom = startPx + xFrom;
+
+            for (xTo = yOffset; xTo < (yOffset + height); xTo++) {
+                *to++ = from[yFrom];
+                yFrom += screenHeight;
+            }
+
+            to += toAddition;
+        }
+
+        break;
+
+    case Clockwise90:
+        startPx = (yOffset + height - 1) * screenHeight;
+        xFrom = xOffset;
+        yTo = xOffset;
+        xTo = screenWidth - yOffset - height;
+        to += yTo * screenWidth + xTo;
+        toAddition = screenWidth - height;
+
+        for (; yTo < (xOffset + width); yTo++) {
+            yFrom = startPx + xFrom;
+
+            for (xTo = screenWidth - yOffset - height; xTo < (screenWidth - yOffset); xTo++) {
+                *to++ = from[yFrom];
+                yFrom -= screenHeight;
+            }
+
+            to += toAddition;
+            xFrom++;
+        }
+
+        break;
+
+    case Rotate180:
+        xFrom = (yOffset + height - 1) * screenWidth + xOffset + width;
+        yTo = screenHeight - yOffset - height;
+        xTo = screenWidth - xOffset - width;
+        to += yTo * screenWidth + xTo;
+        toAddition = screenWidth - width;
+
+        for (; yTo < (screenHeight - yOffset); yTo++) {
+            for (xTo = screenWidth - xOffset - width; xTo < (screenWidth - xOffset); xTo++) {
+                xFrom--;
+                *to++ = from[xFrom];
+            }
+
+            to += toAddition;
+            xFrom -= toAddition;
+        }
+
+        break;
+    }
+}
+
+// BitBltEx as the drivers call the kernels now.
+static void NewBitBlt(Rotation rotation, uint16_t* to, int32_t screenWidth, int32_t screenHeight, int32_t x, int32_t y, int32_t width, int32_t height, const uint16_t* from) {
+    switch (rotation) {
+    case Normal0:
+        DisplayBlit_Copy(to + y * screenWidth + x, screenWidth, from, width, width, height);
+
+        break;
+
+    case CounterClockwise90:
+        DisplayBlit_Rotate90(to + (screenHeight - x - width) * screenWidth + y, screenWidth, from + y * screenHeight + x + width - 1, screenHeight, -1, height, width);
+
+        break;
+
+    case Clockwise90:
+        DisplayBlit_Rotate90(to + x * screenWidth + screenWidth - y - height, screenWidth, from + (y + height - 1) * screenHeight + x, -screenHeight, 1, height, width);
+
+        break;
+
+    case Rotate180:
+        DisplayBlit_Rotate180(to + (screenHeight - y - height) * screenWidth + screenWidth - x - width, screenWidth, from + (y + height - 1) * screenWidth + x + width - 1, screenWidth, width, height);
+
+        break;
+    }
+}
+
+struct Frame {
+    int32_t width;
+    int32_t height;
+
+    // pixel 0 of the buffers is on a word boundary, or one pixel past it to move every pair off its alignment
+    std::vector<uint16_t> source;
+    std::vector<uint16_t> oldBuffer;
+    std::vector<uint16_t> newBuffer;
+
+    Frame(int32_t width, int32_t height) : width(width), height(height), source(width * height + 2), oldBuffer(width * height + 2), newBuffer(width * height + 2) {
+        for (auto& pixel : this->source)
+            pixel = static_cast<uint16_t>(rand());
+    }
+};
+
+static void CheckRectangle(Frame& frame, Rotation rotation, int32_t x, int32_t y, int32_t width, int32_t height, int32_t shift) {
+    auto rotated = rotation == CounterClockwise90 || rotation == Clockwise90;
+    auto frameWidth = rotated ? frame.height : frame.width;
+    auto frameHeight = rotated ? frame.width : frame.height;
+
+    if (width <= 0 || height <= 0 || x < 0 || y < 0 || x + width > frameWidth || y + height > frameHeight)
+        return;
+
+    for (size_t i = 0; i < frame.oldBuffer.size(); i++)
+        frame.oldBuffer[i] = frame.newBuffer[i] = static_cast<uint16_t>(0xA500 + i);
+
+    auto from = frame.source.data() + shift;
+
+    OldBitBlt(rotation, frame.oldBuffer.data() + shift, frame.width, frame.height, x, y, width, height, from);
+    NewBitBlt(rotation, frame.newBuffer.data() + shift, frame.width, frame.height, x, y, width, height, from);
+
+    if (frame.oldBuffer != frame.newBuffer) {
+        printf("rotation %s frame %dx%d rectangle %d,%d %dx%d shift %d differs\n", rotationNames[rotation], frame.width, frame.height, x, y, width, height, shift);
+
+        TEST_CHECK(frame.oldBuffer == frame.newBuffer);
+    }
+}
+
+// sizes on and around the strip edges and odd sizes
+static const int32_t sizes[] = { 1, 2, 3, 15, 16, 17, 31, 32, 33, 47 };
+
+static void CheckFrame(int32_t width, int32_t height) {
+    Frame frame(width, height);
+
+    for (auto rotation = Normal0; rotation <= Rotate180; rotation = static_cast<Rotation>(rotation + 1)) {
+        auto rotated = rotation == CounterClockwise90 || rotation == Clockwise90;
+        auto frameWidth = rotated ? height : width;
+        auto frameHeight = rotated ? width : height;
+
+        for (auto shift = 0; shift < 2; shift++) {
+            CheckRectangle(frame, rotation, 0, 0, frameWidth, frameHeight, shift);
+            CheckRectangle(frame, rotation, 1, 1, frameWidth - 1, frameHeight - 1, shift);
+            CheckRectangle(frame, rotation, 0, 0, frameWidth - 1, frameHeight - 1, shift);
+
+            // every size pair at an even and an odd offset and against the far edges
+            for (auto w : sizes) {
+                for (auto h : sizes) {
+                    CheckRectangle(frame, rotation, 0, 0, w, h, shift);
+                    CheckRectangle(frame, rotation, 3, 5, w, h, shift);
+                    CheckRectangle(frame, rotation, frameWidth - w, frameHeight - h, w, h, shift);
+                }
+            }
+
+            for (auto i = 0; i < 300; i++) {
+                auto w = 1 + rand() % frameWidth;
+                auto h = 1 + rand() % frameHeight;
+
+                CheckRectangle(frame, rotation, rand() % (frameWidth - w + 1), rand() % (frameHeight - h + 1), w, h, shift);
+            }
+        }
+    }
+}
+
+#define BENCHMARK_WIDTH 480
+#define BENCHMARK_HEIGHT 272
+#define BENCHMARK_FRAMES 200
+
+static void Benchmark() {
+    Frame frame(BENCHMARK_WIDTH, BENCHMARK_HEIGHT);
+    auto pixels = static_cast<double>(BENCHMARK_WIDTH) * BENCHMARK_HEIGHT * BENCHMARK_FRAMES;
+
+    for (auto rotation = Normal0; rotation <= Rotate180; rotation = static_cast<Rotation>(rotation + 1)) {
+        auto rotated = rotation == CounterClockwise90 || rotation == Clockwise90;
+        auto frameWidth = rotated ? BENCHMARK_HEIGHT : BENCHMARK_WIDTH;
+        auto frameHeight = rotated ? BENCHMARK_WIDTH : BENCHMARK_HEIGHT;
+        double mpixels[2];
+
+        for (auto kernel = 0; kernel < 2; kernel++) {
+            auto to = kernel == 0 ? frame.oldBuffer.data() : frame.newBuffer.data();
+            auto start = std::chrono::steady_clock::now();
+
+            for (auto i = 0; i < BENCHMARK_FRAMES; i++) {
+                if (kernel == 0)
+                    OldBitBlt(rotation, to, BENCHMARK_WIDTH, BENCHMARK_HEIGHT, 0, 0, frameWidth, frameHeight, frame.source.data());
+                else
+                    NewBitBlt(rotation, to, BENCHMARK_WIDTH, BENCHMARK_HEIGHT, 0, 0, frameWidth, frameHeight, frame.source.data());
+            }
+
+            mpixels[kernel] = pixels / std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        printf("rotation %-6s %dx%d Mpixel/s old %7.1f new %7.1f\n", rotationNames[rotation], BENCHMARK_WIDTH, BENCHMARK_HEIGHT, mpixels[0], mpixels[1]);
+
+        TEST_CHECK(frame.oldBuffer == frame.newBuffer);
+    }
+}
+
+int main() {
+    srand(1);
+
+    CheckFrame(480, 272);
+    CheckFrame(320, 240);
+    CheckFrame(479, 271);
+    CheckFrame(33, 17);
+    CheckFrame(17, 33);
+    CheckFrame(1, 1);
+
+    Benchmark();
+
+    return TEST_RESULT();
+}
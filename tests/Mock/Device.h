@@ -0,0 +1,27 @@
+// Copyright GHI Electronics, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+// Stands in for a device header. Interrupts are a nesting count the tests can look at: mockInterruptsDisabled is
+// non zero while a driver holds them off. A test that uses it defines it.
+
+extern int mockInterruptsDisabled;
+
+struct Mock_DisableInterrupts_RaiiHelper {
+    Mock_DisableInterrupts_RaiiHelper() { mockInterruptsDisabled++; }
+    ~Mock_DisableInterrupts_RaiiHelper() { mockInterruptsDisabled--; }
+};
+
+#define DISABLE_INTERRUPTS_SCOPED(name) Mock_DisableInterrupts_RaiiHelper name
@@ -0,0 +1,44 @@
+// Copyright GHI Electronics, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Stands in for the TinyCLR SDK header so driver sources that need the native time API build on the host. Only the
+// types those drivers use are provided.
+
+enum class TinyCLR_Result : uint32_t {
+    Success,
+    NotSupported,
+    InvalidOperation,
+    ArgumentInvalid,
+    ArgumentNull,
+    ArgumentOutOfRange,
+    Busy,
+    IndexOutOfRange,
+    NotAvailable,
+    NotFound,
+    NotImplemented,
+    NullReference,
+    OutOfMemory,
+    SharingViolation,
+    TimedOut,
+    WrongType,
+};
+
+struct TinyCLR_NativeTime_Controller {
+    uint64_t(*GetNativeTime)(const TinyCLR_NativeTime_Controller* self);
+};
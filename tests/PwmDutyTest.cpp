@@ -0,0 +1,140 @@
+// Copyright GHI Electronics, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Checks PwmDuty_GetCompare, which SetDutyCycles uses, against the double math SetPulseParameters does for the same
+// duty cycle after SetDesiredFrequency. The models below follow the GetScaleFactor and tick arithmetic of the drivers.
+
+#include <stdint.h>
+
+#include "Drivers/PwmDuty/PwmDuty.h"
+#include "Test.h"
+
+#define PWM_MILLISECONDS 1000
+#define PWM_MICROSECONDS 1000000
+#define PWM_NANOSECONDS 1000000000
+
+// G120 and EMX, the LPC PWM blocks count with these many ticks per microsecond
+#define LPC17_TICKS_PER_US ((120000000 / 2) / 1000000)
+#define LPC24_TICKS_PER_US (18000000 / 1000000)
+
+static void GetScaleFactor(double frequency, uint32_t& period, uint32_t& scale) {
+    if (frequency >= 1000.0) {
+        period = (uint32_t)(((uint32_t)PWM_NANOSECONDS / frequency) + 0.5);
+        scale = PWM_NANOSECONDS;
+    }
+    else if (frequency >= 1.0) {
+        period = (uint32_t)(((uint32_t)PWM_MICROSECONDS / frequency) + 0.5);
+        scale = PWM_MICROSECONDS;
+    }
+    else {
+        period = (uint32_t)(((uint32_t)PWM_MILLISECONDS / frequency) + 0.5);
+        scale = PWM_MILLISECONDS;
+    }
+}
+
+static uint32_t Difference(uint32_t a, uint32_t b) {
+    return a > b ? a - b : b - a;
+}
+
+// STM32: SetPulseParameters scales the timer period GetActualFrequency settled on.
+static void CheckStm32(uint32_t periodTicks) {
+    for (uint32_t dutyCycle = 0; dutyCycle <= PWM_DUTY_FULL_SCALE; dutyCycle += 7) {
+        auto duration = (uint32_t)(((double)dutyCycle / PWM_DUTY_FULL_SCALE) * periodTicks);
+
+        if (duration > periodTicks)
+            duration = periodTicks;
+
+        TEST_CHECK(Difference(PwmDuty_GetCompare(dutyCycle, periodTicks), duration) <= 1);
+    }
+
+    TEST_CHECK(PwmDuty_GetCompare(0, periodTicks) == 0);
+    TEST_CHECK(PwmDuty_GetCompare(PWM_DUTY_FULL_SCALE, periodTicks) == periodTicks);
+}
+
+// AT91: the duration is scaled in nanoseconds and divided down to ticks like the period.
+static void CheckAt91(uint32_t periodInNanoSeconds) {
+    static const uint32_t maxPeriods[] = { 491513, 983025, 1966050, 3932100, 7864200, 15728400, 31456800, 62913600, 125827200, 251654401, 503308801 };
+
+    uint32_t divider = 1;
+
+    for (auto i = 0; periodInNanoSeconds > maxPeriods[i]; i++)
+        divider <<= 1;
+
+    auto periodTicks = (uint32_t)(periodInNanoSeconds / (divider * 7.5));
+
+    for (uint32_t dutyCycle = 0; dutyCycle <= PWM_DUTY_FULL_SCALE; dutyCycle += 13) {
+        auto convertedDuration = (uint32_t)(((double)dutyCycle / PWM_DUTY_FULL_SCALE) * periodInNanoSeconds);
+        auto duration = (uint32_t)(convertedDuration / (divider * 7.5));
+
+        TEST_CHECK(Difference(PwmDuty_GetCompare(dutyCycle, periodTicks), duration) <= 1);
+    }
+}
+
+// LPC17/LPC24: GetScaleFactor rounds the period to whole scale units, the duration is taken in the same units and
+// both are turned into ticks, with the workaround for periods that end in 3. From 1 kHz up the scale is nanoseconds
+// and the two paths are at most two ticks apart. Below that the double path only has whole microseconds of duty
+// cycle, so it is up to two microseconds of ticks off while the compare value stays within a tick of exact.
+static void CheckLpc(uint32_t ticksPerMicrosecond, double frequency) {
+    uint32_t period, scale;
+
+    GetScaleFactor(frequency, period, scale);
+
+    auto unit = PWM_NANOSECONDS / scale;
+    auto periodInNanoSeconds = period * unit;
+
+    while ((double)(1000000000 / periodInNanoSeconds) > frequency)
+        periodInNanoSeconds++;
+
+    uint32_t periodTicks = (uint64_t)ticksPerMicrosecond * periodInNanoSeconds / 1000;
+
+    if (0 == ((periodInNanoSeconds - 3) % 10))
+        periodTicks += 1;
+
+    auto tolerance = scale == PWM_NANOSECONDS ? 2 : 2 * ticksPerMicrosecond;
+
+    // 0 and full scale switch the pin instead of using a match
+    for (uint32_t dutyCycle = 1; dutyCycle < PWM_DUTY_FULL_SCALE; dutyCycle += 11) {
+        auto duration = (uint32_t)(((double)dutyCycle / PWM_DUTY_FULL_SCALE) * period);
+        uint32_t highTicks = (uint64_t)ticksPerMicrosecond * duration * unit / 1000;
+
+        if (0 == ((highTicks - 3) % 10))
+            highTicks += 1;
+
+        if (highTicks > periodTicks)
+            highTicks = periodTicks;
+
+        auto compare = PwmDuty_GetCompare(dutyCycle, periodTicks);
+
+        TEST_CHECK(Difference(compare, highTicks) <= tolerance);
+        TEST_CHECK((uint64_t)compare << 16 <= (uint64_t)dutyCycle * periodTicks && (uint64_t)(compare + 1) << 16 > (uint64_t)dutyCycle * periodTicks);
+    }
+}
+
+int main() {
+    for (uint32_t periodTicks = 1; periodTicks <= 0x10000; periodTicks = periodTicks * 5 / 4 + 1)
+        CheckStm32(periodTicks);
+
+    CheckStm32(0xFFFF);
+    CheckStm32(0xFFFFFFFF);
+
+    for (uint32_t periodInNanoSeconds = 40; periodInNanoSeconds <= 503308801; periodInNanoSeconds = periodInNanoSeconds * 9 / 8 + 1)
+        CheckAt91(periodInNanoSeconds);
+
+    for (auto frequency = 1.0; frequency <= 1000000.0; frequency *= 1.07) {
+        CheckLpc(LPC17_TICKS_PER_US, frequency);
+        CheckLpc(LPC24_TICKS_PER_US, frequency);
+    }
+
+    return TEST_RESULT();
+}
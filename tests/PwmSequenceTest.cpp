@@ -0,0 +1,138 @@
+// Copyright GHI Electronics, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Checks the pattern buffers the PWM sequencers play: samples stay in frame order, 16 and 32 bit compare values, and
+// the LPC17 match encoding of always off, always on and inverted channels.
+
+#include <stdint.h>
+#include <string.h>
+
+#include "Drivers/PwmSequence/PwmSequence.h"
+#include "Test.h"
+
+#define FULL PWM_DUTY_FULL_SCALE
+#define HALF (PWM_DUTY_FULL_SCALE / 2)
+
+// three channels, four frames
+static const uint32_t dutyCycles[] = {
+    0, HALF, FULL,
+    FULL / 4, FULL / 4 * 3, FULL + 1,
+    1, FULL - 1, HALF,
+    0xFFFFFFFF, 0, FULL / 8,
+};
+
+#define CHANNELS 3
+#define LENGTH (sizeof(dutyCycles) / sizeof(dutyCycles[0]))
+
+static void CheckCompare16() {
+    uint16_t pattern[LENGTH + 1];
+
+    memset(pattern, 0xA5, sizeof(pattern));
+
+    PwmSequence_EncodeCompare(dutyCycles, LENGTH, 1000, pattern);
+
+    static const uint16_t expected[] = {
+        0, 500, 1000,
+        250, 750, 1000,
+        0, 999, 500,
+        1000, 0, 125,
+    };
+
+    TEST_CHECK(memcmp(pattern, expected, sizeof(expected)) == 0);
+    TEST_CHECK(pattern[LENGTH] == 0xA5A5); // nothing past length
+
+    // a full 16 bit period still fits the sample
+    PwmSequence_EncodeCompare(dutyCycles, LENGTH, 0xFFFF, pattern);
+
+    TEST_CHECK(pattern[2] == 0xFFFF && pattern[5] == 0xFFFF && pattern[9] == 0xFFFF);
+    TEST_CHECK(pattern[1] == 0x7FFF);
+}
+
+static void CheckCompare32() {
+    uint32_t pattern[LENGTH + 1];
+
+    memset(pattern, 0xA5, sizeof(pattern));
+
+    // TIM2 and TIM5 periods can be past 16 bits
+    PwmSequence_EncodeCompare(dutyCycles, LENGTH, 4000000, pattern);
+
+    static const uint32_t expected[] = {
+        0, 2000000, 4000000,
+        1000000, 3000000, 4000000,
+        61, 3999938, 2000000,
+        4000000, 0, 500000,
+    };
+
+    TEST_CHECK(memcmp(pattern, expected, sizeof(expected)) == 0);
+    TEST_CHECK(pattern[LENGTH] == 0xA5A5A5A5);
+}
+
+static void CheckMatch(uint32_t activeLow) {
+    uint32_t pattern[LENGTH + 1];
+    uint32_t periodTicks = 6000;
+
+    memset(pattern, 0xA5, sizeof(pattern));
+
+    PwmSequence_EncodeMatch(dutyCycles, LENGTH, CHANNELS, activeLow, periodTicks, pattern);
+
+    for (auto i = 0u; i < LENGTH; i++) {
+        auto dutyCycle = dutyCycles[i] > FULL ? FULL : dutyCycles[i];
+
+        // the polarity belongs to the channel, the same one in every frame
+        if (activeLow & (1 << (i % CHANNELS)))
+            dutyCycle = FULL - dutyCycle;
+
+        if (dutyCycle == FULL)
+            TEST_CHECK(pattern[i] == periodTicks + 1); // never matches, stays set
+        else if (dutyCycle == 0)
+            TEST_CHECK(pattern[i] == 0); // matches with the period start
+        else
+            TEST_CHECK(pattern[i] == (uint32_t)((uint64_t)dutyCycle * periodTicks / FULL) && pattern[i] < periodTicks);
+    }
+
+    TEST_CHECK(pattern[LENGTH] == 0xA5A5A5A5);
+}
+
+static void CheckMatchValues() {
+    uint32_t pattern[LENGTH];
+
+    // channel 1 inverted
+    PwmSequence_EncodeMatch(dutyCycles, LENGTH, CHANNELS, 1 << 1, 6000, pattern);
+
+    static const uint32_t expected[] = {
+        0, 3000, 6001,
+        1500, 1500, 6001,
+        0, 0, 3000,
+        6001, 6001, 750,
+    };
+
+    TEST_CHECK(memcmp(pattern, expected, sizeof(expected)) == 0);
+
+    // a single channel sequence, inverted
+    PwmSequence_EncodeMatch(dutyCycles, 4, 1, 1, 6000, pattern);
+
+    TEST_CHECK(pattern[0] == 6001 && pattern[1] == 3000 && pattern[2] == 0 && pattern[3] == 4500);
+}
+
+int main() {
+    CheckCompare16();
+    CheckCompare32();
+
+    for (uint32_t activeLow = 0; activeLow < (1 << CHANNELS); activeLow++)
+        CheckMatch(activeLow);
+
+    CheckMatchValues();
+
+    return TEST_RESULT();
+}
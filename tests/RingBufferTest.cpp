@@ -0,0 +1,309 @@
+// Copyright GHI Electronics, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Checks the ring buffer at every capacity edge: pushes, pops and spans that end on, start on and cross the wrap
+// from every starting position. Then runs a producer and a consumer thread over a numbered sequence with every
+// producer and consumer call mixed, and checks the consumer sees each number once and in order.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+// the two threads run on different cores here, not as thread and interrupt on one
+#define RING_BUFFER_BARRIER() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+#include "Drivers/RingBuffer/RingBuffer.h"
+#include "Test.h"
+
+#define MAX_CAPACITY 64
+
+static void CheckCapacity() {
+    TEST_CHECK(RingBuffer<uint32_t>::GetCapacityFor(0) == 1);
+    TEST_CHECK(RingBuffer<uint32_t>::GetCapacityFor(1) == 1);
+    TEST_CHECK(RingBuffer<uint32_t>::GetCapacityFor(2) == 2);
+    TEST_CHECK(RingBuffer<uint32_t>::GetCapacityFor(3) == 4);
+    TEST_CHECK(RingBuffer<uint32_t>::GetCapacityFor(64) == 64);
+    TEST_CHECK(RingBuffer<uint32_t>::GetCapacityFor(65) == 128);
+
+    RingBuffer<uint32_t> ring;
+
+    ring.Uninitialize();
+
+    uint32_t item = 1;
+
+    TEST_CHECK(ring.GetCapacity() == 0 && ring.IsFull() && ring.IsEmpty());
+    TEST_CHECK(!ring.Push(item) && !ring.Pop(item) && ring.Peek() == nullptr);
+}
+
+// Moves the ring to start at offset, empty, so the next items meet the wrap after capacity - offset.
+static void Rewind(RingBuffer<uint32_t>& ring, uint32_t* storage, size_t capacity, size_t offset) {
+    uint32_t item;
+
+    ring.Initialize(storage, capacity);
+
+    for (size_t i = 0; i < offset; i++) {
+        ring.Push(0);
+        ring.Pop(item);
+    }
+}
+
+static void CheckEdges(size_t capacity, size_t offset) {
+    uint32_t storage[MAX_CAPACITY + 1];
+    uint32_t items[MAX_CAPACITY + 2];
+    uint32_t out[MAX_CAPACITY + 2];
+    RingBuffer<uint32_t> ring;
+
+    storage[capacity] = 0xA5A5A5A5;
+
+    for (size_t i = 0; i < MAX_CAPACITY + 2; i++)
+        items[i] = 1000 + i;
+
+    // one at a time up to full, one more is refused
+    Rewind(ring, storage, capacity, offset);
+
+    for (size_t i = 0; i < capacity; i++) {
+        TEST_CHECK(ring.Push(items[i]));
+        TEST_CHECK(ring.GetCount() == i + 1 && ring.GetFree() == capacity - i - 1);
+    }
+
+    TEST_CHECK(ring.IsFull() && !ring.Push(items[capacity]));
+    TEST_CHECK(ring.GetHeadIndex() == offset % capacity);
+
+    for (size_t i = 0; i < capacity; i++) {
+        uint32_t item = 0;
+
+        TEST_CHECK(*ring.Peek() == items[i] && ring.Pop(item) && item == items[i]);
+    }
+
+    TEST_CHECK(ring.IsEmpty() && ring.Peek() == nullptr);
+
+    // every count in bulk, more than fits is cut to what fits
+    for (size_t count = 0; count <= capacity + 1; count++) {
+        Rewind(ring, storage, capacity, offset);
+
+        auto pushed = ring.PushN(items, count);
+
+        TEST_CHECK(pushed == (count < capacity ? count : capacity));
+
+        memset(out, 0, sizeof(out));
+
+        TEST_CHECK(ring.PopN(out, count + 1) == pushed);
+        TEST_CHECK(memcmp(out, items, pushed * sizeof(uint32_t)) == 0 && out[pushed] == 0);
+        TEST_CHECK(ring.IsEmpty());
+    }
+
+    // spans stop at the wrap, the rest is the next span
+    Rewind(ring, storage, capacity, offset);
+
+    size_t count;
+    auto span = ring.GetWriteSpan(count);
+    auto index = offset % capacity;
+
+    TEST_CHECK(span == &storage[index] && count == capacity - index);
+
+    for (size_t i = 0; i < count; i++)
+        span[i] = items[i];
+
+    ring.Commit(count);
+
+    auto first = count;
+
+    span = ring.GetWriteSpan(count);
+
+    TEST_CHECK(count == capacity - first && (count == 0 ? span == nullptr : span == &storage[0]));
+
+    for (size_t i = 0; i < count; i++)
+        span[i] = items[first + i];
+
+    ring.Commit(count);
+
+    TEST_CHECK(ring.IsFull());
+
+    span = ring.GetReadSpan(count);
+
+    TEST_CHECK(span == &storage[index] && count == first && memcmp(span, items, count * sizeof(uint32_t)) == 0);
+
+    ring.Consume(count);
+
+    span = ring.GetReadSpan(count);
+
+    TEST_CHECK(count == capacity - first && memcmp(span, items + first, count * sizeof(uint32_t)) == 0);
+
+    ring.Consume(count);
+
+    TEST_CHECK(ring.IsEmpty() && ring.GetReadSpan(count) == nullptr && count == 0);
+
+    // a producer that laps the consumer: the newest capacity items are kept
+    Rewind(ring, storage, capacity, offset);
+
+    ring.Commit(capacity + 3);
+
+    TEST_CHECK(ring.GetCount() == capacity && ring.SkipOverwritten() && !ring.SkipOverwritten());
+
+    ring.Discard();
+
+    TEST_CHECK(ring.IsEmpty() && storage[capacity] == 0xA5A5A5A5);
+}
+
+#define SEQUENCE_LENGTH 2000000
+
+static void Produce(RingBuffer<uint32_t>& ring, uint32_t seed) {
+    uint32_t next = 0;
+    uint32_t items[MAX_CAPACITY];
+
+    while (next < SEQUENCE_LENGTH) {
+        // the other side may be on the same core
+        if (ring.IsFull())
+            std::this_thread::yield();
+
+        seed = seed * 1103515245 + 12345;
+
+        auto want = 1 + (seed >> 16) % MAX_CAPACITY;
+
+        if (want > SEQUENCE_LENGTH - next)
+            want = SEQUENCE_LENGTH - next;
+
+        switch ((seed >> 8) % 3) {
+            case 0:
+                if (ring.Push(next))
+                    next++;
+
+                break;
+
+            case 1:
+                for (size_t i = 0; i < want; i++)
+                    items[i] = next + i;
+
+                next += ring.PushN(items, want);
+
+                break;
+
+            case 2: {
+                size_t count;
+                auto span = ring.GetWriteSpan(count);
+
+                if (count > want)
+                    count = want;
+
+                for (size_t i = 0; i < count; i++)
+                    span[i] = next + i;
+
+                ring.Commit(count);
+
+                next += count;
+
+                break;
+            }
+        }
+    }
+}
+
+static uint32_t Consume(RingBuffer<uint32_t>& ring, uint32_t seed) {
+    uint32_t next = 0;
+    uint32_t errors = 0;
+    uint32_t items[MAX_CAPACITY];
+
+    while (next < SEQUENCE_LENGTH) {
+        if (ring.IsEmpty())
+            std::this_thread::yield();
+
+        seed = seed * 1103515245 + 12345;
+
+        auto want = 1 + (seed >> 16) % MAX_CAPACITY;
+
+        switch ((seed >> 8) % 4) {
+            case 0: {
+                uint32_t item;
+
+                if (ring.Pop(item)) {
+                    errors += item != next;
+                    next++;
+                }
+
+                break;
+            }
+
+            case 1: {
+                auto count = ring.PopN(items, want);
+
+                for (size_t i = 0; i < count; i++)
+                    errors += items[i] != next + i;
+
+                next += count;
+
+                break;
+            }
+
+            case 2: {
+                size_t count;
+                auto span = ring.GetReadSpan(count);
+
+                if (count > want)
+                    count = want;
+
+                for (size_t i = 0; i < count; i++)
+                    errors += span[i] != next + i;
+
+                ring.Consume(count);
+
+                next += count;
+
+                break;
+            }
+
+            case 3: {
+                auto item = ring.Peek();
+
+                if (item != nullptr)
+                    errors += *item != next;
+
+                break;
+            }
+        }
+
+        errors += ring.GetCount() > ring.GetCapacity();
+    }
+
+    return errors + !ring.IsEmpty();
+}
+
+static void CheckThreads(size_t capacity, uint32_t seed) {
+    std::vector<uint32_t> storage(capacity);
+    RingBuffer<uint32_t> ring;
+    uint32_t errors = 0;
+
+    ring.Initialize(storage.data(), capacity);
+
+    std::thread consumer([&]() { errors = Consume(ring, seed); });
+    std::thread producer([&]() { Produce(ring, seed ^ 0x5A5A); });
+
+    producer.join();
+    consumer.join();
+
+    TEST_CHECK(errors == 0);
+}
+
+int main() {
+    CheckCapacity();
+
+    for (size_t capacity = 1; capacity <= MAX_CAPACITY; capacity <<= 1)
+        for (size_t offset = 0; offset <= 2 * capacity; offset++)
+            CheckEdges(capacity, offset);
+
+    for (size_t capacity = 1; capacity <= 1024; capacity <<= 3)
+        CheckThreads(capacity, static_cast<uint32_t>(capacity));
+
+    return TEST_RESULT();
+}
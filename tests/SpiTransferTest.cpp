@@ -0,0 +1,245 @@
+// Copyright GHI Electronics, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Runs the STM32F4 SPI transfer polled and by DMA against a simulated SPI and DMA and checks both put the same bytes
+// on the bus and in the read buffer: zeros past the end of the write buffer, input past the end of the read buffer
+// dropped, split at the 16 bit DMA count. The simulated DMA moves bytes the way the streams were programmed, so a
+// wrong direction, increment or address shows up as different data. Built against the STM32F429 device header.
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "stm32f4xx.h"
+#include "Drivers/SpiTransfer/SpiTransfer.h"
+#include "Test.h"
+
+struct SimulatedSpi;
+
+// Reading DR takes the received byte, writing it clocks a byte out and one in from the slave.
+struct SimulatedStatus {
+    SimulatedSpi* spi;
+
+    operator uint32_t();
+};
+
+struct SimulatedData {
+    SimulatedSpi* spi;
+
+    SimulatedData& operator=(uint32_t value);
+    operator uint32_t();
+};
+
+struct SimulatedSpi {
+    SimulatedStatus SR;
+    SimulatedData DR;
+    uint32_t CR2;
+
+    std::vector<uint8_t> mosi;  // what the slave got
+    uint8_t received;
+    bool pending;
+    uint32_t overruns;          // bytes clocked in before the one before was read
+
+    SimulatedSpi() : CR2(0), received(0), pending(false), overruns(0) {
+        SR.spi = this;
+        DR.spi = this;
+    }
+};
+
+// what the slave answers with to the n-th byte
+static uint8_t SlaveByte(size_t n) {
+    return static_cast<uint8_t>(n * 37 + 11 + (n >> 8));
+}
+
+SimulatedStatus::operator uint32_t() {
+    return SPI_SR_TXE | (spi->pending ? SPI_SR_RXNE : 0);
+}
+
+SimulatedData& SimulatedData::operator=(uint32_t value) {
+    if (spi->pending)
+        spi->overruns++;
+
+    spi->received = SlaveByte(spi->mosi.size());
+    spi->pending = true;
+    spi->mosi.push_back(static_cast<uint8_t>(value));
+
+    return *this;
+}
+
+SimulatedData::operator uint32_t() {
+    spi->pending = false;
+
+    return spi->received;
+}
+
+struct SimulatedStream {
+    volatile void* peripheral;
+    const void* memory;
+    size_t count;
+    uint32_t configuration;
+    bool enabled;
+};
+
+// Moves the bytes once the SPI asks for them, the receive stream must be running before the transmit one.
+struct SimulatedDma {
+    SimulatedSpi& spi;
+    SimulatedStream rx;
+    SimulatedStream tx;
+
+    uint32_t transfers;
+    uint32_t errors;
+    bool timeout;
+
+    SimulatedDma(SimulatedSpi& spi) : spi(spi), transfers(0), errors(0), timeout(false) {
+        memset(&rx, 0, sizeof(rx));
+        memset(&tx, 0, sizeof(tx));
+    }
+
+    void StartRx(volatile void* peripheral, const void* memory, size_t count, uint32_t configuration) {
+        if (tx.enabled)
+            errors++;
+
+        rx = { peripheral, memory, count, configuration, true };
+    }
+
+    void StartTx(volatile void* peripheral, const void* memory, size_t count, uint32_t configuration) {
+        tx = { peripheral, memory, count, configuration, true };
+    }
+
+    uint32_t WaitRx(size_t count) {
+        if (timeout)
+            return 0;
+
+        // byte wide, peripheral to memory and memory to peripheral on DR, started by the SPI requests
+        auto sizes = DMA_SxCR_MSIZE | DMA_SxCR_PSIZE;
+
+        if (!rx.enabled || !tx.enabled || rx.peripheral != &spi.DR || tx.peripheral != &spi.DR
+            || (rx.configuration & (DMA_SxCR_DIR | sizes)) != 0 || (tx.configuration & (DMA_SxCR_DIR | sizes)) != DMA_SxCR_DIR_0
+            || rx.count != count || tx.count != count || (spi.CR2 & (SPI_CR2_RXDMAEN | SPI_CR2_TXDMAEN)) != (SPI_CR2_RXDMAEN | SPI_CR2_TXDMAEN)) {
+            errors++;
+
+            return DMA_LISR_TEIF0;
+        }
+
+        auto source = reinterpret_cast<const uint8_t*>(tx.memory);
+        auto destination = reinterpret_cast<uint8_t*>(const_cast<void*>(rx.memory));
+
+        for (size_t i = 0; i < count; i++) {
+            spi.DR = source[(tx.configuration & DMA_SxCR_MINC) ? i : 0];
+            destination[(rx.configuration & DMA_SxCR_MINC) ? i : 0] = static_cast<uint8_t>(spi.DR);
+        }
+
+        transfers++;
+
+        return DMA_LISR_TCIF0 | DMA_LISR_HTIF0;
+    }
+
+    void Stop() {
+        rx.enabled = false;
+        tx.enabled = false;
+    }
+};
+
+#define GUARD 16
+#define GUARD_BYTE 0xA5
+
+static void CheckTransfer(size_t writeLength, size_t readLength, bool writeNull, bool readNull) {
+    std::vector<uint8_t> write(writeLength);
+    std::vector<uint8_t> polledRead(readLength + GUARD, GUARD_BYTE);
+    std::vector<uint8_t> dmaRead(readLength + GUARD, GUARD_BYTE);
+
+    for (auto& value : write)
+        value = static_cast<uint8_t>(rand());
+
+    auto writeBuffer = writeNull ? nullptr : write.data();
+
+    SimulatedSpi polledSpi;
+    SimulatedSpi dmaSpi;
+    SimulatedDma dma(dmaSpi);
+
+    SpiTransfer_Polled(polledSpi, writeBuffer, static_cast<int32_t>(writeLength), readNull ? nullptr : polledRead.data(), static_cast<int32_t>(readLength));
+
+    // stale input from before the transfer is dropped, not taken as the first byte
+    dmaSpi.received = 0xEE;
+    dmaSpi.pending = true;
+
+    TEST_CHECK(SpiTransfer_Dma(dmaSpi, dma, writeBuffer, writeLength, readNull ? nullptr : dmaRead.data(), readLength));
+
+    auto total = writeLength > readLength ? writeLength : readLength;
+    auto expectedTransfers = 0u;
+
+    for (size_t offset = 0; offset < total; ) {
+        auto end = (offset < writeLength && writeLength < total) ? writeLength : (offset < readLength && readLength < total) ? readLength : total;
+        auto length = end - offset > SPI_TRANSFER_DMA_MAX_LENGTH ? SPI_TRANSFER_DMA_MAX_LENGTH : end - offset;
+
+        offset += length;
+        expectedTransfers++;
+    }
+
+    TEST_CHECK(dma.errors == 0 && dma.transfers == expectedTransfers);
+    TEST_CHECK(polledSpi.overruns == 0 && dmaSpi.overruns == 0);
+    TEST_CHECK(dmaSpi.CR2 == 0 && !dma.rx.enabled && !dma.tx.enabled);
+
+    // same bytes out, the written ones then zeros
+    TEST_CHECK(polledSpi.mosi.size() == total && dmaSpi.mosi == polledSpi.mosi);
+    TEST_CHECK(memcmp(dmaSpi.mosi.data(), write.data(), writeLength) == 0);
+
+    for (auto i = writeLength; i < total; i++)
+        TEST_CHECK(dmaSpi.mosi[i] == 0);
+
+    // same bytes in, the first ones the slave sent, nothing past the read length
+    if (!readNull) {
+        TEST_CHECK(dmaRead == polledRead);
+
+        for (size_t i = 0; i < readLength; i++)
+            TEST_CHECK(dmaRead[i] == SlaveByte(i));
+
+        for (auto i = readLength; i < readLength + GUARD; i++)
+            TEST_CHECK(dmaRead[i] == GUARD_BYTE);
+    }
+}
+
+static void CheckTimeout() {
+    uint8_t write[100] = { 1, 2, 3 };
+    uint8_t read[100];
+
+    SimulatedSpi spi;
+    SimulatedDma dma(spi);
+
+    dma.timeout = true;
+
+    TEST_CHECK(!SpiTransfer_Dma(spi, dma, write, sizeof(write), read, sizeof(read)));
+    TEST_CHECK(spi.CR2 == 0 && !dma.rx.enabled && !dma.tx.enabled);
+}
+
+static const size_t lengths[] = {
+    1, 2, 31, 32, 33, 1000, SPI_TRANSFER_DMA_MAX_LENGTH - 1, SPI_TRANSFER_DMA_MAX_LENGTH, SPI_TRANSFER_DMA_MAX_LENGTH + 1, 2 * SPI_TRANSFER_DMA_MAX_LENGTH + 7,
+};
+
+int main() {
+    srand(1);
+
+    for (auto writeLength : lengths) {
+        // write only, read only, and every mix
+        CheckTransfer(writeLength, 0, false, true);
+        CheckTransfer(0, writeLength, true, false);
+
+        for (auto readLength : lengths)
+            CheckTransfer(writeLength, readLength, false, false);
+    }
+
+    CheckTimeout();
+
+    return TEST_RESULT();
+}
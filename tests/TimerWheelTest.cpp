@@ -0,0 +1,295 @@
+// Copyright GHI Electronics, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Runs the timer wheel against a simulated native time: timers on every level and past the wheel on the far list
+// fire exactly once and never early, cascades keep the exact expiry, periodic timers rearm on their period, and
+// cancel and restart work from inside a callback. Time is advanced both to each next event the wheel reports, the
+// way the time controllers drive it, and in fixed steps, as when the event comes late.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Drivers/TimerWheel/TimerWheel.h"
+#include "Test.h"
+
+int mockInterruptsDisabled = 0;
+
+static uint64_t nativeTime;
+static uint32_t scheduleCount;
+
+static uint64_t GetNativeTime(const TinyCLR_NativeTime_Controller* self) {
+    return nativeTime;
+}
+
+static void Schedule() {
+    scheduleCount++;
+}
+
+static const TinyCLR_NativeTime_Controller timeController = { &GetNativeTime };
+
+struct TestTimer {
+    TimerWheel_Timer timer;
+
+    uint64_t expected;  // native time of the next expiry
+    uint64_t period;
+    uint32_t fired;
+    uint32_t wrong;     // fired early, late for an exact run, or with interrupts disabled
+    uint32_t cancelAfter;
+};
+
+static bool exactRun;
+static uint64_t stepSize;
+
+static void Expired(TimerWheel_Timer* timer, void* argument) {
+    auto test = reinterpret_cast<TestTimer*>(argument);
+
+    if (nativeTime < test->expected || (exactRun && nativeTime != test->expected) || (!exactRun && nativeTime - test->expected >= stepSize) || mockInterruptsDisabled != 0)
+        test->wrong++;
+
+    test->fired++;
+    test->expected += test->period;
+
+    if (test->cancelAfter != 0 && test->fired == test->cancelAfter)
+        TimerWheel_Cancel(timer);
+}
+
+static void Reset(uint64_t now, uint64_t resolution) {
+    nativeTime = now;
+    scheduleCount = 0;
+
+    TimerWheel_Initialize(&timeController, resolution, &Schedule);
+}
+
+static void Start(TestTimer& test, uint64_t dueTime, uint64_t period) {
+    memset(&test, 0, sizeof(test));
+
+    test.expected = nativeTime + dueTime;
+    test.period = period;
+
+    TEST_CHECK(TimerWheel_Start(&test.timer, dueTime, period, &Expired, &test) == TinyCLR_Result::Success);
+}
+
+// Jumps from event to event up to end, returns how many events there were.
+static uint32_t RunEvents(uint64_t end) {
+    uint32_t events = 0;
+
+    exactRun = true;
+
+    for (;;) {
+        auto next = TimerWheel_GetNextEvent();
+
+        if (next > end)
+            break;
+
+        if (next > nativeTime)
+            nativeTime = next;
+
+        TimerWheel_Expire(nativeTime);
+
+        events++;
+    }
+
+    nativeTime = end;
+
+    TimerWheel_Expire(nativeTime);
+
+    return events;
+}
+
+static void RunSteps(uint64_t end, uint64_t step) {
+    exactRun = false;
+    stepSize = step;
+
+    while (nativeTime < end) {
+        nativeTime += step;
+
+        TimerWheel_Expire(nativeTime);
+    }
+}
+
+// due times on and around the edges of every level
+static const uint64_t edges[] = {
+    1, 2, 63, 64, 65, 127, 128, 4095, 4096, 4097, 8191, 262143, 262144, 262145, 524289, 16777215,
+};
+
+#define EDGE_COUNT (sizeof(edges) / sizeof(edges[0]))
+#define RANDOM_COUNT 500
+
+static void CheckLevels() {
+    static TestTimer timers[EDGE_COUNT + RANDOM_COUNT];
+
+    // not on a turn of any level, so every timer has cascades ahead of it
+    Reset(1000003, 1);
+
+    for (size_t i = 0; i < EDGE_COUNT; i++)
+        Start(timers[i], edges[i], 0);
+
+    for (size_t i = 0; i < RANDOM_COUNT; i++)
+        Start(timers[EDGE_COUNT + i], 1 + rand() % 16777215, 0);
+
+    TEST_CHECK(scheduleCount == EDGE_COUNT + RANDOM_COUNT);
+
+    auto events = RunEvents(1000003 + 16777216 * 2);
+
+    for (auto& test : timers)
+        TEST_CHECK(test.fired == 1 && test.wrong == 0 && !TimerWheel_IsStarted(&test.timer));
+
+    // a timer is looked at once per level it comes down through and once when it fires
+    TEST_CHECK(events <= (EDGE_COUNT + RANDOM_COUNT) * (TIMER_WHEEL_LEVELS + 1));
+    TEST_CHECK(TimerWheel_GetNextEvent() == 0xFFFFFFFFFFFFFFFFULL);
+}
+
+static void CheckSteps() {
+    static TestTimer timers[EDGE_COUNT + RANDOM_COUNT];
+
+    Reset(77, 1);
+
+    for (size_t i = 0; i < EDGE_COUNT; i++)
+        Start(timers[i], edges[i] % 600000, 0);
+
+    for (size_t i = 0; i < RANDOM_COUNT; i++)
+        Start(timers[EDGE_COUNT + i], 1 + rand() % 600000, 0);
+
+    // late events: whatever is due by then fires at once, in no particular order
+    RunSteps(77 + 600000 + 1000, 37);
+
+    for (auto& test : timers)
+        TEST_CHECK(test.fired == 1 && test.wrong == 0);
+}
+
+static void CheckFarList() {
+    static const uint64_t dueTimes[] = {
+        16777216, 16777217, 16777216 * 3 + 12345, 16777216 * 7 - 1, 0x100000007ULL,
+    };
+    static TestTimer timers[sizeof(dueTimes) / sizeof(dueTimes[0])];
+
+    Reset(5, 1);
+
+    for (size_t i = 0; i < sizeof(dueTimes) / sizeof(dueTimes[0]); i++)
+        Start(timers[i], dueTimes[i], 0);
+
+    auto events = RunEvents(0x100000007ULL + 16777216);
+
+    for (auto& test : timers)
+        TEST_CHECK(test.fired == 1 && test.wrong == 0);
+
+    // the far list is looked at once per turn of the top level
+    TEST_CHECK(events <= 0x100000007ULL / 16777216 + 1 + 5 * (TIMER_WHEEL_LEVELS + 1));
+}
+
+static void CheckPeriodic() {
+    static TestTimer timers[5];
+
+    Reset(123456, 1);
+
+    Start(timers[0], 1, 1);         // every tick until cancelled
+    Start(timers[1], 50, 100);
+    Start(timers[2], 10, 70000);    // rearms onto higher levels
+    Start(timers[3], 3, 20000000);  // rearms onto the far list
+    Start(timers[4], 7, 7);
+
+    timers[0].cancelAfter = 100000;
+    timers[4].cancelAfter = 5;
+
+    auto end = nativeTime + 50000000;
+
+    RunEvents(end);
+
+    TEST_CHECK(timers[0].fired == 100000 && timers[0].wrong == 0 && !TimerWheel_IsStarted(&timers[0].timer));
+    TEST_CHECK(timers[1].fired == (50000000 - 50) / 100 + 1 && timers[1].wrong == 0);
+    TEST_CHECK(timers[2].fired == (50000000 - 10) / 70000 + 1 && timers[2].wrong == 0);
+    TEST_CHECK(timers[3].fired == (50000000 - 3) / 20000000 + 1 && timers[3].wrong == 0);
+    TEST_CHECK(timers[4].fired == 5 && timers[4].wrong == 0 && !TimerWheel_IsStarted(&timers[4].timer));
+
+    for (auto i = 1; i < 4; i++)
+        TimerWheel_Cancel(&timers[i].timer);
+
+    TEST_CHECK(TimerWheel_GetNextEvent() == 0xFFFFFFFFFFFFFFFFULL);
+}
+
+static void CheckResolution() {
+    TestTimer timer;
+
+    // wheel ticks of 10: rounded up, so never early
+    Reset(3, 10);
+
+    Start(timer, 15, 0);
+
+    TEST_CHECK(TimerWheel_GetNextEvent() == 20);
+
+    timer.expected = 20;
+
+    RunEvents(1000);
+
+    TEST_CHECK(timer.fired == 1 && timer.wrong == 0);
+
+    // the period is rounded to the nearest wheel tick, 25 becomes 30
+    Start(timer, 30, 25);
+
+    timer.period = 30;
+
+    RunEvents(nativeTime + 300);
+
+    TEST_CHECK(timer.fired == 10 && timer.wrong == 0);
+
+    TimerWheel_Cancel(&timer.timer);
+}
+
+static void CheckCancelAndRestart() {
+    static TestTimer timers[6];
+
+    Reset(0, 1);
+
+    // all in the same slot, cancelled from the head, the middle and the tail of the list
+    for (auto& test : timers)
+        Start(test, 100, 0);
+
+    TimerWheel_Cancel(&timers[5].timer);
+    TimerWheel_Cancel(&timers[2].timer);
+    TimerWheel_Cancel(&timers[0].timer);
+    TimerWheel_Cancel(&timers[0].timer);
+
+    TEST_CHECK(!TimerWheel_IsStarted(&timers[0].timer) && TimerWheel_IsStarted(&timers[1].timer));
+
+    // restarted later, it fires once at the new time only
+    nativeTime = 40;
+
+    TEST_CHECK(TimerWheel_Start(&timers[3].timer, 5000, 0, &Expired, &timers[3]) == TinyCLR_Result::Success);
+
+    timers[3].expected = 5040;
+
+    RunEvents(10000);
+
+    TEST_CHECK(timers[0].fired == 0 && timers[2].fired == 0 && timers[5].fired == 0);
+    TEST_CHECK(timers[1].fired == 1 && timers[4].fired == 1 && timers[1].wrong == 0 && timers[4].wrong == 0);
+    TEST_CHECK(timers[3].fired == 1 && timers[3].wrong == 0);
+
+    TEST_CHECK(TimerWheel_Start(nullptr, 1, 0, &Expired, nullptr) == TinyCLR_Result::ArgumentNull);
+    TEST_CHECK(TimerWheel_Start(&timers[0].timer, 1, 0, nullptr, nullptr) == TinyCLR_Result::ArgumentNull);
+    TEST_CHECK(mockInterruptsDisabled == 0);
+}
+
+int main() {
+    srand(1);
+
+    CheckLevels();
+    CheckSteps();
+    CheckFarList();
+    CheckPeriodic();
+    CheckResolution();
+    CheckCancelAndRestart();
+
+    return TEST_RESULT();
+}
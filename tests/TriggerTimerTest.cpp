@@ -0,0 +1,74 @@
+// Copyright GHI Electronics, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Runs TriggerTimer_Program, which paces the STM32F4/F7 ADC scans and DAC streams, against a timer register block
+// in memory. Built against the STM32F429 device header.
+
+#include <math.h>
+#include <string.h>
+
+#include "stm32f4xx.h"
+#include "Drivers/TriggerTimer/TriggerTimer.h"
+#include "Test.h"
+
+#define FIELD(value, name) (((value) & name##_Msk) >> name##_Pos)
+
+// 84 MHz, the APB1 timer clock of the 168 MHz parts
+#define TIMER_CLOCK_HZ 84000000
+
+static void CheckTrigger(double frequency) {
+    TIM_TypeDef timer;
+
+    memset(&timer, 0xFF, sizeof(timer));
+
+    auto actual = TriggerTimer_Program(timer, TIMER_CLOCK_HZ, frequency);
+    auto prescale = timer.PSC + 1.0;
+    auto reload = timer.ARR + 1.0;
+
+    TEST_CHECK(timer.PSC <= 0xFFFF);
+    TEST_CHECK(timer.ARR <= 0xFFFF);
+    TEST_CHECK(actual == TIMER_CLOCK_HZ / (prescale * reload));
+
+    // the reload drops less than one prescaled tick, rounding the tick count adds half a tick
+    TEST_CHECK(fabs(prescale * reload - TIMER_CLOCK_HZ / frequency) < prescale + 0.5);
+
+    // TRGO on update, stopped, no interrupts, prescaler loaded
+    TEST_CHECK(FIELD(timer.CR2, TIM_CR2_MMS) == 2);
+    TEST_CHECK(timer.CR1 == 0);
+    TEST_CHECK(timer.DIER == 0);
+    TEST_CHECK(timer.EGR == TIM_EGR_UG);
+    TEST_CHECK(timer.SR == 0);
+}
+
+static void CheckTriggers() {
+    CheckTrigger(10000);
+    CheckTrigger(1);
+    CheckTrigger(0.02);
+    CheckTrigger(TIMER_CLOCK_HZ / 2);
+
+    for (auto frequency = 0.05; frequency < 1000000; frequency *= 1.37)
+        CheckTrigger(frequency);
+
+    TIM_TypeDef timer;
+
+    // exact periods need no prescaler below 65536 ticks
+    TEST_CHECK(TriggerTimer_Program(timer, TIMER_CLOCK_HZ, 10000) == 10000);
+    TEST_CHECK(timer.PSC == 0 && timer.ARR == 8399);
+}
+
+int main() {
+    CheckTriggers();
+
+    return TEST_RESULT();
+}